@@ -48,8 +48,30 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
         get_clause(x->conds, query->conds);
         check_clause(query->tables, query->conds);
     } else if (auto x = std::dynamic_pointer_cast<ast::UpdateStmt>(parse)) {
-        /** TODO: */
-
+        // 处理set子句
+        TabMeta &tab = sm_manager_->db_.get_table(x->tab_name);
+        for (auto &sv_set_clause : x->set_clauses) {
+            SetClause set_clause = {.lhs = {.tab_name = x->tab_name, .col_name = sv_set_clause->col_name},
+                                    .rhs = convert_sv_value(sv_set_clause->val),
+                                    .is_incr = !sv_set_clause->incr_col.empty()};
+            auto col = tab.get_col(sv_set_clause->col_name);
+            if (set_clause.is_incr) {
+                // 只支持 col = col + value，并且只能用于数值字段
+                if (sv_set_clause->incr_col != sv_set_clause->col_name) {
+                    throw InternalError("Only col = col + value is supported in SET clause");
+                }
+                if (col->type == TYPE_STRING) {
+                    throw IncompatibleTypeError(coltype2str(col->type), "number");
+                }
+            }
+            if (col->type != set_clause.rhs.type) {
+                throw IncompatibleTypeError(coltype2str(col->type), coltype2str(set_clause.rhs.type));
+            }
+            query->set_clauses.push_back(set_clause);
+        }
+        //处理where条件
+        get_clause(x->conds, query->conds);
+        check_clause({x->tab_name}, query->conds);
     } else if (auto x = std::dynamic_pointer_cast<ast::DeleteStmt>(parse)) {
         //处理where条件
         get_clause(x->conds, query->conds);
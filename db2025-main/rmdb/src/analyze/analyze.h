@@ -12,6 +12,7 @@ See the Mulan PSL v2 for more details. */
 
 #include <cassert>
 #include <cstring>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,8 +25,12 @@ class Query{
     public:
     std::shared_ptr<ast::TreeNode> parse;
     // TODO jointree
-    // where条件
+    // where条件，逻辑优化后只保留多表之间的连接条件
     std::vector<Condition> conds;
+    // 逻辑优化下推到各个表扫描算子上的单表条件
+    std::map<std::string, std::vector<Condition>> tab_conds;
+    // 逻辑优化后各个表需要向上层输出的列，不存在表示输出该表的全部列
+    std::map<std::string, std::vector<TabCol>> tab_cols;
     // 投影列
     std::vector<TabCol> cols;
     // 表名
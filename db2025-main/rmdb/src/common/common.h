@@ -70,6 +70,21 @@ struct Value {
             memcpy(raw->data, str_val.c_str(), str_val.size());
         }
     }
+
+    /* 把数值加到dest处同类型的字段上，用于 col = col + value */
+    void add_to(char *dest) const {
+        if (type == TYPE_INT) {
+            int val;
+            memcpy(&val, dest, sizeof(int));
+            val += int_val;
+            memcpy(dest, &val, sizeof(int));
+        } else if (type == TYPE_FLOAT) {
+            float val;
+            memcpy(&val, dest, sizeof(float));
+            val += float_val;
+            memcpy(dest, &val, sizeof(float));
+        }
+    }
 };
 
 enum CompOp { OP_EQ, OP_NE, OP_LT, OP_GT, OP_LE, OP_GE };
@@ -85,4 +100,5 @@ struct Condition {
 struct SetClause {
     TabCol lhs;
     Value rhs;
+    bool is_incr = false;   // true时rhs是增量，即 lhs = lhs + rhs
 };
\ No newline at end of file
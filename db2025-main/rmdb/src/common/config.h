@@ -13,12 +13,16 @@ See the Mulan PSL v2 for more details. */
 #include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <string>
 
 #define BUFFER_LENGTH 8192
 
 /** Cycle detection is performed every CYCLE_DETECTION_INTERVAL milliseconds. */
 extern std::chrono::milliseconds cycle_detection_interval;
 
+/** Under MVCC, versions older than the watermark are garbage collected every GC_INTERVAL milliseconds. */
+extern std::chrono::milliseconds gc_interval;
+
 /** True if logging should be enabled, false otherwise. */
 extern std::atomic<bool> enable_logging;
 
@@ -38,6 +42,10 @@ static constexpr int BUFFER_POOL_SIZE = 65536;                                //
 // static constexpr int BUFFER_POOL_SIZE = 262144;                                // size of buffer pool 1GB
 static constexpr int LOG_BUFFER_SIZE = (1024 * PAGE_SIZE);                    // size of a log buffer in byte
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr double IX_BULK_FILL_FACTOR = 0.9;                            // fill factor of b+ tree nodes built by bulk loading
+static constexpr double IX_RIGHT_SPLIT_FACTOR = 0.9;                          // ratio kept in the left node when the rightmost b+ tree node splits
+static constexpr size_t IX_SORT_MEMORY = 64 << 20;                            // memory budget of index external sort in byte 64MB
+static constexpr int IX_BLOOM_BITS_PER_KEY = 10;                              // bits per key of index bloom filters, about 1% false positives
 
 using frame_id_t = int32_t;  // frame id type, 帧页ID, 页在BufferPool中的存储单元称为帧,一帧对应一页
 using page_id_t = int32_t;   // page id type , 页ID
@@ -54,3 +62,5 @@ static const std::string LOG_FILE_NAME = "db.log";
 static const std::string REPLACER_TYPE = "LRU";
 
 static const std::string DB_META_NAME = "db.meta";
+
+static const std::string DB_STATS_NAME = "db.stats";
@@ -14,7 +14,7 @@ See the Mulan PSL v2 for more details. */
 #include "transaction/concurrency/lock_manager.h"
 #include "recovery/log_manager.h"
 
-// class TransactionManager;
+class TransactionManager;
 
 // used for data_send
 static int const_offset = -1;
@@ -28,11 +28,12 @@ public:
             ellipsis_ = false;
           }
 
-    // TransactionManager *txn_mgr_;
+    TransactionManager *txn_mgr_ = nullptr;     // 事务管理器，MVCC下读取历史版本时使用
     LockManager *lock_mgr_;
     LogManager *log_mgr_;
     Transaction *txn_;
     char *data_send_;
     int *offset_;
     bool ellipsis_;
+    bool escrow_ = false;   // 正在为使用escrow锁的update扫描记录，对记录加escrow锁而不是S锁
 };
\ No newline at end of file
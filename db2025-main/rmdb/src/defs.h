@@ -52,6 +52,11 @@ inline std::string coltype2str(ColType type) {
     return m.at(type);
 }
 
+// 索引的类型，B+树支持范围查找，可扩展哈希只支持所有索引字段上的等值查找
+enum IndexType {
+    INDEX_BTREE, INDEX_HASH
+};
+
 class RecScan {
 public:
     virtual ~RecScan() = default;
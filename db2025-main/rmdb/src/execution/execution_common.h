@@ -10,16 +10,484 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
-#include <vector>
+#include <cstring>
+#include <mutex>
 #include <optional>
-
+#include <shared_mutex>
+#include <thread>
+#include <vector>
 
 #include "transaction/transaction.h"
 #include "transaction/transaction_manager.h"
 #include "common/common.h"
+#include "common/context.h"
+#include "record/rm_file_handle.h"
+#include "system/sm_manager.h"
+
+/* 从记录中读取字段的值 */
+inline Value GetColumnValue(const ColMeta &col, const char *data) {
+    Value value;
+    const char *src = data + col.offset;
+    switch (col.type) {
+        case TYPE_INT:
+            value.set_int(*(const int *)src);
+            break;
+        case TYPE_FLOAT:
+            value.set_float(*(const float *)src);
+            break;
+        default:
+            value.set_str(std::string(src, strnlen(src, col.len)));
+            break;
+    }
+    return value;
+}
+
+/* 把字段的值写入记录，字符串不足字段长度的部分填0 */
+inline void SetColumnValue(const ColMeta &col, char *data, const Value &value) {
+    char *dest = data + col.offset;
+    switch (col.type) {
+        case TYPE_INT:
+            memcpy(dest, &value.int_val, sizeof(int));
+            break;
+        case TYPE_FLOAT:
+            memcpy(dest, &value.float_val, sizeof(float));
+            break;
+        default:
+            if ((int)value.str_val.size() > col.len) {
+                throw StringOverflowError();
+            }
+            memset(dest, 0, col.len);
+            memcpy(dest, value.str_val.c_str(), value.str_val.size());
+            break;
+    }
+}
+
+/**
+ * @description: 按照撤销日志从新到旧的顺序，从表堆中的元组恢复出旧版本
+ * @return {optional<RmRecord>} 旧版本，旧版本是删除标记时返回nullopt
+ * @param {TabMeta*} schema 表的元数据
+ * @param {RmRecord&} base_tuple 表堆中的元组
+ * @param {TupleMeta&} base_meta 表堆中元组的元信息
+ * @param {vector<UndoLog>&} undo_logs 从新到旧的撤销日志，每条日志保存被修改的字段在修改之前的值
+ */
+inline auto ReconstructTuple(const TabMeta *schema, const RmRecord &base_tuple, const TupleMeta &base_meta,
+                             const std::vector<UndoLog> &undo_logs) -> std::optional<RmRecord> {
+    RmRecord tuple(base_tuple);
+    bool is_deleted = base_meta.is_deleted_;
+    for (auto &undo_log : undo_logs) {
+        is_deleted = undo_log.is_deleted_;
+        if (is_deleted) {
+            continue;
+        }
+        auto value = undo_log.tuple_.begin();
+        for (size_t i = 0; i < schema->cols.size(); i++) {
+            if (undo_log.modified_fields_[i]) {
+                SetColumnValue(schema->cols[i], tuple.data, *value++);
+            }
+        }
+    }
+    if (is_deleted) {
+        return std::nullopt;
+    }
+    return tuple;
+}
+
+/**
+ * @description: 快照隔离下的写写冲突：元组最后一次修改在事务开始之后提交，或者由其他未提交的事务修改
+ * @param {timestamp_t} tuple_ts 元组的时间戳，未提交的修改为修改者的临时时间戳
+ */
+inline auto IsWriteWriteConflict(timestamp_t tuple_ts, Transaction *txn) -> bool {
+    return tuple_ts > txn->get_read_ts() && tuple_ts != txn->get_temp_ts();
+}
+
+/* 当前语句是否在MVCC下执行 */
+inline bool IsMvcc(Context *context) {
+    return context != nullptr && context->txn_ != nullptr && context->txn_mgr_ != nullptr &&
+           context->txn_mgr_->get_concurrency_mode() == ConcurrencyMode::MVCC;
+}
+
+/* 当前语句是否在OCC下执行 */
+inline bool IsOcc(Context *context) {
+    return context != nullptr && context->txn_ != nullptr && context->txn_mgr_ != nullptr &&
+           context->txn_mgr_->get_concurrency_mode() == ConcurrencyMode::OCC;
+}
+
+/* 当前语句是否需要加锁，MVCC下读操作不加锁，写写冲突通过时间戳检测；OCC下提交时验证 */
+inline bool NeedLock(Context *context) {
+    return context != nullptr && context->txn_ != nullptr && context->lock_mgr_ != nullptr && !IsMvcc(context) &&
+           !IsOcc(context);
+}
+
+/**
+ * @description: MVCC下读取事务txn的快照中rid的版本，不加锁。
+ * 元组的时间戳不大于读时间戳或者是自己的修改时直接读取表堆中的元组，否则沿着撤销链找到第一个时间戳不大于读时间戳的版本
+ * @return {optional<RmRecord>} 可见的版本，记录在快照中不存在时返回nullopt
+ */
+inline auto GetVisibleTuple(TransactionManager *txn_mgr, Transaction *txn, const TabMeta *schema, RmFileHandle *fh,
+                            const Rid &rid) -> std::optional<RmRecord> {
+    auto page_info = txn_mgr->GetPageVersionInfo(fh->GetFd(), rid.page_no);
+    std::unique_ptr<RmRecord> base;
+    TupleMeta meta;
+    std::optional<UndoLink> undo_link;
+    while (true) {
+        uint64_t insert_seq = fh->get_insert_seq();
+        bool has_meta;
+        {
+            std::shared_lock<std::shared_mutex> lock(page_info->mutex_);
+            base = fh->get_record(rid, nullptr);
+            auto meta_it = page_info->tuple_meta_.find(rid.slot_no);
+            has_meta = meta_it != page_info->tuple_meta_.end();
+            meta = has_meta ? meta_it->second : TransactionManager::DEFAULT_TUPLE_META;
+            auto link_it = page_info->prev_version_.find(rid.slot_no);
+            undo_link = link_it != page_info->prev_version_.end() ? std::optional<UndoLink>(link_it->second.prev_)
+                                                                   : std::nullopt;
+        }
+        // 没有元信息的可能是正在插入、还没有设置元信息的记录，读取期间没有插入时才是没有修改过的记录
+        if (has_meta || (insert_seq % 2 == 0 && fh->get_insert_seq() == insert_seq)) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    if (base == nullptr) {
+        return std::nullopt;
+    }
+    timestamp_t read_ts = txn->get_read_ts();
+    if (meta.ts_ <= read_ts || meta.ts_ == txn->get_temp_ts()) {
+        if (meta.is_deleted_) {
+            return std::nullopt;
+        }
+        return RmRecord(*base);
+    }
+    std::vector<UndoLog> undo_logs;
+    while (undo_link.has_value() && undo_link->IsValid()) {
+        auto undo_log = txn_mgr->GetUndoLogOptional(*undo_link);
+        if (!undo_log.has_value()) {
+            break;
+        }
+        undo_logs.push_back(*undo_log);
+        if (undo_log->ts_ <= read_ts) {
+            return ReconstructTuple(schema, *base, meta, undo_logs);
+        }
+        undo_link = undo_log->prev_version_;
+    }
+    // 撤销链上没有足够老的版本，记录在快照之后插入
+    return std::nullopt;
+}
+
+/**
+ * @description: OCC下读取一条记录，不加锁。自己写过的记录读取写集中缓存的版本；
+ * 否则读取前后两次的版本字相同并且没有被锁住时读到的记录是一致的，把版本字加入读集，提交时验证
+ * @return {unique_ptr<RmRecord>} 读到的记录，记录不存在时返回nullptr
+ */
+inline std::unique_ptr<RmRecord> OccReadTuple(Context *context, RmFileHandle *fh, const Rid &rid) {
+    Transaction *txn = context->txn_;
+    auto &write_set = txn->get_occ_write_set();
+    if (!write_set.empty()) {
+        auto it = write_set.find(LockDataId(fh->GetFd(), rid, LockDataType::RECORD));
+        if (it != write_set.end()) {
+            switch (it->second.wtype_) {
+                case WType::INSERT_TUPLE:
+                    return fh->get_record(rid, context);
+                case WType::DELETE_TUPLE:
+                    return nullptr;
+                case WType::UPDATE_TUPLE:
+                    return std::make_unique<RmRecord>(*it->second.tuple_);
+            }
+        }
+    }
+    auto version = context->txn_mgr_->GetTupleVersion(fh, rid);
+    uint64_t tid;
+    std::unique_ptr<RmRecord> rec;
+    while (true) {
+        tid = version->load(std::memory_order_acquire);
+        if (tid & OCC_LOCK_BIT) {
+            // 其他事务正在安装写操作，临界区很短
+            std::this_thread::yield();
+            continue;
+        }
+        rec = (tid & OCC_ABSENT_BIT) ? nullptr : fh->get_record(rid, context);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (version->load(std::memory_order_relaxed) == tid) {
+            break;
+        }
+    }
+    txn->append_occ_read(version, tid);
+    return rec;
+}
+
+/**
+ * @description: 扫描算子读取一条记录：MVCC下不加锁，读取快照中的版本；OCC下不加锁，记录读到的版本；
+ * 两阶段封锁下先加行级共享锁
+ * @return {unique_ptr<RmRecord>} 读到的记录，记录对当前事务不可见时返回nullptr
+ */
+inline std::unique_ptr<RmRecord> ReadTuple(Context *context, const TabMeta &tab, RmFileHandle *fh, const Rid &rid) {
+    if (IsMvcc(context)) {
+        auto tuple = GetVisibleTuple(context->txn_mgr_, context->txn_, &tab, fh, rid);
+        return tuple.has_value() ? std::make_unique<RmRecord>(*tuple) : nullptr;
+    }
+    if (IsOcc(context)) {
+        return OccReadTuple(context, fh, rid);
+    }
+    if (NeedLock(context)) {
+        Transaction *txn = context->txn_;
+        if (context->escrow_) {
+            context->lock_mgr_->lock_escrow_on_record(txn, rid, fh->GetFd());
+            auto rec = fh->get_record(rid, context);
+            // 其他事务的增量可能正在写入记录，只有自己缓存的增量需要加上
+            auto escrow_record = txn->get_escrow_set().find(LockDataId(fh->GetFd(), rid, LockDataType::RECORD));
+            if (escrow_record != txn->get_escrow_set().end()) {
+                for (auto &[offset, delta] : escrow_record->second.deltas_) {
+                    delta.add_to(rec->data + offset);
+                }
+            }
+            return rec;
+        }
+        context->lock_mgr_->lock_shared_on_record(txn, rid, fh->GetFd());
+        if (!txn->get_escrow_set().empty() && context->txn_mgr_ != nullptr) {
+            // 持有escrow锁时再加S锁会升级为X锁，此时可以把缓存的增量写入记录
+            context->txn_mgr_->FlushEscrow(txn, fh, rid);
+        }
+    }
+    return fh->get_record(rid, context);
+}
+
+/* 两阶段封锁下对记录加X锁，事务在这条记录上缓存的增量先写入记录 */
+inline void LockRecordExclusive(Context *context, RmFileHandle *fh, const Rid &rid) {
+    context->lock_mgr_->lock_exclusive_on_record(context->txn_, rid, fh->GetFd());
+    if (!context->txn_->get_escrow_set().empty() && context->txn_mgr_ != nullptr) {
+        context->txn_mgr_->FlushEscrow(context->txn_, fh, rid);
+    }
+}
+
+/**
+ * @description: 两阶段封锁下update是否使用escrow锁：所有set子句都是 col = col + value，
+ * 并且被修改的字段不出现在where条件和任何索引中。escrow锁之间相容，增量在提交时才写入记录，
+ * 因此where条件和索引key不能依赖这些字段
+ */
+inline bool UseEscrow(Context *context, const TabMeta &tab, const std::vector<SetClause> &set_clauses,
+                      const std::vector<Condition> &conds) {
+    if (!NeedLock(context) || context->txn_mgr_ == nullptr || !context->txn_mgr_->get_escrow_enabled() ||
+        set_clauses.empty()) {
+        return false;
+    }
+    for (auto &set_clause : set_clauses) {
+        auto &col_name = set_clause.lhs.col_name;
+        if (!set_clause.is_incr) {
+            return false;
+        }
+        for (auto &cond : conds) {
+            if (cond.lhs_col.col_name == col_name || (!cond.is_rhs_val && cond.rhs_col.col_name == col_name)) {
+                return false;
+            }
+        }
+        for (auto &index : tab.indexes) {
+            for (auto &col : index.cols) {
+                if (col.name == col_name) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @description: MVCC下插入记录，记录的时间戳为事务的临时时间戳，提交之前对其他事务不可见。
+ * 同一张表上的插入串行执行，插入期间insert_seq_为奇数，读者据此区分正在插入的记录和没有修改过的记录
+ * @return {Rid} 插入的位置
+ */
+inline Rid MvccInsertTuple(Context *context, const TabMeta &tab, RmFileHandle *fh, char *buf) {
+    Transaction *txn = context->txn_;
+    Rid rid;
+    {
+        std::lock_guard<std::mutex> insert_lock(fh->get_insert_latch());
+        fh->inc_insert_seq();
+        rid = fh->insert_record(buf, context);
+        auto page_info = context->txn_mgr_->GetPageVersionInfo(fh->GetFd(), rid.page_no);
+        {
+            std::unique_lock<std::shared_mutex> lock(page_info->mutex_);
+            page_info->tuple_meta_[rid.slot_no] = TupleMeta{txn->get_temp_ts(), false};
+            page_info->prev_version_.erase(rid.slot_no);
+        }
+        fh->inc_insert_seq();
+    }
+    txn->append_write_record(new WriteRecord(WType::INSERT_TUPLE, tab.name, rid));
+    return rid;
+}
+
+/**
+ * @description: MVCC下原地更新或者删除记录。检查写写冲突，冲突时回滚当前事务；
+ * 否则把被修改的字段的旧值写入撤销日志并链接到版本链的头部，同一个事务再次修改时合并到已有的撤销日志中。
+ * 删除只修改元信息，表堆中的元组保留给更老的快照读取
+ * @param {RmRecord*} new_tuple 更新之后的记录，nullptr表示删除
+ */
+inline void MvccWriteTuple(Context *context, const TabMeta &tab, RmFileHandle *fh, const Rid &rid,
+                           const RmRecord *new_tuple) {
+    Transaction *txn = context->txn_;
+    auto page_info = context->txn_mgr_->GetPageVersionInfo(fh->GetFd(), rid.page_no);
+    {
+        std::unique_lock<std::shared_mutex> lock(page_info->mutex_);
+        auto meta_it = page_info->tuple_meta_.find(rid.slot_no);
+        TupleMeta meta = meta_it != page_info->tuple_meta_.end() ? meta_it->second : TransactionManager::DEFAULT_TUPLE_META;
+        if (IsWriteWriteConflict(meta.ts_, txn) || (meta.is_deleted_ && meta.ts_ != txn->get_temp_ts())) {
+            lock.unlock();
+            txn->set_state(TransactionState::ABORTED);
+            throw TransactionAbortException(txn->get_transaction_id(), AbortReason::WRITE_WRITE_CONFLICT);
+        }
+        auto base = fh->get_record(rid, context);
+        std::vector<bool> modified(tab.cols.size(), false);
+        if (new_tuple != nullptr) {
+            for (size_t i = 0; i < tab.cols.size(); i++) {
+                auto &col = tab.cols[i];
+                modified[i] = memcmp(base->data + col.offset, new_tuple->data + col.offset, col.len) != 0;
+            }
+        }
+        auto link_it = page_info->prev_version_.find(rid.slot_no);
+        if (meta.ts_ != txn->get_temp_ts()) {
+            UndoLog undo_log;
+            undo_log.is_deleted_ = false;
+            undo_log.modified_fields_ = modified;
+            for (size_t i = 0; i < tab.cols.size(); i++) {
+                if (modified[i]) {
+                    undo_log.tuple_.push_back(GetColumnValue(tab.cols[i], base->data));
+                }
+            }
+            undo_log.ts_ = meta.ts_;
+            if (link_it != page_info->prev_version_.end()) {
+                undo_log.prev_version_ = link_it->second.prev_;
+            }
+            page_info->prev_version_[rid.slot_no] =
+                VersionUndoLink{context->txn_mgr_->AppendUndoLog(txn, std::move(undo_log))};
+        } else if (link_it != page_info->prev_version_.end() &&
+                   link_it->second.prev_.prev_txn_ == txn->get_transaction_id()) {
+            // 已经修改过的记录，撤销日志中补充本次第一次修改的字段；自己插入的记录没有撤销日志
+            int log_idx = link_it->second.prev_.prev_log_idx_;
+            UndoLog undo_log = txn->GetUndoLog(log_idx);
+            std::vector<Value> old_values;
+            auto value = undo_log.tuple_.begin();
+            for (size_t i = 0; i < tab.cols.size(); i++) {
+                if (undo_log.modified_fields_[i]) {
+                    old_values.push_back(*value++);
+                } else if (modified[i]) {
+                    old_values.push_back(GetColumnValue(tab.cols[i], base->data));
+                    undo_log.modified_fields_[i] = true;
+                }
+            }
+            undo_log.tuple_ = std::move(old_values);
+            context->txn_mgr_->ModifyUndoLog(txn, log_idx, std::move(undo_log));
+        }
+        if (new_tuple != nullptr) {
+            fh->update_record(rid, new_tuple->data, context);
+        }
+        page_info->tuple_meta_[rid.slot_no] = TupleMeta{txn->get_temp_ts(), new_tuple == nullptr};
+    }
+    txn->append_write_record(
+        new WriteRecord(new_tuple != nullptr ? WType::UPDATE_TUPLE : WType::DELETE_TUPLE, tab.name, rid));
+}
+
+/**
+ * @description: OCC下插入记录：直接写入表堆，版本字标记为不存在，提交之前对其他事务不可见，提交时清除标记。
+ * 与MVCC的插入一样在插入latch下串行执行
+ * @return {Rid} 插入的位置
+ */
+inline Rid OccInsertTuple(Context *context, const TabMeta &tab, RmFileHandle *fh, char *buf) {
+    Transaction *txn = context->txn_;
+    Rid rid;
+    std::atomic<uint64_t> *version;
+    {
+        std::lock_guard<std::mutex> insert_lock(fh->get_insert_latch());
+        rid = fh->insert_record(buf, context);
+        version = context->txn_mgr_->GetTupleVersion(fh, rid);
+        version->fetch_or(OCC_ABSENT_BIT);
+    }
+    txn->append_write_record(new WriteRecord(WType::INSERT_TUPLE, tab.name, rid));
+    txn->get_occ_write_set().emplace(LockDataId(fh->GetFd(), rid, LockDataType::RECORD),
+                                     OccWriteRecord{WType::INSERT_TUPLE, tab.name, rid, version, nullptr});
+    return rid;
+}
+
+/* 记录在索引上的key，记录格式 */
+inline std::vector<char> GetIndexKey(const IndexMeta &index, const char *rec) {
+    std::vector<char> key(index.col_tot_len);
+    int offset = 0;
+    for (auto &col : index.cols) {
+        memcpy(key.data() + offset, rec + col.offset, col.len);
+        offset += col.len;
+    }
+    return key;
+}
+
+inline void InsertIndexEntry(SmManager *sm_manager, const TabMeta &tab, const IndexMeta &index, const char *rec,
+                             const Rid &rid, Transaction *txn) {
+    auto ix_name = sm_manager->get_ix_manager()->get_index_name(tab.name, index.cols);
+    auto key = GetIndexKey(index, rec);
+    if (index.type == INDEX_HASH) {
+        sm_manager->hhs_.at(ix_name)->insert_entry(key.data(), rid, txn);
+    } else {
+        sm_manager->ihs_.at(ix_name)->insert_entry(key.data(), rid, txn);
+    }
+}
 
-auto ReconstructTuple(const TabMeta *schema, const RmRecord &base_tuple, const TupleMeta &base_meta,
-                      const std::vector<UndoLog> &undo_logs) -> std::optional<RmRecord>;
+inline void DeleteIndexEntry(SmManager *sm_manager, const TabMeta &tab, const IndexMeta &index, const char *rec,
+                             const Rid &rid, Transaction *txn) {
+    auto ix_name = sm_manager->get_ix_manager()->get_index_name(tab.name, index.cols);
+    auto key = GetIndexKey(index, rec);
+    if (index.type == INDEX_HASH) {
+        sm_manager->hhs_.at(ix_name)->delete_entry(key.data(), txn);
+    } else {
+        sm_manager->ihs_.at(ix_name)->delete_entry(key.data(), rid, txn);
+    }
+}
 
+/* 记录在索引字段上的值是否改变 */
+inline bool IndexKeyChanged(const IndexMeta &index, const char *old_rec, const char *new_rec) {
+    for (auto &col : index.cols) {
+        if (memcmp(old_rec + col.offset, new_rec + col.offset, col.len) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
-auto IsWriteWriteConflict(timestamp_t tuple_ts, Transaction *txn) -> bool;
+/**
+ * @description: OCC下更新或者删除记录，写操作缓存在写集中，提交时安装。
+ * 自己插入的记录其他事务看不到，直接在表堆和索引中修改
+ * @param {RmRecord*} new_tuple 更新之后的记录，nullptr表示删除
+ */
+inline void OccWriteTuple(SmManager *sm_manager, Context *context, const TabMeta &tab, RmFileHandle *fh,
+                          const Rid &rid, const RmRecord *new_tuple) {
+    Transaction *txn = context->txn_;
+    auto &write_set = txn->get_occ_write_set();
+    LockDataId lock_data_id(fh->GetFd(), rid, LockDataType::RECORD);
+    auto it = write_set.find(lock_data_id);
+    if (it != write_set.end() && it->second.wtype_ == WType::INSERT_TUPLE) {
+        auto rec = fh->get_record(rid, context);
+        if (new_tuple != nullptr) {
+            for (auto &index : tab.indexes) {
+                if (IndexKeyChanged(index, rec->data, new_tuple->data)) {
+                    DeleteIndexEntry(sm_manager, tab, index, rec->data, rid, txn);
+                    InsertIndexEntry(sm_manager, tab, index, new_tuple->data, rid, txn);
+                }
+            }
+            fh->update_record(rid, new_tuple->data, context);
+            return;
+        }
+        for (auto &index : tab.indexes) {
+            DeleteIndexEntry(sm_manager, tab, index, rec->data, rid, txn);
+        }
+        {
+            std::lock_guard<std::mutex> insert_lock(fh->get_insert_latch());
+            fh->delete_record(rid, context);
+        }
+        write_set.erase(it);
+        return;
+    }
+    if (it == write_set.end()) {
+        it = write_set
+                 .emplace(lock_data_id, OccWriteRecord{WType::UPDATE_TUPLE, tab.name, rid,
+                                                       context->txn_mgr_->GetTupleVersion(fh, rid), nullptr})
+                 .first;
+    }
+    it->second.wtype_ = new_tuple != nullptr ? WType::UPDATE_TUPLE : WType::DELETE_TUPLE;
+    it->second.tuple_ = new_tuple != nullptr ? std::make_unique<RmRecord>(*new_tuple) : nullptr;
+}
@@ -31,6 +31,7 @@ const char *help_info = "Supported SQL syntax:\n"
                    "  DELETE FROM table_name [WHERE where_clause]\n"
                    "  UPDATE table_name SET column_name = value [, column_name = value ...] [WHERE where_clause]\n"
                    "  SELECT selector FROM table_name [WHERE where_clause]\n"
+                   "  ANALYZE [table_name]\n"
                    "type:\n"
                    "  {INT | FLOAT | CHAR(n)}\n"
                    "where_clause:\n"
@@ -60,7 +61,7 @@ void QlManager::run_mutli_query(std::shared_ptr<Plan> plan, Context *context){
             }
             case T_CreateIndex:
             {
-                sm_manager_->create_index(x->tab_name_, x->tab_col_names_, context);
+                sm_manager_->create_index(x->tab_name_, x->tab_col_names_, context, x->index_type_, true, x->bloom_);
                 break;
             }
             case T_DropIndex:
@@ -95,6 +96,17 @@ void QlManager::run_cmd_utility(std::shared_ptr<Plan> plan, txn_id_t *txn_id, Co
                 sm_manager_->desc_table(x->tab_name_, context);
                 break;
             }
+            case T_Analyze:
+            {
+                if (!x->tab_name_.empty()) {
+                    sm_manager_->analyze_table(x->tab_name_, context);
+                    break;
+                }
+                for (auto &entry : sm_manager_->fhs_) {
+                    sm_manager_->analyze_table(entry.first, context);
+                }
+                break;
+            }
             case T_Transaction_begin:
             {
                 // 显示开启一个事务
@@ -15,35 +15,68 @@ See the Mulan PSL v2 for more details. */
 #include "index/ix.h"
 #include "system/sm.h"
 
+/**
+ * 排序算子，读出儿子节点的所有记录后按照排序字段排序。
+ * 排序字段转换成规范化的key（见ix_encode_col），降序时把key的每个字节取反，排序时只需要按字节比较key
+ */
 class SortExecutor : public AbstractExecutor {
    private:
     std::unique_ptr<AbstractExecutor> prev_;
     ColMeta cols_;                              // 框架中只支持一个键排序，需要自行修改数据结构支持多个键排序
-    size_t tuple_num;
     bool is_desc_;
-    std::vector<size_t> used_tuple;
-    std::unique_ptr<RmRecord> current_tuple;
+    std::vector<std::unique_ptr<RmRecord>> tuples_;     // 儿子节点的所有记录
+    std::vector<char> keys_;                    // 每条记录的规范化排序key，长度为cols_.len
+    std::vector<size_t> order_;                 // 排序后记录的下标
+    size_t pos_;                                // 当前记录在order_中的位置
 
    public:
     SortExecutor(std::unique_ptr<AbstractExecutor> prev, TabCol sel_cols, bool is_desc) {
         prev_ = std::move(prev);
         cols_ = prev_->get_col_offset(sel_cols);
         is_desc_ = is_desc;
-        tuple_num = 0;
-        used_tuple.clear();
+        pos_ = 0;
     }
 
-    void beginTuple() override { 
-        
-    }
+    size_t tupleLen() const override { return prev_->tupleLen(); }
 
-    void nextTuple() override {
-        
-    }
+    const std::vector<ColMeta> &cols() const override { return prev_->cols(); }
 
-    std::unique_ptr<RmRecord> Next() override {
-        return nullptr;
+    std::string getType() override { return "SortExecutor"; }
+
+    void beginTuple() override {
+        tuples_.clear();
+        keys_.clear();
+        size_t key_len = cols_.len;
+        for (prev_->beginTuple(); !prev_->is_end(); prev_->nextTuple()) {
+            auto rec = prev_->Next();
+            size_t offset = keys_.size();
+            keys_.resize(offset + key_len);
+            char *key = keys_.data() + offset;
+            ix_encode_col(key, rec->data + cols_.offset, cols_.type, cols_.len);
+            if (is_desc_) {
+                for (size_t i = 0; i < key_len; i++) {
+                    key[i] = ~key[i];
+                }
+            }
+            tuples_.push_back(std::move(rec));
+        }
+        order_.resize(tuples_.size());
+        for (size_t i = 0; i < order_.size(); i++) {
+            order_[i] = i;
+        }
+        std::stable_sort(order_.begin(), order_.end(), [&](size_t a, size_t b) {
+            return ix_key_compare(keys_.data() + a * key_len, keys_.data() + b * key_len, key_len) < 0;
+        });
+        pos_ = 0;
     }
 
+    void nextTuple() override { pos_++; }
+
+    bool is_end() const override { return pos_ >= order_.size(); }
+
+    std::unique_ptr<RmRecord> Next() override { return std::make_unique<RmRecord>(*tuples_[order_[pos_]]); }
+
+    ColMeta get_col_offset(const TabCol &target) override { return prev_->get_col_offset(target); }
+
     Rid &rid() override { return _abstract_rid; }
-};
\ No newline at end of file
+};
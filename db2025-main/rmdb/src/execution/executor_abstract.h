@@ -53,4 +53,43 @@ class AbstractExecutor {
         }
         return pos;
     }
+
+    /**
+     * @description: 判断记录是否满足条件，条件中的字段都要在rec_cols中
+     * @param {vector<ColMeta>&} rec_cols 记录包含的字段
+     * @param {Condition&} cond 条件，右侧为常量时常量的raw已经按照左侧字段的长度初始化
+     * @param {RmRecord*} rec 记录
+     */
+    bool eval_cond(const std::vector<ColMeta> &rec_cols, const Condition &cond, const RmRecord *rec) {
+        auto lhs_col = get_col(rec_cols, cond.lhs_col);
+        const char *lhs = rec->data + lhs_col->offset;
+        const char *rhs;
+        if (cond.is_rhs_val) {
+            rhs = cond.rhs_val.raw->data;
+        } else {
+            rhs = rec->data + get_col(rec_cols, cond.rhs_col)->offset;
+        }
+        int cmp = ix_compare(lhs, rhs, lhs_col->type, lhs_col->len);
+        switch (cond.op) {
+            case OP_EQ:
+                return cmp == 0;
+            case OP_NE:
+                return cmp != 0;
+            case OP_LT:
+                return cmp < 0;
+            case OP_GT:
+                return cmp > 0;
+            case OP_LE:
+                return cmp <= 0;
+            case OP_GE:
+                return cmp >= 0;
+            default:
+                throw InternalError("Unexpected op type");
+        }
+    }
+
+    bool eval_conds(const std::vector<ColMeta> &rec_cols, const std::vector<Condition> &conds, const RmRecord *rec) {
+        return std::all_of(conds.begin(), conds.end(),
+                           [&](const Condition &cond) { return eval_cond(rec_cols, cond, rec); });
+    }
 };
\ No newline at end of file
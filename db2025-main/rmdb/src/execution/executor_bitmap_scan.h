@@ -0,0 +1,241 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "executor_index_scan.h"
+
+/**
+ * 表中Rid的集合，第i位对应 Rid{i / slots_per_page, i % slots_per_page}，按位的顺序遍历时Rid按照页号从小到大排列；
+ * 多个索引得到的集合可以按位求交集（and条件）或并集（or条件）
+ */
+class RidBitmap {
+   private:
+    static constexpr int WORD_BITS = 64;
+
+    size_t slots_per_page_;
+    std::vector<uint64_t> words_;
+
+   public:
+    explicit RidBitmap(int slots_per_page) : slots_per_page_(slots_per_page) {}
+
+    void set(const Rid &rid) {
+        size_t pos = rid.page_no * slots_per_page_ + rid.slot_no;
+        if (pos / WORD_BITS >= words_.size()) {
+            words_.resize(pos / WORD_BITS + 1);
+        }
+        words_[pos / WORD_BITS] |= 1ULL << (pos % WORD_BITS);
+    }
+
+    bool test(const Rid &rid) const {
+        size_t pos = rid.page_no * slots_per_page_ + rid.slot_no;
+        return pos / WORD_BITS < words_.size() && (words_[pos / WORD_BITS] >> (pos % WORD_BITS) & 1);
+    }
+
+    void intersect(const RidBitmap &other) {
+        words_.resize(std::min(words_.size(), other.words_.size()));
+        for (size_t i = 0; i < words_.size(); i++) {
+            words_[i] &= other.words_[i];
+        }
+    }
+
+    void unite(const RidBitmap &other) {
+        words_.resize(std::max(words_.size(), other.words_.size()));
+        for (size_t i = 0; i < other.words_.size(); i++) {
+            words_[i] |= other.words_[i];
+        }
+    }
+
+    size_t count() const {
+        size_t res = 0;
+        for (uint64_t word : words_) {
+            res += __builtin_popcountll(word);
+        }
+        return res;
+    }
+
+    /**
+     * @description: 从*pos开始（包含*pos）查找下一个置位的位置
+     * @return {bool} 是否找到，找到时*pos为该位置
+     */
+    bool next(size_t *pos) const {
+        size_t i = *pos / WORD_BITS;
+        if (i >= words_.size()) {
+            return false;
+        }
+        uint64_t word = words_[i] & (~0ULL << (*pos % WORD_BITS));
+        while (word == 0) {
+            if (++i >= words_.size()) {
+                return false;
+            }
+            word = words_[i];
+        }
+        *pos = i * WORD_BITS + __builtin_ctzll(word);
+        return true;
+    }
+
+    Rid rid_at(size_t pos) const {
+        return Rid{.page_no = (int)(pos / slots_per_page_), .slot_no = (int)(pos % slots_per_page_)};
+    }
+
+    size_t slots_per_page() const { return slots_per_page_; }
+};
+
+/**
+ * bitmap heap scan：先扫描索引范围，把满足索引条件的Rid放进位图，多个索引的位图求交集，
+ * 然后按照页号的顺序回表，每个页面只fetch一次，读取页面中所有在位图中的记录之后再检查全部条件。
+ * 范围较大时普通的索引扫描按照key的顺序随机访问页面，同一个页面会被反复换入换出缓冲池；
+ * 输出的记录按照Rid的顺序排列，而不是索引key的顺序
+ */
+class BitmapHeapScanExecutor : public AbstractExecutor {
+   private:
+    std::string tab_name_;                      // 表名称
+    TabMeta tab_;                               // 表的元数据
+    std::vector<Condition> conds_;              // 扫描条件
+    RmFileHandle *fh_;                          // 表的数据文件句柄
+    std::vector<ColMeta> cols_;                 // 需要读取的字段
+    size_t len_;                                // 选取出来的一条记录的长度
+    std::vector<Condition> fed_conds_;          // 扫描条件，和conds_字段相同
+
+    std::vector<std::vector<std::string>> indexes_;     // 使用的B+树索引的字段，Rid集合取交集
+
+    std::unique_ptr<RidBitmap> bitmap_;         // 满足所有索引条件的Rid
+    size_t next_pos_ = 0;                       // 位图中下一个页面的第一位
+    std::vector<Rid> page_rids_;                // 当前页面中在位图里的记录
+    std::vector<std::unique_ptr<RmRecord>> page_recs_;
+    size_t pos_ = 0;                            // 当前记录在page_rids_中的位置
+    Rid rid_;
+
+    SmManager *sm_manager_;
+
+   public:
+    BitmapHeapScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                           std::vector<std::vector<std::string>> indexes, Context *context) {
+        sm_manager_ = sm_manager;
+        context_ = context;
+        tab_name_ = std::move(tab_name);
+        tab_ = sm_manager_->db_.get_table(tab_name_);
+        conds_ = std::move(conds);
+        indexes_ = std::move(indexes);
+        fh_ = sm_manager_->fhs_.at(tab_name_).get();
+        cols_ = tab_.cols;
+        len_ = cols_.back().offset + cols_.back().len;
+        std::map<CompOp, CompOp> swap_op = {
+            {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
+        };
+
+        for (auto &cond : conds_) {
+            if (cond.lhs_col.tab_name != tab_name_) {
+                // lhs is on other table, now rhs must be on this table
+                assert(!cond.is_rhs_val && cond.rhs_col.tab_name == tab_name_);
+                // swap lhs and rhs
+                std::swap(cond.lhs_col, cond.rhs_col);
+                cond.op = swap_op.at(cond.op);
+            }
+        }
+        fed_conds_ = conds_;
+    }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "BitmapHeapScanExecutor"; }
+
+    void beginTuple() override {
+        bitmap_.reset();
+        for (auto &index_col_names : indexes_) {
+            auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index_col_names)).get();
+            Iid lower, upper;
+            IndexScanExecutor::get_scan_range(ih, *tab_.get_index_meta(index_col_names), tab_name_, fed_conds_, lower,
+                                              upper);
+            auto bitmap = std::make_unique<RidBitmap>(fh_->get_file_hdr().num_records_per_page);
+            for (IxScan scan(ih, lower, upper, sm_manager_->get_bpm()); !scan.is_end(); scan.next()) {
+                bitmap->set(scan.rid());
+            }
+            if (bitmap_ == nullptr) {
+                bitmap_ = std::move(bitmap);
+            } else {
+                bitmap_->intersect(*bitmap);
+            }
+        }
+        next_pos_ = 0;
+        load_next_page();
+        find_next_valid();
+    }
+
+    void nextTuple() override {
+        pos_++;
+        find_next_valid();
+    }
+
+    bool is_end() const override { return pos_ >= page_rids_.size(); }
+
+    std::unique_ptr<RmRecord> Next() override { return std::make_unique<RmRecord>(*page_recs_[pos_]); }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
+    Rid &rid() override { return rid_; }
+
+   private:
+    /**
+     * @description: 读取位图中的下一个页面，没有更多页面时page_rids_为空
+     */
+    bool load_next_page() {
+        page_rids_.clear();
+        page_recs_.clear();
+        pos_ = 0;
+        size_t pos = next_pos_;
+        if (!bitmap_->next(&pos)) {
+            return false;
+        }
+        int page_no = bitmap_->rid_at(pos).page_no;
+        size_t page_end = (page_no + 1) * bitmap_->slots_per_page();
+        std::vector<int> slot_nos;
+        for (; pos < page_end && bitmap_->next(&pos) && pos < page_end; pos++) {
+            page_rids_.push_back(bitmap_->rid_at(pos));
+            slot_nos.push_back(page_rids_.back().slot_no);
+        }
+        next_pos_ = page_end;
+        if (IsMvcc(context_) || IsOcc(context_) || NeedLock(context_)) {
+            // 需要读取快照中的版本、记录读集或者加行级锁时逐条读取，跳过当前事务看不到的记录
+            std::vector<Rid> visible_rids;
+            for (auto &rid : page_rids_) {
+                auto rec = ReadTuple(context_, tab_, fh_, rid);
+                if (rec != nullptr) {
+                    visible_rids.push_back(rid);
+                    page_recs_.push_back(std::move(rec));
+                }
+            }
+            page_rids_ = std::move(visible_rids);
+            return true;
+        }
+        fh_->get_records(page_no, slot_nos, &page_recs_, context_);
+        page_rids_.resize(page_recs_.size());
+        return true;
+    }
+
+    /**
+     * @description: 从当前位置开始找到第一条满足所有条件的记录
+     */
+    void find_next_valid() {
+        while (true) {
+            for (; pos_ < page_rids_.size(); pos_++) {
+                if (eval_conds(cols_, fed_conds_, page_recs_[pos_].get())) {
+                    rid_ = page_rids_[pos_];
+                    return;
+                }
+            }
+            if (!load_next_page()) {
+                return;
+            }
+        }
+    }
+};
@@ -9,6 +9,7 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #pragma once
+#include "execution_common.h"
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -37,6 +38,36 @@ class DeleteExecutor : public AbstractExecutor {
     }
 
     std::unique_ptr<RmRecord> Next() override {
+        for (auto &rid : rids_) {
+            if (IsMvcc(context_)) {
+                // 只标记删除，表堆中的元组和索引项保留给更老的快照
+                if (GetVisibleTuple(context_->txn_mgr_, context_->txn_, &tab_, fh_, rid).has_value()) {
+                    MvccWriteTuple(context_, tab_, fh_, rid, nullptr);
+                }
+                continue;
+            }
+            if (IsOcc(context_)) {
+                if (OccReadTuple(context_, fh_, rid) != nullptr) {
+                    OccWriteTuple(sm_manager_, context_, tab_, fh_, rid, nullptr);
+                }
+                continue;
+            }
+            if (NeedLock(context_)) {
+                LockRecordExclusive(context_, fh_, rid);
+            }
+            auto rec = fh_->get_record(rid, context_);
+            for (auto &index : tab_.indexes) {
+                DeleteIndexEntry(sm_manager_, tab_, index, rec->data, rid, context_->txn_);
+            }
+            {
+                // 删除会修改空闲页面链表，与插入一样串行执行
+                std::lock_guard<std::mutex> insert_lock(fh_->get_insert_latch());
+                fh_->delete_record(rid, context_);
+            }
+            if (context_ != nullptr && context_->txn_ != nullptr) {
+                context_->txn_->append_write_record(new WriteRecord(WType::DELETE_TUPLE, tab_name_, rid, *rec));
+            }
+        }
         return nullptr;
     }
 
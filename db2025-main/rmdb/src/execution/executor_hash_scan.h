@@ -0,0 +1,123 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_common.h"
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * 哈希索引上的等值查找：用所有索引字段上的等值条件拼出key，在哈希索引中查找Rid之后读取记录，
+ * 其他条件在读取记录之后检查。哈希索引中的key唯一，最多输出一条记录
+ */
+class HashScanExecutor : public AbstractExecutor {
+   private:
+    std::string tab_name_;                      // 表名称
+    TabMeta tab_;                               // 表的元数据
+    std::vector<Condition> conds_;              // 扫描条件
+    RmFileHandle *fh_;                          // 表的数据文件句柄
+    std::vector<ColMeta> cols_;                 // 需要读取的字段
+    size_t len_;                                // 选取出来的一条记录的长度
+    std::vector<Condition> fed_conds_;          // 扫描条件，和conds_字段相同
+
+    std::vector<std::string> index_col_names_;  // 哈希索引包含的字段
+    IndexMeta index_meta_;                      // 哈希索引的元数据
+
+    Rid rid_;
+    std::vector<Rid> rids_;                     // 哈希索引中查到的Rid
+    size_t pos_ = 0;                            // 当前记录在rids_中的位置
+    std::unique_ptr<RmRecord> rec_;             // 当前满足条件的记录
+
+    SmManager *sm_manager_;
+
+   public:
+    HashScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                     std::vector<std::string> index_col_names, Context *context) {
+        sm_manager_ = sm_manager;
+        context_ = context;
+        tab_name_ = std::move(tab_name);
+        tab_ = sm_manager_->db_.get_table(tab_name_);
+        conds_ = std::move(conds);
+        index_col_names_ = std::move(index_col_names);
+        index_meta_ = *(tab_.get_index_meta(index_col_names_));
+        fh_ = sm_manager_->fhs_.at(tab_name_).get();
+        cols_ = tab_.cols;
+        len_ = cols_.back().offset + cols_.back().len;
+        std::map<CompOp, CompOp> swap_op = {
+            {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
+        };
+
+        for (auto &cond : conds_) {
+            if (cond.lhs_col.tab_name != tab_name_) {
+                // lhs is on other table, now rhs must be on this table
+                assert(!cond.is_rhs_val && cond.rhs_col.tab_name == tab_name_);
+                // swap lhs and rhs
+                std::swap(cond.lhs_col, cond.rhs_col);
+                cond.op = swap_op.at(cond.op);
+            }
+        }
+        fed_conds_ = conds_;
+    }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "HashScanExecutor"; }
+
+    void beginTuple() override {
+        auto hh = sm_manager_->hhs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index_col_names_)).get();
+        std::vector<char> key(index_meta_.col_tot_len);
+        int offset = 0;
+        for (auto &col : index_meta_.cols) {
+            auto eq = std::find_if(fed_conds_.begin(), fed_conds_.end(), [&](const Condition &cond) {
+                return cond.is_rhs_val && cond.op == OP_EQ && cond.lhs_col.col_name == col.name;
+            });
+            assert(eq != fed_conds_.end());
+            memcpy(key.data() + offset, eq->rhs_val.raw->data, col.len);
+            offset += col.len;
+        }
+        rids_.clear();
+        pos_ = 0;
+        hh->get_value(key.data(), &rids_, context_ != nullptr ? context_->txn_ : nullptr);
+        find_next_valid();
+    }
+
+    void nextTuple() override {
+        pos_++;
+        find_next_valid();
+    }
+
+    bool is_end() const override { return pos_ >= rids_.size(); }
+
+    std::unique_ptr<RmRecord> Next() override { return std::make_unique<RmRecord>(*rec_); }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
+    Rid &rid() override { return rid_; }
+
+   private:
+    /**
+     * @description: 从当前位置开始找到第一条满足所有条件的记录
+     */
+    void find_next_valid() {
+        for (; pos_ < rids_.size(); pos_++) {
+            rid_ = rids_[pos_];
+            rec_ = ReadTuple(context_, tab_, fh_, rid_);
+            if (rec_ != nullptr && eval_conds(cols_, fed_conds_, rec_.get())) {
+                return;
+            }
+        }
+    }
+};
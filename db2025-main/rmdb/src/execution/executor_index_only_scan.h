@@ -0,0 +1,63 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "executor_index_scan.h"
+
+/**
+ * 覆盖索引扫描：上层需要的列和扫描条件中的列都在索引中时，直接用叶子结点中的key生成记录，
+ * 不需要按照Rid回表读取记录。输出的记录由索引字段按照索引中的顺序组成；
+ * 不读取记录的Rid，因此只用于select语句
+ */
+class IndexOnlyScanExecutor : public IndexScanExecutor {
+   public:
+    IndexOnlyScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                          std::vector<std::string> index_col_names, Context *context)
+        : IndexScanExecutor(sm_manager, std::move(tab_name), std::move(conds), std::move(index_col_names), context) {
+        // 输出的字段为索引字段，偏移量为字段在key中的偏移量
+        cols_.clear();
+        int offset = 0;
+        for (auto &index_col : index_meta_.cols) {
+            ColMeta col = index_col;
+            col.offset = offset;
+            offset += col.len;
+            cols_.push_back(col);
+        }
+        len_ = offset;
+    }
+
+    std::string getType() override { return "IndexOnlyScanExecutor"; }
+
+   protected:
+    void find_next_valid() override {
+        auto ix_scan = static_cast<IxScan *>(scan_.get());
+        while (!ix_scan->is_end()) {
+            rec_ = std::make_unique<RmRecord>(len_);
+            ix_scan->key(rec_->data);
+            if (eval_conds(cols_, fed_conds_, rec_.get()) && is_visible()) {
+                return;
+            }
+            ix_scan->next();
+        }
+    }
+
+    /**
+     * @description: 索引中没有版本信息，MVCC下需要回表检查索引项对应的记录在快照中是否存在、key是否一致；
+     * OCC下回表把记录的版本字加入读集，并且跳过自己删除或者修改了key的记录
+     */
+    bool is_visible() {
+        if (!IsMvcc(context_) && !IsOcc(context_)) {
+            return true;
+        }
+        auto rec = ReadTuple(context_, tab_, fh_, scan_->rid());
+        return rec != nullptr && is_current_entry(rec->data);
+    }
+};
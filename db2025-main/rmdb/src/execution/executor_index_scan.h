@@ -10,6 +10,10 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <cfloat>
+#include <climits>
+
+#include "execution_common.h"
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -17,7 +21,7 @@ See the Mulan PSL v2 for more details. */
 #include "system/sm.h"
 
 class IndexScanExecutor : public AbstractExecutor {
-   private:
+   protected:
     std::string tab_name_;                      // 表名称
     TabMeta tab_;                               // 表的元数据
     std::vector<Condition> conds_;              // 扫描条件
@@ -31,6 +35,8 @@ class IndexScanExecutor : public AbstractExecutor {
 
     Rid rid_;
     std::unique_ptr<RecScan> scan_;
+    IxIndexHandle *ih_;                         // 索引文件句柄
+    std::unique_ptr<RmRecord> rec_;             // 当前满足条件的记录
 
     SmManager *sm_manager_;
 
@@ -64,17 +70,156 @@ class IndexScanExecutor : public AbstractExecutor {
         fed_conds_ = conds_;
     }
 
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "IndexScanExecutor"; }
+
     void beginTuple() override {
-        
+        ih_ = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index_col_names_)).get();
+        Iid lower, upper;
+        get_scan_range(ih_, index_meta_, tab_name_, fed_conds_, lower, upper);
+        scan_ = std::make_unique<IxScan>(ih_, lower, upper, sm_manager_->get_bpm());
+        find_next_valid();
     }
 
     void nextTuple() override {
-        
+        scan_->next();
+        find_next_valid();
     }
 
-    std::unique_ptr<RmRecord> Next() override {
-        return nullptr;
-    }
+    bool is_end() const override { return scan_->is_end(); }
+
+    std::unique_ptr<RmRecord> Next() override { return std::make_unique<RmRecord>(*rec_); }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
 
     Rid &rid() override { return rid_; }
+
+    /**
+     * @description: 根据条件计算索引扫描的范围[lower, upper)
+     * 索引字段最左前缀上的等值条件确定key的前缀，紧随其后的一个字段上的范围条件确定上下界，
+     * 其余字段用最小值或最大值填充：下界为 > v 时填充最大值并使用upper_bound，否则填充最小值并使用lower_bound；
+     * 上界为 < v 时填充最小值并使用lower_bound，否则填充最大值并使用upper_bound
+     * @param conds 表上的条件，左侧列必须属于tab_name
+     */
+    static void get_scan_range(IxIndexHandle *ih, const IndexMeta &index_meta, const std::string &tab_name,
+                               const std::vector<Condition> &conds, Iid &lower, Iid &upper) {
+        auto &index_cols = index_meta.cols;
+        std::vector<char> lower_key(index_meta.col_tot_len), upper_key(index_meta.col_tot_len);
+        const Condition *lower_cond = nullptr, *upper_cond = nullptr;
+        int offset = 0;
+        size_t i = 0;
+        for (; i < index_cols.size(); i++) {
+            auto &col = index_cols[i];
+            auto is_col_cond = [&](const Condition &cond) {
+                return cond.is_rhs_val && cond.lhs_col.tab_name == tab_name && cond.lhs_col.col_name == col.name;
+            };
+            auto eq = std::find_if(conds.begin(), conds.end(), [&](const Condition &cond) {
+                return is_col_cond(cond) && cond.op == OP_EQ;
+            });
+            if (eq != conds.end()) {
+                memcpy(lower_key.data() + offset, eq->rhs_val.raw->data, col.len);
+                memcpy(upper_key.data() + offset, eq->rhs_val.raw->data, col.len);
+                offset += col.len;
+                continue;
+            }
+            // 同一个字段上有多个范围条件时取最紧的上下界
+            for (auto &cond : conds) {
+                if (!is_col_cond(cond)) continue;
+                const char *val = cond.rhs_val.raw->data;
+                if (cond.op == OP_GT || cond.op == OP_GE) {
+                    int cmp = lower_cond ? ix_compare(val, lower_cond->rhs_val.raw->data, col.type, col.len) : 1;
+                    if (cmp > 0 || (cmp == 0 && cond.op == OP_GT)) lower_cond = &cond;
+                } else if (cond.op == OP_LT || cond.op == OP_LE) {
+                    int cmp = upper_cond ? ix_compare(val, upper_cond->rhs_val.raw->data, col.type, col.len) : -1;
+                    if (cmp < 0 || (cmp == 0 && cond.op == OP_LT)) upper_cond = &cond;
+                }
+            }
+            break;
+        }
+        if (i == index_cols.size() && !ih->may_contain(lower_key.data())) {
+            // 所有索引字段上都有等值条件，Bloom filter判断key不存在
+            lower = upper = ih->leaf_end();
+            return;
+        }
+        bool lower_is_upper_bound = lower_cond != nullptr && lower_cond->op == OP_GT;
+        bool upper_is_lower_bound = upper_cond != nullptr && upper_cond->op == OP_LT;
+        for (size_t j = i; j < index_cols.size(); j++) {
+            auto &col = index_cols[j];
+            if (j == i && lower_cond != nullptr) {
+                memcpy(lower_key.data() + offset, lower_cond->rhs_val.raw->data, col.len);
+            } else {
+                fill_key(lower_key.data() + offset, col, lower_is_upper_bound);
+            }
+            if (j == i && upper_cond != nullptr) {
+                memcpy(upper_key.data() + offset, upper_cond->rhs_val.raw->data, col.len);
+            } else {
+                fill_key(upper_key.data() + offset, col, !upper_is_lower_bound);
+            }
+            offset += col.len;
+        }
+
+        std::vector<ColType> col_types;
+        std::vector<int> col_lens;
+        for (auto &col : index_cols) {
+            col_types.push_back(col.type);
+            col_lens.push_back(col.len);
+        }
+        int cmp = ix_compare(lower_key.data(), upper_key.data(), col_types, col_lens);
+        if (cmp > 0 || (cmp == 0 && lower_is_upper_bound && upper_is_lower_bound)) {
+            // 条件矛盾，扫描范围为空
+            lower = upper = ih->leaf_end();
+            return;
+        }
+        lower = lower_is_upper_bound ? ih->upper_bound(lower_key.data()) : ih->lower_bound(lower_key.data());
+        upper = upper_is_lower_bound ? ih->lower_bound(upper_key.data()) : ih->upper_bound(upper_key.data());
+    }
+
+   protected:
+    /**
+     * @description: 从当前位置开始找到第一条满足所有条件的记录，索引范围之外的条件（例如!=和非前缀字段上的条件）在这里检查
+     */
+    virtual void find_next_valid() {
+        while (!scan_->is_end()) {
+            rid_ = scan_->rid();
+            rec_ = ReadTuple(context_, tab_, fh_, rid_);
+            if (rec_ != nullptr && is_current_entry(rec_->data) && eval_conds(cols_, fed_conds_, rec_.get())) {
+                return;
+            }
+            scan_->next();
+        }
+    }
+
+    /**
+     * @description: MVCC下更新索引字段时保留了旧的索引项，同一条记录可能有多个索引项。
+     * 只有key与快照中的版本一致的索引项有效，其余的跳过，保证每条记录只输出一次。
+     * OCC下修改key的更新在提交时才修改索引，事务通过旧的key读到自己缓存的新版本时同样跳过
+     */
+    bool is_current_entry(const char *rec) {
+        if (!IsMvcc(context_) && !IsOcc(context_)) {
+            return true;
+        }
+        std::vector<char> key(index_meta_.col_tot_len);
+        static_cast<IxScan *>(scan_.get())->key(key.data());
+        return GetIndexKey(index_meta_, rec) == key;
+    }
+
+    /**
+     * @description: 用字段类型的最小值或最大值填充key中的一个字段
+     */
+    static void fill_key(char *dest, const ColMeta &col, bool is_max) {
+        switch (col.type) {
+            case TYPE_INT:
+                *(int *)dest = is_max ? INT_MAX : INT_MIN;
+                break;
+            case TYPE_FLOAT:
+                *(float *)dest = is_max ? FLT_MAX : -FLT_MAX;
+                break;
+            default:
+                memset(dest, is_max ? 0xff : 0, col.len);
+                break;
+        }
+    }
 };
\ No newline at end of file
@@ -9,6 +9,7 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #pragma once
+#include "execution_common.h"
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -50,19 +51,33 @@ class InsertExecutor : public AbstractExecutor {
             memcpy(rec.data + col.offset, val.raw->data, col.len);
         }
         // Insert into record file
-        rid_ = fh_->insert_record(rec.data, context_);
-        
-        // Insert into index
-        for(size_t i = 0; i < tab_.indexes.size(); ++i) {
-            auto& index = tab_.indexes[i];
-            auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
-            char* key = new char[index.col_tot_len];
-            int offset = 0;
-            for(size_t i = 0; i < index.col_num; ++i) {
-                memcpy(key + offset, rec.data + index.cols[i].offset, index.cols[i].len);
-                offset += index.cols[i].len;
+        if (IsMvcc(context_)) {
+            // 新记录提交之前对其他事务不可见，不需要加锁
+            rid_ = MvccInsertTuple(context_, tab_, fh_, rec.data);
+        } else if (IsOcc(context_)) {
+            // 版本字标记为不存在，提交之前对其他事务不可见
+            rid_ = OccInsertTuple(context_, tab_, fh_, rec.data);
+        } else {
+            if (NeedLock(context_)) {
+                context_->lock_mgr_->lock_IX_on_table(context_->txn_, fh_->GetFd());
+            }
+            {
+                // 表堆的插入不是线程安全的，与MVCC和OCC的插入一样串行执行
+                std::lock_guard<std::mutex> insert_lock(fh_->get_insert_latch());
+                rid_ = fh_->insert_record(rec.data, context_);
+            }
+            if (NeedLock(context_)) {
+                context_->lock_mgr_->lock_exclusive_on_record(context_->txn_, rid_, fh_->GetFd());
+            }
+            if (context_ != nullptr && context_->txn_ != nullptr) {
+                context_->txn_->append_write_record(new WriteRecord(WType::INSERT_TUPLE, tab_name_, rid_));
             }
-            ih->insert_entry(key, rid_, context_->txn_);
+        }
+
+        // Insert into index
+        Transaction *txn = context_ != nullptr ? context_->txn_ : nullptr;
+        for (auto &index : tab_.indexes) {
+            InsertIndexEntry(sm_manager_, tab_, index, rec.data, rid_, txn);
         }
         return nullptr;
     }
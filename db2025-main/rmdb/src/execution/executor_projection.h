@@ -39,13 +39,30 @@ class ProjectionExecutor : public AbstractExecutor {
         len_ = curr_offset;
     }
 
-    void beginTuple() override {}
+    size_t tupleLen() const override { return len_; }
 
-    void nextTuple() override {}
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "ProjectionExecutor"; }
+
+    void beginTuple() override { prev_->beginTuple(); }
+
+    void nextTuple() override { prev_->nextTuple(); }
+
+    bool is_end() const override { return prev_->is_end(); }
 
     std::unique_ptr<RmRecord> Next() override {
-        return nullptr;
+        auto prev_rec = prev_->Next();
+        auto &prev_cols = prev_->cols();
+        auto proj_rec = std::make_unique<RmRecord>(len_);
+        for (size_t i = 0; i < sel_idxs_.size(); i++) {
+            auto &prev_col = prev_cols[sel_idxs_[i]];
+            memcpy(proj_rec->data + cols_[i].offset, prev_rec->data + prev_col.offset, prev_col.len);
+        }
+        return proj_rec;
     }
 
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
     Rid &rid() override { return _abstract_rid; }
 };
\ No newline at end of file
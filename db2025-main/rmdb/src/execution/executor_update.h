@@ -9,6 +9,7 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #pragma once
+#include "execution_common.h"
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -24,6 +25,7 @@ class UpdateExecutor : public AbstractExecutor {
     std::string tab_name_;
     std::vector<SetClause> set_clauses_;
     SmManager *sm_manager_;
+    bool escrow_;   // 只包含增量，两阶段封锁下使用escrow锁
 
    public:
     UpdateExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<SetClause> set_clauses,
@@ -36,11 +38,103 @@ class UpdateExecutor : public AbstractExecutor {
         conds_ = conds;
         rids_ = rids;
         context_ = context;
+        escrow_ = UseEscrow(context_, tab_, set_clauses_, conds_);
     }
     std::unique_ptr<RmRecord> Next() override {
-        
+        for (auto &rid : rids_) {
+            if (IsMvcc(context_)) {
+                update_mvcc(rid);
+            } else if (IsOcc(context_)) {
+                update_occ(rid);
+            } else if (escrow_) {
+                update_escrow(rid);
+            } else {
+                update(rid);
+            }
+        }
         return nullptr;
     }
 
     Rid &rid() override { return _abstract_rid; }
+
+   private:
+    /* 按照set子句修改记录 */
+    void apply_set_clauses(RmRecord &rec) {
+        for (auto &set_clause : set_clauses_) {
+            auto col = tab_.get_col(set_clause.lhs.col_name);
+            if (col->type != set_clause.rhs.type) {
+                throw IncompatibleTypeError(coltype2str(col->type), coltype2str(set_clause.rhs.type));
+            }
+            if (set_clause.is_incr) {
+                set_clause.rhs.add_to(rec.data + col->offset);
+            } else {
+                SetColumnValue(*col, rec.data, set_clause.rhs);
+            }
+        }
+    }
+
+    /* 两阶段封锁下原地更新，索引key改变时先删除旧的索引项，写记录中保存旧的记录用于回滚 */
+    void update(const Rid &rid) {
+        if (NeedLock(context_)) {
+            LockRecordExclusive(context_, fh_, rid);
+        }
+        auto old_rec = fh_->get_record(rid, context_);
+        RmRecord new_rec(*old_rec);
+        apply_set_clauses(new_rec);
+        for (auto &index : tab_.indexes) {
+            if (IndexKeyChanged(index, old_rec->data, new_rec.data)) {
+                DeleteIndexEntry(sm_manager_, tab_, index, old_rec->data, rid, context_->txn_);
+                InsertIndexEntry(sm_manager_, tab_, index, new_rec.data, rid, context_->txn_);
+            }
+        }
+        fh_->update_record(rid, new_rec.data, context_);
+        if (context_ != nullptr && context_->txn_ != nullptr) {
+            context_->txn_->append_write_record(new WriteRecord(WType::UPDATE_TUPLE, tab_name_, rid, *old_rec));
+        }
+    }
+
+    /* 只包含增量的update：加escrow锁，把增量缓存在事务中，提交时再加到记录上 */
+    void update_escrow(const Rid &rid) {
+        context_->lock_mgr_->lock_escrow_on_record(context_->txn_, rid, fh_->GetFd());
+        auto &escrow_record = context_->txn_->get_escrow_set()[LockDataId(fh_->GetFd(), rid, LockDataType::RECORD)];
+        escrow_record.tab_name_ = tab_name_;
+        escrow_record.rid_ = rid;
+        for (auto &set_clause : set_clauses_) {
+            auto col = tab_.get_col(set_clause.lhs.col_name);
+            if (col->type != set_clause.rhs.type) {
+                throw IncompatibleTypeError(coltype2str(col->type), coltype2str(set_clause.rhs.type));
+            }
+            escrow_record.deltas_.emplace_back(col->offset, set_clause.rhs);
+        }
+    }
+
+    /**
+     * MVCC下更新快照中的版本，写写冲突时回滚事务。旧的索引项保留给更老的快照使用，
+     * 索引扫描读取记录之后重新检查key，key改变时插入新的索引项
+     */
+    void update_mvcc(const Rid &rid) {
+        auto old_rec = GetVisibleTuple(context_->txn_mgr_, context_->txn_, &tab_, fh_, rid);
+        if (!old_rec.has_value()) {
+            return;
+        }
+        RmRecord new_rec(*old_rec);
+        apply_set_clauses(new_rec);
+        MvccWriteTuple(context_, tab_, fh_, rid, &new_rec);
+        for (auto &index : tab_.indexes) {
+            if (IndexKeyChanged(index, old_rec->data, new_rec.data)) {
+                InsertIndexEntry(sm_manager_, tab_, index, new_rec.data, rid, context_->txn_);
+            }
+        }
+    }
+
+    /* OCC下读取记录（加入读集）之后把更新缓存在写集中，索引在提交时修改 */
+    void update_occ(const Rid &rid) {
+        auto old_rec = OccReadTuple(context_, fh_, rid);
+        if (old_rec == nullptr) {
+            return;
+        }
+        RmRecord new_rec(*old_rec);
+        apply_set_clauses(new_rec);
+        OccWriteTuple(sm_manager_, context_, tab_, fh_, rid, &new_rec);
+    }
 };
\ No newline at end of file
@@ -10,5 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "ix_hash.h"
 #include "ix_scan.h"
 #include "ix_manager.h"
+#include "ix_sorter.h"
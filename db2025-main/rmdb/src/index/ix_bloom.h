@@ -0,0 +1,122 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+#include "common/config.h"
+
+/* Bloom filter的统计信息 */
+struct IxBloomStats {
+    size_t num_keys;                // 加入的key的个数，删除的key不会从Bloom filter中移除
+    size_t num_bits;                // 位数组的大小
+    size_t num_probes;              // 查找的次数
+    size_t num_negatives;           // Bloom filter判断key不存在、不需要查找B+树的次数
+    size_t num_false_positives;     // Bloom filter判断key可能存在，但是B+树中没有的次数
+
+    /* 实测的假阳性率：不存在的key中没有被Bloom filter排除的比例 */
+    double false_positive_rate() const {
+        size_t absent = num_negatives + num_false_positives;
+        return absent == 0 ? 0 : (double)num_false_positives / absent;
+    }
+};
+
+/**
+ * 分块的Bloom filter（split block Bloom filter），只保存在内存中。
+ * 位数组分成512位的块，正好是一个cache line，一个key只访问一个块：哈希值的高32位选择块，
+ * 低32位分别乘以8个奇数常量得到块中8个64位字里的各一位。查找最多只有一次cache miss，
+ * 代价是同样的位数下假阳性率比标准的Bloom filter略高。
+ * 插入用原子的fetch_or置位，查找和插入可以并发执行，不需要加锁
+ */
+class IxBloomFilter {
+   private:
+    static constexpr int BLOCK_WORDS = 8;
+    static constexpr uint32_t SALT[BLOCK_WORDS] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                   0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+    size_t num_blocks_;
+    std::unique_ptr<std::atomic<uint64_t>[]> words_;
+    std::atomic<size_t> num_keys_{0};
+    std::atomic<size_t> num_probes_{0};
+    std::atomic<size_t> num_negatives_{0};
+    std::atomic<size_t> num_false_positives_{0};
+
+    std::atomic<uint64_t> *block(uint64_t hash) const {
+        // (hash >> 32) * num_blocks_ / 2^32 把高32位均匀映射到[0, num_blocks_)，避免取模
+        return words_.get() + ((hash >> 32) * num_blocks_ >> 32) * BLOCK_WORDS;
+    }
+
+    static uint64_t mask(uint64_t hash, int i) { return 1ULL << ((uint32_t)hash * SALT[i] >> 26); }
+
+   public:
+    /**
+     * @param capacity 预计的key的个数，位数组大小为capacity * bits_per_key，按块向上取整
+     */
+    explicit IxBloomFilter(size_t capacity, int bits_per_key = IX_BLOOM_BITS_PER_KEY) {
+        size_t block_bits = BLOCK_WORDS * 64;
+        num_blocks_ = std::max<size_t>(1, (capacity * bits_per_key + block_bits - 1) / block_bits);
+        words_ = std::make_unique<std::atomic<uint64_t>[]>(num_blocks_ * BLOCK_WORDS);
+        for (size_t i = 0; i < num_blocks_ * BLOCK_WORDS; i++) {
+            words_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /* 加入一个key，hash为ix_hash_key得到的规范化key的哈希值 */
+    void add(uint64_t hash) {
+        auto words = block(hash);
+        for (int i = 0; i < BLOCK_WORDS; i++) {
+            words[i].fetch_or(mask(hash, i), std::memory_order_relaxed);
+        }
+        num_keys_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /* 返回false时key一定不存在，返回true时key可能存在 */
+    bool may_contain(uint64_t hash) const {
+        auto words = block(hash);
+        for (int i = 0; i < BLOCK_WORDS; i++) {
+            uint64_t m = mask(hash, i);
+            if ((words[i].load(std::memory_order_relaxed) & m) != m) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* 记录一次查找的结果，用于统计假阳性率 */
+    void record_probe(bool negative) {
+        num_probes_.fetch_add(1, std::memory_order_relaxed);
+        if (negative) {
+            num_negatives_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void record_false_positive() { num_false_positives_.fetch_add(1, std::memory_order_relaxed); }
+
+    IxBloomStats stats() const {
+        return IxBloomStats{.num_keys = num_keys_.load(),
+                            .num_bits = num_blocks_ * BLOCK_WORDS * 64,
+                            .num_probes = num_probes_.load(),
+                            .num_negatives = num_negatives_.load(),
+                            .num_false_positives = num_false_positives_.load()};
+    }
+
+    /**
+     * @description: 按照当前key的个数估算的假阳性率，每个字中一位被置位的概率为 1 - (1 - 1/64)^(n / num_blocks)，
+     * 8个字中对应的位都被置位时才是假阳性
+     */
+    double expected_false_positive_rate() const {
+        double keys_per_block = (double)num_keys_.load() / num_blocks_;
+        return std::pow(1 - std::pow(1 - 1.0 / 64, keys_per_block), BLOCK_WORDS);
+    }
+};
@@ -10,6 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <cstring>
 #include <vector>
 
 #include "defs.h"
@@ -21,6 +22,37 @@ constexpr int IX_LEAF_HEADER_PAGE = 1;
 constexpr int IX_INIT_ROOT_PAGE = 2;
 constexpr int IX_INIT_NUM_PAGES = 3;
 constexpr int IX_MAX_COL_LEN = 512;
+// 索引包含CHAR字段且key的总长度超过该值时，内部结点使用前缀压缩和后缀截断
+constexpr int IX_COMPRESS_MIN_KEY_LEN = 8;
+// 非唯一索引的key在字段之后追加规范化的Rid，使每个键值对的key都不同，见ix_encode_rid
+constexpr int IX_RID_KEY_LEN = 8;
+
+/**
+ * 规范化key的64位哈希值，每次读取8个字节混合，最后使用MurmurHash3的fmix64使低位充分混合。
+ * 哈希索引的目录使用哈希值的低位，桶中保存低32位用于在比较key之前快速排除不同的key；Bloom filter见ix_bloom.h
+ */
+inline uint64_t ix_hash_key(const char *key, int len) {
+    const uint64_t m = 0x9e3779b97f4a7c15ull;
+    uint64_t h = len * m;
+    for (; len >= 8; key += 8, len -= 8) {
+        uint64_t x;
+        memcpy(&x, key, sizeof(x));
+        h = (h ^ x) * m;
+        h ^= h >> 32;
+    }
+    if (len > 0) {
+        uint64_t x = 0;
+        memcpy(&x, key, len);
+        h = (h ^ x) * m;
+        h ^= h >> 32;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
 
 class IxFileHdr {
 public: 
@@ -30,28 +62,34 @@ public:
     int col_num_;                       // 索引包含的字段数量
     std::vector<ColType> col_types_;    // 字段的类型
     std::vector<int> col_lens_;         // 字段的长度
-    int col_tot_len_;                   // 索引包含的字段的总长度
+    int col_tot_len_;                   // 索引包含的字段的总长度，非唯一索引还包括key末尾的Rid（IX_RID_KEY_LEN）
     int btree_order_;                   // # children per page 每个结点最多可插入的键值对数量
     int keys_size_;                     // keys_size = (btree_order + 1) * col_tot_len
     // first_leaf初始化之后没有进行修改，只不过是在测试文件中遍历叶子结点的时候用了
     page_id_t first_leaf_;              // 首叶节点对应的页号，在上层IxManager的open函数进行初始化，初始化为root page_no
     page_id_t last_leaf_;               // 尾叶节点对应的页号
+    bool prefix_compression_;           // 内部结点是否使用前缀压缩和后缀截断，见IxNodeHandle::store
+    bool posting_list_;                 // 非唯一索引，叶子结点中相同的key只保存一次，后面是Rid列表，见IxNodeHandle::store_posting
     int tot_len_;                       // 记录结构体的整体长度
 
     IxFileHdr() {
         tot_len_ = col_num_ = 0;
+        prefix_compression_ = false;
+        posting_list_ = false;
     }
 
     IxFileHdr(page_id_t first_free_page_no, int num_pages, page_id_t root_page, int col_num,
                 int col_tot_len, int btree_order, int keys_size, page_id_t first_leaf, page_id_t last_leaf)
                 : first_free_page_no_(first_free_page_no), num_pages_(num_pages), root_page_(root_page), col_num_(col_num),
                 col_tot_len_(col_tot_len), btree_order_(btree_order), keys_size_(keys_size), first_leaf_(first_leaf), last_leaf_(last_leaf) {
+                    prefix_compression_ = false;
+                    posting_list_ = false;
                     tot_len_ = 0;
                 } 
 
     void update_tot_len() {
         tot_len_ = 0;
-        tot_len_ += sizeof(page_id_t) * 4 + sizeof(int) * 6;
+        tot_len_ += sizeof(page_id_t) * 4 + sizeof(int) * 8;
         tot_len_ += sizeof(ColType) * col_num_ + sizeof(int) * col_num_;
     }
 
@@ -85,6 +123,12 @@ public:
         offset += sizeof(page_id_t);
         memcpy(dest + offset, &last_leaf_, sizeof(page_id_t));
         offset += sizeof(page_id_t);
+        int prefix_compression = prefix_compression_;
+        memcpy(dest + offset, &prefix_compression, sizeof(int));
+        offset += sizeof(int);
+        int posting_list = posting_list_;
+        memcpy(dest + offset, &posting_list, sizeof(int));
+        offset += sizeof(int);
         assert(offset == tot_len_);
     }
 
@@ -123,6 +167,10 @@ public:
         offset += sizeof(page_id_t);
         last_leaf_ = *reinterpret_cast<const page_id_t*>(src + offset);
         offset += sizeof(page_id_t);
+        prefix_compression_ = *reinterpret_cast<const int*>(src + offset) != 0;
+        offset += sizeof(int);
+        posting_list_ = *reinterpret_cast<const int*>(src + offset) != 0;
+        offset += sizeof(int);
         assert(offset == tot_len_);
     }
 };
@@ -135,6 +183,8 @@ public:
     bool is_leaf;                   // 是否为叶节点
     page_id_t prev_leaf;            // previous leaf node's page_no, effective only when is_leaf is true
     page_id_t next_leaf;            // next leaf node's page_no, effective only when is_leaf is true
+    int prefix_len;                 // 压缩的内部结点中所有key的公共前缀长度，effective only when is_leaf is false
+    int data_len;                   // posting list格式的叶子结点占用的字节数，effective only when is_leaf is true
 };
 
 class Iid {
@@ -0,0 +1,273 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "ix_hash.h"
+
+#include <mutex>
+
+/**
+ * @brief 在桶中查找key，先比较哈希值，哈希值相同时再比较key
+ *
+ * @param key 规范化的key
+ * @param hash key的哈希值
+ * @return key在桶中的位置，不存在时返回-1
+ */
+int IxHashBucket::find(const char *key, uint32_t hash) const {
+    int n = bucket_hdr->num_key;
+    int len = file_hdr->col_tot_len_;
+    for (int i = 0; i < n; i++) {
+        if (hashes[i] == hash && ix_key_compare(get_key(i), key, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 在桶的末尾追加一个键值对，调用前需要保证桶没有满
+ */
+void IxHashBucket::append(const char *key, uint32_t hash, const Rid &rid) {
+    int n = bucket_hdr->num_key;
+    assert(n < file_hdr->bucket_capacity_);
+    hashes[n] = hash;
+    memcpy(get_key(n), key, file_hdr->col_tot_len_);
+    rids[n] = rid;
+    bucket_hdr->num_key++;
+}
+
+/**
+ * @brief 删除桶中第pos个键值对，用最后一个键值对填补
+ */
+void IxHashBucket::erase(int pos) {
+    int last = --bucket_hdr->num_key;
+    if (pos != last) {
+        hashes[pos] = hashes[last];
+        memcpy(get_key(pos), get_key(last), file_hdr->col_tot_len_);
+        rids[pos] = rids[last];
+    }
+}
+
+IxHashHandle::IxHashHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
+    : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd) {
+    char buf[PAGE_SIZE];
+    disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, buf, PAGE_SIZE);
+    file_hdr_.deserialize(buf);
+    // 新的页面从文件头中记录的页面数开始分配
+    disk_manager_->set_fd2pageno(fd, file_hdr_.num_pages_);
+    load_directory();
+}
+
+/**
+ * @brief 查找key对应的Rid
+ *
+ * @param rec_key 查找的目标key值，记录格式
+ * @param result 用于存放结果的容器
+ * @param transaction 事务指针
+ * @return bool 返回目标键值对是否存在
+ */
+bool IxHashHandle::get_value(const char *rec_key, std::vector<Rid> *result, Transaction *transaction) {
+    IxKeyBuffer norm_key(rec_key, file_hdr_.col_types_, file_hdr_.col_lens_, file_hdr_.col_tot_len_);
+    const char *key = norm_key.data();
+    uint32_t h = hash(key);
+    std::shared_lock lock{dir_latch_};
+    IxHashBucket bucket = fetch_bucket(bucket_page_no(h));
+    bucket.page->r_latch();
+    int pos = bucket.find(key, h);
+    if (pos >= 0) {
+        result->push_back(bucket.rids[pos]);
+    }
+    bucket.page->r_unlatch();
+    buffer_pool_manager_->unpin_page(bucket.page->get_page_id(), false);
+    return pos >= 0;
+}
+
+/**
+ * @brief 插入键值对，桶满时分裂桶，直到key所在的桶有空位
+ *
+ * @param (rec_key, value) 要插入的键值对，key为记录格式
+ * @param transaction 事务指针
+ * @return page_id_t 插入到的桶的page_no，key已经存在时不插入并返回IX_NO_PAGE
+ * @note 先只持有目录的读锁尝试插入，桶满时再持有目录的写锁分裂，此时没有其他线程访问桶，不需要页面latch
+ */
+page_id_t IxHashHandle::insert_entry(const char *rec_key, const Rid &value, Transaction *transaction) {
+    IxKeyBuffer norm_key(rec_key, file_hdr_.col_types_, file_hdr_.col_lens_, file_hdr_.col_tot_len_);
+    const char *key = norm_key.data();
+    uint32_t h = hash(key);
+    {
+        std::shared_lock lock{dir_latch_};
+        IxHashBucket bucket = fetch_bucket(bucket_page_no(h));
+        bucket.page->w_latch();
+        page_id_t page_no = IX_NO_PAGE;
+        bool done = true;
+        if (bucket.find(key, h) < 0) {
+            if (bucket.is_full()) {
+                done = false;
+            } else {
+                bucket.append(key, h, value);
+                page_no = bucket.get_page_no();
+            }
+        }
+        bucket.page->w_unlatch();
+        buffer_pool_manager_->unpin_page(bucket.page->get_page_id(), page_no != IX_NO_PAGE);
+        if (done) {
+            return page_no;
+        }
+    }
+
+    std::unique_lock lock{dir_latch_};
+    while (true) {
+        IxHashBucket bucket = fetch_bucket(bucket_page_no(h));
+        page_id_t page_no = bucket.get_page_no();
+        if (bucket.find(key, h) >= 0) {
+            // 释放读锁之后其他线程插入了相同的key
+            buffer_pool_manager_->unpin_page(bucket.page->get_page_id(), false);
+            return IX_NO_PAGE;
+        }
+        if (!bucket.is_full()) {
+            bucket.append(key, h, value);
+            buffer_pool_manager_->unpin_page(bucket.page->get_page_id(), true);
+            return page_no;
+        }
+        split_bucket(bucket);
+        buffer_pool_manager_->unpin_page(bucket.page->get_page_id(), true);
+    }
+}
+
+/**
+ * @brief 删除含有指定key的键值对
+ *
+ * @param rec_key 要删除的key值，记录格式
+ * @param transaction 事务指针
+ * @return key是否存在
+ */
+bool IxHashHandle::delete_entry(const char *rec_key, Transaction *transaction) {
+    IxKeyBuffer norm_key(rec_key, file_hdr_.col_types_, file_hdr_.col_lens_, file_hdr_.col_tot_len_);
+    const char *key = norm_key.data();
+    uint32_t h = hash(key);
+    std::shared_lock lock{dir_latch_};
+    IxHashBucket bucket = fetch_bucket(bucket_page_no(h));
+    bucket.page->w_latch();
+    int pos = bucket.find(key, h);
+    if (pos >= 0) {
+        bucket.erase(pos);
+    }
+    bucket.page->w_unlatch();
+    buffer_pool_manager_->unpin_page(bucket.page->get_page_id(), pos >= 0);
+    return pos >= 0;
+}
+
+/**
+ * @brief 获取一个桶
+ * @note pin the page, remember to unpin it outside!
+ */
+IxHashBucket IxHashHandle::fetch_bucket(page_id_t page_no) const {
+    Page *page = buffer_pool_manager_->fetch_page(PageId{fd_, page_no});
+    return IxHashBucket(&file_hdr_, page);
+}
+
+/**
+ * @brief 创建一个空桶，需要持有目录的写锁
+ * @note pin the page, remember to unpin it outside!
+ */
+IxHashBucket IxHashHandle::create_bucket(int local_depth) {
+    PageId new_page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
+    Page *page = buffer_pool_manager_->new_page(&new_page_id);
+    file_hdr_.num_pages_++;
+    file_hdr_.num_buckets_++;
+    IxHashBucket bucket(&file_hdr_, page);
+    bucket.bucket_hdr->local_depth = local_depth;
+    bucket.bucket_hdr->num_key = 0;
+    return bucket;
+}
+
+/**
+ * @brief 分裂桶：局部深度加1，哈希值第local_depth位为1的键值对移动到新桶中，
+ * 原来指向该桶、下标第local_depth位为1的目录项改为指向新桶。局部深度等于全局深度时目录先加倍，
+ * 新的一半目录项与对应的旧目录项指向同一个桶。需要持有目录的写锁
+ *
+ * @param bucket 已满的桶，分裂之后key所在的桶可能仍然是满的，由调用方继续分裂
+ */
+void IxHashHandle::split_bucket(IxHashBucket &bucket) {
+    int local_depth = bucket.get_local_depth();
+    if (local_depth == file_hdr_.global_depth_) {
+        if (file_hdr_.global_depth_ >= IX_HASH_MAX_DEPTH) {
+            throw InternalError("IxHashHandle::split_bucket: directory is full");
+        }
+        size_t size = dir_.size();
+        dir_.resize(size * 2);
+        std::copy(dir_.begin(), dir_.begin() + size, dir_.begin() + size);
+        file_hdr_.global_depth_++;
+    }
+
+    IxHashBucket new_bucket = create_bucket(local_depth + 1);
+    bucket.bucket_hdr->local_depth = local_depth + 1;
+    int n = bucket.get_size(), kept = 0;
+    for (int i = 0; i < n; i++) {
+        if ((bucket.hashes[i] >> local_depth) & 1) {
+            new_bucket.append(bucket.get_key(i), bucket.hashes[i], bucket.rids[i]);
+        } else {
+            if (kept != i) {
+                bucket.hashes[kept] = bucket.hashes[i];
+                memcpy(bucket.get_key(kept), bucket.get_key(i), file_hdr_.col_tot_len_);
+                bucket.rids[kept] = bucket.rids[i];
+            }
+            kept++;
+        }
+    }
+    bucket.bucket_hdr->num_key = kept;
+
+    page_id_t old_page_no = bucket.get_page_no(), new_page_no = new_bucket.get_page_no();
+    for (size_t i = 0; i < dir_.size(); i++) {
+        if (dir_[i] == old_page_no && ((i >> local_depth) & 1)) {
+            dir_[i] = new_page_no;
+        }
+    }
+    buffer_pool_manager_->unpin_page(new_bucket.page->get_page_id(), true);
+}
+
+/**
+ * @brief 从目录页中读取目录
+ */
+void IxHashHandle::load_directory() {
+    dir_.resize((size_t)1 << file_hdr_.global_depth_);
+    size_t pos = 0;
+    for (page_id_t page_no : file_hdr_.dir_pages_) {
+        Page *page = buffer_pool_manager_->fetch_page(PageId{fd_, page_no});
+        size_t n = std::min(dir_.size() - pos, (size_t)IX_HASH_DIR_PAGE_ENTRIES);
+        memcpy(dir_.data() + pos, page->get_data(), n * sizeof(page_id_t));
+        pos += n;
+        buffer_pool_manager_->unpin_page(page->get_page_id(), false);
+    }
+    assert(pos == dir_.size());
+}
+
+/**
+ * @brief 把目录写入目录页，目录加倍之后不够用时分配新的目录页，在关闭索引之前调用
+ */
+void IxHashHandle::flush_directory() {
+    std::unique_lock lock{dir_latch_};
+    size_t num_dir_pages = (dir_.size() + IX_HASH_DIR_PAGE_ENTRIES - 1) / IX_HASH_DIR_PAGE_ENTRIES;
+    for (size_t i = 0; i < num_dir_pages; i++) {
+        Page *page;
+        if (i < file_hdr_.dir_pages_.size()) {
+            page = buffer_pool_manager_->fetch_page(PageId{fd_, file_hdr_.dir_pages_[i]});
+        } else {
+            PageId new_page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
+            page = buffer_pool_manager_->new_page(&new_page_id);
+            file_hdr_.num_pages_++;
+            file_hdr_.dir_pages_.push_back(new_page_id.page_no);
+        }
+        size_t pos = i * IX_HASH_DIR_PAGE_ENTRIES;
+        size_t n = std::min(dir_.size() - pos, (size_t)IX_HASH_DIR_PAGE_ENTRIES);
+        memcpy(page->get_data(), dir_.data() + pos, n * sizeof(page_id_t));
+        buffer_pool_manager_->unpin_page(page->get_page_id(), true);
+    }
+    file_hdr_.update_tot_len();
+}
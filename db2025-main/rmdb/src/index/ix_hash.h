@@ -0,0 +1,189 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <shared_mutex>
+#include <vector>
+
+#include "ix_index_handle.h"
+
+constexpr int IX_HASH_DIR_PAGE = 1;             // 第一个目录页
+constexpr int IX_HASH_INIT_BUCKET_PAGE = 2;     // 第一个桶，初始时全局深度为0，目录中只有这一个桶
+constexpr int IX_HASH_INIT_NUM_PAGES = 3;
+constexpr int IX_HASH_DIR_PAGE_ENTRIES = PAGE_SIZE / sizeof(page_id_t);    // 一个目录页中保存的桶页号个数
+constexpr int IX_HASH_MAX_DEPTH = 19;           // 目录最多2^19项，占512个目录页，目录页号都保存在文件头中
+
+/**
+ * 哈希索引的文件头，保存在第0页
+ * 目录在内存中是一个数组，第i项为哈希值低global_depth_位等于i的key所在的桶的页号，关闭索引时写入dir_pages_中的目录页
+ */
+class IxHashFileHdr {
+public:
+    int num_pages_;                     // 磁盘文件中页面的数量
+    int col_num_;                       // 索引包含的字段数量
+    std::vector<ColType> col_types_;    // 字段的类型
+    std::vector<int> col_lens_;         // 字段的长度
+    int col_tot_len_;                   // 索引包含的字段的总长度
+    int bucket_capacity_;               // 每个桶最多保存的键值对数量
+    int global_depth_;                  // 目录的全局深度，目录共有2^global_depth_项
+    int num_buckets_;                   // 桶的数量
+    std::vector<page_id_t> dir_pages_;  // 保存目录的页面，按照目录项的顺序排列
+    int tot_len_;                       // 记录结构体的整体长度
+
+    IxHashFileHdr() {
+        tot_len_ = col_num_ = col_tot_len_ = 0;
+        num_pages_ = bucket_capacity_ = global_depth_ = num_buckets_ = 0;
+    }
+
+    void update_tot_len() {
+        tot_len_ = sizeof(int) * 8;
+        tot_len_ += sizeof(ColType) * col_num_ + sizeof(int) * col_num_;
+        tot_len_ += sizeof(page_id_t) * dir_pages_.size();
+    }
+
+    void serialize(char *dest) const {
+        int offset = 0;
+        auto put = [&](const void *src, size_t len) {
+            memcpy(dest + offset, src, len);
+            offset += len;
+        };
+        int num_dir_pages = dir_pages_.size();
+        put(&tot_len_, sizeof(int));
+        put(&num_pages_, sizeof(int));
+        put(&col_num_, sizeof(int));
+        put(col_types_.data(), sizeof(ColType) * col_num_);
+        put(col_lens_.data(), sizeof(int) * col_num_);
+        put(&col_tot_len_, sizeof(int));
+        put(&bucket_capacity_, sizeof(int));
+        put(&global_depth_, sizeof(int));
+        put(&num_buckets_, sizeof(int));
+        put(&num_dir_pages, sizeof(int));
+        put(dir_pages_.data(), sizeof(page_id_t) * num_dir_pages);
+        assert(offset == tot_len_);
+    }
+
+    void deserialize(const char *src) {
+        int offset = 0;
+        auto get = [&](void *dest, size_t len) {
+            memcpy(dest, src + offset, len);
+            offset += len;
+        };
+        int num_dir_pages;
+        get(&tot_len_, sizeof(int));
+        get(&num_pages_, sizeof(int));
+        get(&col_num_, sizeof(int));
+        col_types_.resize(col_num_);
+        col_lens_.resize(col_num_);
+        get(col_types_.data(), sizeof(ColType) * col_num_);
+        get(col_lens_.data(), sizeof(int) * col_num_);
+        get(&col_tot_len_, sizeof(int));
+        get(&bucket_capacity_, sizeof(int));
+        get(&global_depth_, sizeof(int));
+        get(&num_buckets_, sizeof(int));
+        get(&num_dir_pages, sizeof(int));
+        dir_pages_.resize(num_dir_pages);
+        get(dir_pages_.data(), sizeof(page_id_t) * num_dir_pages);
+        assert(offset == tot_len_);
+    }
+};
+
+class IxHashBucketHdr {
+public:
+    int local_depth;                    // 桶的局部深度，桶中所有key的哈希值低local_depth位相同
+    int num_key;                        // 桶中键值对的数量
+};
+
+/**
+ * 管理哈希索引中的一个桶，页面格式为 | IxHashBucketHdr | hash[capacity] | key[capacity] | rid[capacity] |，
+ * 桶中的键值对没有顺序，删除时用最后一个键值对填补空位
+ */
+class IxHashBucket {
+    friend class IxHashHandle;
+
+   private:
+    const IxHashFileHdr *file_hdr;
+    Page *page;
+    IxHashBucketHdr *bucket_hdr;
+    uint32_t *hashes;
+    char *keys;
+    Rid *rids;
+
+   public:
+    IxHashBucket(const IxHashFileHdr *file_hdr_, Page *page_) : file_hdr(file_hdr_), page(page_) {
+        bucket_hdr = reinterpret_cast<IxHashBucketHdr *>(page->get_data());
+        hashes = reinterpret_cast<uint32_t *>(page->get_data() + sizeof(IxHashBucketHdr));
+        keys = reinterpret_cast<char *>(hashes + file_hdr->bucket_capacity_);
+        rids = reinterpret_cast<Rid *>(keys + file_hdr->bucket_capacity_ * file_hdr->col_tot_len_);
+    }
+
+    int get_size() const { return bucket_hdr->num_key; }
+
+    bool is_full() const { return bucket_hdr->num_key >= file_hdr->bucket_capacity_; }
+
+    int get_local_depth() const { return bucket_hdr->local_depth; }
+
+    page_id_t get_page_no() const { return page->get_page_id().page_no; }
+
+    char *get_key(int i) const { return keys + i * file_hdr->col_tot_len_; }
+
+    int find(const char *key, uint32_t hash) const;
+
+    void append(const char *key, uint32_t hash, const Rid &rid);
+
+    void erase(int pos);
+};
+
+/**
+ * 可扩展哈希索引，只支持所有索引字段上的等值查找，key唯一
+ * 目录保存在内存中，桶是缓冲池中的页面；查找、插入和删除持有目录的读锁和桶的页面latch，
+ * 桶满时持有目录的写锁分裂桶，局部深度等于全局深度时目录先加倍。删除之后不合并桶，空出的位置留给之后插入的key
+ */
+class IxHashHandle {
+    friend class IxManager;
+
+   private:
+    DiskManager *disk_manager_;
+    BufferPoolManager *buffer_pool_manager_;
+    int fd_;                                    // 存储哈希索引的文件
+    IxHashFileHdr file_hdr_;
+    std::vector<page_id_t> dir_;                // 目录，第i项为哈希值低global_depth_位等于i的key所在的桶
+    mutable std::shared_mutex dir_latch_;       // 保护dir_和文件头，分裂桶时持有写锁
+
+   public:
+    IxHashHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd);
+
+    bool get_value(const char *rec_key, std::vector<Rid> *result, Transaction *transaction);
+
+    page_id_t insert_entry(const char *rec_key, const Rid &value, Transaction *transaction);
+
+    bool delete_entry(const char *rec_key, Transaction *transaction);
+
+    const IxHashFileHdr *get_file_hdr() const { return &file_hdr_; }
+
+    int get_global_depth() const { return file_hdr_.global_depth_; }
+
+    int get_num_buckets() const { return file_hdr_.num_buckets_; }
+
+   private:
+    uint32_t hash(const char *key) const { return (uint32_t)ix_hash_key(key, file_hdr_.col_tot_len_); }
+
+    page_id_t bucket_page_no(uint32_t hash) const { return dir_[hash & ((1u << file_hdr_.global_depth_) - 1)]; }
+
+    IxHashBucket fetch_bucket(page_id_t page_no) const;
+
+    IxHashBucket create_bucket(int local_depth);
+
+    void split_bucket(IxHashBucket &bucket);
+
+    void load_directory();
+
+    void flush_directory();
+};
@@ -10,34 +10,365 @@ See the Mulan PSL v2 for more details. */
 
 #include "ix_index_handle.h"
 
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ix_sorter.h"
+
 #include "ix_scan.h"
 
+/* 把规范化的4字节key转换成int，转换前后的大小关系相同 */
+static inline int ix_key32_value(const char *key) {
+    uint32_t u;
+    memcpy(&u, key, sizeof(u));
+    return (int)(ix_big_endian32(u) ^ 0x80000000u);
+}
+
+/**
+ * @brief 在有序的4字节规范化key数组中查找第一个>=target（upper为true时为>target）的位置
+ * 每个key按照大端序读取并把符号位取反之后就是一个int，INT字段转换回原值，FLOAT字段转换后大小关系不变。
+ * 先用无分支的二分查找把范围缩小到最后IX_INT_SCAN_KEYS个key以内，循环中只有条件传送，不会因为分支预测失败而清空流水线；
+ * 然后用SIMD指令一次转换并比较4个key，统计范围内小于（或小于等于）target的key的个数
+ *
+ * @return 位置，范围为[0,num_key]
+ */
+int ix_key32_search(const char *keys, int num_key, const char *target_key, bool upper) {
+    int target = ix_key32_value(target_key);
+    int base = 0;
+    int len = num_key;
+    // 循环不变式：base之前的key都满足条件（小于或小于等于target），base + len及之后的key都不满足条件
+    while (len > IX_INT_SCAN_KEYS) {
+        int half = len / 2;
+        int key = ix_key32_value(keys + (base + half) * 4);
+        bool go_right = upper ? key <= target : key < target;
+        base = go_right ? base + half : base;
+        len -= half;
+    }
+    const char *begin = keys + base * 4;
+    int count = 0, i = 0;
+#ifdef __SSE2__
+    __m128i target_vec = _mm_set1_epi32(target);
+    __m128i sign_vec = _mm_set1_epi32((int)0x80000000u);
+    for (; i + 4 <= len; i += 4) {
+        __m128i key_vec = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin + i * 4));
+        // 大端序转换成小端序：先交换每个16位中的两个字节，再交换每个32位中的两个16位
+        key_vec = _mm_or_si128(_mm_slli_epi16(key_vec, 8), _mm_srli_epi16(key_vec, 8));
+        key_vec = _mm_shufflelo_epi16(key_vec, _MM_SHUFFLE(2, 3, 0, 1));
+        key_vec = _mm_shufflehi_epi16(key_vec, _MM_SHUFFLE(2, 3, 0, 1));
+        key_vec = _mm_xor_si128(key_vec, sign_vec);
+        // upper时统计<=target的个数，即4减去>target的个数
+        __m128i cmp = upper ? _mm_cmpgt_epi32(key_vec, target_vec) : _mm_cmplt_epi32(key_vec, target_vec);
+        int bits = __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(cmp)));
+        count += upper ? 4 - bits : bits;
+    }
+#endif
+    for (; i < len; i++) {
+        int key = ix_key32_value(begin + i * 4);
+        count += upper ? key <= target : key < target;
+    }
+    return base + count;
+}
+
 /**
  * @brief 在当前node中查找第一个>=target的key_idx
  *
  * @return key_idx，范围为[0,num_key)，如果返回的key_idx=num_key，则表示target大于最后一个key
- * @note 返回key index（同时也是rid index），作为slot no
+ * @note 返回key index（同时也是rid index），作为slot no；target是规范化的key，4字节的key使用ix_key32_search，
+ * 其他key使用ix_key_compare按字节比较。内部结点的第0个key不参与查找，视为负无穷（见compressed_bound）：
+ * 向最左边的子树插入更小的key时不会更新祖先结点，第0个key可能大于第1个key，参与比较会使二分查找和计数的结果出错
  */
 int IxNodeHandle::lower_bound(const char *target) const {
-    // Todo:
-    // 查找当前节点中第一个大于等于target的key，并返回key的位置给上层
-    // 提示: 可以采用多种查找方式，如顺序遍历、二分查找等；使用ix_compare()函数进行比较
-
-    return -1;
+    if (is_compressed() && !decoded_) {
+        if (!page_hdr->is_leaf) {
+            return compressed_bound(target, false);
+        }
+        decode();
+    }
+    int first = page_hdr->is_leaf ? 0 : std::min(1, page_hdr->num_key);
+    if (is_key32()) {
+        return first + ix_key32_search(keys + first * 4, page_hdr->num_key - first, target, false);
+    }
+    int left = first, right = page_hdr->num_key;
+    if (binary_search) {
+        while (left < right) {
+            int mid = (left + right) / 2;
+            if (ix_key_compare(get_key(mid), target, file_hdr->col_tot_len_) < 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        return left;
+    }
+    while (left < right && ix_key_compare(get_key(left), target, file_hdr->col_tot_len_) < 0) {
+        left++;
+    }
+    return left;
 }
 
 /**
  * @brief 在当前node中查找第一个>target的key_idx
  *
- * @return key_idx，范围为[1,num_key)，如果返回的key_idx=num_key，则表示target大于等于最后一个key
- * @note 注意此处的范围从1开始
+ * @return key_idx，范围为[0,num_key)，如果返回的key_idx=num_key，则表示target大于等于最后一个key
+ * @note 查找孩子结点时需要把返回值减1（见internal_lookup），内部结点的第0个key与lower_bound相同，不参与查找
  */
 int IxNodeHandle::upper_bound(const char *target) const {
-    // Todo:
-    // 查找当前节点中第一个大于target的key，并返回key的位置给上层
-    // 提示: 可以采用多种查找方式：顺序遍历、二分查找等；使用ix_compare()函数进行比较
+    if (is_compressed() && !decoded_) {
+        if (!page_hdr->is_leaf) {
+            return compressed_bound(target, true);
+        }
+        decode();
+    }
+    int first = page_hdr->is_leaf ? 0 : std::min(1, page_hdr->num_key);
+    if (is_key32()) {
+        return first + ix_key32_search(keys + first * 4, page_hdr->num_key - first, target, true);
+    }
+    int left = first, right = page_hdr->num_key;
+    if (binary_search) {
+        while (left < right) {
+            int mid = (left + right) / 2;
+            if (ix_key_compare(get_key(mid), target, file_hdr->col_tot_len_) <= 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        return left;
+    }
+    while (left < right && ix_key_compare(get_key(left), target, file_hdr->col_tot_len_) <= 0) {
+        left++;
+    }
+    return left;
+}
 
-    return -1;
+/**
+ * @brief 在压缩的内部结点的页面上查找第一个>=target（upper为true时为>target）的key_idx，不需要解压
+ * 内部结点的第0个key不参与查找孩子结点，这里视为负无穷，返回值至少为1，调用方减1之后得到的孩子结点不变；
+ * key[1..n)的公共前缀只需要和target比较一次，然后二分查找时只比较去掉公共前缀之后的部分，
+ * 这部分相同时key后面都是0，target后面也都是0才相等，否则target更大
+ */
+int IxNodeHandle::compressed_bound(const char *target, bool upper) const {
+    int n = page_hdr->num_key;
+    if (n <= 1) {
+        return n;
+    }
+    int key_len = file_hdr->col_tot_len_;
+    int prefix_len = page_hdr->prefix_len;
+    const char *prefix = page->get_data() + sizeof(IxPageHdr) + key_len;
+    const char *ends = prefix + prefix_len;
+    const char *suffixes = ends + (n - 1) * sizeof(uint16_t) + n * sizeof(Rid);
+    int cmp = memcmp(prefix, target, prefix_len);
+    if (cmp != 0) {
+        return cmp > 0 ? 1 : n;
+    }
+    int target_len = ix_significant_len(target, key_len);
+    auto suffix_end = [&](int i) {
+        uint16_t end = 0;
+        if (i > 0) memcpy(&end, ends + (i - 1) * sizeof(uint16_t), sizeof(uint16_t));
+        return (int)end;
+    };
+    int left = 1, right = n;
+    while (left < right) {
+        int mid = (left + right) / 2;
+        int begin = suffix_end(mid - 1), end = suffix_end(mid);
+        int len = end - begin;
+        cmp = memcmp(suffixes + begin, target + prefix_len, len);
+        if (cmp == 0) {
+            cmp = prefix_len + len >= target_len ? 0 : -1;
+        }
+        if (upper ? cmp <= 0 : cmp < 0) {
+            left = mid + 1;
+        } else {
+            right = mid;
+        }
+    }
+    return left;
+}
+
+/**
+ * @brief 把压缩的结点解压到key_buf_和rid_buf_中，之后keys和rids指向缓冲区
+ */
+void IxNodeHandle::decode() const {
+    if (decoded_) {
+        return;
+    }
+    if (page_hdr->is_leaf) {
+        decode_posting();
+        return;
+    }
+    int n = page_hdr->num_key;
+    int key_len = file_hdr->col_tot_len_;
+    int prefix_len = page_hdr->prefix_len;
+    key_buf_.assign(n * key_len, 0);
+    rid_buf_.resize(n);
+    if (n > 0) {
+        const char *key0 = page->get_data() + sizeof(IxPageHdr);
+        const char *prefix = key0 + key_len;
+        const char *ends = prefix + prefix_len;
+        const char *rid_data = ends + (n - 1) * sizeof(uint16_t);
+        const char *suffixes = rid_data + n * sizeof(Rid);
+        memcpy(key_buf_.data(), key0, key_len);
+        uint16_t begin = 0;
+        for (int i = 1; i < n; i++) {
+            uint16_t end;
+            memcpy(&end, ends + (i - 1) * sizeof(uint16_t), sizeof(uint16_t));
+            char *key = key_buf_.data() + i * key_len;
+            memcpy(key, prefix, prefix_len);
+            memcpy(key + prefix_len, suffixes + begin, end - begin);
+            begin = end;
+        }
+        memcpy(rid_buf_.data(), rid_data, n * sizeof(Rid));
+    }
+    keys = key_buf_.data();
+    rids = rid_buf_.data();
+    decoded_ = true;
+}
+
+/**
+ * @brief 把缓冲区中的键值对压缩后写回页面，超过一个页面时不写回，标记为溢出，等待分裂之后再写回
+ * 压缩的内部结点的页面格式：
+ * | IxPageHdr | key[0] | 公共前缀 | key[1..n)的结束位置 | rid[0..n) | key[1..n)去掉公共前缀和末尾0之后的部分 |
+ * 第0个key不参与查找孩子结点，可能已经过时，甚至大于key[1]（插入更小的key时不会更新），所以完整保存，不参与计算公共前缀
+ */
+void IxNodeHandle::store() {
+    if (page_hdr->is_leaf) {
+        store_posting();
+        return;
+    }
+    int n = page_hdr->num_key;
+    int key_len = file_hdr->col_tot_len_;
+    if (ix_compressed_size(keys, n, key_len) > PAGE_SIZE) {
+        overflow_ = true;
+        return;
+    }
+    overflow_ = false;
+    page_hdr->prefix_len = ix_internal_prefix(keys, n, key_len);
+    if (n == 0) {
+        return;
+    }
+    int prefix_len = page_hdr->prefix_len;
+    char *key0 = page->get_data() + sizeof(IxPageHdr);
+    char *prefix = key0 + key_len;
+    char *ends = prefix + prefix_len;
+    char *rid_data = ends + (n - 1) * sizeof(uint16_t);
+    char *suffixes = rid_data + n * sizeof(Rid);
+    memcpy(key0, keys, key_len);
+    memcpy(prefix, keys + key_len, prefix_len);
+    memcpy(rid_data, rids, n * sizeof(Rid));
+    uint16_t end = 0;
+    for (int i = 1; i < n; i++) {
+        const char *key = keys + i * key_len;
+        int len = std::max(0, ix_significant_len(key, key_len) - prefix_len);
+        memcpy(suffixes + end, key + prefix_len, len);
+        end += len;
+        memcpy(ends + (i - 1) * sizeof(uint16_t), &end, sizeof(uint16_t));
+    }
+}
+
+/**
+ * @brief 把posting list格式的叶子结点解压到key_buf_和rid_buf_中，每个Rid还原成一个键值对，key末尾追加规范化的Rid
+ */
+void IxNodeHandle::decode_posting() const {
+    int n = page_hdr->num_key;
+    int key_len = file_hdr->col_tot_len_;
+    int col_len = key_len - IX_RID_KEY_LEN;
+    key_buf_.assign(n * key_len, 0);
+    rid_buf_.resize(n);
+    if (n > 0) {
+        const char *p = posting_data();
+        uint16_t num_groups;
+        memcpy(&num_groups, p, sizeof(uint16_t));
+        p += sizeof(uint16_t);
+        int i = 0;
+        for (int g = 0; g < num_groups; g++) {
+            uint16_t count;
+            memcpy(&count, p + col_len, sizeof(uint16_t));
+            const char *data = p + col_len + 2 * sizeof(uint16_t);
+            uint64_t value = 0;
+            for (int j = 0; j < count; j++, i++) {
+                uint64_t delta;
+                data += ix_get_varint(data, &delta);
+                value += delta;
+                char *key = key_buf_.data() + i * key_len;
+                memcpy(key, p, col_len);
+                rid_buf_[i] = ix_posting_rid(value);
+                ix_encode_rid(key + col_len, rid_buf_[i]);
+            }
+            p = data;
+        }
+        assert(i == n);
+    }
+    keys = key_buf_.data();
+    rids = rid_buf_.data();
+    decoded_ = true;
+}
+
+/**
+ * @brief 把缓冲区中的键值对按照posting list格式写回页面，超过一个页面时不写回，标记为溢出，等待分裂之后再写回
+ * posting list格式的叶子结点的页面格式：
+ * | IxPageHdr | 组数 | 组0 | 组1 | ... |，每组为字段相同的连续键值对：
+ * | 字段（不含末尾的Rid） | Rid个数 | Rid列表的字节数 | Rid列表 |，Rid列表中第一个Rid和之后每个Rid与前一个的差值保存为varint，
+ * 字段相同的键值对很多时，一个字段的Rid可以分布在多个相邻的叶子结点中，每个叶子结点中保存一次字段
+ */
+void IxNodeHandle::store_posting() {
+    int n = page_hdr->num_key;
+    int key_len = file_hdr->col_tot_len_;
+    int col_len = key_len - IX_RID_KEY_LEN;
+    int size = ix_posting_size(keys, rids, n, key_len);
+    if (size > PAGE_SIZE) {
+        overflow_ = true;
+        return;
+    }
+    overflow_ = false;
+    page_hdr->data_len = size;
+    char *begin = posting_data();
+    char *p = begin + sizeof(uint16_t);
+    uint16_t num_groups = 0;
+    for (int i = 0; i < n;) {
+        const char *key = keys + i * key_len;
+        char *hdr = p;
+        memcpy(p, key, col_len);
+        p += col_len + 2 * sizeof(uint16_t);
+        char *data = p;
+        uint64_t prev = 0;
+        uint16_t count = 0;
+        for (; i < n && memcmp(keys + i * key_len, key, col_len) == 0; i++, count++) {
+            uint64_t value = ix_posting_value(rids[i]);
+            p += ix_put_varint(p, value - prev);
+            prev = value;
+        }
+        uint16_t len = p - data;
+        memcpy(hdr + col_len, &count, sizeof(uint16_t));
+        memcpy(hdr + col_len + sizeof(uint16_t), &len, sizeof(uint16_t));
+        num_groups++;
+    }
+    memcpy(begin, &num_groups, sizeof(uint16_t));
+    assert((int)(sizeof(IxPageHdr) + (p - begin)) == size);
+}
+
+/**
+ * @brief 压缩的结点溢出之后分裂的位置，两半都必须能放进一个页面，优先从preferred分裂
+ */
+int IxNodeHandle::split_point(int preferred) {
+    int n = get_size();
+    int key_len = file_hdr->col_tot_len_;
+    const char *all = get_key(0);
+    const Rid *all_rids = get_rid(0);
+    auto size = [&](int begin, int count) {
+        return page_hdr->is_leaf ? ix_posting_size(all + begin * key_len, all_rids + begin, count, key_len)
+                                 : ix_compressed_size(all + begin * key_len, count, key_len);
+    };
+    for (int d = 0; d < n; d++) {
+        for (int mid : {preferred - d, preferred + d}) {
+            if (mid > 0 && mid < n && size(0, mid) <= PAGE_SIZE && size(mid, n - mid) <= PAGE_SIZE) {
+                return mid;
+            }
+        }
+    }
+    throw InternalError("IxNodeHandle::split_point: no valid split point");
 }
 
 /**
@@ -49,13 +380,52 @@ int IxNodeHandle::upper_bound(const char *target) const {
  * @return 目标key是否存在
  */
 bool IxNodeHandle::leaf_lookup(const char *key, Rid **value) {
-    // Todo:
-    // 1. 在叶子节点中获取目标key所在位置
-    // 2. 判断目标key是否存在
-    // 3. 如果存在，获取key对应的Rid，并赋值给传出参数value
-    // 提示：可以调用lower_bound()和get_rid()函数。
+    int pos = lower_bound(key);
+    if (pos == get_size() || ix_key_compare(get_key(pos), key, file_hdr->col_tot_len_) != 0) {
+        return false;
+    }
+    *value = get_rid(pos);
+    return true;
+}
 
-    return false;
+/**
+ * @brief 在posting list格式的叶子结点的页面上查找字段与key相同的一组，把这一组的Rid依次加入result，不需要解压整个结点
+ *
+ * @param key 目标key，只比较字段部分
+ * @param[out] result 字段与key相同的Rid
+ * @return 后面的叶子结点中是否可能还有字段与key相同的Rid，即结点中没有字段大于key的组
+ */
+bool IxNodeHandle::posting_lookup(const char *key, std::vector<Rid> *result) const {
+    if (page_hdr->num_key == 0) {
+        return true;
+    }
+    int col_len = file_hdr->col_tot_len_ - IX_RID_KEY_LEN;
+    const char *p = posting_data();
+    uint16_t num_groups;
+    memcpy(&num_groups, p, sizeof(uint16_t));
+    p += sizeof(uint16_t);
+    for (int g = 0; g < num_groups; g++) {
+        uint16_t count, len;
+        memcpy(&count, p + col_len, sizeof(uint16_t));
+        memcpy(&len, p + col_len + sizeof(uint16_t), sizeof(uint16_t));
+        const char *data = p + col_len + 2 * sizeof(uint16_t);
+        int cmp = ix_key_compare(p, key, col_len);
+        if (cmp > 0) {
+            return false;
+        }
+        if (cmp == 0) {
+            uint64_t value = 0;
+            for (int j = 0; j < count; j++) {
+                uint64_t delta;
+                data += ix_get_varint(data, &delta);
+                value += delta;
+                result->push_back(ix_posting_rid(value));
+            }
+            return g == num_groups - 1;
+        }
+        p = data + len;
+    }
+    return true;
 }
 
 /**
@@ -64,12 +434,9 @@ bool IxNodeHandle::leaf_lookup(const char *key, Rid **value) {
  * @return page_id_t 目标key所在的孩子节点（子树）的存储页面编号
  */
 page_id_t IxNodeHandle::internal_lookup(const char *key) {
-    // Todo:
-    // 1. 查找当前非叶子节点中目标key所在孩子节点（子树）的位置
-    // 2. 获取该孩子节点（子树）所在页面的编号
-    // 3. 返回页面编号
-
-    return -1;
+    // 最后一个第一个key小于等于key的孩子结点，key比所有孩子结点的第一个key都小时进入第0个孩子结点
+    int pos = upper_bound(key);
+    return value_at(std::max(pos - 1, 0));
 }
 
 /**
@@ -87,12 +454,24 @@ page_id_t IxNodeHandle::internal_lookup(const char *key) {
  *                      key           key_slot
  */
 void IxNodeHandle::insert_pairs(int pos, const char *key, const Rid *rid, int n) {
-    // Todo:
-    // 1. 判断pos的合法性
-    // 2. 通过key获取n个连续键值对的key值，并把n个key值插入到pos位置
-    // 3. 通过rid获取n个连续键值对的rid值，并把n个rid值插入到pos位置
-    // 4. 更新当前节点的键数量
-
+    int num_key = get_size();
+    int key_len = file_hdr->col_tot_len_;
+    if (is_compressed()) {
+        // 压缩的内部结点在缓冲区中插入，插入之后是否超过一个页面由store检查
+        assert(pos >= 0 && pos <= num_key);
+        decode();
+        key_buf_.resize((num_key + n) * key_len);
+        rid_buf_.resize(num_key + n);
+        keys = key_buf_.data();
+        rids = rid_buf_.data();
+    } else {
+        assert(pos >= 0 && pos <= num_key && num_key + n <= get_max_size());
+    }
+    memmove(get_key(pos + n), get_key(pos), (num_key - pos) * key_len);
+    memcpy(get_key(pos), key, n * key_len);
+    memmove(get_rid(pos + n), get_rid(pos), (num_key - pos) * sizeof(Rid));
+    memcpy(get_rid(pos), rid, n * sizeof(Rid));
+    set_size(num_key + n);
 }
 
 /**
@@ -103,13 +482,12 @@ void IxNodeHandle::insert_pairs(int pos, const char *key, const Rid *rid, int n)
  * @return int 键值对数量
  */
 int IxNodeHandle::insert(const char *key, const Rid &value) {
-    // Todo:
-    // 1. 查找要插入的键值对应该插入到当前节点的哪个位置
-    // 2. 如果key重复则不插入
-    // 3. 如果key不重复则插入键值对
-    // 4. 返回完成插入操作之后的键值对数量
-
-    return -1;
+    int pos = lower_bound(key);
+    if (pos < get_size() && ix_key_compare(get_key(pos), key, file_hdr->col_tot_len_) == 0) {
+        return get_size();
+    }
+    insert_pair(pos, key, value);
+    return get_size();
 }
 
 /**
@@ -118,11 +496,12 @@ int IxNodeHandle::insert(const char *key, const Rid &value) {
  * @param pos 要删除键值对的位置
  */
 void IxNodeHandle::erase_pair(int pos) {
-    // Todo:
-    // 1. 删除该位置的key
-    // 2. 删除该位置的rid
-    // 3. 更新结点的键值对数量
-
+    int num_key = get_size();
+    assert(pos >= 0 && pos < num_key);
+    int key_len = file_hdr->col_tot_len_;
+    memmove(get_key(pos), get_key(pos + 1), (num_key - pos - 1) * key_len);
+    memmove(get_rid(pos), get_rid(pos + 1), (num_key - pos - 1) * sizeof(Rid));
+    set_size(num_key - 1);
 }
 
 /**
@@ -132,12 +511,11 @@ void IxNodeHandle::erase_pair(int pos) {
  * @return 完成删除操作后的键值对数量
  */
 int IxNodeHandle::remove(const char *key) {
-    // Todo:
-    // 1. 查找要删除键值对的位置
-    // 2. 如果要删除的键值对存在，删除键值对
-    // 3. 返回完成删除操作后的键值对数量
-
-    return -1;
+    int pos = lower_bound(key);
+    if (pos < get_size() && ix_key_compare(get_key(pos), key, file_hdr->col_tot_len_) == 0) {
+        erase_pair(pos);
+    }
+    return get_size();
 }
 
 IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
@@ -155,59 +533,272 @@ IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffe
     disk_manager_->set_fd2pageno(fd, now_page_no + 1);
 }
 
+/**
+ * @brief 判断结点在执行operation之后是否一定不会分裂或者合并，此时可以释放所有祖先结点的latch
+ * @note 压缩的内部结点插入一个key或者修改一个分隔key之后，公共前缀可能变短，占用的空间不能按照key的个数估计，
+ * 只有按照完全不压缩计算也能再放下一个key时才是安全的；删除时孩子结点重新分配会修改父结点中的分隔key，
+ * 父结点可能因此溢出并分裂（见coalesce_or_redistribute），所以删除时也要满足这个条件。
+ * posting list格式的叶子结点插入时按照实际大小判断（见IxNodeHandle::has_room）
+ */
+bool IxIndexHandle::is_safe(IxNodeHandle *node, Operation operation) {
+    bool has_room = node->has_room();
+    if (operation == Operation::INSERT) {
+        return node->is_compressed() ? has_room : node->get_size() + 1 < node->get_max_size();
+    }
+    if (operation == Operation::DELETE) {
+        if (node->is_root_page()) {
+            // 根结点为叶子结点时允许为空，为内部结点时只剩一个孩子才需要调整
+            return node->is_leaf_page() || (node->get_size() > 2 && has_room);
+        }
+        // 叶子结点中删除键值对不会变大，只有内部结点中的分隔key会被修改
+        return node->get_size() > node->get_min_size() && (node->is_leaf_page() || has_room);
+    }
+    return true;
+}
+
+/**
+ * @brief 生成叶子结点分裂或重新分配之后插入父结点的分隔key，left是左边结点的最后一个key，right是右边结点的第一个key
+ * 内部结点压缩时使用后缀截断，分隔key只保留区分left和right所需的最短前缀，压缩后只占几个字节
+ */
+void IxIndexHandle::make_separator(char *sep, const char *left, const char *right) const {
+    if (file_hdr_->prefix_compression_) {
+        ix_shortest_separator(sep, left, right, file_hdr_->col_tot_len_);
+    } else {
+        memcpy(sep, right, file_hdr_->col_tot_len_);
+    }
+}
+
+/**
+ * @brief 释放latch_set中所有页面的写锁并unpin，nullptr表示root_latch_
+ */
+void IxIndexHandle::release_latches(std::deque<Page *> &latch_set, bool is_dirty) {
+    for (Page *page : latch_set) {
+        if (page == nullptr) {
+            root_latch_.unlock();
+        } else {
+            page->w_unlatch();
+            buffer_pool_manager_->unpin_page(page->get_page_id(), is_dirty);
+        }
+    }
+    latch_set.clear();
+}
+
 /**
  * @brief 用于查找指定键所在的叶子结点
- * @param key 要查找的目标key值
+ * 查找时使用latch crabbing：先对孩子结点加锁再释放父结点的锁。
+ * 查找操作对沿途结点加读锁，只保留叶子结点的读锁；
+ * 插入和删除操作对沿途结点加写锁，孩子结点安全（见is_safe）时释放所有祖先结点的写锁，
+ * 仍然持有的写锁保存在事务的index_latch_page_set中，nullptr表示root_latch_
+ *
+ * @param key 要查找的目标key值，规范化的key
  * @param operation 查找到目标键值对后要进行的操作类型
- * @param transaction 事务参数，如果不需要则默认传入nullptr
+ * @param transaction 事务参数，插入和删除操作必须传入，用于保存持有的写锁
+ * @param find_first 查找第一个大于等于key的位置所在的叶子结点，用于lower_bound
  * @return [leaf node] and [root_is_latched] 返回目标叶子结点以及根结点是否加锁
  * @note need to Unlatch and unpin the leaf node outside!
  * 注意：用了FindLeafPage之后一定要unlatch叶结点，否则下次latch该结点会堵塞！
  */
 std::pair<IxNodeHandle *, bool> IxIndexHandle::find_leaf_page(const char *key, Operation operation,
                                                             Transaction *transaction, bool find_first) {
-    // Todo:
-    // 1. 获取根节点
-    // 2. 从根节点开始不断向下查找目标key
-    // 3. 找到包含该key值的叶子结点停止查找，并返回叶子节点
+    if (operation != Operation::FIND) {
+        assert(transaction != nullptr);
+        auto &latch_set = *transaction->get_index_latch_page_set();
+        IxNodeHandle *leaf = find_leaf_page(key, operation, latch_set);
+        return std::make_pair(leaf, !latch_set.empty() && latch_set.front() == nullptr);
+    }
+    root_latch_.lock();
+    IxNodeHandle *node = fetch_node(file_hdr_->root_page_);
+    node->page->r_latch();
+    root_latch_.unlock();
+    while (!node->is_leaf_page()) {
+        page_id_t child_page_no;
+        if (find_first) {
+            // 查找第一个大于等于key的位置时，进入最后一个第一个key小于key的孩子结点，
+            // 这样与key相等的键值对跨越多个孩子结点时不会漏掉前面的孩子结点
+            child_page_no = node->value_at(std::max(node->lower_bound(key) - 1, 0));
+        } else {
+            child_page_no = node->internal_lookup(key);
+        }
+        IxNodeHandle *child = fetch_node(child_page_no);
+        child->page->r_latch();
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+        node = child;
+    }
+    return std::make_pair(node, false);
+}
 
-    return std::make_pair(nullptr, false);
+/**
+ * @brief 插入和删除操作查找叶子结点，沿途加写锁，返回时叶子结点和所有不安全的祖先结点的写锁都保存在latch_set中
+ */
+IxNodeHandle *IxIndexHandle::find_leaf_page(const char *key, Operation operation, std::deque<Page *> &latch_set) {
+    root_latch_.lock();
+    latch_set.push_back(nullptr);
+    IxNodeHandle *node = fetch_node(file_hdr_->root_page_);
+    node->page->w_latch();
+    if (is_safe(node, operation)) {
+        release_latches(latch_set, false);
+    }
+    latch_set.push_back(node->page);
+    while (!node->is_leaf_page()) {
+        IxNodeHandle *child = fetch_node(node->internal_lookup(key));
+        child->page->w_latch();
+        if (is_safe(child, operation)) {
+            release_latches(latch_set, false);
+        }
+        latch_set.push_back(child->page);
+        delete node;
+        node = child;
+    }
+    return node;
 }
 
 /**
  * @brief 用于查找指定键在叶子结点中的对应的值result
  *
- * @param key 查找的目标key值
+ * @param rec_key 查找的目标key值，记录格式
  * @param result 用于存放结果的容器
  * @param transaction 事务指针
  * @return bool 返回目标键值对是否存在
  */
-bool IxIndexHandle::get_value(const char *key, std::vector<Rid> *result, Transaction *transaction) {
-    // Todo:
-    // 1. 获取目标key值所在的叶子结点
-    // 2. 在叶子节点中查找目标key值的位置，并读取key对应的rid
-    // 3. 把rid存入result参数中
-    // 提示：使用完buffer_pool提供的page之后，记得unpin page；记得处理并发的上锁
+bool IxIndexHandle::get_value(const char *rec_key, std::vector<Rid> *result, Transaction *transaction) {
+    // 调用方传入的是记录格式的key，B+树中保存的是规范化的key
+    IxKeyBuffer norm_key(rec_key, file_hdr_);
+    const char *key = norm_key.data();
+    // Bloom filter判断key不存在时不需要从根结点向下查找
+    if (bloom_ != nullptr) {
+        bool negative = !bloom_->may_contain(ix_hash_key(key, bloom_key_len()));
+        bloom_->record_probe(negative);
+        if (negative) {
+            return false;
+        }
+    }
+    bool exist;
+    if (file_hdr_->posting_list_) {
+        exist = get_posting_values(key, result);
+    } else {
+        IxNodeHandle *leaf = find_leaf_page(key, Operation::FIND, transaction).first;
+        Rid *rid;
+        exist = leaf->leaf_lookup(key, &rid);
+        if (exist) {
+            result->push_back(*rid);
+        }
+        leaf->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+        delete leaf;
+    }
+    if (!exist && bloom_ != nullptr) {
+        bloom_->record_false_positive();
+    }
+    return exist;
+}
 
-    return false;
+/**
+ * @brief 判断索引中是否可能存在字段与key相同的键值对，没有Bloom filter时总是返回true
+ * 只查询Bloom filter，不计入统计信息，调用方不会再确认key是否真的存在
+ *
+ * @param rec_key 记录格式的key，不包括非唯一索引末尾的Rid
+ * @return 返回false时一定不存在
+ */
+bool IxIndexHandle::may_contain(const char *rec_key) const {
+    if (bloom_ == nullptr) {
+        return true;
+    }
+    IxKeyBuffer norm_key(rec_key, file_hdr_);
+    return bloom_->may_contain(ix_hash_key(norm_key.data(), bloom_key_len()));
+}
+
+/**
+ * @brief 扫描所有叶子结点，重新构建索引字段上的Bloom filter。
+ * 在创建索引和打开数据库时调用，之后插入的key在insert_entry中加入；删除的key无法移除，只会提高假阳性率，
+ * 重新构建之后恢复。位数组按照当前键值对个数的两倍分配，表增长一倍之前假阳性率不超过IX_BLOOM_BITS_PER_KEY对应的值。
+ * 构建时不能有并发的查找和插入
+ */
+void IxIndexHandle::build_bloom_filter() {
+    std::vector<uint64_t> hashes;
+    std::vector<char> rec_key(file_hdr_->col_tot_len_);
+    for (IxScan scan(this, leaf_begin(), leaf_end(), buffer_pool_manager_); !scan.is_end(); scan.next()) {
+        scan.key(rec_key.data());
+        IxKeyBuffer norm_key(rec_key.data(), file_hdr_);
+        hashes.push_back(ix_hash_key(norm_key.data(), bloom_key_len()));
+    }
+    auto bloom = std::make_unique<IxBloomFilter>(std::max<size_t>(hashes.size() * 2, 1024));
+    for (uint64_t hash : hashes) {
+        bloom->add(hash);
+    }
+    bloom_ = std::move(bloom);
+}
+
+/**
+ * @brief 在非唯一索引中查找字段与key相同的所有Rid，从下界所在的叶子结点开始，依次读取每个叶子结点中字段相同的一组，
+ * 直到遇到字段更大的组。读完一个叶子结点之后先释放读锁再读取下一个叶子结点，与IxScan相同
+ *
+ * @param key 规范化的key，末尾的Rid全为0
+ * @param result 用于存放结果的容器，Rid从小到大排列
+ * @return 是否存在字段与key相同的键值对
+ */
+bool IxIndexHandle::get_posting_values(const char *key, std::vector<Rid> *result) {
+    size_t old_size = result->size();
+    IxNodeHandle *leaf = find_leaf_page(key, Operation::FIND, nullptr).first;
+    while (true) {
+        bool more = leaf->posting_lookup(key, result);
+        page_id_t next_leaf = leaf->get_next_leaf();
+        leaf->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+        delete leaf;
+        if (!more || next_leaf == IX_LEAF_HEADER_PAGE) {
+            break;
+        }
+        leaf = fetch_node(next_leaf);
+        leaf->page->r_latch();
+    }
+    return result->size() > old_size;
 }
 
 /**
  * @brief  将传入的一个node拆分(Split)成两个结点，在node的右边生成一个新结点new node
  * @param node 需要拆分的结点
+ * @param right_edge 是否在最右边的结点末尾插入之后分裂，此时左边保留IX_RIGHT_SPLIT_FACTOR的键值对，
+ * 递增插入时左边的结点不会再插入新的key，按照一半分裂会使结点只填满一半
  * @return 拆分得到的new_node
  * @note need to unpin the new node outside
  * 注意：本函数执行完毕后，原node和new node都需要在函数外面进行unpin
  */
-IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
-    // Todo:
-    // 1. 将原结点的键值对平均分配，右半部分分裂为新的右兄弟结点
-    //    需要初始化新节点的page_hdr内容
-    // 2. 如果新的右兄弟结点是叶子结点，更新新旧节点的prev_leaf和next_leaf指针
-    //    为新节点分配键值对，更新旧节点的键值对数记录
-    // 3. 如果新的右兄弟结点不是叶子结点，更新该结点的所有孩子结点的父节点信息(使用IxIndexHandle::maintain_child())
-
-    return nullptr;
+IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node, bool right_edge) {
+    IxNodeHandle *new_node = create_node();
+    *new_node->page_hdr = {
+        .next_free_page_no = IX_NO_PAGE,
+        .parent = node->get_parent_page_no(),
+        .num_key = 0,
+        .is_leaf = node->is_leaf_page(),
+        .prev_leaf = IX_NO_PAGE,
+        .next_leaf = IX_NO_PAGE,
+    };
+    // 右边的结点至少保留两个键值对，内部结点分裂之后仍然至少有两个孩子
+    int n = node->get_size();
+    int mid = right_edge ? std::max(n / 2, std::min(n - 2, (int)(n * IX_RIGHT_SPLIT_FACTOR))) : n / 2;
+    if (node->is_compressed()) {
+        // 压缩的结点中key占用的空间不同，按照压缩之后的大小在mid附近选择分裂位置
+        mid = node->split_point(mid);
+    }
+    new_node->insert_pairs(0, node->get_key(mid), node->get_rid(mid), node->get_size() - mid);
+    node->set_size(mid);
+    if (new_node->is_leaf_page()) {
+        // 新结点插入到叶子链表中node的后面
+        new_node->set_prev_leaf(node->get_page_no());
+        new_node->set_next_leaf(node->get_next_leaf());
+        node->set_next_leaf(new_node->get_page_no());
+        std::scoped_lock lock{file_hdr_latch_};
+        if (file_hdr_->last_leaf_ == node->get_page_no()) {
+            file_hdr_->last_leaf_ = new_node->get_page_no();
+        }
+    } else {
+        for (int i = 0; i < new_node->get_size(); i++) {
+            maintain_child(new_node, i);
+        }
+    }
+    return new_node;
 }
 
 /**
@@ -219,49 +810,171 @@ IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
  *
  * @param (old_node, new_node) 原结点为old_node，old_node被分裂之后产生了新的右兄弟结点new_node
  * @param key 要插入parent的key
+ * @param right_edge old_node是否在最右边的结点末尾插入之后分裂，new_node也插入到parent的末尾时parent同样按照right_edge分裂
  * @note 一个结点插入了键值对之后需要分裂，分裂后左半部分的键值对保留在原结点，在参数中称为old_node，
  * 右半部分的键值对分裂为新的右兄弟节点，在参数中称为new_node（参考Split函数来理解old_node和new_node）
  * @note 本函数执行完毕后，new node和old node都需要在函数外面进行unpin
  */
 void IxIndexHandle::insert_into_parent(IxNodeHandle *old_node, const char *key, IxNodeHandle *new_node,
-                                     Transaction *transaction) {
-    // Todo:
-    // 1. 分裂前的结点（原结点, old_node）是否为根结点，如果为根结点需要分配新的root
-    // 2. 获取原结点（old_node）的父亲结点
-    // 3. 获取key对应的rid，并将(key, rid)插入到父亲结点
-    // 4. 如果父亲结点仍需要继续分裂，则进行递归插入
-    // 提示：记得unpin page
+                                     Transaction *transaction, bool right_edge) {
+    if (old_node->is_root_page()) {
+        // 根结点分裂时一定持有root_latch_，因为根结点不安全时不会释放
+        IxNodeHandle *root = create_node();
+        *root->page_hdr = {
+            .next_free_page_no = IX_NO_PAGE,
+            .parent = IX_NO_PAGE,
+            .num_key = 0,
+            .is_leaf = false,
+            .prev_leaf = IX_NO_PAGE,
+            .next_leaf = IX_NO_PAGE,
+        };
+        root->insert_pair(0, old_node->get_key(0), Rid{.page_no = old_node->get_page_no(), .slot_no = -1});
+        root->insert_pair(1, key, Rid{.page_no = new_node->get_page_no(), .slot_no = -1});
+        old_node->set_parent_page_no(root->get_page_no());
+        new_node->set_parent_page_no(root->get_page_no());
+        update_root_page_no(root->get_page_no());
+        buffer_pool_manager_->unpin_page(root->get_page_id(), true);
+        delete root;
+        return;
+    }
+    // 父结点不安全，已经在latch set中加了写锁
+    IxNodeHandle *parent = fetch_node(old_node->get_parent_page_no());
+    int pos = parent->find_child(old_node);
+    parent->insert_pair(pos + 1, key, Rid{.page_no = new_node->get_page_no(), .slot_no = -1});
+    new_node->set_parent_page_no(parent->get_page_no());
+    if (parent->is_overflow()) {
+        bool parent_right_edge = right_edge && pos + 2 == parent->get_size();
+        IxNodeHandle *new_parent = split(parent, parent_right_edge);
+        insert_into_parent(parent, new_parent->get_key(0), new_parent, transaction, parent_right_edge);
+        buffer_pool_manager_->unpin_page(new_parent->get_page_id(), true);
+        delete new_parent;
+    }
+    buffer_pool_manager_->unpin_page(parent->get_page_id(), true);
+    delete parent;
 }
 
 /**
- * @brief 将指定键值对插入到B+树中
- * @param (key, value) 要插入的键值对
- * @param transaction 事务指针
- * @return page_id_t 插入到的叶结点的page_no
+ * @brief 递增插入的快速路径：key大于最右叶子结点中所有的key时直接追加到该结点的末尾，不需要从根结点向下查找
+ * 只对缓存的叶子结点加写锁，结点仍然是最右叶子结点、不为空（合并时删除的结点为空）并且插入之后不会分裂时才插入，
+ * 否则清除缓存，由调用方从根结点查找。这里只持有一个叶子结点的写锁，不会与从根结点向下加锁的线程形成环
+ *
+ * @param page_no 缓存的最右叶子结点
+ * @param (key, value) 要插入的键值对，key为规范化的key
+ * @return 插入到的叶子结点的page_no，不满足条件时返回IX_NO_PAGE
  */
-page_id_t IxIndexHandle::insert_entry(const char *key, const Rid &value, Transaction *transaction) {
-    // Todo:
-    // 1. 查找key值应该插入到哪个叶子节点
-    // 2. 在该叶子节点中插入键值对
-    // 3. 如果结点已满，分裂结点，并把新结点的相关信息插入父节点
-    // 提示：记得unpin page；若当前叶子节点是最右叶子节点，则需要更新file_hdr_.last_leaf；记得处理并发的上锁
+page_id_t IxIndexHandle::insert_rightmost(page_id_t page_no, const char *key, const Rid &value) {
+    IxNodeHandle *leaf = fetch_node(page_no);
+    leaf->page->w_latch();
+    int n = leaf->get_size();
+    bool appended = leaf->is_leaf_page() && leaf->get_next_leaf() == IX_LEAF_HEADER_PAGE && n > 0 &&
+                    is_safe(leaf, Operation::INSERT) &&
+                    ix_key_compare(key, leaf->get_key(n - 1), file_hdr_->col_tot_len_) > 0;
+    if (appended) {
+        leaf->insert_pair(n, key, value);
+    } else {
+        page_id_t expected = page_no;
+        rightmost_leaf_.compare_exchange_strong(expected, IX_NO_PAGE);
+    }
+    leaf->page->w_unlatch();
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), appended);
+    delete leaf;
+    return appended ? page_no : IX_NO_PAGE;
+}
 
-    return -1;
+/**
+ * @brief 将指定键值对插入到B+树中
+ * @param (rec_key, value) 要插入的键值对，key为记录格式
+ * @param transaction 事务指针，为nullptr时使用局部的latch set
+ * @return page_id_t 插入到的叶结点的page_no，key已经存在时不插入并返回IX_NO_PAGE
+ * @note 内部结点的key是对应子树中key的下界，插入更小的key时不需要更新祖先结点，只有分裂的结点需要加写锁
+ * @note 上一次插入追加到了最右叶子结点的末尾时，先尝试直接追加到该结点（见insert_rightmost）
+ */
+page_id_t IxIndexHandle::insert_entry(const char *rec_key, const Rid &value, Transaction *transaction) {
+    // 调用方传入的是记录格式的key，B+树中保存的是规范化的key，非唯一索引的key末尾追加Rid
+    IxKeyBuffer norm_key(rec_key, file_hdr_);
+    if (file_hdr_->posting_list_) {
+        ix_posting_value(value);    // 超出范围的Rid在加锁之前抛出异常
+    }
+    norm_key.set_rid(value);
+    const char *key = norm_key.data();
+    // 在插入B+树之前加入Bloom filter，并发的查找在Bloom filter中没有找到时key一定还没有插入
+    if (bloom_ != nullptr) {
+        bloom_->add(ix_hash_key(key, bloom_key_len()));
+    }
+    page_id_t rightmost = rightmost_leaf_.load();
+    if (rightmost != IX_NO_PAGE) {
+        page_id_t page_no = insert_rightmost(rightmost, key, value);
+        if (page_no != IX_NO_PAGE) {
+            return page_no;
+        }
+    }
+    std::deque<Page *> local_latch_set;
+    auto &latch_set = transaction != nullptr ? *transaction->get_index_latch_page_set() : local_latch_set;
+    IxNodeHandle *leaf = find_leaf_page(key, Operation::INSERT, latch_set);
+    page_id_t page_no = leaf->get_page_no();
+    int old_size = leaf->get_size();
+    if (leaf->insert(key, value) == old_size) {
+        page_no = IX_NO_PAGE;
+    } else {
+        // key插入到了最右叶子结点的末尾，按照递增插入处理
+        bool right_edge = leaf->get_next_leaf() == IX_LEAF_HEADER_PAGE &&
+                          ix_key_compare(key, leaf->get_key(leaf->get_size() - 1), file_hdr_->col_tot_len_) == 0;
+        if (leaf->is_overflow()) {
+            IxNodeHandle *new_leaf = split(leaf, right_edge);
+            std::vector<char> sep(file_hdr_->col_tot_len_);
+            make_separator(sep.data(), leaf->get_key(leaf->get_size() - 1), new_leaf->get_key(0));
+            insert_into_parent(leaf, sep.data(), new_leaf, transaction, right_edge);
+            if (ix_key_compare(key, new_leaf->get_key(0), file_hdr_->col_tot_len_) >= 0) {
+                page_no = new_leaf->get_page_no();
+            }
+            buffer_pool_manager_->unpin_page(new_leaf->get_page_id(), true);
+            delete new_leaf;
+        }
+        if (right_edge) {
+            rightmost_leaf_ = page_no;
+        }
+    }
+    delete leaf;
+    release_latches(latch_set, true);
+    return page_no;
 }
 
 /**
- * @brief 用于删除B+树中含有指定key的键值对
- * @param key 要删除的key值
- * @param transaction 事务指针
+ * @brief 用于删除B+树中含有指定key的键值对，非唯一索引需要指定Rid
+ * @param rec_key 要删除的key值，记录格式
+ * @param transaction 事务指针，为nullptr时使用局部的latch set
+ * @return key是否存在
  */
-bool IxIndexHandle::delete_entry(const char *key, Transaction *transaction) {
-    // Todo:
-    // 1. 获取该键值对所在的叶子结点
-    // 2. 在该叶子结点中删除键值对
-    // 3. 如果删除成功需要调用CoalesceOrRedistribute来进行合并或重分配操作，并根据函数返回结果判断是否有结点需要删除
-    // 4. 如果需要并发，并且需要删除叶子结点，则需要在事务的delete_page_set中添加删除结点的对应页面；记得处理并发的上锁
+bool IxIndexHandle::delete_entry(const char *rec_key, Transaction *transaction) {
+    if (file_hdr_->posting_list_) {
+        throw InternalError("IxIndexHandle::delete_entry: rid is required for non-unique index");
+    }
+    return delete_entry(rec_key, Rid{}, transaction);
+}
 
-    return false;
+/**
+ * @brief 用于删除B+树中的键值对(key, value)
+ * @param rec_key 要删除的key值，记录格式
+ * @param value 要删除的键值对的Rid，唯一索引中key只有一个键值对，不检查Rid
+ * @param transaction 事务指针，为nullptr时使用局部的latch set
+ * @return 键值对是否存在
+ */
+bool IxIndexHandle::delete_entry(const char *rec_key, const Rid &value, Transaction *transaction) {
+    // 调用方传入的是记录格式的key，B+树中保存的是规范化的key，非唯一索引的key末尾追加Rid
+    IxKeyBuffer norm_key(rec_key, file_hdr_);
+    norm_key.set_rid(value);
+    const char *key = norm_key.data();
+    std::deque<Page *> local_latch_set;
+    auto &latch_set = transaction != nullptr ? *transaction->get_index_latch_page_set() : local_latch_set;
+    IxNodeHandle *leaf = find_leaf_page(key, Operation::DELETE, latch_set);
+    int old_size = leaf->get_size();
+    bool exist = leaf->remove(key) != old_size;
+    if (exist) {
+        coalesce_or_redistribute(leaf, transaction);
+    }
+    delete leaf;
+    release_latches(latch_set, true);
+    return exist;
 }
 
 /**
@@ -276,17 +989,42 @@ bool IxIndexHandle::delete_entry(const char *key, Transaction *transaction) {
  * Otherwise, merge(Coalesce).
  */
 bool IxIndexHandle::coalesce_or_redistribute(IxNodeHandle *node, Transaction *transaction, bool *root_is_latched) {
-    // Todo:
-    // 1. 判断node结点是否为根节点
-    //    1.1 如果是根节点，需要调用AdjustRoot() 函数来进行处理，返回根节点是否需要被删除
-    //    1.2 如果不是根节点，并且不需要执行合并或重分配操作，则直接返回false，否则执行2
-    // 2. 获取node结点的父亲结点
-    // 3. 寻找node结点的兄弟结点（优先选取前驱结点）
-    // 4. 如果node结点和兄弟结点的键值对数量之和，能够支撑两个B+树结点（即node.size+neighbor.size >=
-    // NodeMinSize*2)，则只需要重新分配键值对（调用Redistribute函数）
-    // 5. 如果不满足上述条件，则需要合并两个结点，将右边的结点合并到左边的结点（调用Coalesce函数）
-
-    return false;
+    if (node->is_root_page()) {
+        return adjust_root(node);
+    }
+    if (node->get_size() >= node->get_min_size()) {
+        return false;
+    }
+    // node不安全，父结点已经在latch set中加了写锁；兄弟结点是父结点的孩子，加锁时不会与其他线程形成环
+    IxNodeHandle *parent = fetch_node(node->get_parent_page_no());
+    int index = parent->find_child(node);
+    IxNodeHandle *neighbor = fetch_node(parent->value_at(index == 0 ? 1 : index - 1));
+    neighbor->page->w_latch();
+    bool node_deleted = false;
+    int total_size = node->get_size() + neighbor->get_size();
+    bool can_coalesce = total_size < node->get_min_size() * 2 &&
+                        (!node->is_compressed() || node->max_compressed_size(total_size) <= PAGE_SIZE);
+    if (!can_coalesce) {
+        redistribute(neighbor, node, parent, index);
+        if (parent->is_overflow()) {
+            // 压缩的父结点中分隔key变长之后可能超过一个页面，此时父结点不安全，祖先结点仍然持有写锁
+            IxNodeHandle *new_parent = split(parent);
+            insert_into_parent(parent, new_parent->get_key(0), new_parent, transaction);
+            buffer_pool_manager_->unpin_page(new_parent->get_page_id(), true);
+            delete new_parent;
+        }
+    } else {
+        IxNodeHandle *left = neighbor, *right = node, *parent_node = parent;
+        coalesce(&left, &right, &parent_node, index, transaction, root_is_latched);
+        // 合并时总是删除右边的结点
+        node_deleted = index > 0;
+    }
+    neighbor->page->w_unlatch();
+    buffer_pool_manager_->unpin_page(neighbor->get_page_id(), true);
+    buffer_pool_manager_->unpin_page(parent->get_page_id(), true);
+    delete neighbor;
+    delete parent;
+    return node_deleted;
 }
 
 /**
@@ -296,11 +1034,16 @@ bool IxIndexHandle::coalesce_or_redistribute(IxNodeHandle *node, Transaction *tr
  * @note size of root page can be less than min size and this method is only called within coalesce_or_redistribute()
  */
 bool IxIndexHandle::adjust_root(IxNodeHandle *old_root_node) {
-    // Todo:
-    // 1. 如果old_root_node是内部结点，并且大小为1，则直接把它的孩子更新成新的根结点
-    // 2. 如果old_root_node是叶结点，且大小为0，则直接更新root page
-    // 3. 除了上述两种情况，不需要进行操作
-
+    if (!old_root_node->is_leaf_page() && old_root_node->get_size() == 1) {
+        // 根结点不安全时持有root_latch_
+        IxNodeHandle *child = fetch_node(old_root_node->remove_and_return_only_child());
+        child->set_parent_page_no(IX_NO_PAGE);
+        update_root_page_no(child->get_page_no());
+        buffer_pool_manager_->unpin_page(child->get_page_id(), true);
+        delete child;
+        release_node_handle(*old_root_node);
+        return true;
+    }
     return false;
 }
 
@@ -319,11 +1062,42 @@ bool IxIndexHandle::adjust_root(IxNodeHandle *old_root_node) {
  * 注意更新parent结点的相关kv对
  */
 void IxIndexHandle::redistribute(IxNodeHandle *neighbor_node, IxNodeHandle *node, IxNodeHandle *parent, int index) {
-    // Todo:
-    // 1. 通过index判断neighbor_node是否为node的前驱结点
-    // 2. 从neighbor_node中移动一个键值对到node结点中
-    // 3. 更新父节点中的相关信息，并且修改移动键值对对应孩字结点的父结点信息（maintain_child函数）
-    // 注意：neighbor_node的位置不同，需要移动的键值对不同，需要分类讨论
+    if (index == 0) {
+        // neighbor在node右边，把neighbor的第一个键值对移动到node的末尾
+        if (node->is_leaf_page()) {
+            node->insert_pair(node->get_size(), neighbor_node->get_key(0), *neighbor_node->get_rid(0));
+        } else {
+            // 内部结点的第0个key只是下界，使用父结点中的分隔key
+            node->insert_pair(node->get_size(), parent->get_key(1), *neighbor_node->get_rid(0));
+            maintain_child(node, node->get_size() - 1);
+        }
+        neighbor_node->erase_pair(0);
+        set_separator(parent, 1, node, neighbor_node);
+    } else {
+        // neighbor在node左边，把neighbor的最后一个键值对移动到node的开头
+        int last = neighbor_node->get_size() - 1;
+        if (!node->is_leaf_page()) {
+            node->set_key(0, parent->get_key(index));
+        }
+        node->insert_pair(0, neighbor_node->get_key(last), *neighbor_node->get_rid(last));
+        maintain_child(node, 0);
+        neighbor_node->erase_pair(last);
+        set_separator(parent, index, neighbor_node, node);
+    }
+}
+
+/**
+ * @brief 重新分配之后更新parent中右边结点right的分隔key，right在parent中的位置为index
+ * 内部结点的第0个key就是分隔key，叶子结点使用make_separator生成
+ */
+void IxIndexHandle::set_separator(IxNodeHandle *parent, int index, IxNodeHandle *left, IxNodeHandle *right) {
+    if (!right->is_leaf_page()) {
+        parent->set_key(index, right->get_key(0));
+        return;
+    }
+    std::vector<char> sep(file_hdr_->col_tot_len_);
+    make_separator(sep.data(), left->get_key(left->get_size() - 1), right->get_key(0));
+    parent->set_key(index, sep.data());
 }
 
 /**
@@ -342,13 +1116,32 @@ void IxIndexHandle::redistribute(IxNodeHandle *neighbor_node, IxNodeHandle *node
  */
 bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node, IxNodeHandle **parent, int index,
                              Transaction *transaction, bool *root_is_latched) {
-    // Todo:
-    // 1. 用index判断neighbor_node是否为node的前驱结点，若不是则交换两个结点，让neighbor_node作为左结点，node作为右结点
-    // 2. 把node结点的键值对移动到neighbor_node中，并更新node结点孩子结点的父节点信息（调用maintain_child函数）
-    // 3. 释放和删除node结点，并删除parent中node结点的信息，返回parent是否需要被删除
-    // 提示：如果是叶子结点且为最右叶子结点，需要更新file_hdr_.last_leaf
-
-    return false;
+    if (index == 0) {
+        std::swap(*neighbor_node, *node);
+        index = 1;
+    }
+    IxNodeHandle *left = *neighbor_node, *right = *node;
+    int pos = left->get_size();
+    if (!right->is_leaf_page()) {
+        // 内部结点的第0个key只是下界，合并后使用父结点中的分隔key
+        right->set_key(0, (*parent)->get_key(index));
+    }
+    left->insert_pairs(pos, right->get_key(0), right->get_rid(0), right->get_size());
+    if (left->is_leaf_page()) {
+        left->set_next_leaf(right->get_next_leaf());
+        std::scoped_lock lock{file_hdr_latch_};
+        if (file_hdr_->last_leaf_ == right->get_page_no()) {
+            file_hdr_->last_leaf_ = left->get_page_no();
+        }
+    } else {
+        for (int i = pos; i < left->get_size(); i++) {
+            maintain_child(left, i);
+        }
+    }
+    right->set_size(0);
+    release_node_handle(*right);
+    (*parent)->erase_pair(index);
+    return coalesce_or_redistribute(*parent, transaction, root_is_latched);
 }
 
 /**
@@ -362,35 +1155,71 @@ bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node,
  */
 Rid IxIndexHandle::get_rid(const Iid &iid) const {
     IxNodeHandle *node = fetch_node(iid.page_no);
+    node->page->r_latch();
     if (iid.slot_no >= node->get_size()) {
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);  // unpin it!
+        delete node;
         throw IndexEntryNotFoundError();
     }
+    Rid rid = *node->get_rid(iid.slot_no);
+    node->page->r_unlatch();
     buffer_pool_manager_->unpin_page(node->get_page_id(), false);  // unpin it!
-    return *node->get_rid(iid.slot_no);
+    delete node;
+    return rid;
 }
 
 /**
  * @brief FindLeafPage + lower_bound
  *
- * @param key
+ * @param rec_key 记录格式的key
  * @return Iid
- * @note 上层传入的key本来是int类型，通过(const char *)&key进行了转换
- * 可用*(int *)key转换回去
  */
-Iid IxIndexHandle::lower_bound(const char *key) {
-
-    return Iid{-1, -1};
+Iid IxIndexHandle::lower_bound(const char *rec_key) {
+    // 调用方传入的是记录格式的key，B+树中保存的是规范化的key，非唯一索引的key末尾的Rid全为0
+    IxKeyBuffer norm_key(rec_key, file_hdr_);
+    const char *key = norm_key.data();
+    IxNodeHandle *leaf = find_leaf_page(key, Operation::FIND, nullptr, true).first;
+    Iid iid = leaf_iid(leaf, leaf->lower_bound(key));
+    leaf->page->r_unlatch();
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+    delete leaf;
+    return iid;
 }
 
 /**
  * @brief FindLeafPage + upper_bound
  *
- * @param key
+ * @param rec_key 记录格式的key
  * @return Iid
  */
-Iid IxIndexHandle::upper_bound(const char *key) {
-    
-    return Iid{-1, -1};
+Iid IxIndexHandle::upper_bound(const char *rec_key) {
+    // 调用方传入的是记录格式的key，B+树中保存的是规范化的key，非唯一索引的key末尾的Rid取最大值
+    IxKeyBuffer norm_key(rec_key, file_hdr_);
+    norm_key.set_max_rid();
+    const char *key = norm_key.data();
+    IxNodeHandle *leaf = find_leaf_page(key, Operation::FIND, nullptr).first;
+    Iid iid = leaf_iid(leaf, leaf->upper_bound(key));
+    leaf->page->r_unlatch();
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+    delete leaf;
+    return iid;
+}
+
+/**
+ * @brief 把叶子结点中的位置转换成Iid，位置在叶子结点末尾且不是最后一个叶子结点时，转换为下一个叶子结点的第一个位置，
+ * 与IxScan::next()的遍历方式保持一致，使得同一个位置只有一种表示
+ *
+ * @param leaf 叶子结点
+ * @param slot_no 位置，范围为[0,num_key]
+ * @return Iid
+ * @note 调用方需要持有leaf的读锁，最后一个叶子结点的next_leaf为IX_LEAF_HEADER_PAGE
+ */
+Iid IxIndexHandle::leaf_iid(IxNodeHandle *leaf, int slot_no) const {
+    if (slot_no == leaf->get_size() && leaf->get_next_leaf() != IX_LEAF_HEADER_PAGE) {
+        return Iid{.page_no = leaf->get_next_leaf(), .slot_no = 0};
+    }
+    return Iid{.page_no = leaf->get_page_no(), .slot_no = slot_no};
 }
 
 /**
@@ -400,9 +1229,23 @@ Iid IxIndexHandle::upper_bound(const char *key) {
  * @return Iid
  */
 Iid IxIndexHandle::leaf_end() const {
-    IxNodeHandle *node = fetch_node(file_hdr_->last_leaf_);
-    Iid iid = {.page_no = file_hdr_->last_leaf_, .slot_no = node->get_size()};
+    // 沿着最右边的孩子结点加读锁向下查找，last_leaf_可能正在被其他线程修改
+    root_latch_.lock();
+    IxNodeHandle *node = fetch_node(file_hdr_->root_page_);
+    node->page->r_latch();
+    root_latch_.unlock();
+    while (!node->is_leaf_page()) {
+        IxNodeHandle *child = fetch_node(node->value_at(node->get_size() - 1));
+        child->page->r_latch();
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+        node = child;
+    }
+    Iid iid = {.page_no = node->get_page_no(), .slot_no = node->get_size()};
+    node->page->r_unlatch();
     buffer_pool_manager_->unpin_page(node->get_page_id(), false);  // unpin it!
+    delete node;
     return iid;
 }
 
@@ -417,6 +1260,346 @@ Iid IxIndexHandle::leaf_begin() const {
     return iid;
 }
 
+/**
+ * @brief 计算批量构建时一层中的结点个数，num_entries个键值对平均分配到这些结点中
+ * 每个结点最多填充fill_factor比例的键值对，同时保证有多个结点时每个结点至少有min_size个键值对，
+ * 否则之后删除时会立刻触发合并
+ */
+static size_t bulk_num_nodes(size_t num_entries, int max_size, double fill_factor) {
+    int capacity = max_size - 1;    // 结点中的键值对个数达到max_size时会分裂
+    int min_size = max_size / 2;
+    size_t fill = std::min(capacity, std::max(1, (int)(capacity * fill_factor)));
+    size_t num_nodes = (num_entries + fill - 1) / fill;
+    if (num_nodes > 1) {
+        num_nodes = std::max<size_t>(1, std::min(num_nodes, num_entries / min_size));
+    }
+    return std::max<size_t>(1, num_nodes);
+}
+
+/**
+ * @brief 计算批量构建压缩的内部结点时每个结点的键值对个数
+ * 按照压缩之后的大小依次把分隔key填入结点，直到超过fill_factor比例的页面；最后一个结点的键值对少于min_size时与前一个结点平分
+ *
+ * @param seps 这一层所有结点的分隔key，有序
+ */
+static std::vector<int> bulk_compressed_sizes(const std::vector<char> &seps, int key_len, int min_size,
+                                              double fill_factor) {
+    int num_entries = seps.size() / key_len;
+    int limit = std::max<int>(PAGE_SIZE * fill_factor, ix_compressed_size(seps.data(), 2, key_len));
+    std::vector<int> sizes;
+    for (int pos = 0; pos < num_entries;) {
+        // 增量计算ix_compressed_size：公共前缀是key[1..n)的公共前缀，变短时重新计算key[1..n)去掉公共前缀之后的长度
+        const char *first = seps.data() + pos * key_len;
+        int n = 1, prefix_len = key_len, suffix_len = 0;
+        while (pos + n < num_entries) {
+            const char *key = first + n * key_len;
+            int new_prefix = std::min(prefix_len, ix_common_prefix(first + key_len, key, key_len));
+            int new_suffix = suffix_len;
+            if (new_prefix != prefix_len) {
+                new_suffix = 0;
+                for (int i = 1; i < n; i++) {
+                    new_suffix += std::max(0, ix_significant_len(first + i * key_len, key_len) - new_prefix);
+                }
+            }
+            new_suffix += std::max(0, ix_significant_len(key, key_len) - new_prefix);
+            int size = sizeof(IxPageHdr) + key_len + new_prefix + n * sizeof(uint16_t) + (n + 1) * sizeof(Rid) +
+                       new_suffix;
+            if (size > limit) {
+                break;
+            }
+            prefix_len = new_prefix;
+            suffix_len = new_suffix;
+            n++;
+        }
+        sizes.push_back(n);
+        pos += n;
+    }
+    if (sizes.size() > 1 && sizes.back() < min_size) {
+        int total = sizes[sizes.size() - 2] + sizes.back();
+        int left = total / 2;
+        const char *begin = seps.data() + (num_entries - total) * key_len;
+        if (ix_compressed_size(begin, left, key_len) <= PAGE_SIZE &&
+            ix_compressed_size(begin + left * key_len, total - left, key_len) <= PAGE_SIZE) {
+            sizes[sizes.size() - 2] = left;
+            sizes.back() = total - left;
+        }
+    }
+    return sizes;
+}
+
+/**
+ * @brief 批量构建时在leaf后面创建下一个叶子结点，leaf写完之后unpin
+ * @note pin the new leaf, remember to unpin it outside!
+ */
+IxNodeHandle *IxIndexHandle::bulk_next_leaf(IxNodeHandle *leaf) {
+    IxNodeHandle *next = create_node();
+    *next->page_hdr = {
+        .next_free_page_no = IX_NO_PAGE,
+        .parent = IX_NO_PAGE,
+        .num_key = 0,
+        .is_leaf = true,
+        .prev_leaf = leaf->get_page_no(),
+        .next_leaf = IX_LEAF_HEADER_PAGE,
+    };
+    leaf->set_next_leaf(next->get_page_no());
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+    delete leaf;
+    return next;
+}
+
+/**
+ * @brief 批量构建定长格式的叶子结点，所有键值对平均分配到bulk_num_nodes个叶子结点中
+ *
+ * @param root 原来的根结点，作为第一个叶子结点
+ * @param[out] seps 每个叶子结点的分隔key
+ * @param[out] pages 每个叶子结点的page_no
+ * @return 最后一个叶子结点，仍然pin住
+ */
+IxNodeHandle *IxIndexHandle::bulk_load_leaves(IxExternalSorter &sorter, IxNodeHandle *root, double fill_factor,
+                                              std::vector<char> &seps, std::vector<page_id_t> &pages) {
+    size_t num_entries = sorter.size();
+    int key_len = file_hdr_->col_tot_len_;
+    size_t num_nodes = bulk_num_nodes(num_entries, root->get_max_size(), fill_factor);
+    std::vector<char> prev_key(key_len), sep(key_len);
+    Rid rid;
+    IxNodeHandle *leaf = root;
+    for (size_t i = 0; i < num_nodes; i++) {
+        if (i > 0) {
+            leaf = bulk_next_leaf(leaf);
+        }
+        int num_keys = num_entries / num_nodes + (i < num_entries % num_nodes);
+        for (int j = 0; j < num_keys; j++) {
+            sorter.next(leaf->get_key(j), &rid);
+            leaf->set_rid(j, rid);
+            bool is_first = i == 0 && j == 0;
+            if (!is_first && ix_key_compare(prev_key.data(), leaf->get_key(j), key_len) == 0) {
+                buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+                delete leaf;
+                throw IndexEntryExistsError();
+            }
+            if (j == 0) {
+                // prev_key是前一个叶子结点的最后一个key
+                if (is_first) {
+                    memcpy(sep.data(), leaf->get_key(0), key_len);
+                } else {
+                    make_separator(sep.data(), prev_key.data(), leaf->get_key(0));
+                }
+            }
+            memcpy(prev_key.data(), leaf->get_key(j), key_len);
+        }
+        leaf->set_size(num_keys);
+        seps.insert(seps.end(), sep.begin(), sep.end());
+        pages.push_back(leaf->get_page_no());
+    }
+    return leaf;
+}
+
+/**
+ * @brief 批量构建posting list格式的叶子结点，按照压缩之后的大小依次把键值对填入叶子结点，直到超过fill_factor比例的页面。
+ * 前一个叶子结点在当前叶子结点填满之后才写入页面，最后一个叶子结点的键值对少于min_size时与前一个叶子结点平分
+ *
+ * @param root 原来的根结点，作为第一个叶子结点
+ * @param[out] seps 每个叶子结点的分隔key
+ * @param[out] pages 每个叶子结点的page_no
+ * @return 最后一个叶子结点，仍然pin住
+ */
+IxNodeHandle *IxIndexHandle::bulk_load_posting_leaves(IxExternalSorter &sorter, IxNodeHandle *root,
+                                                      double fill_factor, std::vector<char> &seps,
+                                                      std::vector<page_id_t> &pages) {
+    int key_len = file_hdr_->col_tot_len_;
+    int col_len = key_len - IX_RID_KEY_LEN;
+    int min_size = root->get_min_size();
+    int empty_size = sizeof(IxPageHdr) + sizeof(uint16_t);
+    int limit = std::max<int>(PAGE_SIZE * fill_factor, root->max_compressed_size(1));
+    std::vector<char> prev_keys, cur_keys, last_key(key_len), sep(key_len);
+    std::vector<Rid> prev_rids, cur_rids;
+    IxNodeHandle *leaf = root;
+
+    // 把一个叶子结点的键值对写入页面，第一个叶子结点使用root
+    auto write_leaf = [&](const std::vector<char> &keys, const std::vector<Rid> &rids) {
+        if (!pages.empty()) {
+            leaf = bulk_next_leaf(leaf);
+        }
+        int n = rids.size();
+        leaf->insert_pairs(0, keys.data(), rids.data(), n);
+        if (pages.empty()) {
+            memcpy(sep.data(), keys.data(), key_len);
+        } else {
+            make_separator(sep.data(), last_key.data(), keys.data());
+        }
+        seps.insert(seps.end(), sep.begin(), sep.end());
+        pages.push_back(leaf->get_page_no());
+        memcpy(last_key.data(), keys.data() + (n - 1) * key_len, key_len);
+    };
+
+    try {
+        std::vector<char> key(key_len), prev_key(key_len);
+        Rid rid;
+        uint64_t prev_value = 0;
+        int cur_size = empty_size;
+        for (size_t i = 0; i < sorter.size(); i++) {
+            sorter.next(key.data(), &rid);
+            if (i > 0 && ix_key_compare(prev_key.data(), key.data(), key_len) == 0) {
+                throw IndexEntryExistsError();
+            }
+            uint64_t value = ix_posting_value(rid);
+            bool new_group = cur_rids.empty() || memcmp(prev_key.data(), key.data(), col_len) != 0;
+            int grow = new_group ? col_len + 2 * sizeof(uint16_t) + ix_varint_len(value)
+                                 : ix_varint_len(value - prev_value);
+            if (!cur_rids.empty() && cur_size + grow > limit) {
+                if (!prev_rids.empty()) {
+                    write_leaf(prev_keys, prev_rids);
+                }
+                prev_keys.swap(cur_keys);
+                prev_rids.swap(cur_rids);
+                cur_keys.clear();
+                cur_rids.clear();
+                cur_size = empty_size;
+                grow = col_len + 2 * sizeof(uint16_t) + ix_varint_len(value);
+            }
+            cur_keys.insert(cur_keys.end(), key.begin(), key.end());
+            cur_rids.push_back(rid);
+            cur_size += grow;
+            prev_key.swap(key);
+            prev_value = value;
+        }
+
+        int prev_n = prev_rids.size(), cur_n = cur_rids.size();
+        if (prev_n > 0 && cur_n < min_size) {
+            // 两个叶子结点平分，放不下时不调整
+            int left = (prev_n + cur_n) / 2;
+            std::vector<char> keys(prev_keys);
+            keys.insert(keys.end(), cur_keys.begin(), cur_keys.end());
+            std::vector<Rid> rids(prev_rids);
+            rids.insert(rids.end(), cur_rids.begin(), cur_rids.end());
+            int total = prev_n + cur_n;
+            if (ix_posting_size(keys.data(), rids.data(), left, key_len) <= PAGE_SIZE &&
+                ix_posting_size(keys.data() + left * key_len, rids.data() + left, total - left, key_len) <= PAGE_SIZE) {
+                prev_keys.assign(keys.begin(), keys.begin() + left * key_len);
+                prev_rids.assign(rids.begin(), rids.begin() + left);
+                cur_keys.assign(keys.begin() + left * key_len, keys.end());
+                cur_rids.assign(rids.begin() + left, rids.end());
+            }
+        }
+        if (!prev_rids.empty()) {
+            write_leaf(prev_keys, prev_rids);
+        }
+        write_leaf(cur_keys, cur_rids);
+    } catch (RMDBError &) {
+        buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+        delete leaf;
+        throw;
+    }
+    return leaf;
+}
+
+/**
+ * @brief 自底向上批量构建B+树，只能用于空的B+树
+ * 从sorter中按照key从小到大读出所有键值对，依次填满叶子结点，再用相邻叶子结点之间的分隔key（见make_separator）逐层构建内部结点，
+ * 每个结点都按照fill_factor填充，不会产生逐条插入时分裂留下的半满结点
+ *
+ * @param sorter 已经调用过finish()的外部排序器
+ * @param fill_factor 结点的填充率
+ * @note 有重复的key时抛出IndexEntryExistsError，此时B+树处于不一致的状态，调用方需要删除索引文件
+ */
+void IxIndexHandle::bulk_load(IxExternalSorter &sorter, double fill_factor) {
+    std::scoped_lock lock{root_latch_};
+    IxNodeHandle *root = fetch_node(file_hdr_->root_page_);
+    if (!root->is_leaf_page() || root->get_size() != 0) {
+        buffer_pool_manager_->unpin_page(root->get_page_id(), false);
+        delete root;
+        throw InternalError("IxIndexHandle::bulk_load: index is not empty");
+    }
+    size_t num_entries = sorter.size();
+    if (num_entries == 0) {
+        buffer_pool_manager_->unpin_page(root->get_page_id(), false);
+        delete root;
+        return;
+    }
+    int key_len = file_hdr_->col_tot_len_;
+    int max_size = root->get_max_size();
+    std::vector<char> seps;         // 当前层每个结点的第一个key
+    std::vector<page_id_t> pages;   // 当前层每个结点的page_no
+
+    // 构建叶子结点，第一个叶子结点使用原来的根结点，这样first_leaf_不需要修改
+    IxNodeHandle *leaf = file_hdr_->posting_list_ ? bulk_load_posting_leaves(sorter, root, fill_factor, seps, pages)
+                                                  : bulk_load_leaves(sorter, root, fill_factor, seps, pages);
+    leaf->set_next_leaf(IX_LEAF_HEADER_PAGE);
+    {
+        std::scoped_lock hdr_lock{file_hdr_latch_};
+        file_hdr_->last_leaf_ = leaf->get_page_no();
+    }
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+    delete leaf;
+
+    // 逐层构建内部结点，直到只剩一个结点作为根结点
+    while (pages.size() > 1) {
+        std::vector<char> parent_seps;
+        std::vector<page_id_t> parent_pages;
+        std::vector<int> node_sizes;
+        if (file_hdr_->prefix_compression_) {
+            node_sizes = bulk_compressed_sizes(seps, key_len, max_size / 2, fill_factor);
+        } else {
+            size_t num_nodes = bulk_num_nodes(pages.size(), max_size, fill_factor);
+            for (size_t i = 0; i < num_nodes; i++) {
+                node_sizes.push_back(pages.size() / num_nodes + (i < pages.size() % num_nodes));
+            }
+        }
+        size_t pos = 0;
+        for (int num_keys : node_sizes) {
+            IxNodeHandle *node = create_node();
+            *node->page_hdr = {
+                .next_free_page_no = IX_NO_PAGE,
+                .parent = IX_NO_PAGE,
+                .num_key = 0,
+                .is_leaf = false,
+                .prev_leaf = IX_NO_PAGE,
+                .next_leaf = IX_NO_PAGE,
+            };
+            std::vector<Rid> rids;
+            for (int j = 0; j < num_keys; j++) {
+                rids.push_back(Rid{.page_no = pages[pos + j], .slot_no = -1});
+            }
+            node->insert_pairs(0, seps.data() + pos * key_len, rids.data(), num_keys);
+            for (int j = 0; j < num_keys; j++) {
+                maintain_child(node, j);
+            }
+            parent_seps.insert(parent_seps.end(), node->get_key(0), node->get_key(0) + key_len);
+            parent_pages.push_back(node->get_page_no());
+            buffer_pool_manager_->unpin_page(node->get_page_id(), true);
+            delete node;
+            pos += num_keys;
+        }
+        seps = std::move(parent_seps);
+        pages = std::move(parent_pages);
+    }
+    update_root_page_no(pages[0]);
+}
+
+/**
+ * @brief B+树的高度，只有一个叶子结点作为根结点时为1
+ */
+int IxIndexHandle::get_height() const {
+    root_latch_.lock();
+    IxNodeHandle *node = fetch_node(file_hdr_->root_page_);
+    node->page->r_latch();
+    root_latch_.unlock();
+    int height = 1;
+    while (!node->is_leaf_page()) {
+        IxNodeHandle *child = fetch_node(node->value_at(0));
+        child->page->r_latch();
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+        node = child;
+        height++;
+    }
+    node->page->r_unlatch();
+    buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+    delete node;
+    return height;
+}
+
 /**
  * @brief 获取一个指定结点
  *
@@ -443,7 +1626,10 @@ IxNodeHandle *IxIndexHandle::fetch_node(int page_no) const {
  */
 IxNodeHandle *IxIndexHandle::create_node() {
     IxNodeHandle *node;
-    file_hdr_->num_pages_++;
+    {
+        std::scoped_lock lock{file_hdr_latch_};
+        file_hdr_->num_pages_++;
+    }
 
     PageId new_page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
     // 从3开始分配page_no，第一次分配之后，new_page_id.page_no=3，file_hdr_.num_pages=4
@@ -452,53 +1638,13 @@ IxNodeHandle *IxIndexHandle::create_node() {
     return node;
 }
 
-/**
- * @brief 从node开始更新其父节点的第一个key，一直向上更新直到根节点
- *
- * @param node
- */
-void IxIndexHandle::maintain_parent(IxNodeHandle *node) {
-    IxNodeHandle *curr = node;
-    while (curr->get_parent_page_no() != IX_NO_PAGE) {
-        // Load its parent
-        IxNodeHandle *parent = fetch_node(curr->get_parent_page_no());
-        int rank = parent->find_child(curr);
-        char *parent_key = parent->get_key(rank);
-        char *child_first_key = curr->get_key(0);
-        if (memcmp(parent_key, child_first_key, file_hdr_->col_tot_len_) == 0) {
-            assert(buffer_pool_manager_->unpin_page(parent->get_page_id(), true));
-            break;
-        }
-        memcpy(parent_key, child_first_key, file_hdr_->col_tot_len_);  // 修改了parent node
-        curr = parent;
-
-        assert(buffer_pool_manager_->unpin_page(parent->get_page_id(), true));
-    }
-}
-
-/**
- * @brief 要删除leaf之前调用此函数，更新leaf前驱结点的next指针和后继结点的prev指针
- *
- * @param leaf 要删除的leaf
- */
-void IxIndexHandle::erase_leaf(IxNodeHandle *leaf) {
-    assert(leaf->is_leaf_page());
-
-    IxNodeHandle *prev = fetch_node(leaf->get_prev_leaf());
-    prev->set_next_leaf(leaf->get_next_leaf());
-    buffer_pool_manager_->unpin_page(prev->get_page_id(), true);
-
-    IxNodeHandle *next = fetch_node(leaf->get_next_leaf());
-    next->set_prev_leaf(leaf->get_prev_leaf());  // 注意此处是SetPrevLeaf()
-    buffer_pool_manager_->unpin_page(next->get_page_id(), true);
-}
-
 /**
  * @brief 删除node时，更新file_hdr_.num_pages
  *
  * @param node
  */
 void IxIndexHandle::release_node_handle(IxNodeHandle &node) {
+    std::scoped_lock lock{file_hdr_latch_};
     file_hdr_->num_pages_--;
 }
 
@@ -512,5 +1658,6 @@ void IxIndexHandle::maintain_child(IxNodeHandle *node, int child_idx) {
         IxNodeHandle *child = fetch_node(child_page_no);
         child->set_parent_page_no(node->get_page_no());
         buffer_pool_manager_->unpin_page(child->get_page_id(), true);
+        delete child;
     }
 }
\ No newline at end of file
@@ -10,12 +10,21 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+
+#include "ix_bloom.h"
 #include "ix_defs.h"
 #include "transaction/transaction.h"
 
 enum class Operation { FIND = 0, INSERT, DELETE };  // 三种操作：查找、插入、删除
 
-static const bool binary_search = false;
+static const bool binary_search = true;
+
+/* 4字节的key（单个INT或FLOAT字段）在结点内查找时，二分查找缩小到不超过该数量的key后改为SIMD顺序比较，即两个cache line */
+static constexpr int IX_INT_SCAN_KEYS = 32;
+
+int ix_key32_search(const char *keys, int num_key, const char *target, bool upper);
 
 inline int ix_compare(const char *a, const char *b, ColType type, int col_len) {
     switch (type) {
@@ -46,7 +55,301 @@ inline int ix_compare(const char* a, const char* b, const std::vector<ColType>&
     return 0;
 }
 
-/* 管理B+树中的每个节点 */
+inline uint32_t ix_big_endian32(uint32_t x) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_bswap32(x);
+#else
+    return x;
+#endif
+}
+
+inline uint64_t ix_big_endian64(uint64_t x) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_bswap64(x);
+#else
+    return x;
+#endif
+}
+
+/**
+ * 规范化的key：每个字段都转换成按照无符号字节序比较时与原值大小关系相同的格式，复合key的字段直接拼接，
+ * 整个key只需要一次memcmp（见ix_key_compare）就能比较，不需要按照字段类型逐个比较
+ * INT：符号位取反之后按照大端序存储
+ * FLOAT：正数符号位取反，负数所有位取反，然后按照大端序存储，-0.0转换成0.0
+ * CHAR：定长，原样存储
+ */
+inline void ix_encode_col(char *dest, const char *src, ColType type, int col_len) {
+    switch (type) {
+        case TYPE_INT: {
+            uint32_t u;
+            memcpy(&u, src, sizeof(u));
+            u = ix_big_endian32(u ^ 0x80000000u);
+            memcpy(dest, &u, sizeof(u));
+            break;
+        }
+        case TYPE_FLOAT: {
+            float f;
+            memcpy(&f, src, sizeof(f));
+            if (f == 0) f = 0;
+            uint32_t u;
+            memcpy(&u, &f, sizeof(u));
+            u = (u & 0x80000000u) ? ~u : u ^ 0x80000000u;
+            u = ix_big_endian32(u);
+            memcpy(dest, &u, sizeof(u));
+            break;
+        }
+        case TYPE_STRING:
+            memcpy(dest, src, col_len);
+            break;
+        default:
+            throw InternalError("Unexpected data type");
+    }
+}
+
+inline void ix_decode_col(char *dest, const char *src, ColType type, int col_len) {
+    switch (type) {
+        case TYPE_INT: {
+            uint32_t u;
+            memcpy(&u, src, sizeof(u));
+            u = ix_big_endian32(u) ^ 0x80000000u;
+            memcpy(dest, &u, sizeof(u));
+            break;
+        }
+        case TYPE_FLOAT: {
+            uint32_t u;
+            memcpy(&u, src, sizeof(u));
+            u = ix_big_endian32(u);
+            u = (u & 0x80000000u) ? u ^ 0x80000000u : ~u;
+            memcpy(dest, &u, sizeof(u));
+            break;
+        }
+        case TYPE_STRING:
+            memcpy(dest, src, col_len);
+            break;
+        default:
+            throw InternalError("Unexpected data type");
+    }
+}
+
+inline void ix_encode_key(char *dest, const char *src, const std::vector<ColType> &col_types,
+                          const std::vector<int> &col_lens) {
+    int offset = 0;
+    for (size_t i = 0; i < col_types.size(); ++i) {
+        ix_encode_col(dest + offset, src + offset, col_types[i], col_lens[i]);
+        offset += col_lens[i];
+    }
+}
+
+inline void ix_decode_key(char *dest, const char *src, const std::vector<ColType> &col_types,
+                          const std::vector<int> &col_lens) {
+    int offset = 0;
+    for (size_t i = 0; i < col_types.size(); ++i) {
+        ix_decode_col(dest + offset, src + offset, col_types[i], col_lens[i]);
+        offset += col_lens[i];
+    }
+}
+
+/* 比较两个规范化的key，每次按照大端序读取8个字节作为无符号整数比较，结果与memcmp相同 */
+inline int ix_key_compare(const char *a, const char *b, int len) {
+    for (; len >= 8; a += 8, b += 8, len -= 8) {
+        uint64_t x, y;
+        memcpy(&x, a, sizeof(x));
+        memcpy(&y, b, sizeof(y));
+        if (x != y) {
+            return ix_big_endian64(x) < ix_big_endian64(y) ? -1 : 1;
+        }
+    }
+    if (len >= 4) {
+        uint32_t x, y;
+        memcpy(&x, a, sizeof(x));
+        memcpy(&y, b, sizeof(y));
+        if (x != y) {
+            return ix_big_endian32(x) < ix_big_endian32(y) ? -1 : 1;
+        }
+        a += 4, b += 4, len -= 4;
+    }
+    return len == 0 ? 0 : memcmp(a, b, len);
+}
+
+/* 两个key的公共前缀长度 */
+inline int ix_common_prefix(const char *a, const char *b, int len) {
+    int i = 0;
+    while (i < len && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+/* key去掉末尾的0字节之后的长度，截断的分隔key后面补0，压缩时末尾的0不需要保存 */
+inline int ix_significant_len(const char *key, int len) {
+    while (len > 0 && key[len - 1] == 0) {
+        len--;
+    }
+    return len;
+}
+
+/**
+ * 后缀截断：生成分隔left和right（left < right）的最短key，即right保留到与left第一个不同的字节为止，后面补0。
+ * 结果s满足left < s <= right，可以代替right作为内部结点中的分隔key
+ */
+inline void ix_shortest_separator(char *dest, const char *left, const char *right, int len) {
+    int keep = std::min(len, ix_common_prefix(left, right, len) + 1);
+    memcpy(dest, right, keep);
+    memset(dest + keep, 0, len - keep);
+}
+
+/* 压缩的内部结点中key[1..n)的公共前缀长度，key[1..n)有序，所以就是第一个和最后一个的公共前缀 */
+inline int ix_internal_prefix(const char *keys, int n, int len) {
+    return n > 1 ? ix_common_prefix(keys + len, keys + (n - 1) * len, len) : 0;
+}
+
+/**
+ * 压缩的内部结点中n个key所占的空间，页面格式见IxNodeHandle::store：
+ * 第0个key完整保存，key[1..n)的公共前缀保存一次，key[1..n)保存去掉公共前缀和末尾0之后的部分，每个key有2字节的结束位置
+ */
+inline int ix_compressed_size(const char *keys, int n, int len) {
+    int size = sizeof(IxPageHdr);
+    if (n == 0) {
+        return size;
+    }
+    int prefix_len = ix_internal_prefix(keys, n, len);
+    size += len + prefix_len + (n - 1) * sizeof(uint16_t) + n * sizeof(Rid);
+    for (int i = 1; i < n; i++) {
+        size += std::max(0, ix_significant_len(keys + i * len, len) - prefix_len);
+    }
+    return size;
+}
+
+/**
+ * 非唯一索引key末尾的Rid：page_no和slot_no按照INT字段规范化，相同字段的键值对按照Rid排序，
+ * 全0和全0xff分别小于和大于任何实际的Rid，用作查找字段相同的键值对时的下界和上界
+ */
+inline void ix_encode_rid(char *dest, const Rid &rid) {
+    ix_encode_col(dest, reinterpret_cast<const char *>(&rid.page_no), TYPE_INT, sizeof(int));
+    ix_encode_col(dest + sizeof(int), reinterpret_cast<const char *>(&rid.slot_no), TYPE_INT, sizeof(int));
+}
+
+/* posting list中Rid的varint最多占用的字节数，page_no不超过31位，slot_no不超过16位，共47位 */
+static constexpr int IX_RID_VARINT_MAX = 7;
+static constexpr int IX_POSTING_SLOT_BITS = 16;
+
+/**
+ * posting list中把Rid转换成一个整数，大小关系与ix_encode_rid相同，同一个页面中相邻的Rid差值很小，
+ * 不同页面的Rid差值也只有三个字节左右
+ */
+inline uint64_t ix_posting_value(const Rid &rid) {
+    if (rid.page_no < 0 || rid.slot_no < 0 || rid.slot_no >= (1 << IX_POSTING_SLOT_BITS)) {
+        throw InternalError("ix_posting_value: rid out of range");
+    }
+    return ((uint64_t)rid.page_no << IX_POSTING_SLOT_BITS) | (uint64_t)rid.slot_no;
+}
+
+inline Rid ix_posting_rid(uint64_t value) {
+    return Rid{.page_no = (int)(value >> IX_POSTING_SLOT_BITS),
+               .slot_no = (int)(value & ((1u << IX_POSTING_SLOT_BITS) - 1))};
+}
+
+inline int ix_varint_len(uint64_t x) {
+    int len = 1;
+    while (x >= 0x80) {
+        x >>= 7;
+        len++;
+    }
+    return len;
+}
+
+/* 每个字节保存7位，最高位为1表示后面还有字节，返回写入的字节数 */
+inline int ix_put_varint(char *dest, uint64_t x) {
+    int len = 0;
+    while (x >= 0x80) {
+        dest[len++] = (char)(x | 0x80);
+        x >>= 7;
+    }
+    dest[len++] = (char)x;
+    return len;
+}
+
+inline int ix_get_varint(const char *src, uint64_t *x) {
+    uint64_t res = 0;
+    int len = 0, shift = 0;
+    while (true) {
+        uint8_t b = src[len++];
+        res |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+        shift += 7;
+    }
+    *x = res;
+    return len;
+}
+
+/**
+ * posting list格式的叶子结点中n个键值对所占的空间，页面格式见IxNodeHandle::store_posting：
+ * 字段相同的连续键值对组成一组，每组保存一次字段和4字节的组头，Rid按照差值保存为varint
+ */
+inline int ix_posting_size(const char *keys, const Rid *rids, int n, int key_len) {
+    int col_len = key_len - IX_RID_KEY_LEN;
+    int size = sizeof(IxPageHdr) + sizeof(uint16_t);
+    uint64_t prev = 0;
+    for (int i = 0; i < n; i++) {
+        uint64_t value = ix_posting_value(rids[i]);
+        if (i == 0 || memcmp(keys + (i - 1) * key_len, keys + i * key_len, col_len) != 0) {
+            size += col_len + 2 * sizeof(uint16_t);
+            prev = 0;
+        }
+        size += ix_varint_len(value - prev);
+        prev = value;
+    }
+    return size;
+}
+
+/* 把记录格式的key转换成规范化的key，较短的key使用栈上的缓冲区，避免每次查找都分配内存 */
+class IxKeyBuffer {
+   private:
+    static constexpr int INLINE_LEN = 256;
+    char inline_buf_[INLINE_LEN];
+    std::unique_ptr<char[]> heap_buf_;
+    char *data_;
+    char *rid_suffix_ = nullptr;    // 非唯一索引key末尾的Rid
+
+   public:
+    IxKeyBuffer(const char *key, const std::vector<ColType> &col_types, const std::vector<int> &col_lens,
+                int col_tot_len) {
+        data_ = inline_buf_;
+        if (col_tot_len > INLINE_LEN) {
+            heap_buf_ = std::make_unique<char[]>(col_tot_len);
+            data_ = heap_buf_.get();
+        }
+        ix_encode_key(data_, key, col_types, col_lens);
+    }
+
+    IxKeyBuffer(const char *key, const IxFileHdr *file_hdr)
+        : IxKeyBuffer(key, file_hdr->col_types_, file_hdr->col_lens_, file_hdr->col_tot_len_) {
+        if (file_hdr->posting_list_) {
+            rid_suffix_ = data_ + file_hdr->col_tot_len_ - IX_RID_KEY_LEN;
+            memset(rid_suffix_, 0, IX_RID_KEY_LEN);
+        }
+    }
+
+    const char *data() const { return data_; }
+
+    /* 非唯一索引中插入和删除时key末尾为键值对的Rid，查找时默认全0，即字段相同的键值对的下界 */
+    void set_rid(const Rid &rid) {
+        if (rid_suffix_ != nullptr) ix_encode_rid(rid_suffix_, rid);
+    }
+
+    /* 非唯一索引中字段相同的键值对的上界 */
+    void set_max_rid() {
+        if (rid_suffix_ != nullptr) memset(rid_suffix_, 0xff, IX_RID_KEY_LEN);
+    }
+};
+
+/**
+ * 管理B+树中的每个节点
+ * 叶子结点和不压缩的内部结点中key和rid都是定长数组；索引的prefix_compression_为true时内部结点是压缩的（见store），
+ * 查找孩子结点时直接在页面上查找，读取key或者修改结点时先解压到key_buf_和rid_buf_中，keys和rids指向这两个缓冲区，
+ * 每次修改之后重新压缩写回页面。索引的posting_list_为true时叶子结点以同样的方式压缩（见store_posting），
+ * 解压之后仍然是每个Rid一个键值对，等值查找直接在页面上读取Rid列表（见posting_lookup）
+ */
 class IxNodeHandle {
     friend class IxIndexHandle;
     friend class IxScan;
@@ -55,8 +358,12 @@ class IxNodeHandle {
     const IxFileHdr *file_hdr;      // 节点所在文件的头部信息
     Page *page;                     // 存储节点的页面
     IxPageHdr *page_hdr;            // page->data的第一部分，指针指向首地址，长度为sizeof(IxPageHdr)
-    char *keys;                     // page->data的第二部分，指针指向首地址，长度为file_hdr->keys_size，每个key的长度为file_hdr->col_len
-    Rid *rids;                      // page->data的第三部分，指针指向首地址
+    mutable char *keys;             // page->data的第二部分，指针指向首地址，长度为file_hdr->keys_size，每个key的长度为file_hdr->col_len
+    mutable Rid *rids;              // page->data的第三部分，指针指向首地址
+    mutable bool decoded_ = false;  // 压缩的结点是否已经解压到缓冲区中
+    mutable bool overflow_ = false; // 压缩的结点修改之后超过了一个页面，还没有写回，需要分裂
+    mutable std::vector<char> key_buf_;
+    mutable std::vector<Rid> rid_buf_;
 
    public:
     IxNodeHandle() = default;
@@ -69,7 +376,15 @@ class IxNodeHandle {
 
     int get_size() { return page_hdr->num_key; }
 
-    void set_size(int size) { page_hdr->num_key = size; }
+    void set_size(int size) {
+        if (is_compressed()) {
+            decode();
+            page_hdr->num_key = size;
+            store();
+            return;
+        }
+        page_hdr->num_key = size;
+    }
 
     int get_max_size() { return file_hdr->btree_order_ + 1; }
 
@@ -78,7 +393,14 @@ class IxNodeHandle {
     int key_at(int i) { return *(int *)get_key(i); }
 
     /* 得到第i个孩子结点的page_no */
-    page_id_t value_at(int i) { return get_rid(i)->page_no; }
+    page_id_t value_at(int i) {
+        if (is_compressed() && !decoded_) {
+            Rid rid;
+            memcpy(&rid, compressed_rids() + i * sizeof(Rid), sizeof(Rid));
+            return rid.page_no;
+        }
+        return get_rid(i)->page_no;
+    }
 
     page_id_t get_page_no() { return page->get_page_id().page_no; }
 
@@ -100,13 +422,66 @@ class IxNodeHandle {
 
     void set_parent_page_no(page_id_t parent) { page_hdr->parent = parent; }
 
-    char *get_key(int key_idx) const { return keys + key_idx * file_hdr->col_tot_len_; }
+    char *get_key(int key_idx) const {
+        if (is_compressed()) decode();
+        return keys + key_idx * file_hdr->col_tot_len_;
+    }
+
+    Rid *get_rid(int rid_idx) const {
+        if (is_compressed()) decode();
+        return &rids[rid_idx];
+    }
+
+    void set_key(int key_idx, const char *key) {
+        memcpy(get_key(key_idx), key, file_hdr->col_tot_len_);
+        if (is_compressed()) store();
+    }
+
+    void set_rid(int rid_idx, const Rid &rid) {
+        *get_rid(rid_idx) = rid;
+        if (is_compressed()) store();
+    }
+
+    bool is_key32() const { return file_hdr->col_tot_len_ == 4; }
+
+    bool is_compressed() const {
+        return page_hdr->is_leaf ? file_hdr->posting_list_ : file_hdr->prefix_compression_;
+    }
 
-    Rid *get_rid(int rid_idx) const { return &rids[rid_idx]; }
+    /* 修改之后是否需要分裂：压缩的结点超过一个页面，其他结点键值对个数达到max_size */
+    bool is_overflow() { return is_compressed() ? overflow_ : get_size() >= get_max_size(); }
+
+    /**
+     * 压缩的结点有num_key个键值对时最多占用的空间：内部结点的key都没有公共前缀和末尾的0，
+     * posting list格式的叶子结点每个键值对单独成组
+     */
+    int max_compressed_size(int num_key) const {
+        if (page_hdr->is_leaf) {
+            int col_len = file_hdr->col_tot_len_ - IX_RID_KEY_LEN;
+            return sizeof(IxPageHdr) + sizeof(uint16_t) +
+                   num_key * (col_len + 2 * (int)sizeof(uint16_t) + IX_RID_VARINT_MAX);
+        }
+        return sizeof(IxPageHdr) + num_key * (file_hdr->col_tot_len_ + sizeof(Rid)) +
+               std::max(0, num_key - 1) * (int)sizeof(uint16_t);
+    }
 
-    void set_key(int key_idx, const char *key) { memcpy(keys + key_idx * file_hdr->col_tot_len_, key, file_hdr->col_tot_len_); }
+    /**
+     * 压缩的结点再插入一个键值对之后是否一定不超过一个页面。posting list格式的叶子结点按照实际大小计算：
+     * 新的一组最多增加字段、组头和一个varint，插入已有的组最多增加两个varint；删除一个Rid时两个差值合并成一个，不会变大
+     */
+    bool has_room() {
+        if (!is_compressed()) {
+            return true;
+        }
+        if (page_hdr->is_leaf) {
+            int col_len = file_hdr->col_tot_len_ - IX_RID_KEY_LEN;
+            int data_len = std::max<int>(page_hdr->data_len, sizeof(IxPageHdr) + sizeof(uint16_t));
+            return data_len + col_len + 2 * (int)sizeof(uint16_t) + 2 * IX_RID_VARINT_MAX <= PAGE_SIZE;
+        }
+        return max_compressed_size(get_size() + 1) <= PAGE_SIZE;
+    }
 
-    void set_rid(int rid_idx, const Rid &rid) { rids[rid_idx] = rid; }
+    int split_point(int preferred);
 
     int lower_bound(const char *target) const;
 
@@ -118,6 +493,8 @@ class IxNodeHandle {
 
     bool leaf_lookup(const char *key, Rid **value);
 
+    bool posting_lookup(const char *key, std::vector<Rid> *result) const;
+
     int insert(const char *key, const Rid &value);
 
     // 用于在结点中的指定位置插入单个键值对
@@ -148,15 +525,38 @@ class IxNodeHandle {
     int find_child(IxNodeHandle *child) {
         int rid_idx;
         for (rid_idx = 0; rid_idx < page_hdr->num_key; rid_idx++) {
-            if (get_rid(rid_idx)->page_no == child->get_page_no()) {
+            if (value_at(rid_idx) == child->get_page_no()) {
                 break;
             }
         }
         assert(rid_idx < page_hdr->num_key);
         return rid_idx;
     }
+
+   private:
+    // 压缩的内部结点
+    char *compressed_rids() const {
+        int n = page_hdr->num_key;
+        return page->get_data() + sizeof(IxPageHdr) + file_hdr->col_tot_len_ + page_hdr->prefix_len +
+               std::max(0, n - 1) * sizeof(uint16_t);
+    }
+
+    int compressed_bound(const char *target, bool upper) const;
+
+    // posting list格式的叶子结点
+    char *posting_data() const { return page->get_data() + sizeof(IxPageHdr); }
+
+    void decode() const;
+
+    void store();
+
+    void decode_posting() const;
+
+    void store_posting();
 };
 
+class IxExternalSorter;
+
 /* B+树 */
 class IxIndexHandle {
     friend class IxScan;
@@ -167,26 +567,34 @@ class IxIndexHandle {
     BufferPoolManager *buffer_pool_manager_;
     int fd_;                                    // 存储B+树的文件
     IxFileHdr* file_hdr_;                       // 存了root_page，但其初始化为2（第0页存FILE_HDR_PAGE，第1页存LEAF_HEADER_PAGE）
-    std::mutex root_latch_;
+    mutable std::mutex root_latch_;             // 保护root_page_，持有时才能修改根结点
+    std::mutex file_hdr_latch_;                 // 保护文件头中的num_pages_和last_leaf_
+    std::atomic<page_id_t> rightmost_leaf_{IX_NO_PAGE};  // 上一次插入追加到了这个最右叶子结点的末尾，递增插入时直接追加
+    std::unique_ptr<IxBloomFilter> bloom_;      // 索引字段上的Bloom filter，为空时不使用，见build_bloom_filter
 
    public:
     IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd);
 
     // for search
-    bool get_value(const char *key, std::vector<Rid> *result, Transaction *transaction);
+    bool get_value(const char *rec_key, std::vector<Rid> *result, Transaction *transaction);
 
     std::pair<IxNodeHandle *, bool> find_leaf_page(const char *key, Operation operation, Transaction *transaction,
                                                  bool find_first = false);
 
+    IxNodeHandle *find_leaf_page(const char *key, Operation operation, std::deque<Page *> &latch_set);
+
     // for insert
-    page_id_t insert_entry(const char *key, const Rid &value, Transaction *transaction);
+    page_id_t insert_entry(const char *rec_key, const Rid &value, Transaction *transaction);
 
-    IxNodeHandle *split(IxNodeHandle *node);
+    IxNodeHandle *split(IxNodeHandle *node, bool right_edge = false);
 
-    void insert_into_parent(IxNodeHandle *old_node, const char *key, IxNodeHandle *new_node, Transaction *transaction);
+    void insert_into_parent(IxNodeHandle *old_node, const char *key, IxNodeHandle *new_node, Transaction *transaction,
+                            bool right_edge = false);
 
     // for delete
-    bool delete_entry(const char *key, Transaction *transaction);
+    bool delete_entry(const char *rec_key, Transaction *transaction);
+
+    bool delete_entry(const char *rec_key, const Rid &value, Transaction *transaction);
 
     bool coalesce_or_redistribute(IxNodeHandle *node, Transaction *transaction = nullptr,
                                 bool *root_is_latched = nullptr);
@@ -197,14 +605,30 @@ class IxIndexHandle {
     bool coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node, IxNodeHandle **parent, int index,
                   Transaction *transaction, bool *root_is_latched);
 
-    Iid lower_bound(const char *key);
+    Iid lower_bound(const char *rec_key);
 
-    Iid upper_bound(const char *key);
+    Iid upper_bound(const char *rec_key);
 
     Iid leaf_end() const;
 
     Iid leaf_begin() const;
 
+    // for bulk load
+    void bulk_load(IxExternalSorter &sorter, double fill_factor = IX_BULK_FILL_FACTOR);
+
+    bool is_unique() const { return !file_hdr_->posting_list_; }
+
+    const IxFileHdr *get_file_hdr() const { return file_hdr_; }
+
+    int get_height() const;
+
+    // for bloom filter
+    void build_bloom_filter();
+
+    bool may_contain(const char *rec_key) const;
+
+    const IxBloomFilter *get_bloom_filter() const { return bloom_.get(); }
+
    private:
     // 辅助函数
     void update_root_page_no(page_id_t root) { file_hdr_->root_page_ = root; }
@@ -216,15 +640,37 @@ class IxIndexHandle {
 
     IxNodeHandle *create_node();
 
-    // for maintain data structure
-    void maintain_parent(IxNodeHandle *node);
+    // for latch crabbing
+    bool is_safe(IxNodeHandle *node, Operation operation);
 
-    void erase_leaf(IxNodeHandle *leaf);
+    void release_latches(std::deque<Page *> &latch_set, bool is_dirty);
 
+    // for maintain data structure
     void release_node_handle(IxNodeHandle &node);
 
     void maintain_child(IxNodeHandle *node, int child_idx);
 
+    void make_separator(char *sep, const char *left, const char *right) const;
+
+    void set_separator(IxNodeHandle *parent, int index, IxNodeHandle *left, IxNodeHandle *right);
+
+    Iid leaf_iid(IxNodeHandle *leaf, int slot_no) const;
+
+    bool get_posting_values(const char *key, std::vector<Rid> *result);
+
+    // 非唯一索引的key末尾的Rid不参与Bloom filter的哈希
+    int bloom_key_len() const { return file_hdr_->col_tot_len_ - (file_hdr_->posting_list_ ? IX_RID_KEY_LEN : 0); }
+
+    page_id_t insert_rightmost(page_id_t page_no, const char *key, const Rid &value);
+
+    IxNodeHandle *bulk_next_leaf(IxNodeHandle *leaf);
+
+    IxNodeHandle *bulk_load_leaves(IxExternalSorter &sorter, IxNodeHandle *root, double fill_factor,
+                                   std::vector<char> &seps, std::vector<page_id_t> &pages);
+
+    IxNodeHandle *bulk_load_posting_leaves(IxExternalSorter &sorter, IxNodeHandle *root, double fill_factor,
+                                           std::vector<char> &seps, std::vector<page_id_t> &pages);
+
     // for index test
     Rid get_rid(const Iid &iid) const;
 };
\ No newline at end of file
@@ -15,6 +15,7 @@ See the Mulan PSL v2 for more details. */
 
 #include "system/sm_meta.h"
 #include "ix_defs.h"
+#include "ix_hash.h"
 #include "ix_index_handle.h"
 
 class IxManager {
@@ -54,7 +55,13 @@ class IxManager {
         return disk_manager_->is_file(ix_name);
     }
 
-    void create_index(const std::string &filename, const std::vector<ColMeta>& index_cols) {
+    /**
+     * @description: 创建B+树索引
+     * @param {string&} filename 表名称
+     * @param {vector<ColMeta>&} index_cols 索引包含的字段
+     * @param {bool} unique 是否为唯一索引，非唯一索引的key末尾追加Rid，叶子结点使用posting list格式
+     */
+    void create_index(const std::string &filename, const std::vector<ColMeta>& index_cols, bool unique = true) {
         std::string ix_name = get_index_name(filename, index_cols);
         // Create index file
         disk_manager_->create_file(ix_name);
@@ -73,6 +80,9 @@ class IxManager {
         if (col_tot_len > IX_MAX_COL_LEN) {
             throw InvalidColLengthError(col_tot_len);
         }
+        if (!unique) {
+            col_tot_len += IX_RID_KEY_LEN;
+        }
         // 根据 |page_hdr| + (|attr| + |rid|) * (n + 1) <= PAGE_SIZE 求得n的最大值btree_order
         // 即 n <= btree_order，那么btree_order就是每个结点最多可插入的键值对数量（实际还多留了一个空位，但其不可插入）
         int btree_order = static_cast<int>((PAGE_SIZE - sizeof(IxPageHdr)) / (col_tot_len + sizeof(Rid)) - 1);
@@ -82,9 +92,14 @@ class IxManager {
         IxFileHdr* fhdr = new IxFileHdr(IX_NO_PAGE, IX_INIT_NUM_PAGES, IX_INIT_ROOT_PAGE,
                                 col_num, col_tot_len, btree_order, (btree_order + 1) * col_tot_len,
                                 IX_INIT_ROOT_PAGE, IX_INIT_ROOT_PAGE);
+        fhdr->posting_list_ = !unique;
         for(int i = 0; i < col_num; ++i) {
             fhdr->col_types_.push_back(index_cols[i].type);
             fhdr->col_lens_.push_back(index_cols[i].len);
+            // 字符串key的分隔key通常只需要前几个字节就能区分，内部结点压缩后扇出更大
+            if (index_cols[i].type == TYPE_STRING && col_tot_len > IX_COMPRESS_MIN_KEY_LEN) {
+                fhdr->prefix_compression_ = true;
+            }
         }
         fhdr->update_tot_len();
         
@@ -133,6 +148,55 @@ class IxManager {
         disk_manager_->close_file(fd);
     }
 
+    /**
+     * @description: 创建可扩展哈希索引，文件中第0页为文件头，第1页为目录页，第2页为初始的桶
+     * @param {string&} filename 表名称
+     * @param {vector<ColMeta>&} index_cols 索引包含的字段
+     */
+    void create_hash_index(const std::string &filename, const std::vector<ColMeta>& index_cols) {
+        IxHashFileHdr fhdr;
+        fhdr.col_num_ = index_cols.size();
+        for (auto &col : index_cols) {
+            fhdr.col_types_.push_back(col.type);
+            fhdr.col_lens_.push_back(col.len);
+            fhdr.col_tot_len_ += col.len;
+        }
+        if (fhdr.col_tot_len_ > IX_MAX_COL_LEN) {
+            throw InvalidColLengthError(fhdr.col_tot_len_);
+        }
+        // 每个键值对占用 |hash| + |key| + |rid|
+        fhdr.bucket_capacity_ = static_cast<int>((PAGE_SIZE - sizeof(IxHashBucketHdr)) /
+                                                 (sizeof(uint32_t) + fhdr.col_tot_len_ + sizeof(Rid)));
+        assert(fhdr.bucket_capacity_ > 1);
+        fhdr.num_pages_ = IX_HASH_INIT_NUM_PAGES;
+        fhdr.global_depth_ = 0;
+        fhdr.num_buckets_ = 1;
+        fhdr.dir_pages_.push_back(IX_HASH_DIR_PAGE);
+        fhdr.update_tot_len();
+
+        std::string ix_name = get_index_name(filename, index_cols);
+        disk_manager_->create_file(ix_name);
+        int fd = disk_manager_->open_file(ix_name);
+
+        char page_buf[PAGE_SIZE];
+        memset(page_buf, 0, PAGE_SIZE);
+        fhdr.serialize(page_buf);
+        disk_manager_->write_page(fd, IX_FILE_HDR_PAGE, page_buf, PAGE_SIZE);
+
+        // 全局深度为0时目录只有一项，指向初始的桶
+        memset(page_buf, 0, PAGE_SIZE);
+        page_id_t bucket_page_no = IX_HASH_INIT_BUCKET_PAGE;
+        memcpy(page_buf, &bucket_page_no, sizeof(page_id_t));
+        disk_manager_->write_page(fd, IX_HASH_DIR_PAGE, page_buf, PAGE_SIZE);
+
+        memset(page_buf, 0, PAGE_SIZE);
+        auto bhdr = reinterpret_cast<IxHashBucketHdr *>(page_buf);
+        *bhdr = {.local_depth = 0, .num_key = 0};
+        disk_manager_->write_page(fd, IX_HASH_INIT_BUCKET_PAGE, page_buf, PAGE_SIZE);
+
+        disk_manager_->close_file(fd);
+    }
+
     void destroy_index(const std::string &filename, const std::vector<ColMeta>& index_cols) {
         std::string ix_name = get_index_name(filename, index_cols);
         disk_manager_->destroy_file(ix_name);
@@ -156,12 +220,29 @@ class IxManager {
         return std::make_unique<IxIndexHandle>(disk_manager_, buffer_pool_manager_, fd);
     }
 
+    std::unique_ptr<IxHashHandle> open_hash_index(const std::string &filename, const std::vector<ColMeta>& index_cols) {
+        std::string ix_name = get_index_name(filename, index_cols);
+        int fd = disk_manager_->open_file(ix_name);
+        return std::make_unique<IxHashHandle>(disk_manager_, buffer_pool_manager_, fd);
+    }
+
+    void close_hash_index(IxHashHandle *hh) {
+        // 目录写入目录页之后文件头中的目录页号和页面数才是最终的
+        hh->flush_directory();
+        char data[PAGE_SIZE];
+        memset(data, 0, PAGE_SIZE);
+        hh->file_hdr_.serialize(data);
+        disk_manager_->write_page(hh->fd_, IX_FILE_HDR_PAGE, data, PAGE_SIZE);
+        buffer_pool_manager_->delete_all_pages(hh->fd_);
+        disk_manager_->close_file(hh->fd_);
+    }
+
     void close_index(const IxIndexHandle *ih) {
         char* data = new char[ih->file_hdr_->tot_len_];
         ih->file_hdr_->serialize(data);
         disk_manager_->write_page(ih->fd_, IX_FILE_HDR_PAGE, data, ih->file_hdr_->tot_len_);
-        // 缓冲区的所有页刷到磁盘，注意这句话必须写在close_file前面
-        buffer_pool_manager_->flush_all_pages(ih->fd_);
+        // 缓冲区的所有页刷到磁盘并从缓冲区中删除，注意这句话必须写在close_file前面
+        buffer_pool_manager_->delete_all_pages(ih->fd_);
         disk_manager_->close_file(ih->fd_);
     }
 };
\ No newline at end of file
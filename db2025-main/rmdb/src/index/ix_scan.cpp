@@ -11,23 +11,64 @@ See the Mulan PSL v2 for more details. */
 #include "ix_scan.h"
 
 /**
- * @brief 
- * @todo 加上读锁（需要使用缓冲池得到page）
+ * @brief 复制iid_所在的叶子结点中的所有键值对，已经复制过时不再读取页面
  */
-void IxScan::next() {
-    assert(!is_end());
+void IxScan::load_leaf() const {
+    if (leaf_page_no_ == iid_.page_no) {
+        return;
+    }
     IxNodeHandle *node = ih_->fetch_node(iid_.page_no);
+    node->page->r_latch();
     assert(node->is_leaf_page());
-    assert(iid_.slot_no < node->get_size());
+    int n = node->get_size();
+    int key_len = ih_->file_hdr_->col_tot_len_;
+    keys_.resize(n * key_len);
+    rids_.resize(n);
+    if (n > 0) {
+        memcpy(keys_.data(), node->get_key(0), n * key_len);
+        memcpy(rids_.data(), node->get_rid(0), n * sizeof(Rid));
+    }
+    next_leaf_ = node->get_next_leaf();
+    leaf_page_no_ = iid_.page_no;
+    node->page->r_unlatch();
+    bpm_->unpin_page(node->get_page_id(), false);
+    delete node;
+}
+
+/**
+ * @brief 移动到下一个键值对
+ * 当前叶子结点已经读完时移动到下一个叶子结点的开头，最后一个叶子结点读完时到达end_
+ */
+void IxScan::next() {
+    assert(!is_end());
+    load_leaf();
     // increment slot no
     iid_.slot_no++;
-    if (iid_.page_no != ih_->file_hdr_->last_leaf_ && iid_.slot_no == node->get_size()) {
-        // go to next leaf
-        iid_.slot_no = 0;
-        iid_.page_no = node->get_next_leaf();
+    if (iid_.slot_no >= (int)rids_.size()) {
+        if (next_leaf_ == IX_LEAF_HEADER_PAGE) {
+            iid_ = end_;
+        } else {
+            // go to next leaf
+            iid_.slot_no = 0;
+            iid_.page_no = next_leaf_;
+        }
     }
 }
 
 Rid IxScan::rid() const {
-    return ih_->get_rid(iid_);
-}
\ No newline at end of file
+    load_leaf();
+    if (iid_.slot_no >= (int)rids_.size()) {
+        throw IndexEntryNotFoundError();
+    }
+    return rids_[iid_.slot_no];
+}
+
+/**
+ * @brief 把当前位置的key转换成记录格式复制到dest中，用于覆盖索引扫描直接从叶子结点读取字段
+ */
+void IxScan::key(char *dest) const {
+    assert(!is_end());
+    load_leaf();
+    const char *key = keys_.data() + iid_.slot_no * ih_->file_hdr_->col_tot_len_;
+    ix_decode_key(dest, key, ih_->file_hdr_->col_types_, ih_->file_hdr_->col_lens_);
+}
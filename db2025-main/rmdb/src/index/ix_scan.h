@@ -17,13 +17,21 @@ See the Mulan PSL v2 for more details. */
 
 // 用于遍历叶子结点
 // 用于直接遍历叶子结点，而不用findleafpage来得到叶子结点
-// TODO：对page遍历时，要加上读锁
+// 每个叶子结点只在第一次访问时加读锁，把所有键值对复制出来，之后的访问都读取副本，
+// posting list格式的叶子结点也只需要解压一次
 class IxScan : public RecScan {
     const IxIndexHandle *ih_;
     Iid iid_;  // 初始为lower（用于遍历的指针）
     Iid end_;  // 初始为upper
     BufferPoolManager *bpm_;
 
+    mutable page_id_t leaf_page_no_ = IX_NO_PAGE;   // 已经复制的叶子结点
+    mutable page_id_t next_leaf_ = IX_NO_PAGE;      // 已经复制的叶子结点的下一个叶子结点
+    mutable std::vector<char> keys_;                // 叶子结点中key的副本，规范化的key
+    mutable std::vector<Rid> rids_;                 // 叶子结点中rid的副本
+
+    void load_leaf() const;
+
    public:
     IxScan(const IxIndexHandle *ih, const Iid &lower, const Iid &upper, BufferPoolManager *bpm)
         : ih_(ih), iid_(lower), end_(upper), bpm_(bpm) {}
@@ -34,5 +42,7 @@ class IxScan : public RecScan {
 
     Rid rid() const override;
 
+    void key(char *dest) const;
+
     const Iid &iid() const { return iid_; }
 };
\ No newline at end of file
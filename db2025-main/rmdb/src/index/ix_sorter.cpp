@@ -0,0 +1,146 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "ix_sorter.h"
+
+#include <algorithm>
+#include <cstdio>
+
+IxExternalSorter::IxExternalSorter(const IxFileHdr *file_hdr, std::string run_prefix, size_t mem_limit)
+    : file_hdr_(file_hdr), run_prefix_(std::move(run_prefix)) {
+    entry_size_ = file_hdr_->col_tot_len_ + sizeof(Rid);
+    max_entries_ = std::max<size_t>(1, mem_limit / (entry_size_ + sizeof(size_t)));
+}
+
+IxExternalSorter::~IxExternalSorter() {
+    runs_.clear();
+    for (auto &run_name : run_names_) {
+        std::remove(run_name.c_str());
+    }
+}
+
+/**
+ * @description: 加入一个键值对，内存中的键值对达到上限时写入run文件
+ */
+void IxExternalSorter::add(const char *key, const Rid &rid) {
+    assert(!finished_);
+    if (order_.size() == max_entries_) {
+        spill();
+    }
+    size_t offset = buf_.size();
+    buf_.resize(offset + entry_size_);
+    memcpy(buf_.data() + offset, key, file_hdr_->col_tot_len_);
+    memcpy(buf_.data() + offset + file_hdr_->col_tot_len_, &rid, sizeof(Rid));
+    order_.push_back(order_.size());
+    num_entries_++;
+}
+
+/**
+ * @description: 对内存中的键值对排序，只移动下标不移动键值对
+ */
+void IxExternalSorter::sort_buffer() {
+    std::sort(order_.begin(), order_.end(), [&](size_t a, size_t b) {
+        return compare(buf_.data() + a * entry_size_, buf_.data() + b * entry_size_) < 0;
+    });
+}
+
+/**
+ * @description: 把内存中的键值对排序后写入一个新的run文件
+ */
+void IxExternalSorter::spill() {
+    sort_buffer();
+    std::string run_name = run_prefix_ + ".run" + std::to_string(run_names_.size());
+    std::ofstream ofs(run_name, std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        throw UnixError();
+    }
+    run_names_.push_back(run_name);
+    for (size_t idx : order_) {
+        ofs.write(buf_.data() + idx * entry_size_, entry_size_);
+    }
+    if (!ofs) {
+        throw UnixError();
+    }
+    buf_.clear();
+    order_.clear();
+}
+
+/**
+ * @description: 所有键值对加入之后调用，之后才能调用next()
+ * 只有内存中的键值对时直接按照排序后的下标读出，否则把剩余的键值对也写入run文件，然后打开所有run文件进行多路归并
+ */
+void IxExternalSorter::finish() {
+    assert(!finished_);
+    finished_ = true;
+    if (run_names_.empty()) {
+        sort_buffer();
+        return;
+    }
+    if (!order_.empty()) {
+        spill();
+    }
+    buf_.shrink_to_fit();
+    order_.shrink_to_fit();
+    runs_.resize(run_names_.size());
+    for (size_t i = 0; i < runs_.size(); i++) {
+        runs_[i].ifs = std::make_unique<std::ifstream>(run_names_[i], std::ios::binary);
+        runs_[i].entry.resize(entry_size_);
+        if (read_entry(runs_[i])) {
+            heap_.push_back(i);
+        }
+    }
+    auto cmp = [&](int a, int b) { return heap_less(b, a); };
+    std::make_heap(heap_.begin(), heap_.end(), cmp);
+}
+
+/**
+ * @description: 按照key从小到大读出下一个键值对
+ * @return {bool} 是否读到了键值对，所有键值对都读完时返回false
+ * @param {char*} key 读出的key，长度为col_tot_len_
+ * @param {Rid*} rid 读出的Rid
+ */
+bool IxExternalSorter::next(char *key, Rid *rid) {
+    assert(finished_);
+    if (runs_.empty()) {
+        if (pos_ == order_.size()) {
+            return false;
+        }
+        const char *entry = buf_.data() + order_[pos_++] * entry_size_;
+        memcpy(key, entry, file_hdr_->col_tot_len_);
+        memcpy(rid, entry + file_hdr_->col_tot_len_, sizeof(Rid));
+        return true;
+    }
+    if (heap_.empty()) {
+        return false;
+    }
+    auto cmp = [&](int a, int b) { return heap_less(b, a); };
+    std::pop_heap(heap_.begin(), heap_.end(), cmp);
+    Run &run = runs_[heap_.back()];
+    memcpy(key, run.entry.data(), file_hdr_->col_tot_len_);
+    memcpy(rid, run.entry.data() + file_hdr_->col_tot_len_, sizeof(Rid));
+    if (read_entry(run)) {
+        std::push_heap(heap_.begin(), heap_.end(), cmp);
+    } else {
+        heap_.pop_back();
+    }
+    return true;
+}
+
+bool IxExternalSorter::read_entry(Run &run) {
+    return (bool)run.ifs->read(run.entry.data(), entry_size_);
+}
+
+/**
+ * @description: 比较两个run的当前键值对，key相同时先写入的run在前，保证排序是稳定的
+ */
+bool IxExternalSorter::heap_less(int a, int b) const {
+    int cmp = compare(runs_[a].entry.data(), runs_[b].entry.data());
+    return cmp < 0 || (cmp == 0 && a < b);
+}
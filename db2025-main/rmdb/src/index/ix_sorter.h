@@ -0,0 +1,75 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ix_index_handle.h"
+
+/**
+ * 索引批量构建使用的外部排序，对(key, Rid)键值对按照key排序，key是规范化的key（见ix_encode_key），直接按字节比较。
+ * 内存中的键值对超过mem_limit时，排序后写入一个临时的run文件；
+ * finish()之后通过next()按照key从小到大读出所有键值对，有多个run文件时进行多路归并
+ */
+class IxExternalSorter {
+   private:
+    // 正在归并的run文件
+    struct Run {
+        std::unique_ptr<std::ifstream> ifs;
+        std::vector<char> entry;            // 当前读到的键值对
+    };
+
+    const IxFileHdr *file_hdr_;
+    std::string run_prefix_;                // run文件名的前缀，第i个run文件名为run_prefix_ + ".run" + i
+    size_t entry_size_;                     // 一个键值对的长度，key在前，Rid在后
+    size_t max_entries_;                    // 内存中最多保存的键值对个数
+
+    std::vector<char> buf_;                 // 内存中的键值对
+    std::vector<size_t> order_;             // 内存中的键值对排序后的顺序
+    size_t num_entries_ = 0;                // 已经加入的键值对总数
+    size_t pos_ = 0;                        // 没有run文件时，order_中下一个要读出的位置
+
+    std::vector<std::string> run_names_;
+    std::vector<Run> runs_;
+    std::vector<int> heap_;                 // 按照当前键值对排序的run下标组成的小根堆
+    bool finished_ = false;
+
+   public:
+    IxExternalSorter(const IxFileHdr *file_hdr, std::string run_prefix, size_t mem_limit = IX_SORT_MEMORY);
+
+    ~IxExternalSorter();
+
+    void add(const char *key, const Rid &rid);
+
+    void finish();
+
+    bool next(char *key, Rid *rid);
+
+    size_t size() const { return num_entries_; }
+
+    size_t num_runs() const { return run_names_.size(); }
+
+   private:
+    int compare(const char *a, const char *b) const {
+        return ix_key_compare(a, b, file_hdr_->col_tot_len_);
+    }
+
+    void sort_buffer();
+
+    void spill();
+
+    bool read_entry(Run &run);
+
+    bool heap_less(int a, int b) const;
+};
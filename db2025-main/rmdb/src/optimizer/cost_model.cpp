@@ -0,0 +1,260 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "cost_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @description: 获取表的基数，表的数据文件已经打开时使用文件头中维护的记录数，否则使用ANALYZE收集的记录数
+ * @return {double} 表中的记录数，至少为1
+ * @param {string&} tab_name 表名
+ */
+double CostModel::get_table_rows(const std::string &tab_name) {
+    auto fh = sm_manager_->fhs_.find(tab_name);
+    if (fh != sm_manager_->fhs_.end()) {
+        return std::max(1.0, (double)fh->second->get_file_hdr().num_records);
+    }
+    auto stats = sm_manager_->stats_.find(tab_name);
+    if (stats != sm_manager_->stats_.end()) {
+        return std::max(1.0, (double)stats->second.num_rows);
+    }
+    return DEFAULT_TABLE_ROWS;
+}
+
+/**
+ * @description: 估算表的数据页面数，记录按照页面能存放的最大记录数紧密排列
+ * @return {double} 页面数，至少为1
+ * @param {string&} tab_name 表名
+ */
+double CostModel::get_table_pages(const std::string &tab_name) {
+    double records_per_page;
+    auto fh = sm_manager_->fhs_.find(tab_name);
+    if (fh != sm_manager_->fhs_.end()) {
+        records_per_page = fh->second->get_file_hdr().num_records_per_page;
+    } else {
+        auto &cols = sm_manager_->db_.get_table(tab_name).cols;
+        records_per_page = PAGE_SIZE / (cols.back().offset + cols.back().len);
+    }
+    return std::max(1.0, std::ceil(get_table_rows(tab_name) / std::max(1.0, records_per_page)));
+}
+
+/**
+ * @description: 获取字段的不同值个数
+ * @return {double} 不同值个数，没有统计信息时返回-1
+ * @param {TabCol&} col 字段
+ */
+double CostModel::get_col_ndv(const TabCol &col) {
+    auto stats = sm_manager_->stats_.find(col.tab_name);
+    if (stats == sm_manager_->stats_.end()) {
+        return -1;
+    }
+    auto col_stats = stats->second.cols.find(col.col_name);
+    if (col_stats == stats->second.cols.end() || col_stats->second.ndv == 0) {
+        return -1;
+    }
+    return col_stats->second.ndv;
+}
+
+/**
+ * @description: 估算条件的选择率
+ * 有ANALYZE收集的统计信息时，列与常量比较的条件使用直方图和高频值估算，不同表的列之间的等值条件估算为 1 / max(ndv(R.a), ndv(S.b))；
+ * 没有统计信息时，列与常量比较的条件使用默认选择率，不同表的列之间的等值条件按照主外键连接估算，即 1 / max(|R|, |S|)
+ * @return {double} 选择率，取值范围(0, 1]
+ * @param {Condition&} cond 条件
+ */
+double CostModel::get_selectivity(const Condition &cond) {
+    if (cond.is_rhs_val) {
+        auto stats = sm_manager_->stats_.find(cond.lhs_col.tab_name);
+        if (stats != sm_manager_->stats_.end()) {
+            double sel = stats->second.get_selectivity(cond);
+            if (sel >= 0) return sel;
+        }
+    }
+    switch (cond.op) {
+        case OP_EQ:
+            if (!cond.is_rhs_val && cond.lhs_col.tab_name != cond.rhs_col.tab_name) {
+                double lhs_ndv = get_col_ndv(cond.lhs_col), rhs_ndv = get_col_ndv(cond.rhs_col);
+                if (lhs_ndv > 0 && rhs_ndv > 0) {
+                    return 1.0 / std::max(lhs_ndv, rhs_ndv);
+                }
+                return 1.0 / std::max(get_table_rows(cond.lhs_col.tab_name), get_table_rows(cond.rhs_col.tab_name));
+            }
+            return DEFAULT_EQ_SEL;
+        case OP_NE:
+            return DEFAULT_NE_SEL;
+        default:
+            return DEFAULT_RANGE_SEL;
+    }
+}
+
+/**
+ * @description: 获取可以用于确定索引扫描范围的条件：索引字段最左前缀上的等值条件，以及紧随其后的一个字段上的范围条件
+ * @return {vector<Condition>} 可以利用索引的条件，为空表示该索引不能用于这些条件
+ * @param {string&} tab_name 表名
+ * @param {vector<Condition>&} conds 表上的条件
+ * @param {vector<string>&} index_col_names 索引字段
+ */
+std::vector<Condition> CostModel::get_index_conds(const std::string &tab_name, const std::vector<Condition> &conds,
+                                                  const std::vector<std::string> &index_col_names) {
+    std::vector<Condition> res;
+    for (auto &col_name : index_col_names) {
+        auto is_col_cond = [&](const Condition &cond) {
+            return cond.is_rhs_val && cond.lhs_col.tab_name == tab_name && cond.lhs_col.col_name == col_name;
+        };
+        auto eq = std::find_if(conds.begin(), conds.end(),
+                               [&](const Condition &cond) { return is_col_cond(cond) && cond.op == OP_EQ; });
+        if (eq != conds.end()) {
+            res.push_back(*eq);
+            continue;
+        }
+        for (auto &cond : conds) {
+            if (is_col_cond(cond) && cond.op != OP_EQ && cond.op != OP_NE) {
+                res.push_back(cond);
+            }
+        }
+        break;
+    }
+    return res;
+}
+
+/**
+ * @description: 估算索引条件的选择率，即索引扫描范围内的记录占全表的比例
+ */
+double CostModel::get_index_selectivity(const std::string &tab_name, const std::vector<Condition> &conds,
+                                        const std::vector<std::string> &index_col_names) {
+    double index_sel = 1;
+    for (auto &cond : get_index_conds(tab_name, conds, index_col_names)) {
+        index_sel *= get_selectivity(cond);
+    }
+    return index_sel;
+}
+
+/**
+ * @description: 判断表上由index_col_names组成的索引是否为哈希索引
+ */
+bool CostModel::is_hash_index(const std::string &tab_name, const std::vector<std::string> &index_col_names) {
+    TabMeta &tab = sm_manager_->db_.get_table(tab_name);
+    return tab.is_index(index_col_names) && tab.get_index_meta(index_col_names)->type == INDEX_HASH;
+}
+
+/**
+ * @description: 估算表扫描算子的输出行数和代价
+ * @param {string&} tab_name 表名
+ * @param {vector<Condition>&} conds 下推到表扫描算子的条件
+ * @param {vector<string>&} index_col_names 使用的索引字段，为空表示顺序扫描
+ * @param {bool} index_only 是否只读取索引，覆盖索引扫描不需要按照Rid回表读取记录
+ */
+PlanCost CostModel::scan_cost(const std::string &tab_name, const std::vector<Condition> &conds,
+                              const std::vector<std::string> &index_col_names, bool index_only) {
+    double table_rows = get_table_rows(tab_name);
+    double sel = 1, index_sel = get_index_selectivity(tab_name, conds, index_col_names);
+    for (auto &cond : conds) {
+        sel *= get_selectivity(cond);
+    }
+    PlanCost res;
+    res.rows = table_rows * sel;
+    if (index_col_names.empty()) {
+        // 顺序扫描需要读取全表并对每条记录检查所有条件
+        res.cost = table_rows * (1 + conds.size() * CPU_OPERATOR_COST);
+    } else {
+        // 索引扫描需要从根节点查找到叶子节点，然后按照Rid随机读取索引范围内的记录，覆盖索引扫描只需要顺序读取叶子结点；
+        // 哈希索引直接定位到桶
+        double index_rows = table_rows * index_sel;
+        double row_cost = index_only ? 1 : RANDOM_ACCESS_COST;
+        double probe_cost = is_hash_index(tab_name, index_col_names) ? HASH_PROBE_COST : std::log2(table_rows + 1);
+        res.cost = probe_cost + index_rows * (row_cost + conds.size() * CPU_OPERATOR_COST);
+    }
+    return res;
+}
+
+/**
+ * @description: 估算bitmap heap scan的输出行数和代价
+ * 每个索引需要从根节点查找到叶子结点并顺序读取范围内的索引项，各个索引的Rid集合取交集之后按照页面顺序回表，
+ * 每个页面只随机读取一次。k条记录均匀分布在P个页面中时，读取的页面数估算为 P * (1 - (1 - 1/P)^k)，
+ * 选择率较低时每个页面中只有一条记录，代价比普通的索引扫描更高；选择率较高时一个页面中的多条记录只需要读取一次
+ * @param {string&} tab_name 表名
+ * @param {vector<Condition>&} conds 下推到表扫描算子的条件
+ * @param {vector<vector<string>>&} indexes 使用的B+树索引的字段
+ */
+PlanCost CostModel::bitmap_scan_cost(const std::string &tab_name, const std::vector<Condition> &conds,
+                                     const std::vector<std::vector<std::string>> &indexes) {
+    double table_rows = get_table_rows(tab_name);
+    double table_pages = get_table_pages(tab_name);
+    double sel = 1, heap_sel = 1;
+    for (auto &cond : conds) {
+        sel *= get_selectivity(cond);
+    }
+    PlanCost res;
+    res.rows = table_rows * sel;
+    res.cost = 0;
+    for (auto &index_col_names : indexes) {
+        double index_sel = get_index_selectivity(tab_name, conds, index_col_names);
+        heap_sel *= index_sel;
+        res.cost += std::log2(table_rows + 1) + table_rows * index_sel;
+    }
+    double heap_rows = table_rows * heap_sel;
+    double heap_pages = table_pages * (1 - std::pow(1 - 1 / table_pages, heap_rows));
+    res.cost += heap_pages * RANDOM_ACCESS_COST + heap_rows * (1 + conds.size() * CPU_OPERATOR_COST);
+    return res;
+}
+
+/**
+ * @description: 估算连接算子的输出行数和代价
+ * nested loop join对于左儿子的每条记录都需要重新执行一遍右儿子；
+ * sort merge join需要对两个儿子的输出分别排序，然后归并
+ * @param {PlanTag} join_tag 连接算法，T_NestLoop或T_SortMerge
+ * @param {PlanCost&} left 左儿子的估算结果
+ * @param {PlanCost&} right 右儿子的估算结果
+ * @param {vector<Condition>&} conds 连接条件
+ */
+PlanCost CostModel::join_cost(PlanTag join_tag, const PlanCost &left, const PlanCost &right,
+                              const std::vector<Condition> &conds) {
+    double sel = 1;
+    for (auto &cond : conds) {
+        sel *= get_selectivity(cond);
+    }
+    PlanCost res;
+    res.rows = left.rows * right.rows * sel;
+    if (join_tag == T_SortMerge) {
+        auto sort_cost = [](double rows) { return rows * std::log2(rows + 1) * CPU_OPERATOR_COST; };
+        res.cost = left.cost + right.cost + sort_cost(left.rows) + sort_cost(right.rows) +
+                   (left.rows + right.rows + res.rows) * CPU_OPERATOR_COST;
+    } else {
+        res.cost = left.cost + left.rows * right.cost +
+                   left.rows * right.rows * std::max<size_t>(conds.size(), 1) * CPU_OPERATOR_COST;
+    }
+    return res;
+}
+
+/**
+ * @description: 递归估算查询计划的输出行数和代价
+ * @param {shared_ptr<Plan>&} plan 查询计划
+ */
+PlanCost CostModel::estimate(const std::shared_ptr<Plan> &plan) {
+    if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        if (x->tag == T_BitmapHeapScan) {
+            return bitmap_scan_cost(x->tab_name_, x->conds_, x->bitmap_indexes_);
+        }
+        return scan_cost(x->tab_name_, x->conds_, x->index_col_names_, x->tag == T_IndexOnlyScan);
+    } else if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        return join_cost(x->tag, estimate(x->left_), estimate(x->right_), x->conds_);
+    } else if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+        return estimate(x->subplan_);
+    } else if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        PlanCost res = estimate(x->subplan_);
+        res.cost += res.rows * std::log2(res.rows + 1) * CPU_OPERATOR_COST;
+        return res;
+    } else if (auto x = std::dynamic_pointer_cast<DMLPlan>(plan)) {
+        return estimate(x->subplan_);
+    }
+    return {0, 0};
+}
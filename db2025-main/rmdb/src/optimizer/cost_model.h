@@ -0,0 +1,77 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/common.h"
+#include "system/sm.h"
+#include "plan.h"
+
+/* 查询计划（或者计划中的一个子树）的估算结果 */
+struct PlanCost {
+    double rows;    // 输出的行数
+    double cost;    // 执行的代价
+};
+
+/**
+ * 代价模型，根据表的基数和条件的选择率估算计划的输出行数和代价。
+ * 代价的单位是读取一条记录的代价，比较一次条件的代价为CPU_OPERATOR_COST
+ */
+class CostModel {
+   public:
+    // 无法获取表的基数时使用的默认行数
+    static constexpr double DEFAULT_TABLE_ROWS = 1000;
+    // 没有统计信息时的默认选择率
+    static constexpr double DEFAULT_EQ_SEL = 0.1;
+    static constexpr double DEFAULT_RANGE_SEL = 1.0 / 3;
+    static constexpr double DEFAULT_NE_SEL = 1.0 - DEFAULT_EQ_SEL;
+    static constexpr double CPU_OPERATOR_COST = 0.01;
+    // 通过索引中的Rid随机读取一条记录的代价，顺序扫描时一个页面中的记录是连续读取的
+    static constexpr double RANDOM_ACCESS_COST = 4;
+    // 哈希索引查找只需要读取一个桶，与表的大小无关
+    static constexpr double HASH_PROBE_COST = 1;
+
+   private:
+    SmManager *sm_manager_;
+
+   public:
+    explicit CostModel(SmManager *sm_manager) : sm_manager_(sm_manager) {}
+
+    double get_table_rows(const std::string &tab_name);
+
+    double get_table_pages(const std::string &tab_name);
+
+    double get_col_ndv(const TabCol &col);
+
+    double get_selectivity(const Condition &cond);
+
+    static std::vector<Condition> get_index_conds(const std::string &tab_name, const std::vector<Condition> &conds,
+                                                  const std::vector<std::string> &index_col_names);
+
+    double get_index_selectivity(const std::string &tab_name, const std::vector<Condition> &conds,
+                                 const std::vector<std::string> &index_col_names);
+
+    bool is_hash_index(const std::string &tab_name, const std::vector<std::string> &index_col_names);
+
+    PlanCost scan_cost(const std::string &tab_name, const std::vector<Condition> &conds,
+                       const std::vector<std::string> &index_col_names, bool index_only = false);
+
+    PlanCost bitmap_scan_cost(const std::string &tab_name, const std::vector<Condition> &conds,
+                              const std::vector<std::vector<std::string>> &indexes);
+
+    PlanCost join_cost(PlanTag join_tag, const PlanCost &left, const PlanCost &right,
+                       const std::vector<Condition> &conds);
+
+    PlanCost estimate(const std::shared_ptr<Plan> &plan);
+};
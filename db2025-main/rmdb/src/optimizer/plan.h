@@ -24,6 +24,7 @@ typedef enum PlanTag{
     T_Help,
     T_ShowTable,
     T_DescTable,
+    T_Analyze,
     T_CreateTable,
     T_DropTable,
     T_CreateIndex,
@@ -39,6 +40,9 @@ typedef enum PlanTag{
     T_Transaction_rollback,
     T_SeqScan,
     T_IndexScan,
+    T_IndexOnlyScan,    // 只读取索引的覆盖索引扫描
+    T_HashScan,         // 哈希索引上的等值查找
+    T_BitmapHeapScan,   // 收集一个或多个索引中的Rid之后按照页面顺序回表
     T_NestLoop,
     T_SortMerge,    // sort merge join
     T_Sort,
@@ -76,6 +80,7 @@ class ScanPlan : public Plan
         size_t len_;                               
         std::vector<Condition> fed_conds_;
         std::vector<std::string> index_col_names_;
+        std::vector<std::vector<std::string>> bitmap_indexes_;  // T_BitmapHeapScan使用的所有索引，第一个与index_col_names_相同
     
 };
 
@@ -171,6 +176,8 @@ class DDLPlan : public Plan
         std::string tab_name_;
         std::vector<std::string> tab_col_names_;
         std::vector<ColDef> cols_;
+        IndexType index_type_ = INDEX_BTREE;    // create index创建的索引类型
+        bool bloom_ = false;                    // create index是否在B+树索引上维护Bloom filter
 };
 
 // help; show tables; desc tables; begin; abort; commit; rollback语句对应的plan
@@ -10,7 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #include "planner.h"
 
+#include <functional>
 #include <memory>
+#include <set>
 
 #include "execution/executor_delete.h"
 #include "execution/executor_index_scan.h"
@@ -22,16 +24,111 @@ See the Mulan PSL v2 for more details. */
 #include "index/ix.h"
 #include "record_printer.h"
 
-// 目前的索引匹配规则为：完全匹配索引字段，且全部为单点查询，不会自动调整where条件的顺序
-bool Planner::get_index_cols(std::string tab_name, std::vector<Condition> curr_conds, std::vector<std::string>& index_col_names) {
+/**
+ * @brief 选择表的访问路径
+ * 索引可以用于字段最左前缀上的等值条件以及紧随其后的一个字段上的范围条件（与where条件的顺序无关），
+ * 哈希索引只能用于所有索引字段上都有等值条件的查找；
+ * 对每个可用的索引估算索引扫描的代价，与顺序扫描的代价比较，选择代价最小的访问路径。
+ * 需要时还考虑bitmap heap scan：按照索引条件的选择率从小到大依次加入B+树索引，Rid集合取交集，加入之后代价降低才保留
+ *
+ * @param tab_name 表名
+ * @param curr_conds 表上的条件
+ * @param index_col_names 传出参数，选择索引扫描时为所选索引的全部字段
+ * @param sel_cols 上层需要的列，为nullptr表示需要读取完整的记录
+ * @param index_only 传出参数，所选索引是否包含上层需要的列和所有条件中的列，此时可以只读取索引而不需要回表
+ * @param bitmap_indexes 传出参数，为nullptr时不考虑bitmap heap scan；选择bitmap heap scan时为使用的所有索引，否则为空
+ * @return 是否使用索引扫描
+ */
+bool Planner::get_index_cols(std::string tab_name, std::vector<Condition> curr_conds, std::vector<std::string>& index_col_names,
+                             const std::vector<TabCol> *sel_cols, bool *index_only,
+                             std::vector<std::vector<std::string>> *bitmap_indexes) {
     index_col_names.clear();
-    for(auto& cond: curr_conds) {
-        if(cond.is_rhs_val && cond.op == OP_EQ && cond.lhs_col.tab_name.compare(tab_name) == 0)
-            index_col_names.push_back(cond.lhs_col.col_name);
-    }
     TabMeta& tab = sm_manager_->db_.get_table(tab_name);
-    if(tab.is_index(index_col_names)) return true;
-    return false;
+    std::set<std::string> needed;
+    if (sel_cols != nullptr) {
+        for (auto &col : *sel_cols) {
+            needed.insert(col.col_name);
+        }
+        for (auto &cond : curr_conds) {
+            needed.insert(cond.lhs_col.col_name);
+            if (!cond.is_rhs_val) needed.insert(cond.rhs_col.col_name);
+        }
+    }
+    double best_cost = cost_model_.scan_cost(tab_name, curr_conds, {}).cost;
+    bool best_index_only = false;
+    for (auto &index : tab.indexes) {
+        std::vector<std::string> cols;
+        for (auto &col : index.cols) {
+            cols.push_back(col.name);
+        }
+        auto index_conds = CostModel::get_index_conds(tab_name, curr_conds, cols);
+        if (index_conds.empty()) {
+            continue;
+        }
+        if (index.type == INDEX_HASH &&
+            (index_conds.size() != cols.size() ||
+             std::any_of(index_conds.begin(), index_conds.end(), [](const Condition &cond) { return cond.op != OP_EQ; }))) {
+            continue;
+        }
+        // 哈希索引的桶中保存的是规范化的key，不用于覆盖索引扫描
+        bool covering = sel_cols != nullptr && index.type == INDEX_BTREE &&
+                        std::all_of(needed.begin(), needed.end(), [&](const std::string &name) {
+                            return std::find(cols.begin(), cols.end(), name) != cols.end();
+                        });
+        double cost = cost_model_.scan_cost(tab_name, curr_conds, cols, covering).cost;
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_index_only = covering;
+            index_col_names = std::move(cols);
+        }
+    }
+    if (bitmap_indexes != nullptr) {
+        bitmap_indexes->clear();
+        std::vector<std::pair<double, std::vector<std::string>>> candidates;
+        for (auto &index : tab.indexes) {
+            std::vector<std::string> cols;
+            for (auto &col : index.cols) {
+                cols.push_back(col.name);
+            }
+            if (index.type == INDEX_BTREE && !CostModel::get_index_conds(tab_name, curr_conds, cols).empty()) {
+                candidates.emplace_back(cost_model_.get_index_selectivity(tab_name, curr_conds, cols), std::move(cols));
+            }
+        }
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const auto &a, const auto &b) { return a.first < b.first; });
+        std::vector<std::vector<std::string>> chosen;
+        double bitmap_cost = 0;
+        for (auto &candidate : candidates) {
+            chosen.push_back(candidate.second);
+            double cost = cost_model_.bitmap_scan_cost(tab_name, curr_conds, chosen).cost;
+            if (chosen.size() == 1 || cost < bitmap_cost) {
+                bitmap_cost = cost;
+            } else {
+                chosen.pop_back();
+            }
+        }
+        if (!chosen.empty() && bitmap_cost < best_cost) {
+            best_index_only = false;
+            index_col_names = chosen[0];
+            *bitmap_indexes = std::move(chosen);
+        }
+    }
+    if (index_only != nullptr) {
+        *index_only = best_index_only;
+    }
+    return !index_col_names.empty();
+}
+
+/**
+ * @brief 使用索引时表扫描算子的类型：哈希索引为T_HashScan，B+树为T_IndexScan或者覆盖索引扫描T_IndexOnlyScan
+ */
+PlanTag Planner::get_index_scan_tag(const std::string &tab_name, const std::vector<std::string> &index_col_names,
+                                    bool index_only) {
+    TabMeta &tab = sm_manager_->db_.get_table(tab_name);
+    if (tab.get_index_meta(index_col_names)->type == INDEX_HASH) {
+        return T_HashScan;
+    }
+    return index_only ? T_IndexOnlyScan : T_IndexScan;
 }
 
 /**
@@ -42,13 +139,12 @@ bool Planner::get_index_cols(std::string tab_name, std::vector<Condition> curr_c
  * @return std::vector<Condition>
  */
 std::vector<Condition> pop_conds(std::vector<Condition> &conds, std::string tab_names) {
-    // auto has_tab = [&](const std::string &tab_name) {
-    //     return std::find(tab_names.begin(), tab_names.end(), tab_name) != tab_names.end();
-    // };
     std::vector<Condition> solved_conds;
     auto it = conds.begin();
     while (it != conds.end()) {
-        if ((tab_names.compare(it->lhs_col.tab_name) == 0 && it->is_rhs_val) || (it->lhs_col.tab_name.compare(it->rhs_col.tab_name) == 0)) {
+        // 只有左侧列属于该表，且右侧为常量或同一张表的列时，才能下推到该表的扫描算子
+        if (tab_names.compare(it->lhs_col.tab_name) == 0 &&
+            (it->is_rhs_val || it->lhs_col.tab_name.compare(it->rhs_col.tab_name) == 0)) {
             solved_conds.emplace_back(std::move(*it));
             it = conds.erase(it);
         } else {
@@ -58,69 +154,171 @@ std::vector<Condition> pop_conds(std::vector<Condition> &conds, std::string tab_
     return solved_conds;
 }
 
-int push_conds(Condition *cond, std::shared_ptr<Plan> plan)
-{
-    if(auto x = std::dynamic_pointer_cast<ScanPlan>(plan))
-    {
-        if(x->tab_name_.compare(cond->lhs_col.tab_name) == 0) {
-            return 1;
-        } else if(x->tab_name_.compare(cond->rhs_col.tab_name) == 0){
-            return 2;
-        } else {
-            return 0;
-        }
+/**
+ * @brief 判断两个常量值是否相同
+ */
+static bool same_value(const Value &lhs, const Value &rhs) {
+    if (lhs.type != rhs.type) return false;
+    switch (lhs.type) {
+        case TYPE_INT:
+            return lhs.int_val == rhs.int_val;
+        case TYPE_FLOAT:
+            return lhs.float_val == rhs.float_val;
+        default:
+            return lhs.str_val == rhs.str_val;
     }
-    else if(auto x = std::dynamic_pointer_cast<JoinPlan>(plan))
-    {
-        int left_res = push_conds(cond, x->left_);
-        // 条件已经下推到左子节点
-        if(left_res == 3){
-            return 3;
+}
+
+/**
+ * @brief 推导隐含条件：根据列之间的等值条件把列划分为等价类，
+ * 同一等价类中某一列上的常量条件对其他列同样成立，同一等价类中的任意两列也两两相等。
+ * 例如 a.x = b.y and b.y = 5 可以推导出 a.x = 5，推导出的单表条件可以继续下推到表扫描算子。
+ *
+ * @param conds where条件，推导出的新条件直接追加在后面
+ */
+void Planner::derive_implied_conds(std::vector<Condition> &conds) {
+    std::map<TabCol, TabCol> parent;
+    std::function<TabCol(const TabCol &)> find = [&](const TabCol &col) -> TabCol {
+        auto it = parent.find(col);
+        if (it == parent.end()) {
+            parent.emplace(col, col);
+            return col;
+        }
+        if (it->second.tab_name == col.tab_name && it->second.col_name == col.col_name) {
+            return col;
+        }
+        TabCol root = find(it->second);
+        parent[col] = root;
+        return root;
+    };
+    auto same_col = [](const TabCol &x, const TabCol &y) {
+        return x.tab_name == y.tab_name && x.col_name == y.col_name;
+    };
+    for (auto &cond : conds) {
+        if (!cond.is_rhs_val && cond.op == OP_EQ) {
+            TabCol lroot = find(cond.lhs_col), rroot = find(cond.rhs_col);
+            if (!same_col(lroot, rroot)) parent[lroot] = rroot;
         }
-        int right_res = push_conds(cond, x->right_);
-        // 条件已经下推到右子节点
-        if(right_res == 3){
-            return 3;
+    }
+    if (parent.empty()) return;
+
+    // 收集等价类
+    std::map<TabCol, std::vector<TabCol>> classes;
+    for (auto &entry : parent) {
+        classes[find(entry.first)].push_back(entry.first);
+    }
+    auto has_cond = [&](const Condition &target) {
+        for (auto &cond : conds) {
+            if (cond.op != target.op || cond.is_rhs_val != target.is_rhs_val) continue;
+            if (target.is_rhs_val) {
+                if (same_col(cond.lhs_col, target.lhs_col) && same_value(cond.rhs_val, target.rhs_val)) return true;
+            } else if ((same_col(cond.lhs_col, target.lhs_col) && same_col(cond.rhs_col, target.rhs_col)) ||
+                       (same_col(cond.lhs_col, target.rhs_col) && same_col(cond.rhs_col, target.lhs_col))) {
+                return true;
+            }
         }
-        // 左子节点或右子节点有一个没有匹配到条件的列
-        if(left_res == 0 || right_res == 0) {
-            return left_res + right_res;
+        return false;
+    };
+
+    std::vector<Condition> implied_conds;
+    // 等价类中的列两两相等
+    for (auto &entry : classes) {
+        auto &members = entry.second;
+        for (size_t i = 0; i < members.size(); i++) {
+            for (size_t j = i + 1; j < members.size(); j++) {
+                Condition cond;
+                cond.lhs_col = members[i];
+                cond.op = OP_EQ;
+                cond.is_rhs_val = false;
+                cond.rhs_col = members[j];
+                if (!has_cond(cond)) implied_conds.push_back(std::move(cond));
+            }
         }
-        // 左子节点匹配到条件的右边
-        if(left_res == 2) {
-            // 需要将左右两边的条件变换位置
-            std::map<CompOp, CompOp> swap_op = {
-                {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
-            };
-            std::swap(cond->lhs_col, cond->rhs_col);
-            cond->op = swap_op.at(cond->op);
+    }
+    // 常量条件在等价类中传播
+    size_t num_conds = conds.size();
+    for (size_t i = 0; i < num_conds; i++) {
+        if (!conds[i].is_rhs_val || parent.count(conds[i].lhs_col) == 0) continue;
+        // conds在循环中会扩容，这里需要拷贝一份
+        Condition origin = conds[i];
+        auto origin_col = sm_manager_->db_.get_table(origin.lhs_col.tab_name).get_col(origin.lhs_col.col_name);
+        for (auto &member : classes[find(origin.lhs_col)]) {
+            if (same_col(member, origin.lhs_col)) continue;
+            // 只在类型和长度都相同的列之间传播，否则常量按照目标列的长度生成raw可能溢出或被截断
+            auto member_col = sm_manager_->db_.get_table(member.tab_name).get_col(member.col_name);
+            if (member_col->type != origin_col->type || member_col->len != origin_col->len) continue;
+            Condition cond;
+            cond.lhs_col = member;
+            cond.op = origin.op;
+            cond.is_rhs_val = true;
+            cond.rhs_val = origin.rhs_val;
+            if (has_cond(cond)) continue;
+            cond.rhs_val.raw = nullptr;
+            cond.rhs_val.init_raw(member_col->len);
+            conds.push_back(std::move(cond));
         }
-        x->conds_.emplace_back(std::move(*cond));
-        return 3;
     }
-    return false;
+    for (auto &cond : implied_conds) {
+        conds.push_back(std::move(cond));
+    }
 }
 
-std::shared_ptr<Plan> pop_scan(int *scantbl, std::string table, std::vector<std::string> &joined_tables, 
-                std::vector<std::shared_ptr<Plan>> plans)
-{
-    for (size_t i = 0; i < plans.size(); i++) {
-        auto x = std::dynamic_pointer_cast<ScanPlan>(plans[i]);
-        if(x->tab_name_.compare(table) == 0)
-        {
-            scantbl[i] = 1;
-            joined_tables.emplace_back(x->tab_name_);
-            return plans[i];
+/**
+ * @brief 投影下推：计算每个表需要向上层输出的列，包括select列表、连接条件和order by中用到的列
+ *
+ * @param query 查询，结果写入query->tab_cols，输出全部列的表不会写入；
+ * 单表查询的结果只用于判断能否使用覆盖索引，投影仍由最上层的ProjectionPlan完成
+ */
+void Planner::prune_cols(std::shared_ptr<Query> query) {
+    auto x = std::dynamic_pointer_cast<ast::SelectStmt>(query->parse);
+    std::map<std::string, std::set<std::string>> needed;
+    for (auto &col : query->cols) {
+        needed[col.tab_name].insert(col.col_name);
+    }
+    for (auto &cond : query->conds) {
+        needed[cond.lhs_col.tab_name].insert(cond.lhs_col.col_name);
+        if (!cond.is_rhs_val) needed[cond.rhs_col.tab_name].insert(cond.rhs_col.col_name);
+    }
+    if (x != nullptr && x->has_sort) {
+        for (auto &tab_name : query->tables) {
+            if (!x->order->cols->tab_name.empty() && x->order->cols->tab_name != tab_name) continue;
+            for (auto &col : sm_manager_->db_.get_table(tab_name).cols) {
+                if (col.name == x->order->cols->col_name) needed[tab_name].insert(col.name);
+            }
         }
     }
-    return nullptr;
+    for (auto &tab_name : query->tables) {
+        auto &tab_cols = sm_manager_->db_.get_table(tab_name).cols;
+        auto &names = needed[tab_name];
+        if (names.size() == tab_cols.size()) continue;
+        std::vector<TabCol> sel_cols;
+        if (names.empty()) {
+            // 该表只参与笛卡尔积，保留最短的一列即可
+            auto shortest = std::min_element(tab_cols.begin(), tab_cols.end(),
+                                             [](const ColMeta &a, const ColMeta &b) { return a.len < b.len; });
+            sel_cols.push_back({.tab_name = tab_name, .col_name = shortest->name});
+        } else {
+            // 按照表中列的顺序输出
+            for (auto &col : tab_cols) {
+                if (names.count(col.name)) sel_cols.push_back({.tab_name = tab_name, .col_name = col.name});
+            }
+        }
+        if (sel_cols.size() < tab_cols.size()) query->tab_cols[tab_name] = std::move(sel_cols);
+    }
 }
 
-
 std::shared_ptr<Query> Planner::logical_optimization(std::shared_ptr<Query> query, Context *context)
 {
-    
-    //TODO 实现逻辑优化规则
+    // 1. 根据等值条件推导隐含条件
+    derive_implied_conds(query->conds);
+
+    // 2. 谓词下推：单表条件下推到表扫描算子，query->conds中只剩下连接条件
+    for (auto &tab_name : query->tables) {
+        query->tab_conds[tab_name] = pop_conds(query->conds, tab_name);
+    }
+
+    // 3. 投影下推：计算每个表需要输出的列
+    prune_cols(query);
 
     return query;
 }
@@ -139,24 +337,85 @@ std::shared_ptr<Plan> Planner::physical_optimization(std::shared_ptr<Query> quer
 
 
 
+/**
+ * @brief 为两个关系的连接选择代价最小的连接算法
+ *
+ * @param left 左儿子的估算结果
+ * @param right 右儿子的估算结果
+ * @param conds 连接条件，左侧列已经属于左儿子
+ * @param join_tag 选出的连接算法
+ * @return PlanCost 选出的连接算法的估算结果
+ */
+PlanCost Planner::choose_join_method(const PlanCost &left, const PlanCost &right, const std::vector<Condition> &conds,
+                                     PlanTag &join_tag) {
+    if (!enable_nestedloop_join && !enable_sortmerge_join) {
+        throw RMDBError("No join executor selected!");
+    }
+    bool has_eq_cond = std::any_of(conds.begin(), conds.end(), [](const Condition &cond) { return cond.op == OP_EQ; });
+    // sort merge join只能处理等值连接，没有等值连接条件时只能使用nested loop join
+    if (!enable_sortmerge_join || !has_eq_cond) {
+        join_tag = T_NestLoop;
+        return cost_model_.join_cost(T_NestLoop, left, right, conds);
+    }
+    PlanCost sortmerge = cost_model_.join_cost(T_SortMerge, left, right, conds);
+    if (enable_nestedloop_join) {
+        PlanCost nestloop = cost_model_.join_cost(T_NestLoop, left, right, conds);
+        if (nestloop.cost <= sortmerge.cost) {
+            join_tag = T_NestLoop;
+            return nestloop;
+        }
+    }
+    join_tag = T_SortMerge;
+    return sortmerge;
+}
+
+/**
+ * @brief 生成所有表的连接计划。
+ * 表的数量不超过DP_JOIN_THRESHOLD时，按照关系包含的表的个数自底向上动态规划（DPsize），
+ * 优先只连接存在连接条件的两个关系，找不到时才使用笛卡尔积；表的数量更多时使用贪心算法，
+ * 每次选择代价最小的两个关系进行连接
+ */
 std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query)
 {
     auto x = std::dynamic_pointer_cast<ast::SelectStmt>(query->parse);
     std::vector<std::string> tables = query->tables;
     // // Scan table , 生成表算子列表tab_nodes
     std::vector<std::shared_ptr<Plan>> table_scan_executors(tables.size());
+    std::vector<PlanCost> table_scan_costs(tables.size());
     for (size_t i = 0; i < tables.size(); i++) {
-        auto curr_conds = pop_conds(query->conds, tables[i]);
+        auto curr_conds = std::move(query->tab_conds[tables[i]]);
         // int index_no = get_indexNo(tables[i], curr_conds);
         std::vector<std::string> index_col_names;
-        bool index_exist = get_index_cols(tables[i], curr_conds, index_col_names);
+        // 上层需要的列，query->tab_cols中没有记录时需要输出表的全部列
+        auto tab_cols = query->tab_cols.find(tables[i]);
+        std::vector<TabCol> sel_cols;
+        if (tab_cols != query->tab_cols.end()) {
+            sel_cols = tab_cols->second;
+        } else {
+            for (auto &col : sm_manager_->db_.get_table(tables[i]).cols) {
+                sel_cols.push_back({.tab_name = tables[i], .col_name = col.name});
+            }
+        }
+        bool index_only = false;
+        std::vector<std::vector<std::string>> bitmap_indexes;
+        bool index_exist = get_index_cols(tables[i], curr_conds, index_col_names, &sel_cols, &index_only, &bitmap_indexes);
         if (index_exist == false) {  // 该表没有索引
             index_col_names.clear();
             table_scan_executors[i] = 
                 std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, tables[i], curr_conds, index_col_names);
+        } else if (!bitmap_indexes.empty()) {  // 收集索引中的Rid之后按照页面顺序回表
+            auto scan = std::make_shared<ScanPlan>(T_BitmapHeapScan, sm_manager_, tables[i], curr_conds, index_col_names);
+            scan->bitmap_indexes_ = std::move(bitmap_indexes);
+            table_scan_executors[i] = std::move(scan);
         } else {  // 存在索引
+            table_scan_executors[i] = std::make_shared<ScanPlan>(get_index_scan_tag(tables[i], index_col_names, index_only),
+                                                                 sm_manager_, tables[i], curr_conds, index_col_names);
+        }
+        table_scan_costs[i] = cost_model_.estimate(table_scan_executors[i]);
+        // 投影下推，在表扫描算子上只保留上层需要的列
+        if (tables.size() > 1 && tab_cols != query->tab_cols.end()) {
             table_scan_executors[i] =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, tables[i], curr_conds, index_col_names);
+                std::make_shared<ProjectionPlan>(T_Projection, std::move(table_scan_executors[i]), tab_cols->second);
         }
     }
     // 只有一个表，不需要join。
@@ -164,101 +423,107 @@ std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query)
     {
         return table_scan_executors[0];
     }
-    // 获取where条件
-    auto conds = std::move(query->conds);
-    std::shared_ptr<Plan> table_join_executors;
-    
-    int scantbl[tables.size()];
-    for(size_t i = 0; i < tables.size(); i++)
-    {
-        scantbl[i] = -1;
+
+    // 逻辑优化之后，query->conds中只剩下两张不同表之间的连接条件，记录每个条件涉及的两张表
+    std::map<std::string, size_t> tab_idx;
+    for (size_t i = 0; i < tables.size(); i++) {
+        tab_idx[tables[i]] = i;
     }
-    // 假设在ast中已经添加了jointree，这里需要修改的逻辑是，先处理jointree，然后再考虑剩下的部分
-    if(conds.size() >= 1)
-    {
-        // 有连接条件
-
-        // 根据连接条件，生成第一层join
-        std::vector<std::string> joined_tables(tables.size());
-        auto it = conds.begin();
-        while (it != conds.end()) {
-            std::shared_ptr<Plan> left , right;
-            left = pop_scan(scantbl, it->lhs_col.tab_name, joined_tables, table_scan_executors);
-            right = pop_scan(scantbl, it->rhs_col.tab_name, joined_tables, table_scan_executors);
-            std::vector<Condition> join_conds{*it};
-            //建立join
-            // 判断使用哪种join方式
-            if(enable_nestedloop_join && enable_sortmerge_join) {
-                // 默认nested loop join
-                table_join_executors = std::make_shared<JoinPlan>(T_NestLoop, std::move(left), std::move(right), join_conds);
-            } else if(enable_nestedloop_join) {
-                table_join_executors = std::make_shared<JoinPlan>(T_NestLoop, std::move(left), std::move(right), join_conds);
-            } else if(enable_sortmerge_join) {
-                table_join_executors = std::make_shared<JoinPlan>(T_SortMerge, std::move(left), std::move(right), join_conds);
-            } else {
-                // error
-                throw RMDBError("No join executor selected!");
+    std::vector<std::pair<uint64_t, uint64_t>> cond_tabs;
+    for (auto &cond : query->conds) {
+        cond_tabs.emplace_back(1ULL << tab_idx.at(cond.lhs_col.tab_name), 1ULL << tab_idx.at(cond.rhs_col.tab_name));
+    }
+    // 收集连接left和right两个关系的条件，并把条件的左侧列调整到左儿子
+    auto get_join_conds = [&](uint64_t left, uint64_t right) {
+        std::vector<Condition> join_conds;
+        for (size_t i = 0; i < query->conds.size(); i++) {
+            auto cond = query->conds[i];
+            if ((cond_tabs[i].first & right) && (cond_tabs[i].second & left)) {
+                std::map<CompOp, CompOp> swap_op = {
+                    {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
+                };
+                std::swap(cond.lhs_col, cond.rhs_col);
+                cond.op = swap_op.at(cond.op);
+            } else if (!((cond_tabs[i].first & left) && (cond_tabs[i].second & right))) {
+                continue;
             }
-
-            // table_join_executors = std::make_shared<JoinPlan>(T_NestLoop, std::move(left), std::move(right), join_conds);
-            it = conds.erase(it);
-            break;
+            join_conds.push_back(std::move(cond));
         }
-        // 根据连接条件，生成第2-n层join
-        it = conds.begin();
-        while (it != conds.end()) {
-            std::shared_ptr<Plan> left_need_to_join_executors = nullptr;
-            std::shared_ptr<Plan> right_need_to_join_executors = nullptr;
-            bool isneedreverse = false;
-            if (std::find(joined_tables.begin(), joined_tables.end(), it->lhs_col.tab_name) == joined_tables.end()) {
-                left_need_to_join_executors = pop_scan(scantbl, it->lhs_col.tab_name, joined_tables, table_scan_executors);
-            }
-            if (std::find(joined_tables.begin(), joined_tables.end(), it->rhs_col.tab_name) == joined_tables.end()) {
-                right_need_to_join_executors = pop_scan(scantbl, it->rhs_col.tab_name, joined_tables, table_scan_executors);
-                isneedreverse = true;
-            } 
-
-            if(left_need_to_join_executors != nullptr && right_need_to_join_executors != nullptr) {
-                std::vector<Condition> join_conds{*it};
-                std::shared_ptr<Plan> temp_join_executors = std::make_shared<JoinPlan>(T_NestLoop, 
-                                                                    std::move(left_need_to_join_executors), 
-                                                                    std::move(right_need_to_join_executors), 
-                                                                    join_conds);
-                table_join_executors = std::make_shared<JoinPlan>(T_NestLoop, std::move(temp_join_executors), 
-                                                                    std::move(table_join_executors), 
-                                                                    std::vector<Condition>());
-            } else if(left_need_to_join_executors != nullptr || right_need_to_join_executors != nullptr) {
-                if(isneedreverse) {
-                    std::map<CompOp, CompOp> swap_op = {
-                        {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
-                    };
-                    std::swap(it->lhs_col, it->rhs_col);
-                    it->op = swap_op.at(it->op);
-                    left_need_to_join_executors = std::move(right_need_to_join_executors);
+        return join_conds;
+    };
+
+    // 一个关系（一张表或若干张表的连接结果）的最优计划
+    struct JoinRel {
+        std::shared_ptr<Plan> plan;
+        PlanCost cost;
+    };
+    auto make_join_rel = [&](const JoinRel &left, uint64_t left_tabs, const JoinRel &right, uint64_t right_tabs) {
+        auto join_conds = get_join_conds(left_tabs, right_tabs);
+        PlanTag join_tag;
+        PlanCost cost = choose_join_method(left.cost, right.cost, join_conds, join_tag);
+        return JoinRel{std::make_shared<JoinPlan>(join_tag, left.plan, right.plan, std::move(join_conds)), cost};
+    };
+
+    if (tables.size() <= DP_JOIN_THRESHOLD) {
+        // best[s]为表的集合s的最优连接计划，集合用二进制位表示
+        size_t num_sets = 1ULL << tables.size();
+        std::vector<JoinRel> best(num_sets);
+        for (size_t i = 0; i < tables.size(); i++) {
+            best[1ULL << i] = {table_scan_executors[i], table_scan_costs[i]};
+        }
+        for (size_t size = 2; size <= tables.size(); size++) {
+            for (uint64_t set = 1; set < num_sets; set++) {
+                if ((size_t)__builtin_popcountll(set) != size) continue;
+                // 第一轮只考虑存在连接条件的划分，找不到时第二轮允许笛卡尔积
+                for (int round = 0; round < 2 && best[set].plan == nullptr; round++) {
+                    for (uint64_t left = (set - 1) & set; left > 0; left = (left - 1) & set) {
+                        uint64_t right = set ^ left;
+                        if (best[left].plan == nullptr || best[right].plan == nullptr) continue;
+                        auto join_conds = get_join_conds(left, right);
+                        if (round == 0 && join_conds.empty()) continue;
+                        PlanTag join_tag;
+                        PlanCost cost = choose_join_method(best[left].cost, best[right].cost, join_conds, join_tag);
+                        if (best[set].plan == nullptr || cost.cost < best[set].cost.cost) {
+                            best[set] = {std::make_shared<JoinPlan>(join_tag, best[left].plan, best[right].plan,
+                                                                    std::move(join_conds)),
+                                         cost};
+                        }
+                    }
                 }
-                std::vector<Condition> join_conds{*it};
-                table_join_executors = std::make_shared<JoinPlan>(T_NestLoop, std::move(left_need_to_join_executors), 
-                                                                    std::move(table_join_executors), join_conds);
-            } else {
-                push_conds(std::move(&(*it)), table_join_executors);
             }
-            it = conds.erase(it);
         }
-    } else {
-        table_join_executors = table_scan_executors[0];
-        scantbl[0] = 1;
+        return best[num_sets - 1].plan;
     }
 
-    //连接剩余表
+    // 贪心：每次选择连接后代价最小的两个关系，优先选择存在连接条件的两个关系
+    std::vector<std::pair<uint64_t, JoinRel>> rels;
     for (size_t i = 0; i < tables.size(); i++) {
-        if(scantbl[i] == -1) {
-            table_join_executors = std::make_shared<JoinPlan>(T_NestLoop, std::move(table_scan_executors[i]), 
-                                                    std::move(table_join_executors), std::vector<Condition>());
+        rels.push_back({1ULL << i, {table_scan_executors[i], table_scan_costs[i]}});
+    }
+    while (rels.size() > 1) {
+        JoinRel best_rel;
+        size_t best_left = 0, best_right = 0;
+        bool best_connected = false;
+        for (size_t i = 0; i < rels.size(); i++) {
+            for (size_t j = 0; j < rels.size(); j++) {
+                if (i == j) continue;
+                bool connected = !get_join_conds(rels[i].first, rels[j].first).empty();
+                if (best_connected && !connected) continue;
+                JoinRel rel = make_join_rel(rels[i].second, rels[i].first, rels[j].second, rels[j].first);
+                if (best_rel.plan == nullptr || (connected && !best_connected) || rel.cost.cost < best_rel.cost.cost) {
+                    best_rel = std::move(rel);
+                    best_left = i;
+                    best_right = j;
+                    best_connected = connected;
+                }
+            }
         }
+        uint64_t tabs = rels[best_left].first | rels[best_right].first;
+        rels.erase(rels.begin() + std::max(best_left, best_right));
+        rels.erase(rels.begin() + std::min(best_left, best_right));
+        rels.push_back({tabs, std::move(best_rel)});
     }
-
-    return table_join_executors;
-
+    return rels[0].second.plan;
 }
 
 
@@ -328,7 +593,10 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
         plannerRoot = std::make_shared<DDLPlan>(T_DropTable, x->tab_name, std::vector<std::string>(), std::vector<ColDef>());
     } else if (auto x = std::dynamic_pointer_cast<ast::CreateIndex>(query->parse)) {
         // create index;
-        plannerRoot = std::make_shared<DDLPlan>(T_CreateIndex, x->tab_name, x->col_names, std::vector<ColDef>());
+        auto ddl = std::make_shared<DDLPlan>(T_CreateIndex, x->tab_name, x->col_names, std::vector<ColDef>());
+        ddl->index_type_ = x->using_hash ? INDEX_HASH : INDEX_BTREE;
+        ddl->bloom_ = x->with_bloom;
+        plannerRoot = ddl;
     } else if (auto x = std::dynamic_pointer_cast<ast::DropIndex>(query->parse)) {
         // drop index
         plannerRoot = std::make_shared<DDLPlan>(T_DropIndex, x->tab_name, x->col_names, std::vector<ColDef>());
@@ -350,8 +618,8 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
             table_scan_executors = 
                 std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, x->tab_name, query->conds, index_col_names);
         } else {  // 存在索引
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, x->tab_name, query->conds, index_col_names);
+            table_scan_executors = std::make_shared<ScanPlan>(get_index_scan_tag(x->tab_name, index_col_names),
+                                                              sm_manager_, x->tab_name, query->conds, index_col_names);
         }
 
         plannerRoot = std::make_shared<DMLPlan>(T_Delete, table_scan_executors, x->tab_name,  
@@ -370,8 +638,8 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
             table_scan_executors = 
                 std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, x->tab_name, query->conds, index_col_names);
         } else {  // 存在索引
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, x->tab_name, query->conds, index_col_names);
+            table_scan_executors = std::make_shared<ScanPlan>(get_index_scan_tag(x->tab_name, index_col_names),
+                                                              sm_manager_, x->tab_name, query->conds, index_col_names);
         }
         plannerRoot = std::make_shared<DMLPlan>(T_Update, table_scan_executors, x->tab_name,
                                                      std::vector<Value>(), query->conds, 
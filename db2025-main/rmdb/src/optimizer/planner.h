@@ -21,20 +21,26 @@ See the Mulan PSL v2 for more details. */
 #include "record/rm.h"
 #include "system/sm.h"
 #include "common/context.h"
+#include "cost_model.h"
 #include "plan.h"
 #include "parser/parser.h"
 #include "common/common.h"
 #include "analyze/analyze.h"
 
 class Planner {
+   public:
+    // 参与连接的表的个数超过该值时，不再使用动态规划枚举连接顺序，而是使用贪心算法
+    static constexpr size_t DP_JOIN_THRESHOLD = 10;
+
    private:
     SmManager *sm_manager_;
+    CostModel cost_model_;
 
     bool enable_nestedloop_join = true;
     bool enable_sortmerge_join = false;
 
    public:
-    Planner(SmManager *sm_manager) : sm_manager_(sm_manager) {}
+    Planner(SmManager *sm_manager) : sm_manager_(sm_manager), cost_model_(sm_manager) {}
 
 
     std::shared_ptr<Plan> do_planner(std::shared_ptr<Query> query, Context *context);
@@ -49,13 +55,25 @@ class Planner {
 
     std::shared_ptr<Plan> make_one_rel(std::shared_ptr<Query> query);
 
+    PlanCost choose_join_method(const PlanCost &left, const PlanCost &right, const std::vector<Condition> &conds,
+                                PlanTag &join_tag);
+
     std::shared_ptr<Plan> generate_sort_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan);
     
     std::shared_ptr<Plan> generate_select_plan(std::shared_ptr<Query> query, Context *context);
 
+    void derive_implied_conds(std::vector<Condition> &conds);
+
+    void prune_cols(std::shared_ptr<Query> query);
+
 
     // int get_indexNo(std::string tab_name, std::vector<Condition> curr_conds);
-    bool get_index_cols(std::string tab_name, std::vector<Condition> curr_conds, std::vector<std::string>& index_col_names);
+    bool get_index_cols(std::string tab_name, std::vector<Condition> curr_conds, std::vector<std::string>& index_col_names,
+                        const std::vector<TabCol> *sel_cols = nullptr, bool *index_only = nullptr,
+                        std::vector<std::vector<std::string>> *bitmap_indexes = nullptr);
+
+    PlanTag get_index_scan_tag(const std::string &tab_name, const std::vector<std::string> &index_col_names,
+                               bool index_only = false);
 
     ColType interp_sv_type(ast::SvType sv_type) {
         std::map<ast::SvType, ColType> m = {
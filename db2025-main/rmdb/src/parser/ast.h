@@ -97,12 +97,23 @@ struct DescTable : public TreeNode {
     DescTable(std::string tab_name_) : tab_name(std::move(tab_name_)) {}
 };
 
+// analyze [table]，表名为空时收集所有表的统计信息
+struct AnalyzeStmt : public TreeNode {
+    std::string tab_name;
+
+    AnalyzeStmt(std::string tab_name_) : tab_name(std::move(tab_name_)) {}
+};
+
 struct CreateIndex : public TreeNode {
     std::string tab_name;
     std::vector<std::string> col_names;
+    bool using_hash;    // CREATE INDEX ... USING HASH，创建可扩展哈希索引
+    bool with_bloom;    // CREATE INDEX ... WITH BLOOM，B+树索引在内存中维护Bloom filter
 
-    CreateIndex(std::string tab_name_, std::vector<std::string> col_names_) :
-            tab_name(std::move(tab_name_)), col_names(std::move(col_names_)) {}
+    CreateIndex(std::string tab_name_, std::vector<std::string> col_names_, bool using_hash_ = false,
+                bool with_bloom_ = false) :
+            tab_name(std::move(tab_name_)), col_names(std::move(col_names_)), using_hash(using_hash_),
+            with_bloom(with_bloom_) {}
 };
 
 struct DropIndex : public TreeNode {
@@ -154,9 +165,10 @@ struct Col : public Expr {
 struct SetClause : public TreeNode {
     std::string col_name;
     std::shared_ptr<Value> val;
+    std::string incr_col;   // col_name = incr_col + val，为空时是普通的赋值
 
-    SetClause(std::string col_name_, std::shared_ptr<Value> val_) :
-            col_name(std::move(col_name_)), val(std::move(val_)) {}
+    SetClause(std::string col_name_, std::shared_ptr<Value> val_, std::string incr_col_ = "") :
+            col_name(std::move(col_name_)), val(std::move(val_)), incr_col(std::move(incr_col_)) {}
 };
 
 struct BinaryExpr : public TreeNode {
@@ -17,15 +17,22 @@ int main() {
     std::vector<std::string> sqls = {
         "show tables;",
         "desc tb;",
+        "analyze tb;",
+        "analyze;",
         "create table tb (a int, b float, c char(4));",
         "drop table tb;",
         "create index tb(a);",
         "create index tb(a, b, c);",
+        "create index tb(a) using hash;",
+        "create index tb(a) with bloom;",
         "drop index tb(a, b, c);",
         "drop index tb(b);",
         "insert into tb values (1, 3.14, 'pi');",
         "delete from tb where a = 1;",
         "update tb set a = 1, b = 2.2, c = 'xyz' where x = 2 and y < 1.1 and z > 'abc';",
+        "update tb set a = a + 1, b = b - 2.5, c = c+3, d = d -4 where x = 2;",
+        "insert into tb values (-1, +2.5, 'neg');",
+        "select * from tb where a > -3;",
         "select * from tb;",
         "select * from tb where x <> 2 and y >= 3. and z <= '123' and b < tb.a;",
         "select x.a, y.b from x, y where x.a = y.b and c = d;",
@@ -46,6 +53,17 @@ int main() {
             std::cout << "exit/EOF" << std::endl;
         }
     }
+    // 没有符号的数值紧跟在列名之后不是增量更新
+    std::vector<std::string> invalid_sqls = {
+        "update tb set c = c 3;",
+        "update tb set c = c 3.5;",
+    };
+    for (auto &sql : invalid_sqls) {
+        std::cout << sql << std::endl;
+        YY_BUFFER_STATE buf = yy_scan_string(sql.c_str());
+        assert(yyparse() != 0);
+        yy_delete_buffer(buf);
+    }
     ast::parse_tree.reset();
     return 0;
 }
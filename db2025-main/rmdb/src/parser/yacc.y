@@ -22,14 +22,14 @@ using namespace ast;
 
 // keywords
 %token SHOW TABLES CREATE TABLE DROP DESC INSERT INTO VALUES DELETE FROM ASC ORDER BY
-WHERE UPDATE SET SELECT INT CHAR FLOAT INDEX AND JOIN EXIT HELP TXN_BEGIN TXN_COMMIT TXN_ABORT TXN_ROLLBACK ORDER_BY ENABLE_NESTLOOP ENABLE_SORTMERGE
+WHERE UPDATE SET SELECT INT CHAR FLOAT INDEX USING HASH WITH BLOOM AND JOIN EXIT HELP ANALYZE TXN_BEGIN TXN_COMMIT TXN_ABORT TXN_ROLLBACK ORDER_BY ENABLE_NESTLOOP ENABLE_SORTMERGE
 // non-keywords
 %token LEQ NEQ GEQ T_EOF
 
 // type-specific tokens
 %token <sv_str> IDENTIFIER VALUE_STRING
-%token <sv_int> VALUE_INT
-%token <sv_float> VALUE_FLOAT
+%token <sv_int> VALUE_INT SIGNED_VALUE_INT
+%token <sv_float> VALUE_FLOAT SIGNED_VALUE_FLOAT
 %token <sv_bool> VALUE_BOOL
 
 // specify types for non-terminal symbol
@@ -39,7 +39,7 @@ WHERE UPDATE SET SELECT INT CHAR FLOAT INDEX AND JOIN EXIT HELP TXN_BEGIN TXN_CO
 %type <sv_type_len> type
 %type <sv_comp_op> op
 %type <sv_expr> expr
-%type <sv_val> value
+%type <sv_val> value signedValue
 %type <sv_vals> valueList
 %type <sv_str> tbName colName
 %type <sv_strs> tableList colNameList
@@ -109,6 +109,14 @@ dbStmt:
     {
         $$ = std::make_shared<ShowTables>();
     }
+    |   ANALYZE tbName
+    {
+        $$ = std::make_shared<AnalyzeStmt>($2);
+    }
+    |   ANALYZE
+    {
+        $$ = std::make_shared<AnalyzeStmt>("");
+    }
     ;
 
 setStmt:
@@ -135,6 +143,14 @@ ddl:
     {
         $$ = std::make_shared<CreateIndex>($3, $5);
     }
+    |   CREATE INDEX tbName '(' colNameList ')' USING HASH
+    {
+        $$ = std::make_shared<CreateIndex>($3, $5, true);
+    }
+    |   CREATE INDEX tbName '(' colNameList ')' WITH BLOOM
+    {
+        $$ = std::make_shared<CreateIndex>($3, $5, false, true);
+    }
     |   DROP INDEX tbName '(' colNameList ')'
     {
         $$ = std::make_shared<DropIndex>($3, $5);
@@ -232,6 +248,18 @@ value:
     {
         $$ = std::make_shared<BoolLit>($1);
     }
+    |   signedValue
+    ;
+
+signedValue:
+        SIGNED_VALUE_INT
+    {
+        $$ = std::make_shared<IntLit>($1);
+    }
+    |   SIGNED_VALUE_FLOAT
+    {
+        $$ = std::make_shared<FloatLit>($1);
+    }
     ;
 
 condition:
@@ -336,6 +364,25 @@ setClause:
     {
         $$ = std::make_shared<SetClause>($1, $3);
     }
+    |   colName '=' colName '+' value
+    {
+        $$ = std::make_shared<SetClause>($1, $5, $3);
+    }
+    |   colName '=' colName '-' value
+    {
+        // col = col - value按照加上相反数处理
+        if (auto x = std::dynamic_pointer_cast<IntLit>($5)) {
+            x->val = -x->val;
+        } else if (auto x = std::dynamic_pointer_cast<FloatLit>($5)) {
+            x->val = -x->val;
+        }
+        $$ = std::make_shared<SetClause>($1, $5, $3);
+    }
+    |   colName '=' colName signedValue
+    {
+        // col=col+1中的+1被词法分析为带符号的数值，没有符号的col=col 1是语法错误
+        $$ = std::make_shared<SetClause>($1, $4, $3);
+    }
     ;
 
 selector:
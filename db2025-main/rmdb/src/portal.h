@@ -19,6 +19,9 @@ See the Mulan PSL v2 for more details. */
 #include "execution/executor_projection.h"
 #include "execution/executor_seq_scan.h"
 #include "execution/executor_index_scan.h"
+#include "execution/executor_index_only_scan.h"
+#include "execution/executor_hash_scan.h"
+#include "execution/executor_bitmap_scan.h"
 #include "execution/executor_update.h"
 #include "execution/executor_insert.h"
 #include "execution/executor_delete.h"
@@ -78,9 +81,13 @@ class Portal
                 {
                     std::unique_ptr<AbstractExecutor> scan= convert_plan_executor(x->subplan_, context);
                     std::vector<Rid> rids;
+                    // 只包含增量的update扫描时对记录加escrow锁，不与其他事务的增量冲突
+                    context->escrow_ = UseEscrow(context, sm_manager_->db_.get_table(x->tab_name_), x->set_clauses_,
+                                                 x->conds_);
                     for (scan->beginTuple(); !scan->is_end(); scan->nextTuple()) {
                         rids.push_back(scan->rid());
                     }
+                    context->escrow_ = false;
                     std::unique_ptr<AbstractExecutor> root =std::make_unique<UpdateExecutor>(sm_manager_, 
                                                             x->tab_name_, x->set_clauses_, x->conds_, rids, context);
                     return std::make_shared<PortalStmt>(PORTAL_DML_WITHOUT_SELECT, std::vector<TabCol>(), std::move(root), plan);
@@ -162,6 +169,15 @@ class Portal
             if(x->tag == T_SeqScan) {
                 return std::make_unique<SeqScanExecutor>(sm_manager_, x->tab_name_, x->conds_, context);
             }
+            else if(x->tag == T_IndexOnlyScan) {
+                return std::make_unique<IndexOnlyScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->index_col_names_, context);
+            }
+            else if(x->tag == T_HashScan) {
+                return std::make_unique<HashScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->index_col_names_, context);
+            }
+            else if(x->tag == T_BitmapHeapScan) {
+                return std::make_unique<BitmapHeapScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->bitmap_indexes_, context);
+            }
             else {
                 return std::make_unique<IndexScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->index_col_names_, context);
             } 
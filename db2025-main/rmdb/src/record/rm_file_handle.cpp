@@ -18,28 +18,46 @@ See the Mulan PSL v2 for more details. */
  */
 std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid& rid, Context* context) const {
     // 检查rid是否有效
-    if (rid.page_no >= file_hdr_.num_pages || rid.slot_no >= file_hdr_.num_records_per_page) {
+    if (rid.page_no < RM_FIRST_RECORD_PAGE || rid.page_no >= file_hdr_.num_pages ||
+        rid.slot_no >= file_hdr_.num_records_per_page) {
         return nullptr;
     }
-    
+
     // 获取页面
-    PageId page_id = {fd_, rid.page_no};
-    Page *page = buffer_pool_manager_->fetch_page(page_id);
-    if (page == nullptr) {
-        return nullptr;
-    }
-    
+    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+
     // 获取记录
-    char *slot = page->data_ + rid.slot_no * file_hdr_.record_size;
     std::unique_ptr<RmRecord> record = std::make_unique<RmRecord>(file_hdr_.record_size);
-    memcpy(record->data, slot, file_hdr_.record_size);
-    
+    memcpy(record->data, page_handle.get_slot(rid.slot_no), file_hdr_.record_size);
+
     // 取消固定页面
-    buffer_pool_manager_->unpin_page(page_id, false);
-    
+    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
+
     return record;
 }
 
+/**
+ * @description: 读取同一个页面中的多条记录，页面只fetch一次，用于按页面顺序回表的bitmap heap scan
+ * @param {int} page_no 页面号
+ * @param {vector<int>&} slot_nos 要读取的记录在页面中的位置
+ * @param {vector<unique_ptr<RmRecord>>*} records 读到的记录，按照slot_nos的顺序追加在末尾
+ * @param {Context*} context
+ */
+void RmFileHandle::get_records(int page_no, const std::vector<int> &slot_nos,
+                               std::vector<std::unique_ptr<RmRecord>> *records, Context *context) const {
+    if (page_no < RM_FIRST_RECORD_PAGE || page_no >= file_hdr_.num_pages) {
+        return;
+    }
+    RmPageHandle page_handle = fetch_page_handle(page_no);
+    for (int slot_no : slot_nos) {
+        assert(slot_no < file_hdr_.num_records_per_page);
+        auto record = std::make_unique<RmRecord>(file_hdr_.record_size);
+        memcpy(record->data, page_handle.get_slot(slot_no), file_hdr_.record_size);
+        records->push_back(std::move(record));
+    }
+    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
+}
+
 /**
  * @description: 在当前表中插入一条记录，不指定插入位置
  * @param {char*} buf 要插入的记录的数据
@@ -47,87 +65,55 @@ std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid& rid, Context* cont
  * @return {Rid} 插入的记录的记录号（位置）
  */
 Rid RmFileHandle::insert_record(char* buf, Context* context) {
-    // 查找空闲槽位
-    for (page_id_t page_no = 0; page_no < file_hdr_.num_pages; page_no++) {
-        PageId page_id = {fd_, page_no};
-        Page *page = buffer_pool_manager_->fetch_page(page_id);
-        if (page == nullptr) {
-            continue;
-        }
-        
-        // 在页面中查找空闲槽位
-        for (int slot_no = 0; slot_no < file_hdr_.num_records_per_page; slot_no++) {
-            char *slot = page->data_ + slot_no * file_hdr_.record_size;
-            if (slot[0] == 0) {  // 0表示空闲槽位
-                // 插入记录
-                memcpy(slot, buf, file_hdr_.record_size);
-                page->is_dirty_ = true;
-                
-                // 更新文件头
-                file_hdr_.first_free_page_no = page_no;
-                file_hdr_.num_records++;
-                
-                // 取消固定页面
-                buffer_pool_manager_->unpin_page(page_id, true);
-                
-                return {page_no, slot_no};
-            }
-        }
-        
-        // 取消固定页面
-        buffer_pool_manager_->unpin_page(page_id, false);
-    }
-    
-    // 如果没有找到空闲槽位，创建新页面
-    PageId page_id = {fd_, file_hdr_.num_pages};
-    Page *page = buffer_pool_manager_->new_page(&page_id);
-    if (page == nullptr) {
-        return {-1, -1};
-    }
-    
-    // 初始化新页面
-    memset(page->data_, 0, PAGE_SIZE);
-    
+    // 获取第一个有空闲位置的页面，没有时分配新页面
+    RmPageHandle page_handle = create_page_handle();
+
+    // 在页面的bitmap中找第一个空闲槽位
+    int slot_no = Bitmap::first_bit(false, page_handle.bitmap, file_hdr_.num_records_per_page);
+    assert(slot_no < file_hdr_.num_records_per_page);
+
     // 插入记录
-    memcpy(page->data_, buf, file_hdr_.record_size);
-    page->is_dirty_ = true;
-    
-    // 更新文件头
-    file_hdr_.num_pages++;
-    file_hdr_.first_free_page_no = file_hdr_.num_pages - 1;
+    Bitmap::set(page_handle.bitmap, slot_no);
+    memcpy(page_handle.get_slot(slot_no), buf, file_hdr_.record_size);
+    page_handle.page_hdr->num_records++;
     file_hdr_.num_records++;
-    
-    // 取消固定页面
-    buffer_pool_manager_->unpin_page(page_id, true);
-    
-    return {file_hdr_.num_pages - 1, 0};
+
+    // 页面已满，从空闲页面链表中摘除
+    if (page_handle.page_hdr->num_records == file_hdr_.num_records_per_page) {
+        file_hdr_.first_free_page_no = page_handle.page_hdr->next_free_page_no;
+        page_handle.page_hdr->next_free_page_no = RM_NO_PAGE;
+    }
+
+    Rid rid{.page_no = page_handle.page->get_page_id().page_no, .slot_no = slot_no};
+    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
+    return rid;
 }
 
 /**
- * @description: 在当前表中的指定位置插入一条记录
+ * @description: 在当前表中的指定位置插入一条记录，用于撤销删除操作
  * @param {Rid&} rid 要插入记录的位置
  * @param {char*} buf 要插入记录的数据
  */
 void RmFileHandle::insert_record(const Rid& rid, char* buf) {
     // 检查rid是否有效
-    if (rid.page_no >= file_hdr_.num_pages || rid.slot_no >= file_hdr_.num_records_per_page) {
+    if (rid.page_no < RM_FIRST_RECORD_PAGE || rid.page_no >= file_hdr_.num_pages ||
+        rid.slot_no >= file_hdr_.num_records_per_page) {
         return;
     }
-    
-    // 获取页面
-    PageId page_id = {fd_, rid.page_no};
-    Page *page = buffer_pool_manager_->fetch_page(page_id);
-    if (page == nullptr) {
-        return;
+
+    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+    memcpy(page_handle.get_slot(rid.slot_no), buf, file_hdr_.record_size);
+    if (!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
+        Bitmap::set(page_handle.bitmap, rid.slot_no);
+        page_handle.page_hdr->num_records++;
+        file_hdr_.num_records++;
+        // 页面已满，从空闲页面链表中摘除，保证链表中只有未满的页面
+        if (page_handle.page_hdr->num_records == file_hdr_.num_records_per_page) {
+            unlink_free_page(page_handle);
+        }
     }
-    
-    // 插入记录
-    char *slot = page->data_ + rid.slot_no * file_hdr_.record_size;
-    memcpy(slot, buf, file_hdr_.record_size);
-    page->is_dirty_ = true;
-    
-    // 取消固定页面
-    buffer_pool_manager_->unpin_page(page_id, true);
+
+    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
 }
 
 /**
@@ -137,27 +123,29 @@ void RmFileHandle::insert_record(const Rid& rid, char* buf) {
  */
 void RmFileHandle::delete_record(const Rid& rid, Context* context) {
     // 检查rid是否有效
-    if (rid.page_no >= file_hdr_.num_pages || rid.slot_no >= file_hdr_.num_records_per_page) {
+    if (rid.page_no < RM_FIRST_RECORD_PAGE || rid.page_no >= file_hdr_.num_pages ||
+        rid.slot_no >= file_hdr_.num_records_per_page) {
         return;
     }
-    
-    // 获取页面
-    PageId page_id = {fd_, rid.page_no};
-    Page *page = buffer_pool_manager_->fetch_page(page_id);
-    if (page == nullptr) {
+
+    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+    if (!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
+        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
         return;
     }
-    
+
     // 删除记录
-    char *slot = page->data_ + rid.slot_no * file_hdr_.record_size;
-    slot[0] = 0;  // 标记为空闲槽位
-    page->is_dirty_ = true;
-    
-    // 更新文件头
+    bool was_full = page_handle.page_hdr->num_records == file_hdr_.num_records_per_page;
+    Bitmap::reset(page_handle.bitmap, rid.slot_no);
+    page_handle.page_hdr->num_records--;
     file_hdr_.num_records--;
-    
-    // 取消固定页面
-    buffer_pool_manager_->unpin_page(page_id, true);
+
+    // 页面从已满变为未满，加入空闲页面链表
+    if (was_full) {
+        release_page_handle(page_handle);
+    }
+
+    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
 }
 
 
@@ -169,24 +157,14 @@ void RmFileHandle::delete_record(const Rid& rid, Context* context) {
  */
 void RmFileHandle::update_record(const Rid& rid, char* buf, Context* context) {
     // 检查rid是否有效
-    if (rid.page_no >= file_hdr_.num_pages || rid.slot_no >= file_hdr_.num_records_per_page) {
+    if (rid.page_no < RM_FIRST_RECORD_PAGE || rid.page_no >= file_hdr_.num_pages ||
+        rid.slot_no >= file_hdr_.num_records_per_page) {
         return;
     }
-    
-    // 获取页面
-    PageId page_id = {fd_, rid.page_no};
-    Page *page = buffer_pool_manager_->fetch_page(page_id);
-    if (page == nullptr) {
-        return;
-    }
-    
-    // 更新记录
-    char *slot = page->data_ + rid.slot_no * file_hdr_.record_size;
-    memcpy(slot, buf, file_hdr_.record_size);
-    page->is_dirty_ = true;
-    
-    // 取消固定页面
-    buffer_pool_manager_->unpin_page(page_id, true);
+
+    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+    memcpy(page_handle.get_slot(rid.slot_no), buf, file_hdr_.record_size);
+    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
 }
 
 /**
@@ -196,26 +174,39 @@ void RmFileHandle::update_record(const Rid& rid, char* buf, Context* context) {
  * @description: 获取指定页面的页面句柄
  * @param {int} page_no 页面号
  * @return {RmPageHandle} 指定页面的句柄
+ * @note pin the page, remember to unpin it outside!
  */
 RmPageHandle RmFileHandle::fetch_page_handle(int page_no) const {
-    // Todo:
-    // 使用缓冲池获取指定页面，并生成page_handle返回给上层
-    // if page_no is invalid, throw PageNotExistError exception
-
-    return RmPageHandle(&file_hdr_, nullptr);
+    if (page_no < RM_FIRST_RECORD_PAGE || page_no >= file_hdr_.num_pages) {
+        throw PageNotExistError(disk_manager_->get_file_name(fd_), page_no);
+    }
+    Page *page = buffer_pool_manager_->fetch_page(PageId{.fd = fd_, .page_no = page_no});
+    if (page == nullptr) {
+        throw InternalError("RmFileHandle::fetch_page_handle: buffer pool is full");
+    }
+    return RmPageHandle(&file_hdr_, page);
 }
 
 /**
  * @description: 创建一个新的page handle
  * @return {RmPageHandle} 新的PageHandle
+ * @note pin the page, remember to unpin it outside!
  */
 RmPageHandle RmFileHandle::create_new_page_handle() {
-    // Todo:
-    // 1.使用缓冲池来创建一个新page
-    // 2.更新page handle中的相关信息
-    // 3.更新file_hdr_
+    PageId page_id{.fd = fd_, .page_no = INVALID_PAGE_ID};
+    Page *page = buffer_pool_manager_->new_page(&page_id);
+    if (page == nullptr) {
+        throw InternalError("RmFileHandle::create_new_page_handle: buffer pool is full");
+    }
+    RmPageHandle page_handle(&file_hdr_, page);
+    page_handle.page_hdr->next_free_page_no = RM_NO_PAGE;
+    page_handle.page_hdr->num_records = 0;
+    Bitmap::init(page_handle.bitmap, file_hdr_.bitmap_size);
 
-    return RmPageHandle(&file_hdr_, nullptr);
+    // 新页面成为空闲页面链表的头
+    file_hdr_.num_pages = page_id.page_no + 1;
+    file_hdr_.first_free_page_no = page_id.page_no;
+    return page_handle;
 }
 
 /**
@@ -225,22 +216,39 @@ RmPageHandle RmFileHandle::create_new_page_handle() {
  * @note pin the page, remember to unpin it outside!
  */
 RmPageHandle RmFileHandle::create_page_handle() {
-    // Todo:
-    // 1. 判断file_hdr_中是否还有空闲页
-    //     1.1 没有空闲页：使用缓冲池来创建一个新page；可直接调用create_new_page_handle()
-    //     1.2 有空闲页：直接获取第一个空闲页
-    // 2. 生成page handle并返回给上层
-
-    return RmPageHandle(&file_hdr_, nullptr);
+    if (file_hdr_.first_free_page_no == RM_NO_PAGE) {
+        return create_new_page_handle();
+    }
+    return fetch_page_handle(file_hdr_.first_free_page_no);
 }
 
 /**
  * @description: 当一个页面从没有空闲空间的状态变为有空闲空间状态时，更新文件头和页头中空闲页面相关的元数据
  */
 void RmFileHandle::release_page_handle(RmPageHandle&page_handle) {
-    // Todo:
-    // 当page从已满变成未满，考虑如何更新：
-    // 1. page_handle.page_hdr->next_free_page_no
-    // 2. file_hdr_.first_free_page_no
-    
-}
\ No newline at end of file
+    page_handle.page_hdr->next_free_page_no = file_hdr_.first_free_page_no;
+    file_hdr_.first_free_page_no = page_handle.page->get_page_id().page_no;
+}
+
+/**
+ * @description: 页面在指定位置插入记录后变满时，把它从空闲页面链表中摘除。只有撤销删除时会发生，链表中的页面需要逐个读取
+ */
+void RmFileHandle::unlink_free_page(RmPageHandle &page_handle) {
+    int page_no = page_handle.page->get_page_id().page_no;
+    int next_page_no = page_handle.page_hdr->next_free_page_no;
+    page_handle.page_hdr->next_free_page_no = RM_NO_PAGE;
+    if (file_hdr_.first_free_page_no == page_no) {
+        file_hdr_.first_free_page_no = next_page_no;
+        return;
+    }
+    int prev_page_no = file_hdr_.first_free_page_no;
+    while (prev_page_no != RM_NO_PAGE) {
+        RmPageHandle prev = fetch_page_handle(prev_page_no);
+        int prev_next = prev.page_hdr->next_free_page_no;
+        if (prev_next == page_no) {
+            prev.page_hdr->next_free_page_no = next_page_no;
+        }
+        buffer_pool_manager_->unpin_page(prev.page->get_page_id(), prev_next == page_no);
+        prev_page_no = prev_next == page_no ? RM_NO_PAGE : prev_next;
+    }
+}
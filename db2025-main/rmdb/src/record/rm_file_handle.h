@@ -12,7 +12,10 @@ See the Mulan PSL v2 for more details. */
 
 #include <assert.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "bitmap.h"
 #include "common/context.h"
@@ -50,6 +53,8 @@ class RmFileHandle {
     BufferPoolManager *buffer_pool_manager_;
     int fd_;        // 打开文件后产生的文件句柄
     RmFileHdr file_hdr_;    // 文件头，维护当前表文件的元数据
+    std::mutex insert_latch_;               // MVCC下串行化插入，插入记录和设置元信息是一个原子操作
+    std::atomic<uint64_t> insert_seq_{0};   // 插入开始和结束时各加一，为奇数时有插入正在进行
 
    public:
     RmFileHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
@@ -65,14 +70,24 @@ class RmFileHandle {
     RmFileHdr get_file_hdr() { return file_hdr_; }
     int GetFd() { return fd_; }
 
+    std::mutex &get_insert_latch() { return insert_latch_; }
+    /* 读取的前后两次insert_seq相同并且为偶数时，读取期间没有插入记录 */
+    uint64_t get_insert_seq() const { return insert_seq_.load(); }
+    void inc_insert_seq() { insert_seq_.fetch_add(1); }
+
     /* 判断指定位置上是否已经存在一条记录，通过Bitmap来判断 */
     bool is_record(const Rid &rid) const {
         RmPageHandle page_handle = fetch_page_handle(rid.page_no);
-        return Bitmap::is_set(page_handle.bitmap, rid.slot_no);  // page的slot_no位置上是否有record
+        bool exist = Bitmap::is_set(page_handle.bitmap, rid.slot_no);  // page的slot_no位置上是否有record
+        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
+        return exist;
     }
 
     std::unique_ptr<RmRecord> get_record(const Rid &rid, Context *context) const;
 
+    void get_records(int page_no, const std::vector<int> &slot_nos, std::vector<std::unique_ptr<RmRecord>> *records,
+                     Context *context) const;
+
     Rid insert_record(char *buf, Context *context);
 
     void insert_record(const Rid &rid, char *buf);
@@ -89,4 +104,6 @@ class RmFileHandle {
     RmPageHandle create_page_handle();
 
     void release_page_handle(RmPageHandle &page_handle);
+
+    void unlink_free_page(RmPageHandle &page_handle);
 };
\ No newline at end of file
@@ -12,70 +12,42 @@ See the Mulan PSL v2 for more details. */
 #include "rm_file_handle.h"
 
 /**
- * @brief 初始化file_handle和rid
+ * @brief 初始化file_handle和rid，并定位到第一条记录
  * @param file_handle
  */
 RmScan::RmScan(const RmFileHandle *file_handle) : file_handle_(file_handle) {
-    // 初始化扫描位置
-    rid_ = {0, 0};
+    // 第0页是文件头，记录从RM_FIRST_RECORD_PAGE开始存放，从其第一个槽位之前开始找
+    rid_ = {RM_FIRST_RECORD_PAGE, -1};
+    next();
 }
 
 /**
  * @brief 找到文件中下一个存放了记录的位置
  */
 void RmScan::next() {
-    // 获取当前页面
-    PageId page_id = {file_handle_->fd_, rid_.page_no};
-    Page *page = file_handle_->buffer_pool_manager_->fetch_page(page_id);
-    if (page == nullptr) {
-        rid_ = {-1, -1};  // 标记扫描结束
+    if (is_end()) {
         return;
     }
-    
-    // 在当前页面中查找下一个有效记录
-    while (true) {
-        // 检查是否到达页面末尾
-        if (rid_.slot_no >= file_handle_->file_hdr_.num_records_per_page) {
-            // 取消固定当前页面
-            file_handle_->buffer_pool_manager_->unpin_page(page_id, false);
-            
-            // 移动到下一页
-            rid_.page_no++;
-            rid_.slot_no = 0;
-            
-            // 检查是否到达文件末尾
-            if (rid_.page_no >= file_handle_->file_hdr_.num_pages) {
-                rid_ = {-1, -1};  // 标记扫描结束
-                return;
-            }
-            
-            // 获取新页面
-            page_id = {file_handle_->fd_, rid_.page_no};
-            page = file_handle_->buffer_pool_manager_->fetch_page(page_id);
-            if (page == nullptr) {
-                rid_ = {-1, -1};  // 标记扫描结束
-                return;
-            }
-        }
-        
-        // 检查当前槽位是否有效
-        char *slot = page->data_ + rid_.slot_no * file_handle_->file_hdr_.record_size;
-        if (slot[0] != 0) {  // 非0表示有效记录
-            // 取消固定页面
-            file_handle_->buffer_pool_manager_->unpin_page(page_id, false);
+    int num_records_per_page = file_handle_->file_hdr_.num_records_per_page;
+    while (rid_.page_no < file_handle_->file_hdr_.num_pages) {
+        // 在当前页面的bitmap中找rid_之后第一个被占用的槽位
+        RmPageHandle page_handle = file_handle_->fetch_page_handle(rid_.page_no);
+        rid_.slot_no = Bitmap::next_bit(true, page_handle.bitmap, num_records_per_page, rid_.slot_no);
+        file_handle_->buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
+        if (rid_.slot_no < num_records_per_page) {
             return;
         }
-        
-        // 移动到下一个槽位
-        rid_.slot_no++;
+        // 当前页面没有更多记录，移动到下一页
+        rid_ = {rid_.page_no + 1, -1};
     }
+    rid_ = {RM_NO_PAGE, -1};  // 标记扫描结束
 }
 
 /**
  * @brief ​ 判断是否到达文件末尾
  */
 bool RmScan::is_end() const {
-    return rid_.page_no == -1 && rid_.slot_no == -1;
+    return rid_.page_no == RM_NO_PAGE;
 }
 
 /**
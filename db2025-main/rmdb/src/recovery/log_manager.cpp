@@ -9,6 +9,7 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #include <cstring>
+#include <unistd.h>
 #include "log_manager.h"
 
 /**
@@ -17,12 +18,63 @@ See the Mulan PSL v2 for more details. */
  * @return {lsn_t} 返回该日志的日志记录号
  */
 lsn_t LogManager::add_log_to_buffer(LogRecord* log_record) {
-  
+    std::unique_lock<std::mutex> lock(latch_);
+    while (log_buffer_.is_full(log_record->log_tot_len_)) {
+        // 缓冲区已满，先刷盘；刷盘需要获取latch_
+        lock.unlock();
+        flush_log_to_disk();
+        lock.lock();
+    }
+    // 在latch_内分配lsn，缓冲区中的日志按照lsn的顺序排列
+    log_record->lsn_ = global_lsn_++;
+    log_record->serialize(log_buffer_.buffer_ + log_buffer_.offset_);
+    log_buffer_.offset_ += log_record->log_tot_len_;
+    return log_record->lsn_;
 }
 
 /**
  * @description: 把日志缓冲区的内容刷到磁盘中，由于目前只设置了一个缓冲区，因此需要阻塞其他日志操作
  */
 void LogManager::flush_log_to_disk() {
+    std::lock_guard<std::mutex> flush_lock(flush_latch_);
+    flush_buffer();
+}
 
+/**
+ * @description: 等待lsn及之前的日志持久化，lsn为INVALID_LSN时直接返回
+ * @param {lsn_t} lsn 需要持久化的日志记录号
+ */
+void LogManager::wait_for_durable(lsn_t lsn) {
+    if (lsn == INVALID_LSN || persist_lsn_.load() >= lsn) {
+        return;
+    }
+    std::lock_guard<std::mutex> flush_lock(flush_latch_);
+    // 等待flush_latch_期间，上一个刷盘的线程可能已经把lsn写入磁盘
+    if (persist_lsn_.load() >= lsn) {
+        return;
+    }
+    flush_buffer();
+}
+
+/**
+ * @description: 取出日志缓冲区中的所有日志写入磁盘，调用者持有flush_latch_。
+ * 只在复制缓冲区时持有latch_，写盘和fsync期间其他线程可以继续追加日志
+ */
+void LogManager::flush_buffer() {
+    int size;
+    lsn_t last_lsn;
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        size = log_buffer_.offset_;
+        memcpy(flush_buffer_, log_buffer_.buffer_, size);
+        log_buffer_.offset_ = 0;
+        last_lsn = global_lsn_.load() - 1;
+    }
+    if (size > 0) {
+        disk_manager_->write_log(flush_buffer_, size);
+        if (sync_on_flush_ && fsync(disk_manager_->GetLogFd()) != 0) {
+            throw UnixError();
+        }
+    }
+    persist_lsn_.store(last_lsn);
 }
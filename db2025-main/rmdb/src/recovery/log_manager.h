@@ -16,6 +16,7 @@ See the Mulan PSL v2 for more details. */
 #include "log_defs.h"
 #include "common/config.h"
 #include "record/rm_defs.h"
+#include "common/common.h"
 
 /* 日志记录对应操作的类型 */
 enum LogType: int {
@@ -24,7 +25,8 @@ enum LogType: int {
     DELETE,
     begin,
     commit,
-    ABORT
+    ABORT,
+    INCREMENT
 };
 static std::string LogTypeStr[] = {
     "UPDATE",
@@ -32,7 +34,8 @@ static std::string LogTypeStr[] = {
     "DELETE",
     "BEGIN",
     "COMMIT",
-    "ABORT"
+    "ABORT",
+    "INCREMENT"
 };
 
 class LogRecord {
@@ -98,17 +101,57 @@ public:
 };
 
 /**
- * TODO: commit操作的日志记录
+ * commit操作的日志记录
 */
 class CommitLogRecord: public LogRecord {
-
+public:
+    CommitLogRecord() {
+        log_type_ = LogType::commit;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+    }
+    CommitLogRecord(txn_id_t txn_id) : CommitLogRecord() {
+        log_tid_ = txn_id;
+    }
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+    }
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+    }
+    virtual void format_print() override {
+        std::cout << "log type in son_function: " << LogTypeStr[log_type_] << "\n";
+        LogRecord::format_print();
+    }
 };
 
 /**
- * TODO: abort操作的日志记录
+ * abort操作的日志记录
 */
 class AbortLogRecord: public LogRecord {
-
+public:
+    AbortLogRecord() {
+        log_type_ = LogType::ABORT;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+    }
+    AbortLogRecord(txn_id_t txn_id) : AbortLogRecord() {
+        log_tid_ = txn_id;
+    }
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+    }
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+    }
+    virtual void format_print() override {
+        std::cout << "log type in son_function: " << LogTypeStr[log_type_] << "\n";
+        LogRecord::format_print();
+    }
 };
 
 class InsertLogRecord: public LogRecord {
@@ -189,6 +232,93 @@ class UpdateLogRecord: public LogRecord {
 
 };
 
+/**
+ * escrow锁下的增量修改（col = col + value）的逻辑日志，只记录字段的偏移和增量：
+ * 持有escrow锁的事务可以同时修改同一条记录，写日志时记录的前后镜像并不确定。
+ * redo时把增量加到记录上，根据页面的lsn判断增量是否已经写入页面
+ */
+class IncrementLogRecord: public LogRecord {
+public:
+    IncrementLogRecord() {
+        log_type_ = LogType::INCREMENT;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+    }
+    IncrementLogRecord(txn_id_t txn_id, const Rid& rid, const std::string& table_name,
+                       std::vector<std::pair<int, Value>> deltas)
+        : IncrementLogRecord() {
+        log_tid_ = txn_id;
+        rid_ = rid;
+        table_name_ = table_name;
+        deltas_ = std::move(deltas);
+        log_tot_len_ += sizeof(Rid) + sizeof(size_t) + table_name_.size() + sizeof(int) + deltas_.size() * DELTA_SIZE;
+    }
+
+    // 把increment日志记录序列化到dest中，每个增量保存为 | offset | type | 4字节的数值 |
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+        int offset = OFFSET_LOG_DATA;
+        memcpy(dest + offset, &rid_, sizeof(Rid));
+        offset += sizeof(Rid);
+        size_t table_name_size = table_name_.size();
+        memcpy(dest + offset, &table_name_size, sizeof(size_t));
+        offset += sizeof(size_t);
+        memcpy(dest + offset, table_name_.data(), table_name_size);
+        offset += table_name_size;
+        int num_deltas = deltas_.size();
+        memcpy(dest + offset, &num_deltas, sizeof(int));
+        offset += sizeof(int);
+        for (auto &[col_offset, delta] : deltas_) {
+            memcpy(dest + offset, &col_offset, sizeof(int));
+            memcpy(dest + offset + sizeof(int), &delta.type, sizeof(ColType));
+            memcpy(dest + offset + sizeof(int) + sizeof(ColType), &delta.int_val, sizeof(int));
+            offset += DELTA_SIZE;
+        }
+    }
+    // 从src中反序列化出一条Increment日志记录
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+        int offset = OFFSET_LOG_DATA;
+        rid_ = *reinterpret_cast<const Rid*>(src + offset);
+        offset += sizeof(Rid);
+        size_t table_name_size = *reinterpret_cast<const size_t*>(src + offset);
+        offset += sizeof(size_t);
+        table_name_.assign(src + offset, table_name_size);
+        offset += table_name_size;
+        int num_deltas = *reinterpret_cast<const int*>(src + offset);
+        offset += sizeof(int);
+        deltas_.clear();
+        for (int i = 0; i < num_deltas; i++) {
+            Value delta;
+            memcpy(&delta.type, src + offset + sizeof(int), sizeof(ColType));
+            memcpy(&delta.int_val, src + offset + sizeof(int) + sizeof(ColType), sizeof(int));
+            deltas_.emplace_back(*reinterpret_cast<const int*>(src + offset), delta);
+            offset += DELTA_SIZE;
+        }
+    }
+    void format_print() override {
+        printf("increment record\n");
+        LogRecord::format_print();
+        printf("increment rid: %d, %d\n", rid_.page_no, rid_.slot_no);
+        printf("table name: %s\n", table_name_.c_str());
+        for (auto &[col_offset, delta] : deltas_) {
+            if (delta.type == TYPE_INT) {
+                printf("offset %d: +%d\n", col_offset, delta.int_val);
+            } else {
+                printf("offset %d: +%f\n", col_offset, delta.float_val);
+            }
+        }
+    }
+
+    static constexpr int DELTA_SIZE = sizeof(int) + sizeof(ColType) + sizeof(int);
+
+    Rid rid_;                                   // 修改的记录
+    std::string table_name_;                    // 记录所在的表名称
+    std::vector<std::pair<int, Value>> deltas_; // 字段在记录中的偏移和增量
+};
+
 /* 日志缓冲区，只有一个buffer，因此需要阻塞地去把日志写入缓冲区中 */
 
 class LogBuffer {
@@ -216,12 +346,31 @@ public:
     lsn_t add_log_to_buffer(LogRecord* log_record);
     void flush_log_to_disk();
 
+    /**
+     * 等待lsn及之前的所有日志持久化。已经有线程在刷盘时先等它完成，之后仍未持久化时由当前线程
+     * 把缓冲区中积累的所有日志一起刷盘（组提交），刷盘期间其他线程可以继续向缓冲区追加日志
+     */
+    void wait_for_durable(lsn_t lsn);
+
+    lsn_t get_persist_lsn() { return persist_lsn_.load(); }
+
+    /* 重启时从恢复之后的下一个lsn开始分配 */
+    void set_global_lsn(lsn_t lsn) { global_lsn_.store(lsn); }
+
+    /* 刷盘时是否调用fsync，关闭时日志只写入操作系统的页缓存 */
+    void set_sync_on_flush(bool sync_on_flush) { sync_on_flush_ = sync_on_flush; }
+
     LogBuffer* get_log_buffer() { return &log_buffer_; }
 
 private:    
-    std::atomic<lsn_t> global_lsn_{0};  // 全局lsn，递增，用于为每条记录分发lsn
+    void flush_buffer();
+
+    std::atomic<lsn_t> global_lsn_{1};  // 全局lsn，递增，用于为每条记录分发lsn；页面的lsn为0表示没有写过日志的修改
     std::mutex latch_;                  // 用于对log_buffer_的互斥访问
     LogBuffer log_buffer_;              // 日志缓冲区
-    lsn_t persist_lsn_;                 // 记录已经持久化到磁盘中的最后一条日志的日志号
+    std::mutex flush_latch_;            // 同一时刻只有一个线程刷盘，保护flush_buffer_
+    char flush_buffer_[LOG_BUFFER_SIZE];    // 刷盘时从日志缓冲区中取出的日志，写盘时不持有latch_
+    std::atomic<lsn_t> persist_lsn_{INVALID_LSN};   // 记录已经持久化到磁盘中的最后一条日志的日志号
+    bool sync_on_flush_ = true;
     DiskManager* disk_manager_;
 }; 
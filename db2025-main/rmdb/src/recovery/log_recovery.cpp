@@ -10,18 +10,68 @@ See the Mulan PSL v2 for more details. */
 
 #include "log_recovery.h"
 
+#include <algorithm>
+
 /**
  * @description: analyze阶段，需要获得脏页表（DPT）和未完成的事务列表（ATT）
  */
 void RecoveryManager::analyze() {
- 
+    committed_txns_.clear();
+    increment_logs_.clear();
+    int offset = 0;
+    while (true) {
+        int size = disk_manager_->read_log(buffer_.buffer_, LOG_BUFFER_SIZE, offset);
+        if (size <= 0) {
+            break;
+        }
+        int pos = 0;
+        while (pos + LOG_HEADER_SIZE <= size) {
+            LogRecord header;
+            header.deserialize(buffer_.buffer_ + pos);
+            // 日志记录跨过了读入的末尾，从这条记录开始重新读取；日志文件末尾的记录可能只写入了一部分
+            if (header.log_tot_len_ < (uint32_t)LOG_HEADER_SIZE || pos + header.log_tot_len_ > (uint32_t)size) {
+                break;
+            }
+            next_lsn_ = std::max(next_lsn_, header.lsn_ + 1);
+            if (header.log_type_ == LogType::commit) {
+                committed_txns_.insert(header.log_tid_);
+            } else if (header.log_type_ == LogType::INCREMENT) {
+                increment_logs_.emplace_back();
+                increment_logs_.back().deserialize(buffer_.buffer_ + pos);
+            }
+            pos += header.log_tot_len_;
+        }
+        if (pos == 0) {
+            break;
+        }
+        offset += pos;
+    }
 }
 
 /**
- * @description: 重做所有未落盘的操作
+ * @description: 重做所有未落盘的操作。目前只有已提交事务的increment日志需要重做：
+ * 页面的lsn小于日志的lsn时说明增量还没有写入磁盘上的页面，重新加到记录上并更新页面的lsn
  */
 void RecoveryManager::redo() {
-
+    for (auto &log : increment_logs_) {
+        if (committed_txns_.count(log.log_tid_) == 0) {
+            continue;
+        }
+        auto fh = sm_manager_->fhs_.find(log.table_name_);
+        if (fh == sm_manager_->fhs_.end()) {
+            // 表已经被删除
+            continue;
+        }
+        RmPageHandle page_handle = fh->second->fetch_page_handle(log.rid_.page_no);
+        bool dirty = page_handle.page->get_page_lsn() < log.lsn_;
+        if (dirty) {
+            for (auto &[col_offset, delta] : log.deltas_) {
+                delta.add_to(page_handle.get_slot(log.rid_.slot_no) + col_offset);
+            }
+            page_handle.page->set_page_lsn(log.lsn_);
+        }
+        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), dirty);
+    }
 }
 
 /**
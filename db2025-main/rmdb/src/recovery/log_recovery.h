@@ -12,6 +12,7 @@ See the Mulan PSL v2 for more details. */
 
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include "log_manager.h"
 #include "storage/disk_manager.h"
 #include "system/sm_manager.h"
@@ -34,8 +35,14 @@ public:
     void analyze();
     void redo();
     void undo();
+
+    /* 日志中最大的lsn加一，重启之后日志管理器从这里继续分配lsn */
+    lsn_t get_next_lsn() const { return next_lsn_; }
 private:
     LogBuffer buffer_;                                              // 读入日志
+    std::unordered_set<txn_id_t> committed_txns_;                   // 日志中有提交记录的事务
+    std::vector<IncrementLogRecord> increment_logs_;                // 按照lsn顺序排列的increment日志
+    lsn_t next_lsn_ = 1;
     DiskManager* disk_manager_;                                     // 用来读写文件
     BufferPoolManager* buffer_pool_manager_;                        // 对页面进行读写
     SmManager* sm_manager_;                                         // 访问数据库元数据
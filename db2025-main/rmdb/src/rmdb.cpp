@@ -56,10 +56,16 @@ void sigint_handler(int signo) {
 }
 
 // 判断当前正在执行的是显式事务还是单条SQL语句的事务，并更新事务ID
-void SetTransaction(txn_id_t *txn_id, Context *context) {
+// 显式事务之外的单条SELECT语句使用只读事务，它不在全局事务表中，事务ID保持为INVALID_TXN_ID
+void SetTransaction(txn_id_t *txn_id, Context *context, bool read_only) {
     context->txn_ = txn_manager->get_transaction(*txn_id);
     if(context->txn_ == nullptr || context->txn_->get_state() == TransactionState::COMMITTED ||
         context->txn_->get_state() == TransactionState::ABORTED) {
+        if (read_only) {
+            context->txn_ = txn_manager->begin_read_only(context->log_mgr_);
+            *txn_id = INVALID_TXN_ID;
+            return;
+        }
         context->txn_ = txn_manager->begin(nullptr, context->log_mgr_);
         *txn_id = context->txn_->get_transaction_id();
         context->txn_->set_txn_mode(false);
@@ -116,13 +122,16 @@ void *client_handler(void *sock_fd) {
 
         // 开启事务，初始化系统所需的上下文信息（包括事务对象指针、锁管理器指针、日志管理器指针、存放结果的buffer、记录结果长度的变量）
         Context *context = new Context(lock_manager.get(), log_manager.get(), nullptr, data_send, &offset);
-        SetTransaction(&txn_id, context);
+        context->txn_mgr_ = txn_manager.get();
 
         // 用于判断是否已经调用了yy_delete_buffer来删除buf
         bool finish_analyze = false;
         pthread_mutex_lock(buffer_mutex);
         YY_BUFFER_STATE buf = yy_scan_string(data_recv);
-        if (yyparse() == 0) {
+        bool parsed = yyparse() == 0;
+        SetTransaction(&txn_id, context,
+                       parsed && std::dynamic_pointer_cast<ast::SelectStmt>(ast::parse_tree) != nullptr);
+        if (parsed) {
             if (ast::parse_tree != nullptr) {
                 try {
                     // analyze and rewrite
@@ -172,16 +181,38 @@ void *client_handler(void *sock_fd) {
             yy_delete_buffer(buf);
             pthread_mutex_unlock(buffer_mutex);
         }
+        // 如果是单挑语句，需要按照一个完整的事务来执行，所以执行完当前语句后，自动提交事务。
+        // OCC下提交时才验证，需要在返回结果之前提交，验证失败时返回abort
+        if(context->txn_->get_txn_mode() == false && context->txn_->get_state() != TransactionState::ABORTED)
+        {
+            try {
+                txn_manager->commit(context->txn_, context->log_mgr_);
+            } catch (TransactionAbortException &e) {
+                std::string str = "abort\n";
+                memcpy(data_send, str.c_str(), str.length());
+                data_send[str.length()] = '\0';
+                offset = str.length();
+                txn_manager->abort(context->txn_, log_manager.get());
+                std::cout << e.GetInfo() << std::endl;
+
+                std::fstream outfile;
+                outfile.open("output.txt", std::ios::out | std::ios::app);
+                outfile << str;
+                outfile.close();
+            }
+        }
+        // 事务已经结束时交还给事务管理器，事务对象之后可能被其他连接复用，不能再通过txn_id访问
+        if (context->txn_->get_state() == TransactionState::COMMITTED ||
+            context->txn_->get_state() == TransactionState::ABORTED) {
+            txn_manager->recycle(context->txn_);
+            context->txn_ = nullptr;
+            txn_id = INVALID_TXN_ID;
+        }
         // future TODO: 格式化 sql_handler.result, 传给客户端
         // send result with fixed format, use protobuf in the future
         if (write(fd, data_send, offset + 1) == -1) {
             break;
         }
-        // 如果是单挑语句，需要按照一个完整的事务来执行，所以执行完当前语句后，自动提交事务
-        if(context->txn_->get_txn_mode() == false)
-        {
-            txn_manager->commit(context->txn_, context->log_mgr_);
-        }
     }
 
     // Clear
@@ -262,11 +293,24 @@ void start_server() {
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2) {
-        // 需要指定数据库名称
-        std::cerr << "Usage: " << argv[0] << " <database>" << std::endl;
+    if (argc != 2 && argc != 3) {
+        // 需要指定数据库名称，可选指定并发控制算法
+        std::cerr << "Usage: " << argv[0] << " <database> [2pl|mvcc|occ]" << std::endl;
         exit(1);
     }
+    if (argc == 3) {
+        std::string mode = argv[2];
+        if (mode == "2pl") {
+            txn_manager->set_concurrency_mode(ConcurrencyMode::TWO_PHASE_LOCKING);
+        } else if (mode == "mvcc") {
+            txn_manager->set_concurrency_mode(ConcurrencyMode::MVCC);
+        } else if (mode == "occ") {
+            txn_manager->set_concurrency_mode(ConcurrencyMode::OCC);
+        } else {
+            std::cerr << "Unknown concurrency mode: " << mode << std::endl;
+            exit(1);
+        }
+    }
 
     signal(SIGINT, sigint_handler);
     try {
@@ -294,6 +338,7 @@ int main(int argc, char **argv) {
         recovery->analyze();
         recovery->redo();
         recovery->undo();
+        log_manager->set_global_lsn(recovery->get_next_lsn());
         
         // 开启服务端，开始接受客户端连接
         start_server();
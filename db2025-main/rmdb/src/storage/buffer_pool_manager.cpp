@@ -56,6 +56,7 @@ void BufferPoolManager::update_page(Page *page, PageId new_page_id, frame_id_t n
  * @param {PageId} page_id 需要获取的页的PageId
  */
 Page* BufferPoolManager::fetch_page(PageId page_id) {
+    std::scoped_lock lock{latch_};
     // 检查页面是否在缓冲池中
     if (page_table_.count(page_id) > 0) {
         frame_id_t frame_id = page_table_[page_id];
@@ -71,17 +72,11 @@ Page* BufferPoolManager::fetch_page(PageId page_id) {
         return nullptr;
     }
     
-    // 从磁盘读取页面
+    // 淘汰的页面是脏页时先写回磁盘，然后从磁盘读取页面
     Page *page = &pages_[frame_id];
+    update_page(page, page_id, frame_id);
     disk_manager_->read_page(page_id.fd, page_id.page_no, page->data_, PAGE_SIZE);
-    
-    // 更新页面信息
-    page->id_ = page_id;
     page->pin_count_ = 1;
-    page->is_dirty_ = false;
-    
-    // 更新页表
-    page_table_[page_id] = frame_id;
     
     return page;
 }
@@ -93,6 +88,7 @@ Page* BufferPoolManager::fetch_page(PageId page_id) {
  * @param {bool} is_dirty 若目标page应该被标记为dirty则为true，否则为false
  */
 bool BufferPoolManager::unpin_page(PageId page_id, bool is_dirty) {
+    std::scoped_lock lock{latch_};
     // 检查页面是否在缓冲池中
     if (page_table_.count(page_id) == 0) {
         return false;
@@ -125,6 +121,7 @@ bool BufferPoolManager::unpin_page(PageId page_id, bool is_dirty) {
  * @param {PageId} page_id 目标页的page_id，不能为INVALID_PAGE_ID
  */
 bool BufferPoolManager::flush_page(PageId page_id) {
+    std::scoped_lock lock{latch_};
     // 检查页面是否在缓冲池中
     if (page_table_.count(page_id) == 0) {
         return false;
@@ -146,25 +143,21 @@ bool BufferPoolManager::flush_page(PageId page_id) {
  * @param {PageId*} page_id 当成功创建一个新的page时存储其page_id
  */
 Page* BufferPoolManager::new_page(PageId* page_id) {
+    std::scoped_lock lock{latch_};
     // 获取一个可用的帧
     frame_id_t frame_id;
     if (!find_victim_page(&frame_id)) {
         return nullptr;
     }
     
-    // 分配新的页面ID
-    page_id->fd = fd_;
-    page_id->page_no = next_page_id_++;
+    // 在page_id->fd对应的文件中分配新的页面号
+    page_id->page_no = disk_manager_->allocate_page(page_id->fd);
     
-    // 获取页面并初始化
+    // 淘汰的页面是脏页时先写回磁盘，然后初始化页面
     Page *page = &pages_[frame_id];
+    update_page(page, *page_id, frame_id);
     page->reset_memory();
-    page->id_ = *page_id;
     page->pin_count_ = 1;
-    page->is_dirty_ = false;
-    
-    // 更新页表
-    page_table_[*page_id] = frame_id;
     
     return page;
 }
@@ -175,6 +168,7 @@ Page* BufferPoolManager::new_page(PageId* page_id) {
  * @param {PageId} page_id 目标页
  */
 bool BufferPoolManager::delete_page(PageId page_id) {
+    std::scoped_lock lock{latch_};
     // 检查页面是否在缓冲池中
     if (page_table_.count(page_id) == 0) {
         return false;
@@ -191,11 +185,14 @@ bool BufferPoolManager::delete_page(PageId page_id) {
     // 从页表中删除
     page_table_.erase(page_id);
     
-    // 将帧加入空闲列表
+    // 将帧从replacer中移除并加入空闲列表，避免同一个帧被分配两次
+    replacer_->pin(frame_id);
     free_list_.push_back(frame_id);
     
-    // 重置页面
+    // 重置页面，被删除的页面不需要写回磁盘
     page->reset_memory();
+    page->id_.page_no = INVALID_PAGE_ID;
+    page->is_dirty_ = false;
     
     return true;
 }
@@ -205,11 +202,39 @@ bool BufferPoolManager::delete_page(PageId page_id) {
  * @param {int} fd 文件句柄
  */
 void BufferPoolManager::flush_all_pages(int fd) {
+    std::scoped_lock lock{latch_};
     // 遍历所有页面
     for (auto &pair : page_table_) {
-        PageId page_id = pair.first;
-        if (page_id.fd == fd) {
-            flush_page(page_id);
+        if (pair.first.fd == fd) {
+            Page *page = &pages_[pair.second];
+            disk_manager_->write_page(fd, pair.first.page_no, page->data_, PAGE_SIZE);
+            page->is_dirty_ = false;
         }
     }
-}
\ No newline at end of file
+}
+/**
+ * @description: 关闭文件时将文件在buffer_pool中的所有页写回磁盘并释放对应的帧
+ * 文件关闭之后fd可能被新打开的文件复用，不能在页表中留下旧文件的页面
+ * @param {int} fd 文件句柄
+ */
+void BufferPoolManager::delete_all_pages(int fd) {
+    std::scoped_lock lock{latch_};
+    for (auto it = page_table_.begin(); it != page_table_.end();) {
+        if (it->first.fd != fd) {
+            ++it;
+            continue;
+        }
+        frame_id_t frame_id = it->second;
+        Page *page = &pages_[frame_id];
+        assert(page->pin_count_ == 0);
+        if (page->is_dirty_) {
+            disk_manager_->write_page(fd, it->first.page_no, page->data_, PAGE_SIZE);
+        }
+        it = page_table_.erase(it);
+        replacer_->pin(frame_id);
+        free_list_.push_back(frame_id);
+        page->reset_memory();
+        page->id_.page_no = INVALID_PAGE_ID;
+        page->is_dirty_ = false;
+    }
+}
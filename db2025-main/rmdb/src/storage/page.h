@@ -10,6 +10,8 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <shared_mutex>
+
 #include "common/config.h"
 
 /**
@@ -71,6 +73,15 @@ class Page {
 
     inline void set_page_lsn(lsn_t page_lsn) { memcpy(get_data() + OFFSET_LSN, &page_lsn, sizeof(lsn_t)); }
 
+    /** 页面的读写锁，保护页面内容，与pin_count无关，调用方需要先pin住页面再加锁 */
+    void w_latch() { rwlatch_.lock(); }
+
+    void w_unlatch() { rwlatch_.unlock(); }
+
+    void r_latch() { rwlatch_.lock_shared(); }
+
+    void r_unlatch() { rwlatch_.unlock_shared(); }
+
    private:
     void reset_memory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }  // 将data_的PAGE_SIZE个字节填充为0
 
@@ -87,4 +98,7 @@ class Page {
 
     /** The pin count of this page. */
     int pin_count_ = 0;
+
+    /** 页面内容的读写锁 */
+    std::shared_mutex rwlatch_;
 };
\ No newline at end of file
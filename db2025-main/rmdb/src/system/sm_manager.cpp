@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 #include <unistd.h>
 
 #include <fstream>
+#include <iomanip>
 
 #include "index/ix.h"
 #include "record/rm.h"
@@ -85,7 +86,31 @@ void SmManager::drop_db(const std::string& db_name) {
  * @param {string&} db_name 数据库名称，与文件夹同名
  */
 void SmManager::open_db(const std::string& db_name) {
-    
+    if (!is_dir(db_name)) {
+        throw DatabaseNotFoundError(db_name);
+    }
+    if (chdir(db_name.c_str()) < 0) {
+        throw UnixError();
+    }
+    std::ifstream ifs(DB_META_NAME);
+    ifs >> db_;
+    for (auto &entry : db_.tabs_) {
+        auto &tab = entry.second;
+        fhs_.emplace(tab.name, rm_manager_->open_file(tab.name));
+        for (auto &index : tab.indexes) {
+            if (index.type == INDEX_HASH) {
+                hhs_.emplace(ix_manager_->get_index_name(tab.name, index.cols),
+                             ix_manager_->open_hash_index(tab.name, index.cols));
+                continue;
+            }
+            auto ih = ix_manager_->open_index(tab.name, index.cols);
+            if (index.bloom) {
+                ih->build_bloom_filter();
+            }
+            ihs_.emplace(ix_manager_->get_index_name(tab.name, index.cols), std::move(ih));
+        }
+    }
+    load_stats();
 }
 
 /**
@@ -97,11 +122,59 @@ void SmManager::flush_meta() {
     ofs << db_;
 }
 
+/**
+ * @description: 把ANALYZE生成的统计信息刷入磁盘中，与元数据文件放在同一个目录下
+ */
+void SmManager::flush_stats() {
+    std::ofstream ofs(DB_STATS_NAME);
+    // 直方图边界和高频值需要原样读回，不能损失精度
+    ofs << std::setprecision(17) << stats_.size() << '\n';
+    for (auto &entry : stats_) {
+        ofs << entry.first << ' ' << entry.second;
+    }
+}
+
+/**
+ * @description: 从磁盘中加载统计信息，没有执行过ANALYZE的数据库没有统计信息文件
+ */
+void SmManager::load_stats() {
+    stats_.clear();
+    std::ifstream ifs(DB_STATS_NAME);
+    size_t n;
+    if (!(ifs >> n)) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        std::string tab_name;
+        ifs >> tab_name;
+        ifs >> stats_[tab_name];
+    }
+}
+
 /**
  * @description: 关闭数据库并把数据落盘
  */
 void SmManager::close_db() {
-    
+    flush_meta();
+    flush_stats();
+    for (auto &entry : fhs_) {
+        rm_manager_->close_file(entry.second.get());
+    }
+    for (auto &entry : ihs_) {
+        ix_manager_->close_index(entry.second.get());
+    }
+    for (auto &entry : hhs_) {
+        ix_manager_->close_hash_index(entry.second.get());
+    }
+    fhs_.clear();
+    ihs_.clear();
+    hhs_.clear();
+    stats_.clear();
+    db_.name_.clear();
+    db_.tabs_.clear();
+    if (chdir("..") < 0) {
+        throw UnixError();
+    }
 }
 
 /**
@@ -196,9 +269,113 @@ void SmManager::drop_table(const std::string& tab_name, Context* context) {
  * @param {string&} tab_name 表的名称
  * @param {vector<string>&} col_names 索引包含的字段名称
  * @param {Context*} context
+ * @param {IndexType} type 索引的类型，默认为B+树
+ * @param {bool} unique 是否为唯一索引，哈希索引只能是唯一索引
+ * @param {bool} bloom 是否在B+树索引上维护Bloom filter，查找不存在的key时不需要从根结点向下查找
  */
-void SmManager::create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context) {
-    
+void SmManager::create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context,
+                             IndexType type, bool unique, bool bloom) {
+    TabMeta &tab = db_.get_table(tab_name);
+    if (tab.is_index(col_names)) {
+        throw IndexExistsError(tab_name, col_names);
+    }
+    if (type == INDEX_HASH && !unique) {
+        throw InternalError("SmManager::create_index: hash index must be unique");
+    }
+    if (type == INDEX_HASH && bloom) {
+        throw InternalError("SmManager::create_index: bloom filter is only supported on b+ tree index");
+    }
+    IndexMeta index = {.tab_name = tab_name,
+                       .col_tot_len = 0,
+                       .col_num = (int)col_names.size(),
+                       .type = type,
+                       .unique = unique,
+                       .bloom = bloom};
+    for (auto &col_name : col_names) {
+        auto col = tab.get_col(col_name);
+        index.cols.push_back(*col);
+        index.col_tot_len += col->len;
+    }
+    if (type == INDEX_HASH) {
+        create_hash_index(tab, index, context);
+        return;
+    }
+    ix_manager_->create_index(tab_name, index.cols, unique);
+    auto ih = ix_manager_->open_index(tab_name, index.cols);
+
+    // 扫描表中已有的记录，对(key, Rid)排序之后自底向上批量构建B+树，避免逐条插入时反复分裂
+    std::string ix_name = ix_manager_->get_index_name(tab_name, index.cols);
+    RmFileHandle *fh = fhs_.at(tab_name).get();
+    try {
+        IxExternalSorter sorter(ih->get_file_hdr(), ix_name);
+        // 非唯一索引的key末尾追加Rid
+        std::vector<char> key(ih->get_file_hdr()->col_tot_len_);
+        for (RmScan scan(fh); !scan.is_end(); scan.next()) {
+            auto rec = fh->get_record(scan.rid(), context);
+            int offset = 0;
+            for (auto &col : index.cols) {
+                ix_encode_col(key.data() + offset, rec->data + col.offset, col.type, col.len);
+                offset += col.len;
+            }
+            if (!unique) {
+                ix_encode_rid(key.data() + offset, scan.rid());
+            }
+            sorter.add(key.data(), scan.rid());
+        }
+        sorter.finish();
+        ih->bulk_load(sorter);
+        if (bloom) {
+            ih->build_bloom_filter();
+        }
+    } catch (RMDBError &) {
+        ix_manager_->close_index(ih.get());
+        ix_manager_->destroy_index(tab_name, index.cols);
+        throw;
+    }
+
+    for (auto &col : index.cols) {
+        tab.get_col(col.name)->index = true;
+    }
+    tab.indexes.push_back(index);
+    ihs_.emplace(ix_name, std::move(ih));
+    flush_meta();
+}
+
+/**
+ * @description: 创建哈希索引，扫描表中已有的记录逐条插入，桶满时分裂
+ * @param {TabMeta&} tab 表的元数据
+ * @param {IndexMeta&} index 索引的元数据
+ * @param {Context*} context
+ */
+void SmManager::create_hash_index(TabMeta& tab, const IndexMeta& index, Context* context) {
+    ix_manager_->create_hash_index(tab.name, index.cols);
+    auto hh = ix_manager_->open_hash_index(tab.name, index.cols);
+    RmFileHandle *fh = fhs_.at(tab.name).get();
+    try {
+        std::vector<char> key(index.col_tot_len);
+        for (RmScan scan(fh); !scan.is_end(); scan.next()) {
+            auto rec = fh->get_record(scan.rid(), context);
+            int offset = 0;
+            for (auto &col : index.cols) {
+                memcpy(key.data() + offset, rec->data + col.offset, col.len);
+                offset += col.len;
+            }
+            if (hh->insert_entry(key.data(), scan.rid(), nullptr) == IX_NO_PAGE) {
+                throw IndexEntryExistsError();
+            }
+        }
+    } catch (RMDBError &) {
+        ix_manager_->close_hash_index(hh.get());
+        ix_manager_->destroy_index(tab.name, index.cols);
+        throw;
+    }
+
+    for (auto &col : index.cols) {
+        tab.get_col(col.name)->index = true;
+    }
+    tab.indexes.push_back(index);
+    hhs_.emplace(ix_manager_->get_index_name(tab.name, index.cols), std::move(hh));
+    flush_meta();
 }
 
 /**
@@ -219,4 +396,28 @@ void SmManager::drop_index(const std::string& tab_name, const std::vector<std::s
  */
 void SmManager::drop_index(const std::string& tab_name, const std::vector<ColMeta>& cols, Context* context) {
     
-}
\ No newline at end of file
+}
+/**
+ * @description: 收集表的统计信息，使用蓄水池抽样从表中抽取至多STATS_SAMPLE_SIZE条记录，
+ * 根据样本生成各个字段的统计信息，并写入统计信息文件
+ * @param {string&} tab_name 表名称
+ * @param {Context*} context
+ */
+void SmManager::analyze_table(const std::string& tab_name, Context* context) {
+    TabMeta &tab = db_.get_table(tab_name);
+    RmFileHandle *fh = fhs_.at(tab_name).get();
+
+    ReservoirSampler sampler(STATS_SAMPLE_SIZE);
+    std::vector<std::unique_ptr<RmRecord>> samples;
+    for (RmScan scan(fh); !scan.is_end(); scan.next()) {
+        int64_t pos = sampler.offer();
+        if (pos < 0) continue;
+        if ((size_t)pos == samples.size()) {
+            samples.push_back(fh->get_record(scan.rid(), context));
+        } else {
+            samples[pos] = fh->get_record(scan.rid(), context);
+        }
+    }
+    stats_[tab_name] = TabStats::build(tab, samples, sampler.num_seen(), fh->get_file_hdr().num_pages);
+    flush_stats();
+}
@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 #include "record/rm_file_handle.h"
 #include "sm_defs.h"
 #include "sm_meta.h"
+#include "sm_stats.h"
 #include "common/context.h"
 
 class Context;
@@ -30,6 +31,8 @@ class SmManager {
     DbMeta db_;             // 当前打开的数据库的元数据
     std::unordered_map<std::string, std::unique_ptr<RmFileHandle>> fhs_;    // file name -> record file handle, 当前数据库中每张表的数据文件
     std::unordered_map<std::string, std::unique_ptr<IxIndexHandle>> ihs_;   // file name -> index file handle, 当前数据库中每个索引的文件
+    std::unordered_map<std::string, std::unique_ptr<IxHashHandle>> hhs_;    // file name -> hash index handle, 当前数据库中每个哈希索引的文件
+    std::unordered_map<std::string, TabStats> stats_;   // table name -> table statistics, ANALYZE生成的统计信息
    private:
     DiskManager* disk_manager_;
     BufferPoolManager* buffer_pool_manager_;
@@ -64,6 +67,10 @@ class SmManager {
 
     void flush_meta();
 
+    void flush_stats();
+
+    void load_stats();
+
     void show_tables(Context* context);
 
     void desc_table(const std::string& tab_name, Context* context);
@@ -72,9 +79,15 @@ class SmManager {
 
     void drop_table(const std::string& tab_name, Context* context);
 
-    void create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context);
+    void create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context,
+                      IndexType type = INDEX_BTREE, bool unique = true, bool bloom = false);
 
     void drop_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context);
     
     void drop_index(const std::string& tab_name, const std::vector<ColMeta>& col_names, Context* context);
+
+    void analyze_table(const std::string& tab_name, Context* context);
+
+   private:
+    void create_hash_index(TabMeta& tab, const IndexMeta& index, Context* context);
 };
\ No newline at end of file
@@ -45,9 +45,13 @@ struct IndexMeta {
     int col_tot_len;                // 索引字段长度总和
     int col_num;                    // 索引字段数量
     std::vector<ColMeta> cols;      // 索引包含的字段
+    IndexType type = INDEX_BTREE;   // 索引的类型
+    bool unique = true;             // 是否为唯一索引，非唯一的B+树索引中相同的key可以对应多个Rid
+    bool bloom = false;             // B+树索引是否维护Bloom filter，Bloom filter只在内存中，打开数据库时重新构建
 
     friend std::ostream &operator<<(std::ostream &os, const IndexMeta &index) {
-        os << index.tab_name << " " << index.col_tot_len << " " << index.col_num;
+        os << index.tab_name << " " << index.col_tot_len << " " << index.col_num << " " << index.type << " "
+           << index.unique << " " << index.bloom;
         for(auto& col: index.cols) {
             os << "\n" << col;
         }
@@ -55,7 +59,9 @@ struct IndexMeta {
     }
 
     friend std::istream &operator>>(std::istream &is, IndexMeta &index) {
-        is >> index.tab_name >> index.col_tot_len >> index.col_num;
+        int type;
+        is >> index.tab_name >> index.col_tot_len >> index.col_num >> type >> index.unique >> index.bloom;
+        index.type = static_cast<IndexType>(type);
         for(int i = 0; i < index.col_num; ++i) {
             ColMeta col;
             is >> col;
@@ -0,0 +1,198 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "sm_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+/**
+ * @description: 把字段的值转换成double，字符串取前8个字节按照256进制转换成[0, 1)之间的小数
+ * @return {double} 转换后的值，保持原有的大小关系（字符串前8个字节相同时会被视为相等）
+ * @param {ColType} type 字段类型
+ * @param {char*} data 字段的数据
+ * @param {int} len 字段长度
+ */
+double ColStats::to_scalar(ColType type, const char *data, int len) {
+    switch (type) {
+        case TYPE_INT:
+            return *(const int *)data;
+        case TYPE_FLOAT:
+            return *(const float *)data;
+        default: {
+            double res = 0, base = 1;
+            for (int i = 0; i < len && i < 8; i++) {
+                base /= 256;
+                res += (unsigned char)data[i] * base;
+            }
+            return res;
+        }
+    }
+}
+
+double ColStats::to_scalar(const Value &val) {
+    switch (val.type) {
+        case TYPE_INT:
+            return val.int_val;
+        case TYPE_FLOAT:
+            return val.float_val;
+        default: {
+            char buf[8] = {0};
+            memcpy(buf, val.str_val.c_str(), std::min<size_t>(val.str_val.size(), sizeof(buf)));
+            return to_scalar(TYPE_STRING, buf, sizeof(buf));
+        }
+    }
+}
+
+/**
+ * @description: 根据样本生成列的统计信息
+ * @param {vector<double>} vals 样本中该列的值
+ * @param {size_t} num_rows 表中的记录数，样本可能只是表的一部分
+ */
+ColStats ColStats::build(std::vector<double> vals, size_t num_rows) {
+    ColStats stats;
+    if (vals.empty()) {
+        return stats;
+    }
+    std::sort(vals.begin(), vals.end());
+    size_t n = vals.size();
+    stats.min_val = vals.front();
+    stats.max_val = vals.back();
+
+    // 统计样本中每个值出现的次数
+    std::vector<std::pair<size_t, double>> freqs;   // <出现次数, 值>
+    for (size_t i = 0, j; i < n; i = j) {
+        for (j = i; j < n && vals[j] == vals[i]; j++) {
+        }
+        freqs.emplace_back(j - i, vals[i]);
+    }
+    size_t d = freqs.size();
+    size_t f1 = std::count_if(freqs.begin(), freqs.end(), [](const std::pair<size_t, double> &f) { return f.first == 1; });
+
+    // 样本就是全表时不同值的个数是准确的，否则使用Haas-Stokes的Duj1估计：n * d / (n - f1 + f1 * n / N)
+    if (n >= num_rows) {
+        stats.ndv = d;
+    } else {
+        double est = (double)n * d / (n - f1 + (double)f1 * n / num_rows);
+        stats.ndv = std::min<size_t>(num_rows, std::max<size_t>(d, (size_t)est));
+    }
+
+    // 出现次数超过一个直方图桶的平均深度的值记为高频值
+    std::sort(freqs.begin(), freqs.end(), [](const std::pair<size_t, double> &a, const std::pair<size_t, double> &b) {
+        return a.first > b.first;
+    });
+    for (auto &freq : freqs) {
+        if (stats.mcvs.size() >= STATS_NUM_MCVS || freq.first < 2 || freq.first * STATS_NUM_BUCKETS < n) break;
+        stats.mcvs.emplace_back(freq.second, (double)freq.first / n);
+    }
+
+    // 等深直方图，每个桶中的样本个数相同
+    size_t num_buckets = std::min(STATS_NUM_BUCKETS, n);
+    for (size_t i = 0; i <= num_buckets; i++) {
+        stats.bounds.push_back(vals[i * (n - 1) / num_buckets]);
+    }
+    return stats;
+}
+
+/**
+ * @description: 估算 col = val 的选择率，高频值直接使用样本中的频率，其他值平分剩余的频率
+ */
+double ColStats::eq_selectivity(double val, size_t num_rows) const {
+    if (val < min_val || val > max_val) {
+        return 0;
+    }
+    double mcv_freq = 0;
+    for (auto &mcv : mcvs) {
+        if (mcv.first == val) return mcv.second;
+        mcv_freq += mcv.second;
+    }
+    size_t num_others = ndv > mcvs.size() ? ndv - mcvs.size() : 1;
+    return std::max(0.0, 1 - mcv_freq) / num_others;
+}
+
+/**
+ * @description: 估算 col < val 的选择率，在直方图中找到val所在的桶，桶内按照均匀分布线性插值
+ */
+double ColStats::lt_selectivity(double val) const {
+    if (bounds.size() < 2 || val <= bounds.front()) {
+        return 0;
+    }
+    if (val > bounds.back()) {
+        return 1;
+    }
+    size_t num_buckets = bounds.size() - 1;
+    // 第一个大于等于val的桶边界，val位于第pos - 1个桶中
+    size_t pos = std::lower_bound(bounds.begin(), bounds.end(), val) - bounds.begin();
+    double lo = bounds[pos - 1], hi = bounds[pos];
+    double frac = hi > lo ? (val - lo) / (hi - lo) : 0;
+    return (pos - 1 + frac) / num_buckets;
+}
+
+/**
+ * @description: 根据样本生成表的统计信息
+ * @param {TabMeta&} tab 表的元数据
+ * @param {vector<unique_ptr<RmRecord>>&} samples 抽样得到的记录
+ * @param {size_t} num_rows 表中的记录数
+ * @param {int} num_pages 表的数据文件中的页面数
+ */
+TabStats TabStats::build(const TabMeta &tab, const std::vector<std::unique_ptr<RmRecord>> &samples, size_t num_rows,
+                         int num_pages) {
+    TabStats stats;
+    stats.num_rows = num_rows;
+    stats.num_pages = num_pages;
+    for (auto &col : tab.cols) {
+        std::vector<double> vals;
+        vals.reserve(samples.size());
+        for (auto &rec : samples) {
+            vals.push_back(ColStats::to_scalar(col.type, rec->data + col.offset, col.len));
+        }
+        stats.cols[col.name] = ColStats::build(std::move(vals), num_rows);
+    }
+    return stats;
+}
+
+/**
+ * @description: 估算列与常量比较的条件的选择率
+ * @return {double} 选择率，没有该列的统计信息或者条件不是列与常量的比较时返回-1
+ * @param {Condition&} cond 条件，左侧列属于当前表
+ */
+double TabStats::get_selectivity(const Condition &cond) const {
+    auto col = cols.find(cond.lhs_col.col_name);
+    if (!cond.is_rhs_val || col == cols.end() || num_rows == 0) {
+        return -1;
+    }
+    auto &stats = col->second;
+    double val = ColStats::to_scalar(cond.rhs_val);
+    double eq = stats.eq_selectivity(val, num_rows);
+    double lt = stats.lt_selectivity(val);
+    double sel;
+    switch (cond.op) {
+        case OP_EQ:
+            sel = eq;
+            break;
+        case OP_NE:
+            sel = 1 - eq;
+            break;
+        case OP_LT:
+            sel = lt;
+            break;
+        case OP_LE:
+            sel = lt + eq;
+            break;
+        case OP_GT:
+            sel = 1 - lt - eq;
+            break;
+        default:
+            sel = 1 - lt;
+            break;
+    }
+    // 估算值不能为0，否则后续的代价估算无法区分不同的计划
+    return std::min(1.0, std::max(sel, 1.0 / num_rows));
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/common.h"
+#include "sm_meta.h"
+
+/* ANALYZE时每张表最多抽样的记录数 */
+static constexpr size_t STATS_SAMPLE_SIZE = 30000;
+/* 等深直方图的桶数 */
+static constexpr size_t STATS_NUM_BUCKETS = 64;
+/* 最多记录的高频值个数 */
+static constexpr size_t STATS_NUM_MCVS = 16;
+
+/**
+ * 蓄水池抽样：依次处理N条记录，每条记录被选入样本的概率都是 capacity / N，
+ * offer()返回当前记录在样本中的位置，返回-1表示当前记录不需要放入样本，调用方可以跳过读取该记录
+ */
+class ReservoirSampler {
+   private:
+    size_t capacity_;
+    size_t num_seen_ = 0;
+    std::mt19937_64 rng_;
+
+   public:
+    explicit ReservoirSampler(size_t capacity, uint64_t seed = std::random_device{}())
+        : capacity_(capacity), rng_(seed) {}
+
+    int64_t offer() {
+        num_seen_++;
+        if (num_seen_ <= capacity_) {
+            return num_seen_ - 1;
+        }
+        uint64_t pos = std::uniform_int_distribution<uint64_t>(0, num_seen_ - 1)(rng_);
+        return pos < capacity_ ? (int64_t)pos : -1;
+    }
+
+    size_t num_seen() const { return num_seen_; }
+};
+
+/* 列的统计信息，所有的值都转换成double之后保存，字符串按照前8个字节转换，保持字典序 */
+struct ColStats {
+    size_t ndv = 0;                                 // 不同值的个数
+    size_t num_nulls = 0;                           // 空值个数，目前所有字段都不允许为空，恒为0
+    double min_val = 0;                             // 最小值
+    double max_val = 0;                             // 最大值
+    std::vector<double> bounds;                     // 等深直方图的桶边界，桶的个数为bounds.size() - 1
+    std::vector<std::pair<double, double>> mcvs;    // 高频值及其在表中出现的频率
+
+    static double to_scalar(ColType type, const char *data, int len);
+
+    static double to_scalar(const Value &val);
+
+    static ColStats build(std::vector<double> vals, size_t num_rows);
+
+    double eq_selectivity(double val, size_t num_rows) const;
+
+    double lt_selectivity(double val) const;
+
+    friend std::ostream &operator<<(std::ostream &os, const ColStats &stats) {
+        os << stats.ndv << ' ' << stats.num_nulls << ' ' << stats.min_val << ' ' << stats.max_val << ' '
+           << stats.bounds.size();
+        for (auto bound : stats.bounds) {
+            os << ' ' << bound;
+        }
+        os << ' ' << stats.mcvs.size();
+        for (auto &mcv : stats.mcvs) {
+            os << ' ' << mcv.first << ' ' << mcv.second;
+        }
+        return os;
+    }
+
+    friend std::istream &operator>>(std::istream &is, ColStats &stats) {
+        size_t n;
+        is >> stats.ndv >> stats.num_nulls >> stats.min_val >> stats.max_val >> n;
+        stats.bounds.resize(n);
+        for (auto &bound : stats.bounds) {
+            is >> bound;
+        }
+        is >> n;
+        stats.mcvs.resize(n);
+        for (auto &mcv : stats.mcvs) {
+            is >> mcv.first >> mcv.second;
+        }
+        return is;
+    }
+};
+
+/* 表的统计信息，由ANALYZE语句生成，保存在数据库目录下的DB_STATS_NAME文件中 */
+struct TabStats {
+    size_t num_rows = 0;                        // 表中的记录数
+    int num_pages = 0;                          // 表的数据文件中的页面数
+    std::map<std::string, ColStats> cols;       // 列名 -> 列的统计信息
+
+    static TabStats build(const TabMeta &tab, const std::vector<std::unique_ptr<RmRecord>> &samples,
+                          size_t num_rows, int num_pages);
+
+    double get_selectivity(const Condition &cond) const;
+
+    friend std::ostream &operator<<(std::ostream &os, const TabStats &stats) {
+        os << stats.num_rows << ' ' << stats.num_pages << ' ' << stats.cols.size() << '\n';
+        for (auto &entry : stats.cols) {
+            os << entry.first << ' ' << entry.second << '\n';
+        }
+        return os;
+    }
+
+    friend std::istream &operator>>(std::istream &is, TabStats &stats) {
+        size_t n;
+        is >> stats.num_rows >> stats.num_pages >> n;
+        for (size_t i = 0; i < n; i++) {
+            std::string col_name;
+            is >> col_name;
+            is >> stats.cols[col_name];
+        }
+        return is;
+    }
+};
@@ -10,27 +10,439 @@ See the Mulan PSL v2 for more details. */
 
 #include "lock_manager.h"
 
+#include <algorithm>
+#include <ctime>
+#include <functional>
+
+std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(50);
+
+/**
+ * @description: 两种锁是否相容，按照多粒度锁的相容矩阵。escrow锁之间相容，与S、X不相容：
+ * 增量修改可以交换顺序，但是读到的值或者覆盖写入的值会受到其他事务还没有提交的增量影响
+ */
+bool LockManager::compatible(LockMode a, LockMode b) {
+    static const bool matrix[NUM_LOCK_MODES][NUM_LOCK_MODES] = {
+        //            S      X      IS     IX     SIX    E
+        /* S   */ {true, false, true, false, false, false},
+        /* X   */ {false, false, false, false, false, false},
+        /* IS  */ {true, false, true, true, true, true},
+        /* IX  */ {false, false, true, true, false, true},
+        /* SIX */ {false, false, true, false, false, false},
+        /* E   */ {false, false, true, true, false, true},
+    };
+    return matrix[static_cast<int>(a)][static_cast<int>(b)];
+}
+
+/**
+ * @description: 已经持有held的事务再申请requested时需要持有的锁，即两者的上确界，例如S和IX合并为SIX
+ */
+LockManager::LockMode LockManager::combine(LockMode held, LockMode requested) {
+    if (held == requested || requested == LockMode::INTENTION_SHARED) {
+        return held;
+    }
+    if (held == LockMode::INTENTION_SHARED) {
+        return requested;
+    }
+    // escrow锁与其他的锁合并时，既要增量修改又要读或者写，只能是X锁
+    if (held == LockMode::EXLUCSIVE || requested == LockMode::EXLUCSIVE || held == LockMode::ESCROW ||
+        requested == LockMode::ESCROW) {
+        return LockMode::EXLUCSIVE;
+    }
+    // 剩下的组合是S、IX、SIX中的两种不同的锁
+    return LockMode::S_IX;
+}
+
+/**
+ * @description: mode是否与队列中其他事务已经持有的锁都相容，self持有的锁不计入
+ */
+bool LockManager::compatible_with_granted(const LockRequestQueue &queue, LockMode mode, const LockRequest *self) {
+    for (int m = 0; m < NUM_LOCK_MODES; m++) {
+        int count = queue.granted_count_[m];
+        if (self != nullptr && self->granted_ && static_cast<int>(self->granted_mode_) == m) {
+            count--;
+        }
+        if (count > 0 && !compatible(static_cast<LockMode>(m), mode)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @description: 是否可以授予request：锁升级优先于其他等待的申请，只需要与已经持有的锁相容；
+ * 新的申请按照先后顺序授予，前面的申请都已经授予并且没有正在等待的锁升级时才能授予
+ */
+bool LockManager::can_grant(const LockRequestQueue &queue, const LockRequest &request) {
+    if (request.upgrading_) {
+        return compatible_with_granted(queue, request.lock_mode_, &request);
+    }
+    if (queue.upgrading_) {
+        return false;
+    }
+    for (auto &other : queue.request_queue_) {
+        if (&other == &request) {
+            break;
+        }
+        if (!other.granted_) {
+            return false;
+        }
+    }
+    return compatible_with_granted(queue, request.lock_mode_, nullptr);
+}
+
+void LockManager::grant(LockRequestQueue &queue, LockRequest &request) {
+    if (request.granted_) {
+        queue.granted_count_[static_cast<int>(request.granted_mode_)]--;
+    }
+    queue.granted_count_[static_cast<int>(request.lock_mode_)]++;
+    if (request.upgrading_) {
+        request.upgrading_ = false;
+        queue.upgrading_ = false;
+    }
+    request.granted_ = true;
+    request.granted_mode_ = request.lock_mode_;
+    update_group_lock_mode(queue);
+}
+
+void LockManager::release(LockRequestQueue &queue, LockMode mode) {
+    queue.granted_count_[static_cast<int>(mode)]--;
+    update_group_lock_mode(queue);
+}
+
+void LockManager::update_group_lock_mode(LockRequestQueue &queue) {
+    auto count = [&](LockMode mode) { return queue.granted_count_[static_cast<int>(mode)]; };
+    if (count(LockMode::EXLUCSIVE) > 0) {
+        queue.group_lock_mode_ = GroupLockMode::X;
+    } else if (count(LockMode::S_IX) > 0 || (count(LockMode::SHARED) > 0 && count(LockMode::INTENTION_EXCLUSIVE) > 0)) {
+        queue.group_lock_mode_ = GroupLockMode::SIX;
+    } else if (count(LockMode::SHARED) > 0) {
+        queue.group_lock_mode_ = GroupLockMode::S;
+    } else if (count(LockMode::ESCROW) > 0) {
+        queue.group_lock_mode_ = GroupLockMode::E;
+    } else if (count(LockMode::INTENTION_EXCLUSIVE) > 0) {
+        queue.group_lock_mode_ = GroupLockMode::IX;
+    } else if (count(LockMode::INTENTION_SHARED) > 0) {
+        queue.group_lock_mode_ = GroupLockMode::IS;
+    } else {
+        queue.group_lock_mode_ = GroupLockMode::NON_LOCK;
+    }
+}
+
+/**
+ * @description: 与request冲突、request需要等待的申请，包括持有不相容的锁的事务，以及新的申请需要排在后面等待的事务
+ */
+std::vector<LockManager::LockRequest *> LockManager::get_conflicts(LockRequestQueue &queue, const LockRequest &request) {
+    std::vector<LockRequest *> conflicts;
+    bool before = true;    // other是否排在request前面
+    for (auto &other : queue.request_queue_) {
+        if (&other == &request) {
+            before = false;
+            continue;
+        }
+        bool conflict;
+        if (other.granted_) {
+            conflict = !compatible(other.granted_mode_, request.lock_mode_) || (!request.upgrading_ && other.upgrading_);
+        } else {
+            conflict = before && !request.upgrading_;
+        }
+        if (conflict) {
+            conflicts.push_back(&other);
+        }
+    }
+    return conflicts;
+}
+
+/**
+ * @description: request不能立即授予时按照冲突处理策略决定等待还是回滚
+ * @return {bool} true表示等待，false表示回滚申请加锁的事务
+ * @param {vector<txn_id_t>*} wounded wound-wait策略下被回滚的年轻事务的ID。释放分区的latch之后事务对象可能已经结束并被释放，
+ * 因此只保存ID
+ */
+bool LockManager::resolve_conflict(LockRequestQueue &queue, LockRequest &request, std::vector<txn_id_t> *wounded) {
+    if (policy_ == DeadlockPolicy::NO_WAIT) {
+        return false;
+    }
+    if (policy_ == DeadlockPolicy::DETECTION) {
+        // 死锁由检测线程打破
+        return true;
+    }
+    for (auto other : get_conflicts(queue, request)) {
+        if (policy_ == DeadlockPolicy::WAIT_DIE && other->txn_id_ < request.txn_id_) {
+            return false;
+        }
+        if (policy_ == DeadlockPolicy::WOUND_WAIT && other->txn_id_ > request.txn_id_) {
+            // 正在提交的事务已经开始释放锁，不能再回滚，等待它释放即可
+            if (other->txn_->compare_and_set_state(TransactionState::GROWING, TransactionState::ABORTED)) {
+                wounded->push_back(other->txn_id_);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @description: 唤醒被wound的事务，它们可能正在其他数据项上等待锁，醒来之后发现自己已经被回滚
+ */
+void LockManager::wake_wounded(const std::vector<txn_id_t> &wounded) {
+    for (auto txn_id : wounded) {
+        std::unique_lock<std::mutex> waits_lock(waits_latch_);
+        auto it = waiting_.find(txn_id);
+        if (it == waiting_.end()) {
+            continue;
+        }
+        LockDataId lock_data_id = it->second;
+        waits_lock.unlock();
+        auto &bucket = bucket_of(lock_data_id);
+        std::lock_guard<std::mutex> lock(bucket.latch_);
+        auto queue = bucket.lock_table_.find(lock_data_id);
+        if (queue != bucket.lock_table_.end()) {
+            queue->second.cv_.notify_all();
+        }
+    }
+}
+
 /**
- * @description: 申请行级共享锁
+ * @description: 在数据项上申请锁，已经持有的锁不够时升级，不能立即授予时按照冲突处理策略等待或者回滚
+ * @return {LockMode} 加锁之后事务在该数据项上持有的锁类型，失败时抛出TransactionAbortException
+ * @param {Transaction*} txn 要申请锁的事务对象指针
+ * @param {LockDataId&} lock_data_id 加锁的数据项
+ * @param {LockMode} lock_mode 申请的锁类型
+ */
+LockManager::LockMode LockManager::lock(Transaction *txn, const LockDataId &lock_data_id, LockMode lock_mode) {
+    txn_id_t txn_id = txn->get_transaction_id();
+    if (txn->get_state() == TransactionState::ABORTED) {
+        throw TransactionAbortException(txn_id, AbortReason::DEADLOCK_PREVENTION);
+    }
+    if (txn->get_state() == TransactionState::SHRINKING) {
+        // 两阶段封锁：释放锁之后不能再申请锁
+        txn->set_state(TransactionState::ABORTED);
+        throw TransactionAbortException(txn_id, AbortReason::LOCK_ON_SHIRINKING);
+    }
+    txn->compare_and_set_state(TransactionState::DEFAULT, TransactionState::GROWING);
+
+    auto &bucket = bucket_of(lock_data_id);
+    std::unique_lock<std::mutex> lock(bucket.latch_);
+    auto &queue = bucket.lock_table_[lock_data_id];
+    auto request = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                                [&](const LockRequest &req) { return req.txn_id_ == txn_id; });
+    if (request != queue.request_queue_.end()) {
+        // 已经持有锁
+        if (covers(request->granted_mode_, lock_mode)) {
+            return request->granted_mode_;
+        }
+        if (queue.upgrading_) {
+            txn->set_state(TransactionState::ABORTED);
+            throw TransactionAbortException(txn_id, AbortReason::UPGRADE_CONFLICT);
+        }
+        request->lock_mode_ = combine(request->granted_mode_, lock_mode);
+        request->upgrading_ = true;
+        queue.upgrading_ = true;
+    } else {
+        queue.request_queue_.emplace_back(txn, lock_mode);
+        request = std::prev(queue.request_queue_.end());
+    }
+
+    // 撤销还没有授予的申请，锁升级恢复为原来持有的锁
+    auto cancel = [&]() {
+        if (request->upgrading_) {
+            request->lock_mode_ = request->granted_mode_;
+            request->upgrading_ = false;
+            queue.upgrading_ = false;
+        } else {
+            queue.request_queue_.erase(request);
+        }
+        if (queue.request_queue_.empty() && queue.release_lsn_ == INVALID_LSN) {
+            bucket.lock_table_.erase(lock_data_id);
+        } else {
+            queue.cv_.notify_all();
+        }
+    };
+
+    if (!can_grant(queue, *request)) {
+        std::vector<txn_id_t> wounded;
+        if (!resolve_conflict(queue, *request, &wounded)) {
+            cancel();
+            txn->set_state(TransactionState::ABORTED);
+            throw TransactionAbortException(txn_id, AbortReason::DEADLOCK_PREVENTION);
+        }
+        {
+            std::lock_guard<std::mutex> waits_lock(waits_latch_);
+            waiting_.emplace(txn_id, lock_data_id);
+        }
+        if (!wounded.empty()) {
+            // 唤醒其他分区中的事务时不能持有当前分区的latch
+            lock.unlock();
+            wake_wounded(wounded);
+            lock.lock();
+        }
+        queue.cv_.wait(lock, [&]() {
+            return txn->get_state() == TransactionState::ABORTED || can_grant(queue, *request);
+        });
+        {
+            std::lock_guard<std::mutex> waits_lock(waits_latch_);
+            waiting_.erase(txn_id);
+        }
+        if (txn->get_state() == TransactionState::ABORTED) {
+            cancel();
+            throw TransactionAbortException(txn_id, policy_ == DeadlockPolicy::DETECTION
+                                                        ? AbortReason::DEADLOCK_DETECTION
+                                                        : AbortReason::DEADLOCK_PREVENTION);
+        }
+    }
+    grant(queue, *request);
+    LockMode granted_mode = request->granted_mode_;
+    if (queue.release_lsn_ != INVALID_LSN) {
+        // 前一个持有者提前释放了锁，它的修改可能还没有持久化
+        txn->add_dependency_lsn(queue.release_lsn_);
+    }
+    // 排在后面的申请可能因为前面的申请都已经授予而可以授予
+    queue.cv_.notify_all();
+    lock.unlock();
+    if (txn->get_lock_set()->insert(lock_data_id).second && lock_data_id.type_ == LockDataType::RECORD) {
+        txn->get_row_lock_counts()[lock_data_id.fd_]++;
+    }
+    return granted_mode;
+}
+
+/**
+ * @description: 释放事务在数据项上已经授予的锁，唤醒在该数据项上等待的事务，不修改事务的状态和锁集
+ * @return {bool} 事务是否持有该锁
+ * @param {lsn_t} commit_lsn 提前释放锁时事务的提交日志lsn，否则为INVALID_LSN
+ */
+bool LockManager::release_lock(txn_id_t txn_id, const LockDataId &lock_data_id, lsn_t commit_lsn) {
+    auto &bucket = bucket_of(lock_data_id);
+    std::lock_guard<std::mutex> lock(bucket.latch_);
+    auto queue = bucket.lock_table_.find(lock_data_id);
+    if (queue == bucket.lock_table_.end()) {
+        return false;
+    }
+    auto &requests = queue->second.request_queue_;
+    auto request = std::find_if(requests.begin(), requests.end(),
+                                [&](const LockRequest &req) { return req.txn_id_ == txn_id && req.granted_; });
+    if (request == requests.end()) {
+        return false;
+    }
+    if (commit_lsn != INVALID_LSN && request->granted_mode_ != LockMode::SHARED &&
+        request->granted_mode_ != LockMode::INTENTION_SHARED) {
+        queue->second.release_lsn_ = std::max(queue->second.release_lsn_, commit_lsn);
+    }
+    release(queue->second, request->granted_mode_);
+    requests.erase(request);
+    if (requests.empty() && queue->second.release_lsn_ == INVALID_LSN) {
+        bucket.lock_table_.erase(queue);
+    } else {
+        queue->second.cv_.notify_all();
+    }
+    return true;
+}
+
+/**
+ * @description: 锁升级。事务在表上的行锁个数达到阈值时，如果表级S/X锁与其他事务持有的表锁相容，
+ * 直接把表锁升级（不等待，不相容时放弃，等行锁个数达到阈值的下一个整数倍时再尝试），然后释放该表上的所有行锁。
+ * 其他事务在这张表上加行锁之前都要先持有表级意向锁，因此升级成功时没有其他事务持有或者等待这些行锁。
+ * 调用者必须已经持有该表上的表锁（lock_*_on_record在加行锁之前申请表级意向锁），否则不升级
+ * @param {Transaction*} txn 刚刚在表上获得行锁的事务
+ * @param {int} tab_fd 表的fd
+ */
+void LockManager::escalate(Transaction *txn, int tab_fd) {
+    auto &row_lock_counts = txn->get_row_lock_counts();
+    auto count = row_lock_counts.find(tab_fd);
+    if (escalation_threshold_ == 0 || count == row_lock_counts.end() || count->second == 0 ||
+        count->second % escalation_threshold_ != 0) {
+        return;
+    }
+    txn_id_t txn_id = txn->get_transaction_id();
+    LockDataId table_id(tab_fd, LockDataType::TABLE);
+    {
+        auto &bucket = bucket_of(table_id);
+        std::lock_guard<std::mutex> lock(bucket.latch_);
+        auto it = bucket.lock_table_.find(table_id);
+        if (it == bucket.lock_table_.end()) {
+            return;
+        }
+        auto &queue = it->second;
+        auto request = std::find_if(queue.request_queue_.begin(), queue.request_queue_.end(),
+                                    [&](const LockRequest &req) { return req.txn_id_ == txn_id; });
+        // 没有持有表锁时不升级
+        if (request == queue.request_queue_.end() || !request->granted_) {
+            return;
+        }
+        // 持有IX或SIX说明有行级X锁，需要升级为表级X锁
+        LockMode held = request->granted_mode_;
+        LockMode target = held == LockMode::INTENTION_EXCLUSIVE || held == LockMode::S_IX ? LockMode::EXLUCSIVE
+                                                                                          : LockMode::SHARED;
+        if (queue.upgrading_ || !compatible_with_granted(queue, target, &*request)) {
+            num_escalation_failures_.fetch_add(1);
+            return;
+        }
+        request->lock_mode_ = target;
+        grant(queue, *request);
+    }
+    auto lock_set = txn->get_lock_set();
+    size_t num_released = 0;
+    for (auto it = lock_set->begin(); it != lock_set->end();) {
+        if (it->type_ == LockDataType::RECORD && it->fd_ == tab_fd) {
+            release_lock(txn_id, *it);
+            it = lock_set->erase(it);
+            num_released++;
+        } else {
+            ++it;
+        }
+    }
+    row_lock_counts.erase(count);
+    num_escalations_.fetch_add(1);
+    num_escalated_locks_.fetch_add(num_released);
+}
+
+/**
+ * @description: 申请行级共享锁，先申请表级意向共享锁，已经持有表级S/SIX/X锁时不需要行锁。
+ * 表级意向锁必须在行锁之前获得，escalate依赖事务已经持有表锁
  * @return {bool} 加锁是否成功
  * @param {Transaction*} txn 要申请锁的事务对象指针
  * @param {Rid&} rid 加锁的目标记录ID 记录所在的表的fd
  * @param {int} tab_fd
  */
 bool LockManager::lock_shared_on_record(Transaction* txn, const Rid& rid, int tab_fd) {
-    
+    if (covers(lock(txn, LockDataId(tab_fd, LockDataType::TABLE), LockMode::INTENTION_SHARED), LockMode::SHARED)) {
+        return true;
+    }
+    lock(txn, LockDataId(tab_fd, rid, LockDataType::RECORD), LockMode::SHARED);
+    escalate(txn, tab_fd);
     return true;
 }
 
 /**
- * @description: 申请行级排他锁
+ * @description: 申请行级排他锁，先申请表级意向排他锁，已经持有表级X锁时不需要行锁。
+ * 表级意向锁必须在行锁之前获得，escalate依赖事务已经持有表锁
  * @return {bool} 加锁是否成功
  * @param {Transaction*} txn 要申请锁的事务对象指针
  * @param {Rid&} rid 加锁的目标记录ID
  * @param {int} tab_fd 记录所在的表的fd
  */
 bool LockManager::lock_exclusive_on_record(Transaction* txn, const Rid& rid, int tab_fd) {
+    if (lock(txn, LockDataId(tab_fd, LockDataType::TABLE), LockMode::INTENTION_EXCLUSIVE) == LockMode::EXLUCSIVE) {
+        return true;
+    }
+    lock(txn, LockDataId(tab_fd, rid, LockDataType::RECORD), LockMode::EXLUCSIVE);
+    escalate(txn, tab_fd);
+    return true;
+}
 
+/**
+ * @description: 申请行级escrow锁，先申请表级意向排他锁，已经持有表级X锁时不需要行锁。
+ * 持有escrow锁的事务之间不互相等待，它们的增量在提交时才写入记录。
+ * 表级意向锁必须在行锁之前获得，escalate依赖事务已经持有表锁
+ * @return {bool} 加锁是否成功
+ * @param {Transaction*} txn 要申请锁的事务对象指针
+ * @param {Rid&} rid 加锁的目标记录ID
+ * @param {int} tab_fd 记录所在的表的fd
+ */
+bool LockManager::lock_escrow_on_record(Transaction* txn, const Rid& rid, int tab_fd) {
+    if (lock(txn, LockDataId(tab_fd, LockDataType::TABLE), LockMode::INTENTION_EXCLUSIVE) == LockMode::EXLUCSIVE) {
+        return true;
+    }
+    lock(txn, LockDataId(tab_fd, rid, LockDataType::RECORD), LockMode::ESCROW);
+    escalate(txn, tab_fd);
     return true;
 }
 
@@ -41,7 +453,7 @@ bool LockManager::lock_exclusive_on_record(Transaction* txn, const Rid& rid, int
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_shared_on_table(Transaction* txn, int tab_fd) {
-    
+    lock(txn, LockDataId(tab_fd, LockDataType::TABLE), LockMode::SHARED);
     return true;
 }
 
@@ -52,7 +464,7 @@ bool LockManager::lock_shared_on_table(Transaction* txn, int tab_fd) {
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_exclusive_on_table(Transaction* txn, int tab_fd) {
-    
+    lock(txn, LockDataId(tab_fd, LockDataType::TABLE), LockMode::EXLUCSIVE);
     return true;
 }
 
@@ -63,7 +475,7 @@ bool LockManager::lock_exclusive_on_table(Transaction* txn, int tab_fd) {
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_IS_on_table(Transaction* txn, int tab_fd) {
-    
+    lock(txn, LockDataId(tab_fd, LockDataType::TABLE), LockMode::INTENTION_SHARED);
     return true;
 }
 
@@ -74,17 +486,193 @@ bool LockManager::lock_IS_on_table(Transaction* txn, int tab_fd) {
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_IX_on_table(Transaction* txn, int tab_fd) {
-    
+    lock(txn, LockDataId(tab_fd, LockDataType::TABLE), LockMode::INTENTION_EXCLUSIVE);
     return true;
 }
 
 /**
- * @description: 释放锁
+ * @description: 释放锁，唤醒在该数据项上等待的事务；两阶段封锁中事务进入SHRINKING阶段
  * @return {bool} 返回解锁是否成功
  * @param {Transaction*} txn 要释放锁的事务对象指针
  * @param {LockDataId} lock_data_id 要释放的锁ID
+ * @param {lsn_t} commit_lsn 提前释放锁时事务还没有持久化的提交日志lsn，否则为INVALID_LSN
  */
-bool LockManager::unlock(Transaction* txn, LockDataId lock_data_id) {
-   
+bool LockManager::unlock(Transaction* txn, LockDataId lock_data_id, lsn_t commit_lsn) {
+    if (!release_lock(txn->get_transaction_id(), lock_data_id, commit_lsn)) {
+        return false;
+    }
+    txn->compare_and_set_state(TransactionState::GROWING, TransactionState::SHRINKING);
+    if (txn->get_lock_set()->erase(lock_data_id) > 0 && lock_data_id.type_ == LockDataType::RECORD) {
+        auto &row_lock_counts = txn->get_row_lock_counts();
+        auto count = row_lock_counts.find(lock_data_id.fd_);
+        if (count != row_lock_counts.end() && --count->second == 0) {
+            row_lock_counts.erase(count);
+        }
+    }
     return true;
-}
\ No newline at end of file
+}
+
+void LockManager::clear_release_lsn(const LockDataId &lock_data_id, lsn_t durable_lsn) {
+    auto &bucket = bucket_of(lock_data_id);
+    std::lock_guard<std::mutex> lock(bucket.latch_);
+    auto queue = bucket.lock_table_.find(lock_data_id);
+    if (queue == bucket.lock_table_.end() || queue->second.release_lsn_ > durable_lsn) {
+        return;
+    }
+    queue->second.release_lsn_ = INVALID_LSN;
+    if (queue->second.request_queue_.empty()) {
+        bucket.lock_table_.erase(queue);
+    }
+}
+
+size_t LockManager::get_lock_table_size() {
+    size_t size = 0;
+    for (auto &bucket : buckets_) {
+        std::lock_guard<std::mutex> lock(bucket.latch_);
+        size += bucket.lock_table_.size();
+    }
+    return size;
+}
+
+void LockManager::set_policy(DeadlockPolicy policy) {
+    policy_ = policy;
+    if (policy == DeadlockPolicy::DETECTION) {
+        start_cycle_detection();
+    } else {
+        stop_cycle_detection();
+    }
+}
+
+void LockManager::start_cycle_detection() {
+    if (cycle_detection_thread_.joinable()) {
+        return;
+    }
+    enable_cycle_detection_ = true;
+    cycle_detection_thread_ = std::thread(&LockManager::run_cycle_detection, this);
+}
+
+void LockManager::stop_cycle_detection() {
+    if (!cycle_detection_thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(cycle_detection_latch_);
+        enable_cycle_detection_ = false;
+    }
+    cycle_detection_cv_.notify_all();
+    cycle_detection_thread_.join();
+}
+
+/**
+ * @description: 死锁检测线程，每隔cycle_detection_interval检测一次，并统计检测消耗的CPU时间
+ */
+void LockManager::run_cycle_detection() {
+    auto cpu_now = []() {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    };
+    std::unique_lock<std::mutex> lock(cycle_detection_latch_);
+    while (true) {
+        cycle_detection_cv_.wait_for(lock, cycle_detection_interval, [&]() { return !enable_cycle_detection_; });
+        if (!enable_cycle_detection_) {
+            break;
+        }
+        lock.unlock();
+        int64_t start = cpu_now();
+        detect_deadlocks();
+        detection_cpu_ns_.fetch_add(cpu_now() - start);
+        num_detection_runs_.fetch_add(1);
+        lock.lock();
+    }
+}
+
+/**
+ * @description: 在等待图中查找环路，按照事务ID从小到大的顺序深度优先搜索，结果是确定的
+ * @return {bool} 是否存在环路
+ * @param {map&} waits_for 等待图，事务ID到它等待的事务ID的边
+ * @param {txn_id_t*} victim 找到的环路中最年轻的事务
+ */
+bool LockManager::find_cycle(const std::map<txn_id_t, std::vector<txn_id_t>> &waits_for, txn_id_t *victim) {
+    enum { UNVISITED = 0, ON_PATH, FINISHED };
+    std::unordered_map<txn_id_t, int> color;
+    std::vector<txn_id_t> path;
+    std::function<bool(txn_id_t)> dfs = [&](txn_id_t txn_id) {
+        color[txn_id] = ON_PATH;
+        path.push_back(txn_id);
+        auto edges = waits_for.find(txn_id);
+        if (edges != waits_for.end()) {
+            for (txn_id_t next : edges->second) {
+                if (color[next] == ON_PATH) {
+                    // path中从next开始的部分构成环路
+                    *victim = *std::max_element(std::find(path.begin(), path.end(), next), path.end());
+                    return true;
+                }
+                if (color[next] == UNVISITED && dfs(next)) {
+                    return true;
+                }
+            }
+        }
+        color[txn_id] = FINISHED;
+        path.pop_back();
+        return false;
+    };
+    for (auto &[txn_id, edges] : waits_for) {
+        if (color[txn_id] == UNVISITED && dfs(txn_id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @description: 按照分区的顺序锁住所有分区，得到所有加锁队列的一致快照，从中构造等待图：
+ * 每个还没有授予的申请（包括正在等待的锁升级）指向与它冲突的申请所属的事务。
+ * 反复查找环路，回滚环路中最年轻的事务并从图中删除，直到没有环路。被回滚的事务在所等待的队列上被唤醒，
+ * 撤销申请并抛出异常，由调用者回滚事务释放它持有的锁
+ */
+size_t LockManager::detect_deadlocks() {
+    std::map<txn_id_t, std::vector<txn_id_t>> waits_for;
+    std::unordered_map<txn_id_t, std::pair<Transaction *, LockRequestQueue *>> waiters;
+    for (auto &bucket : buckets_) {
+        bucket.latch_.lock();
+    }
+    for (auto &bucket : buckets_) {
+        for (auto &[lock_data_id, queue] : bucket.lock_table_) {
+            for (auto &request : queue.request_queue_) {
+                if (request.granted_ && !request.upgrading_) {
+                    continue;
+                }
+                auto &edges = waits_for[request.txn_id_];
+                for (auto other : get_conflicts(queue, request)) {
+                    edges.push_back(other->txn_id_);
+                }
+                waiters[request.txn_id_] = {request.txn_, &queue};
+            }
+        }
+    }
+    for (auto &[txn_id, edges] : waits_for) {
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    }
+
+    size_t num_victims = 0;
+    txn_id_t victim;
+    while (find_cycle(waits_for, &victim)) {
+        waits_for.erase(victim);
+        for (auto &[txn_id, edges] : waits_for) {
+            edges.erase(std::remove(edges.begin(), edges.end(), victim), edges.end());
+        }
+        auto [txn, queue] = waiters[victim];
+        if (txn->compare_and_set_state(TransactionState::GROWING, TransactionState::ABORTED)) {
+            queue->cv_.notify_all();
+            num_victims++;
+        }
+    }
+    // 在被唤醒的事务看到自己被回滚之前计数
+    num_victims_.fetch_add(num_victims);
+    for (auto &bucket : buckets_) {
+        bucket.latch_.unlock();
+    }
+    return num_victims;
+}
@@ -10,47 +10,106 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "transaction/transaction.h"
 
-static const std::string GroupLockModeStr[10] = {"NON_LOCK", "IS", "IX", "S", "X", "SIX"};
+static const std::string GroupLockModeStr[10] = {"NON_LOCK", "IS", "IX", "S", "X", "SIX", "E"};
+
+/**
+ * 加锁冲突时的处理策略
+ * NO_WAIT：立即回滚申请加锁的事务；
+ * WAIT_DIE：事务ID越小越老，老事务等待年轻事务，年轻事务遇到老事务时回滚自己；
+ * WOUND_WAIT：老事务回滚（wound）持有或者排在前面的年轻事务之后等待，年轻事务等待老事务；
+ * DETECTION：冲突时总是等待，后台线程每隔cycle_detection_interval构造一次等待图，回滚每个环路中最年轻的事务
+ */
+enum class DeadlockPolicy { NO_WAIT = 0, WAIT_DIE, WOUND_WAIT, DETECTION };
+
+/* 死锁检测的统计信息 */
+struct DeadlockDetectionStats {
+    size_t num_runs;                    // 检测的次数
+    size_t num_victims;                 // 为了打破环路而回滚的事务个数
+    std::chrono::nanoseconds cpu_time;  // 检测线程消耗的CPU时间
+};
+
+/* 锁升级的统计信息 */
+struct LockEscalationStats {
+    size_t num_escalations;     // 行锁升级为表锁的次数
+    size_t num_failures;        // 与其他事务持有的表锁不相容而放弃升级的次数
+    size_t num_released_locks;  // 升级之后释放的行锁个数
+};
 
 class LockManager {
-    /* 加锁类型，包括共享锁、排他锁、意向共享锁、意向排他锁、SIX（意向排他锁+共享锁） */
-    enum class LockMode { SHARED, EXLUCSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, S_IX };
+    /**
+     * 加锁类型，包括共享锁、排他锁、意向共享锁、意向排他锁、SIX（意向排他锁+共享锁），
+     * 以及escrow锁：只加在记录上，持有者只对记录做可交换的增量修改（col = col + k），escrow锁之间相容
+     */
+    enum class LockMode { SHARED, EXLUCSIVE, INTENTION_SHARED, INTENTION_EXCLUSIVE, S_IX, ESCROW };
 
     /* 用于标识加锁队列中排他性最强的锁类型，例如加锁队列中有SHARED和EXLUSIVE两个加锁操作，则该队列的锁模式为X */
-    enum class GroupLockMode { NON_LOCK, IS, IX, S, X, SIX};
+    enum class GroupLockMode { NON_LOCK, IS, IX, S, X, SIX, E };
+
+    static constexpr int NUM_LOCK_MODES = 6;
 
     /* 事务的加锁申请 */
     class LockRequest {
     public:
-        LockRequest(txn_id_t txn_id, LockMode lock_mode)
-            : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false) {}
+        LockRequest(Transaction *txn, LockMode lock_mode)
+            : txn_id_(txn->get_transaction_id()), lock_mode_(lock_mode), granted_(false), txn_(txn) {}
 
         txn_id_t txn_id_;   // 申请加锁的事务ID
-        LockMode lock_mode_;    // 事务申请加锁的类型
+        LockMode lock_mode_;    // 事务申请加锁的类型，锁升级时为升级之后的类型
         bool granted_;          // 该事务是否已经被赋予锁
+        Transaction *txn_;      // 申请加锁的事务，wound-wait策略需要回滚其他事务
+        bool upgrading_ = false;    // 已经持有锁，正在等待升级
+        LockMode granted_mode_ = LockMode::INTENTION_SHARED;    // 正在升级时已经持有的锁类型
     };
 
     /* 数据项上的加锁队列 */
     class LockRequestQueue {
     public:
-        std::list<LockRequest> request_queue_;  // 加锁队列
+        std::list<LockRequest> request_queue_;  // 加锁队列，已经授予的申请在前，等待的申请按照先后顺序排在后面
         std::condition_variable cv_;            // 条件变量，用于唤醒正在等待加锁的申请，在no-wait策略下无需使用
         GroupLockMode group_lock_mode_ = GroupLockMode::NON_LOCK;   // 加锁队列的锁模式
+        int granted_count_[NUM_LOCK_MODES] = {};    // 已经授予的各种类型的锁的个数
+        bool upgrading_ = false;                // 是否有事务正在等待锁升级，同一时刻只允许一个
+        /**
+         * 提前释放写锁（X/IX/SIX/E）的事务的提交日志中最大的lsn，之后获得锁的事务依赖于它。
+         * 不为INVALID_LSN时队列为空也保留在锁表中，释放者的提交日志持久化之后由clear_release_lsn清除
+         */
+        lsn_t release_lsn_ = INVALID_LSN;
+    };
+
+    /**
+     * 锁表的一个分区，LockDataId::Get()的哈希值决定数据项属于哪个分区，每个分区有自己的latch，
+     * 不同分区上的加锁和解锁互不阻塞。按照cache line对齐，避免相邻分区的latch互相干扰
+     */
+    struct alignas(64) LockTableBucket {
+        std::mutex latch_;
+        std::unordered_map<LockDataId, LockRequestQueue> lock_table_;
     };
 
 public:
-    LockManager() {}
+    static constexpr size_t NUM_LOCK_TABLE_BUCKETS = 1024;
+    static constexpr size_t DEFAULT_ESCALATION_THRESHOLD = 5000;
 
-    ~LockManager() {}
+    explicit LockManager(DeadlockPolicy policy = DeadlockPolicy::NO_WAIT) { set_policy(policy); }
+
+    ~LockManager() { stop_cycle_detection(); }
 
     bool lock_shared_on_record(Transaction* txn, const Rid& rid, int tab_fd);
 
     bool lock_exclusive_on_record(Transaction* txn, const Rid& rid, int tab_fd);
 
+    bool lock_escrow_on_record(Transaction* txn, const Rid& rid, int tab_fd);
+
     bool lock_shared_on_table(Transaction* txn, int tab_fd);
 
     bool lock_exclusive_on_table(Transaction* txn, int tab_fd);
@@ -59,9 +118,106 @@ public:
 
     bool lock_IX_on_table(Transaction* txn, int tab_fd);
 
-    bool unlock(Transaction* txn, LockDataId lock_data_id);
+    /**
+     * 释放锁。提前释放（early lock release）时commit_lsn为释放者还没有持久化的提交日志的lsn，
+     * 之后获得该锁的事务在提交前需要等待它持久化
+     */
+    bool unlock(Transaction* txn, LockDataId lock_data_id, lsn_t commit_lsn = INVALID_LSN);
+
+    /* 提交日志持久化之后，清除数据项上不超过durable_lsn的release_lsn_，释放空的加锁队列 */
+    void clear_release_lsn(const LockDataId &lock_data_id, lsn_t durable_lsn);
+
+    DeadlockPolicy get_policy() const { return policy_; }
+
+    /* 修改冲突处理策略，只能在没有事务等待锁的时候调用，DETECTION策略下启动死锁检测线程 */
+    void set_policy(DeadlockPolicy policy);
+
+    /**
+     * @description: 构造等待图并打破其中所有的环路，每个环路回滚事务ID最大（最年轻）的事务。
+     * 由死锁检测线程周期性调用，也可以直接调用
+     * @return {size_t} 回滚的事务个数
+     */
+    size_t detect_deadlocks();
+
+    /**
+     * 事务在一张表上持有的行锁个数每达到threshold的整数倍时，尝试把它们升级为表级S锁（只有行级S锁时）或X锁，
+     * 然后释放这些行锁。threshold为0时不进行锁升级
+     */
+    void set_escalation_threshold(size_t threshold) { escalation_threshold_ = threshold; }
+    size_t get_escalation_threshold() const { return escalation_threshold_; }
+
+    LockEscalationStats get_escalation_stats() const {
+        return LockEscalationStats{.num_escalations = num_escalations_.load(),
+                                   .num_failures = num_escalation_failures_.load(),
+                                   .num_released_locks = num_escalated_locks_.load()};
+    }
+
+    /* 锁表中加锁队列的个数，需要锁住每个分区，只用于统计 */
+    size_t get_lock_table_size();
+
+    DeadlockDetectionStats get_detection_stats() const {
+        return DeadlockDetectionStats{.num_runs = num_detection_runs_.load(),
+                                      .num_victims = num_victims_.load(),
+                                      .cpu_time = std::chrono::nanoseconds(detection_cpu_ns_.load())};
+    }
 
 private:
-    std::mutex latch_;      // 用于锁表的并发
-    std::unordered_map<LockDataId, LockRequestQueue> lock_table_;   // 全局锁表
+    LockMode lock(Transaction *txn, const LockDataId &lock_data_id, LockMode lock_mode);
+
+    bool release_lock(txn_id_t txn_id, const LockDataId &lock_data_id, lsn_t commit_lsn = INVALID_LSN);
+
+    void escalate(Transaction *txn, int tab_fd);
+
+    LockTableBucket &bucket_of(const LockDataId &lock_data_id) {
+        return buckets_[std::hash<int64_t>()(lock_data_id.Get()) % NUM_LOCK_TABLE_BUCKETS];
+    }
+
+    static bool compatible(LockMode a, LockMode b);
+
+    static LockMode combine(LockMode held, LockMode requested);
+
+    static bool covers(LockMode held, LockMode requested) { return combine(held, requested) == held; }
+
+    static bool compatible_with_granted(const LockRequestQueue &queue, LockMode mode, const LockRequest *self);
+
+    static bool can_grant(const LockRequestQueue &queue, const LockRequest &request);
+
+    static std::vector<LockRequest *> get_conflicts(LockRequestQueue &queue, const LockRequest &request);
+
+    static void grant(LockRequestQueue &queue, LockRequest &request);
+
+    static void release(LockRequestQueue &queue, LockMode mode);
+
+    static void update_group_lock_mode(LockRequestQueue &queue);
+
+    bool resolve_conflict(LockRequestQueue &queue, LockRequest &request, std::vector<txn_id_t> *wounded);
+
+    void wake_wounded(const std::vector<txn_id_t> &wounded);
+
+    void start_cycle_detection();
+
+    void stop_cycle_detection();
+
+    void run_cycle_detection();
+
+    static bool find_cycle(const std::map<txn_id_t, std::vector<txn_id_t>> &waits_for, txn_id_t *victim);
+
+    DeadlockPolicy policy_ = DeadlockPolicy::NO_WAIT;
+    LockTableBucket buckets_[NUM_LOCK_TABLE_BUCKETS];   // 分区的锁表
+
+    std::mutex waits_latch_;    // 保护waiting_
+    std::unordered_map<txn_id_t, LockDataId> waiting_;  // 正在等待锁的事务及其等待的数据项，被wound时需要唤醒
+
+    std::thread cycle_detection_thread_;        // 死锁检测线程，只在DETECTION策略下运行
+    std::mutex cycle_detection_latch_;
+    std::condition_variable cycle_detection_cv_;    // 停止检测时唤醒检测线程
+    bool enable_cycle_detection_ = false;
+    std::atomic<size_t> num_detection_runs_{0};
+    std::atomic<size_t> num_victims_{0};
+    std::atomic<int64_t> detection_cpu_ns_{0};
+
+    size_t escalation_threshold_ = DEFAULT_ESCALATION_THRESHOLD;
+    std::atomic<size_t> num_escalations_{0};
+    std::atomic<size_t> num_escalation_failures_{0};
+    std::atomic<size_t> num_escalated_locks_{0};
 };
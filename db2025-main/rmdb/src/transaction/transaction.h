@@ -13,8 +13,10 @@ See the Mulan PSL v2 for more details. */
 #include <atomic>
 #include <deque>
 #include <memory>
+#include <optional>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -46,30 +48,96 @@ struct UndoLog {
   std::vector<bool> modified_fields_;
   /* 修改后的字段 */
   std::vector<Value> tuple_;
-  RmRecord* tuple_test_;
+  RmRecord* tuple_test_{nullptr};
   /* 此撤销日志的时间戳 */
   timestamp_t ts_{INVALID_TS};
   /* 撤销日志的前一个版本 */
   UndoLink prev_version_{};
 };
 
+/* OCC下读过的元组和读到的版本字，提交时验证版本没有改变 */
+struct OccReadRecord {
+  std::atomic<uint64_t> *version_;
+  uint64_t tid_;
+};
+
+/* OCC下缓存的写操作，提交时锁住元组、验证读集之后安装到表堆中 */
+struct OccWriteRecord {
+  WType wtype_;
+  std::string tab_name_;
+  Rid rid_;
+  std::atomic<uint64_t> *version_;
+  /* 更新之后的记录；删除时为空，插入的记录已经写入表堆，也为空 */
+  std::unique_ptr<RmRecord> tuple_;
+};
+
+/* escrow锁下缓存的增量修改，提交时（或者事务获得记录的X锁时）加到记录上 */
+struct EscrowRecord {
+  std::string tab_name_;
+  Rid rid_;
+  std::vector<std::pair<int, Value>> deltas_;   // 字段在记录中的偏移和增量
+};
 
 class Transaction {
    public:
-    explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::SERIALIZABLE)
-        : state_(TransactionState::DEFAULT), isolation_level_(isolation_level), txn_id_(txn_id) {
-        write_set_ = std::make_shared<std::deque<WriteRecord *>>();
-        lock_set_ = std::make_shared<std::unordered_set<LockDataId>>();
-        index_latch_page_set_ = std::make_shared<std::deque<Page *>>();
-        index_deleted_page_set_ = std::make_shared<std::deque<Page*>>();
+    /**
+     * read_only为true时是只读事务（见TransactionManager::begin_read_only），不分配写集和索引latch集，
+     * 锁集在第一次加锁时才分配
+     */
+    explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::SERIALIZABLE,
+                         bool read_only = false)
+        : state_(TransactionState::DEFAULT), isolation_level_(isolation_level), txn_id_(txn_id), read_only_(read_only) {
+        if (!read_only) {
+            write_set_ = std::make_shared<std::deque<WriteRecord *>>();
+            lock_set_ = std::make_shared<std::unordered_set<LockDataId>>();
+            index_latch_page_set_ = std::make_shared<std::deque<Page *>>();
+            index_deleted_page_set_ = std::make_shared<std::deque<Page*>>();
+        }
         prev_lsn_ = INVALID_LSN;
         thread_id_ = std::this_thread::get_id();
     }
 
     ~Transaction() = default;
 
+    /* 从事务池中取出时重新初始化为新事务，保留已经分配的容器，只用于非只读事务 */
+    void reset(txn_id_t txn_id) {
+        state_.store(TransactionState::DEFAULT);
+        {
+            // 其他事务可能还持有旧的指针读取撤销日志，见GetUndoLogOptional
+            std::scoped_lock<std::mutex> lck(latch_);
+            txn_id_ = txn_id;
+            undo_logs_.clear();
+        }
+        txn_mode_ = false;
+        prev_lsn_ = INVALID_LSN;
+        dependency_lsn_ = INVALID_LSN;
+        thread_id_ = std::this_thread::get_id();
+        write_set_->clear();
+        lock_set_->clear();
+        row_lock_counts_.clear();
+        index_latch_page_set_->clear();
+        index_deleted_page_set_->clear();
+        occ_read_set_.clear();
+        occ_write_set_.clear();
+        escrow_set_.clear();
+        read_ts_.store(0);
+        commit_ts_.store(INVALID_TS);
+        watermark_slot_ = 0;
+        num_owners_.store(1);
+    }
+
+    /**
+     * 事务对象的持有者个数：开始事务的调用者，以及MVCC下撤销日志还没有回收时的垃圾回收。
+     * 最后一个持有者释放时事务对象放回事务池，见TransactionManager::recycle
+     */
+    inline void add_owner() { num_owners_.fetch_add(1); }
+    /* @return 是否为最后一个持有者 */
+    inline bool release_owner() { return num_owners_.fetch_sub(1) == 1; }
+
     inline txn_id_t get_transaction_id() { return txn_id_; }
 
+    inline bool is_read_only() const { return read_only_; }
+
     inline std::thread::id get_thread_id() { return thread_id_; }
 
     inline void set_txn_mode(bool txn_mode) { txn_mode_ = txn_mode; }
@@ -80,12 +148,20 @@ class Transaction {
 
     inline IsolationLevel get_isolation_level() { return isolation_level_; }
 
-    inline TransactionState get_state() { return state_; }
-    inline void set_state(TransactionState state) { state_ = state; }
+    inline TransactionState get_state() { return state_.load(); }
+    inline void set_state(TransactionState state) { state_.store(state); }
+    /* 事务状态为expected时修改为state，其他线程（例如wound-wait）也会修改事务状态 */
+    inline bool compare_and_set_state(TransactionState expected, TransactionState state) {
+        return state_.compare_exchange_strong(expected, state);
+    }
 
     inline lsn_t get_prev_lsn() { return prev_lsn_; }
     inline void set_prev_lsn(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+    /* 获得的锁曾被提前释放时，释放者的提交日志中最大的lsn；提交前要等待它持久化 */
+    inline lsn_t get_dependency_lsn() { return dependency_lsn_; }
+    inline void add_dependency_lsn(lsn_t lsn) { dependency_lsn_ = std::max(dependency_lsn_, lsn); }
+
     inline std::shared_ptr<std::deque<WriteRecord *>> get_write_set() { return write_set_; }  
     inline void append_write_record(WriteRecord* write_record) { write_set_->push_back(write_record); }
 
@@ -95,10 +171,34 @@ class Transaction {
     inline std::shared_ptr<std::deque<Page*>> get_index_latch_page_set() { return index_latch_page_set_; }
     inline void append_index_latch_page_set(Page* page) { index_latch_page_set_->push_back(page); }
 
-    inline std::shared_ptr<std::unordered_set<LockDataId>> get_lock_set() { return lock_set_; }
+    inline std::shared_ptr<std::unordered_set<LockDataId>> get_lock_set() {
+        if (lock_set_ == nullptr) {
+            lock_set_ = std::make_shared<std::unordered_set<LockDataId>>();
+        }
+        return lock_set_;
+    }
+    /* 是否申请过锁，只读事务没有加锁时不需要分配锁集 */
+    inline bool has_lock_set() const { return lock_set_ != nullptr; }
+    /* 表的fd到事务在该表上持有的行锁个数，超过阈值时升级为表锁 */
+    inline std::unordered_map<int, size_t> &get_row_lock_counts() { return row_lock_counts_; }
+
+    inline std::vector<OccReadRecord> &get_occ_read_set() { return occ_read_set_; }
+    inline void append_occ_read(std::atomic<uint64_t> *version, uint64_t tid) { occ_read_set_.push_back({version, tid}); }
+    /* 按照记录的LockDataId索引，事务读取自己写过的记录时先在这里查找 */
+    inline std::unordered_map<LockDataId, OccWriteRecord> &get_occ_write_set() { return occ_write_set_; }
+
+    /* 按照记录的LockDataId索引，同一条记录上的多次增量合并在一个EscrowRecord中 */
+    inline std::unordered_map<LockDataId, EscrowRecord> &get_escrow_set() { return escrow_set_; }
 
     inline timestamp_t get_read_ts() const { return read_ts_; }
     inline timestamp_t get_commit_ts() const { return commit_ts_; }
+    inline void set_read_ts(timestamp_t read_ts) { read_ts_ = read_ts; }
+    inline void set_commit_ts(timestamp_t commit_ts) { commit_ts_ = commit_ts; }
+    /* MVCC下未提交的修改在TupleMeta中使用的临时时间戳，大于所有的提交时间戳 */
+    inline timestamp_t get_temp_ts() const { return TXN_START_ID + txn_id_; }
+    /* 事务在Watermark中发布读时间戳的槽位 */
+    inline size_t get_watermark_slot() const { return watermark_slot_; }
+    inline void set_watermark_slot(size_t slot) { watermark_slot_ = slot; }
 
     /** 修改现有的撤销日志 */
     inline auto ModifyUndoLog(int log_idx, UndoLog new_log) {
@@ -117,28 +217,56 @@ class Transaction {
         return undo_logs_[log_id];
       }
 
+    /**
+     * 其他事务沿着版本链读取撤销日志，在latch下检查后复制。
+     * @return 撤销日志已经被垃圾回收，或者事务对象已经复用为其他事务时返回空
+     */
+    inline auto GetUndoLogOptional(txn_id_t txn_id, size_t log_id) -> std::optional<UndoLog> {
+        std::scoped_lock<std::mutex> lck(latch_);
+        if (txn_id_ != txn_id || log_id >= undo_logs_.size()) {
+            return std::nullopt;
+        }
+        return undo_logs_[log_id];
+      }
+
     /** @return 撤销日志的数量 */
     inline auto GetUndoLogNum() -> size_t {
         std::scoped_lock<std::mutex> lck(latch_);
         return undo_logs_.size();
       }
 
+    /** 垃圾回收：所有撤销日志都已经不可达时取出并释放，之后GetUndoLogNum返回0 */
+    inline auto TakeUndoLogs() -> std::vector<UndoLog> {
+        std::scoped_lock<std::mutex> lck(latch_);
+        std::vector<UndoLog> undo_logs;
+        undo_logs.swap(undo_logs_);
+        return undo_logs;
+      }
+
 
    private:
     bool txn_mode_;                   // 用于标识当前事务为显式事务还是单条SQL语句的隐式事务
-    TransactionState state_;          // 事务状态
+    std::atomic<TransactionState> state_;   // 事务状态
     IsolationLevel isolation_level_;  // 事务的隔离级别，默认隔离级别为可串行化
     std::thread::id thread_id_;       // 当前事务对应的线程id
     lsn_t prev_lsn_;                  // 当前事务执行的最后一条操作对应的lsn，用于系统故障恢复
+    lsn_t dependency_lsn_ = INVALID_LSN;  // 依赖的提前释放锁的事务的提交日志lsn
     txn_id_t txn_id_;                 // 事务的ID，唯一标识符
+    bool read_only_;                  // 是否为只读事务
     timestamp_t start_ts_;            // 事务的开始时间戳
 
     std::shared_ptr<std::deque<WriteRecord *>> write_set_;  // 事务包含的所有写操作
     std::shared_ptr<std::unordered_set<LockDataId>> lock_set_;  // 事务申请的所有锁
+    std::unordered_map<int, size_t> row_lock_counts_;           // 每张表上持有的行锁个数
     std::shared_ptr<std::deque<Page*>> index_latch_page_set_;          // 维护事务执行过程中加锁的索引页面
     std::shared_ptr<std::deque<Page*>> index_deleted_page_set_;    // 维护事务执行过程中删除的索引页面
+    std::vector<OccReadRecord> occ_read_set_;                          // OCC下的读集
+    std::unordered_map<LockDataId, OccWriteRecord> occ_write_set_;     // OCC下缓存的写集
+    std::unordered_map<LockDataId, EscrowRecord> escrow_set_;          // 两阶段封锁下缓存的增量
 
   std::atomic<timestamp_t> read_ts_{0};
+  size_t watermark_slot_{0};
+  std::atomic<int> num_owners_{1};
   /** 提交时间戳 */
   std::atomic<timestamp_t> commit_ts_{INVALID_TS};
   /**
@@ -9,10 +9,20 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #include "transaction_manager.h"
+#include "execution/execution_common.h"
 #include "record/rm_file_handle.h"
 #include "system/sm_manager.h"
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
+std::chrono::milliseconds gc_interval = std::chrono::milliseconds(50);
+
+/* 撤销日志占用的内存 */
+static int64_t undo_log_bytes(const UndoLog &undo_log) {
+    int64_t bytes = sizeof(UndoLog) + (undo_log.modified_fields_.size() + 7) / 8 + undo_log.tuple_.size() * sizeof(Value);
+    for (auto &value : undo_log.tuple_) {
+        bytes += value.str_val.size();
+    }
+    return bytes;
+}
 
 /**
  * @description: 事务的开始方法
@@ -27,8 +37,143 @@ Transaction * TransactionManager::begin(Transaction* txn, LogManager* log_manage
     // 3. 把开始事务加入到全局事务表中
     // 4. 返回当前事务指针
     // 如果需要支持MVCC请在上述过程中添加代码
-    
-    return nullptr;
+    if (txn == nullptr) {
+        txn = allocate_transaction();
+        txn->set_start_ts(next_timestamp_++);
+    }
+    if (concurrency_mode_ == ConcurrencyMode::MVCC) {
+        start_snapshot(txn);
+    }
+    auto &shard = txn_map_shard(txn->get_transaction_id());
+    std::lock_guard<std::mutex> lock(shard.latch_);
+    shard.txns_[txn->get_transaction_id()] = txn;
+    return txn;
+}
+
+TransactionManager::~TransactionManager() {
+    stop_garbage_collection();
+    for (auto &shard : txn_pool_) {
+        for (auto txn : shard.free_txns_) {
+            delete txn;
+        }
+    }
+}
+
+/**
+ * @description: 优先从当前线程对应的事务池分区中取出空闲的事务对象，分区为空时创建新的事务对象
+ * @return {Transaction*} 分配了新事务ID的事务对象
+ */
+Transaction * TransactionManager::allocate_transaction() {
+    Transaction *txn = nullptr;
+    {
+        auto &shard = txn_pool_shard();
+        std::lock_guard<std::mutex> lock(shard.latch_);
+        if (!shard.free_txns_.empty()) {
+            txn = shard.free_txns_.back();
+            shard.free_txns_.pop_back();
+        }
+    }
+    if (txn == nullptr) {
+        return new Transaction(next_txn_id_++);
+    }
+    txn->reset(next_txn_id_++);
+    return txn;
+}
+
+void TransactionManager::recycle(Transaction* txn) {
+    if (txn->is_read_only()) {
+        delete txn;
+        return;
+    }
+    if (txn->release_owner()) {
+        release_transaction(txn);
+    }
+}
+
+/**
+ * @description: 事务的最后一个持有者释放之后，从全局事务表中删除，放回当前线程对应的事务池分区，分区已满时释放
+ * @param {Transaction*} txn 没有持有者的事务
+ */
+void TransactionManager::release_transaction(Transaction* txn) {
+    {
+        auto &shard = txn_map_shard(txn->get_transaction_id());
+        std::lock_guard<std::mutex> lock(shard.latch_);
+        shard.txns_.erase(txn->get_transaction_id());
+    }
+    {
+        auto &shard = txn_pool_shard();
+        std::lock_guard<std::mutex> lock(shard.latch_);
+        if (shard.free_txns_.size() < MAX_POOLED_TXNS_PER_SHARD) {
+            shard.free_txns_.push_back(txn);
+            return;
+        }
+    }
+    delete txn;
+}
+
+size_t TransactionManager::get_num_transactions() {
+    size_t num_txns = 0;
+    for (auto &shard : txn_map_) {
+        std::lock_guard<std::mutex> lock(shard.latch_);
+        num_txns += shard.txns_.size();
+    }
+    return num_txns;
+}
+
+size_t TransactionManager::get_pool_size() {
+    size_t pool_size = 0;
+    for (auto &shard : txn_pool_) {
+        std::lock_guard<std::mutex> lock(shard.latch_);
+        pool_size += shard.free_txns_.size();
+    }
+    return pool_size;
+}
+
+/**
+ * @description: 开始只读事务，用于显式事务之外的单条SELECT语句。不分配写集和锁集，不加入全局事务表，
+ * 提交或者回滚之后由调用者释放。MVCC下读取快照，OCC下读不加锁，两阶段封锁下仍然需要加S锁
+ * @return {Transaction*} 新的只读事务
+ * @param {LogManager*} log_manager 日志管理器指针
+ */
+Transaction * TransactionManager::begin_read_only(LogManager* log_manager) {
+    auto *txn = new Transaction(next_txn_id_++, IsolationLevel::SERIALIZABLE, true);
+    txn->set_start_ts(next_timestamp_++);
+    txn->set_txn_mode(false);
+    if (concurrency_mode_ == ConcurrencyMode::MVCC) {
+        start_snapshot(txn);
+    }
+    return txn;
+}
+
+/**
+ * @description: MVCC下为事务获取快照，在Watermark中登记读时间戳
+ * @param {Transaction*} txn 事务指针
+ */
+void TransactionManager::start_snapshot(Transaction* txn) {
+    // 快照包含开始之前所有已经提交的事务。先发布读到的提交时间戳，再重新读取作为读时间戳，
+    // 并发计算的水印不会超过读时间戳，见Watermark::GetWatermark
+    size_t slot = running_txns_.AddTxn(last_commit_ts_.load(), txn->get_transaction_id());
+    timestamp_t read_ts = last_commit_ts_.load();
+    running_txns_.UpdateTxn(slot, read_ts);
+    txn->set_read_ts(read_ts);
+    txn->set_watermark_slot(slot);
+}
+
+/**
+ * @description: 释放事务持有的所有锁
+ * @return {std::vector<LockDataId>} 释放的锁
+ * @param {Transaction*} txn 事务指针
+ * @param {lsn_t} commit_lsn 提前释放锁时事务还没有持久化的提交日志lsn
+ */
+std::vector<LockDataId> TransactionManager::release_locks(Transaction* txn, lsn_t commit_lsn) {
+    auto lock_set = txn->get_lock_set();
+    // unlock会从锁集中删除，先复制一份
+    std::vector<LockDataId> locks(lock_set->begin(), lock_set->end());
+    for (auto &lock_data_id : locks) {
+        lock_manager_->unlock(txn, lock_data_id, commit_lsn);
+    }
+    lock_set->clear();
+    return locks;
 }
 
 /**
@@ -44,7 +189,102 @@ void TransactionManager::commit(Transaction* txn, LogManager* log_manager) {
     // 4. 把事务日志刷入磁盘中
     // 5. 更新事务状态
     // 如果需要支持MVCC请在上述过程中添加代码
+    // 进入SHRINKING阶段之后其他事务不能再wound该事务；已经被wound的事务只能回滚
+    txn->compare_and_set_state(TransactionState::GROWING, TransactionState::SHRINKING);
+    if (txn->get_state() == TransactionState::ABORTED) {
+        throw TransactionAbortException(txn->get_transaction_id(), AbortReason::DEADLOCK_PREVENTION);
+    }
+    if (txn->is_read_only()) {
+        commit_read_only(txn, log_manager);
+        return;
+    }
+    auto write_set = txn->get_write_set();
+    bool read_only = write_set->empty() && txn->get_escrow_set().empty() && txn->get_occ_write_set().empty();
+    if (concurrency_mode_ == ConcurrencyMode::MVCC) {
+        if (!write_set->empty()) {
+            // 把修改过的元组的时间戳从临时时间戳改为提交时间戳，之后开始的事务才能看到
+            std::lock_guard<std::mutex> commit_lock(commit_latch_);
+            timestamp_t commit_ts = last_commit_ts_.load() + 1;
+            for (auto write_record : *write_set) {
+                int fd = sm_manager_->fhs_.at(write_record->GetTableName())->GetFd();
+                Rid &rid = write_record->GetRid();
+                auto page_info = GetPageVersionInfo(fd, rid.page_no);
+                std::unique_lock<std::shared_mutex> lock(page_info->mutex_);
+                auto meta = page_info->tuple_meta_.find(rid.slot_no);
+                if (meta != page_info->tuple_meta_.end() && meta->second.ts_ == txn->get_temp_ts()) {
+                    meta->second.ts_ = commit_ts;
+                }
+            }
+            txn->set_commit_ts(commit_ts);
+            last_commit_ts_.store(commit_ts);
+            running_txns_.UpdateCommitTs(commit_ts);
+        }
+        running_txns_.RemoveTxn(txn->get_watermark_slot());
+        add_gc_candidate(txn);
+    } else if (concurrency_mode_ == ConcurrencyMode::OCC) {
+        // 验证失败时抛出异常，由调用者回滚
+        commit_occ(txn);
+    }
+    // 释放escrow锁之前把缓存的增量加到记录上，并且在提交日志之前写入increment日志
+    for (auto &[lock_data_id, escrow_record] : txn->get_escrow_set()) {
+        apply_escrow(txn, sm_manager_->fhs_.at(escrow_record.tab_name_).get(), escrow_record, log_manager, nullptr);
+    }
+    txn->get_escrow_set().clear();
+    for (auto write_record : *write_set) {
+        delete write_record;
+    }
+    write_set->clear();
+    if (log_manager == nullptr) {
+        release_locks(txn);
+        txn->set_state(TransactionState::COMMITTED);
+        return;
+    }
+    // 只读事务不写提交日志，但是读到的数据可能来自提前释放锁、还没有持久化的事务
+    lsn_t commit_lsn = INVALID_LSN;
+    if (!read_only) {
+        CommitLogRecord commit_log(txn->get_transaction_id());
+        commit_log.prev_lsn_ = txn->get_prev_lsn();
+        commit_lsn = log_manager->add_log_to_buffer(&commit_log);
+        txn->set_prev_lsn(commit_lsn);
+    }
+    lsn_t durable_lsn = std::max(commit_lsn, txn->get_dependency_lsn());
+    if (early_lock_release_) {
+        // 提交日志已经在缓冲区中，释放锁之后等待日志持久化，其他事务在此期间可以访问这些数据
+        auto locks = release_locks(txn, commit_lsn);
+        log_manager->wait_for_durable(durable_lsn);
+        if (commit_lsn != INVALID_LSN) {
+            lsn_t persist_lsn = log_manager->get_persist_lsn();
+            for (auto &lock_data_id : locks) {
+                lock_manager_->clear_release_lsn(lock_data_id, persist_lsn);
+            }
+        }
+    } else {
+        log_manager->wait_for_durable(durable_lsn);
+        release_locks(txn);
+    }
+    txn->set_state(TransactionState::COMMITTED);
+}
 
+/**
+ * @description: 只读事务的提交：不写提交日志，MVCC下没有撤销日志，不需要加入垃圾回收的候选事务
+ * @param {Transaction*} txn 需要提交的只读事务
+ * @param {LogManager*} log_manager 日志管理器指针
+ */
+void TransactionManager::commit_read_only(Transaction* txn, LogManager* log_manager) {
+    if (concurrency_mode_ == ConcurrencyMode::MVCC) {
+        running_txns_.RemoveTxn(txn->get_watermark_slot());
+    } else if (concurrency_mode_ == ConcurrencyMode::OCC) {
+        // 验证读集，失败时抛出异常，由调用者回滚
+        commit_occ(txn);
+    }
+    if (txn->has_lock_set()) {
+        release_locks(txn);
+    }
+    // 读到的数据可能来自提前释放锁、提交日志还没有持久化的事务
+    if (log_manager != nullptr) {
+        log_manager->wait_for_durable(txn->get_dependency_lsn());
+    }
+    txn->set_state(TransactionState::COMMITTED);
 }
 
 /**
@@ -60,5 +300,565 @@ void TransactionManager::abort(Transaction * txn, LogManager *log_manager) {
     // 4. 把事务日志刷入磁盘中
     // 5. 更新事务状态
     // 如果需要支持MVCC请在上述过程中添加代码
-    
+    if (txn->is_read_only()) {
+        // 只读事务没有需要撤销的写操作
+        if (concurrency_mode_ == ConcurrencyMode::MVCC) {
+            running_txns_.RemoveTxn(txn->get_watermark_slot());
+        }
+        txn->get_occ_read_set().clear();
+        if (txn->has_lock_set()) {
+            release_locks(txn);
+        }
+        txn->set_state(TransactionState::ABORTED);
+        return;
+    }
+    if (concurrency_mode_ == ConcurrencyMode::OCC) {
+        abort_occ(txn);
+    }
+    auto write_set = txn->get_write_set();
+    // 按照相反的顺序撤销写操作
+    for (auto it = write_set->rbegin(); it != write_set->rend(); it++) {
+        if (concurrency_mode_ == ConcurrencyMode::MVCC) {
+            rollback_mvcc_write(txn, *it);
+        } else {
+            rollback_write(txn, *it);
+        }
+        delete *it;
+    }
+    write_set->clear();
+    // 缓存的增量还没有写入记录，直接丢弃
+    txn->get_escrow_set().clear();
+    if (concurrency_mode_ == ConcurrencyMode::MVCC) {
+        running_txns_.RemoveTxn(txn->get_watermark_slot());
+        add_gc_candidate(txn);
+    }
+    release_locks(txn);
+    txn->set_state(TransactionState::ABORTED);
+}
+
+/**
+ * @description: 两阶段封锁下撤销一个写操作，恢复表堆中的记录和索引。事务持有记录上的排他锁，不会与其他事务冲突
+ */
+void TransactionManager::rollback_write(Transaction* txn, WriteRecord* write_record) {
+    auto &tab = sm_manager_->db_.get_table(write_record->GetTableName());
+    RmFileHandle *fh = sm_manager_->fhs_.at(tab.name).get();
+    Rid &rid = write_record->GetRid();
+    switch (write_record->GetWriteType()) {
+        case WType::INSERT_TUPLE: {
+            auto rec = fh->get_record(rid, nullptr);
+            for (auto &index : tab.indexes) {
+                DeleteIndexEntry(sm_manager_, tab, index, rec->data, rid, txn);
+            }
+            {
+                std::lock_guard<std::mutex> insert_lock(fh->get_insert_latch());
+                fh->delete_record(rid, nullptr);
+            }
+        } break;
+        case WType::DELETE_TUPLE: {
+            RmRecord &old_rec = write_record->GetRecord();
+            {
+                std::lock_guard<std::mutex> insert_lock(fh->get_insert_latch());
+                fh->insert_record(rid, old_rec.data);
+            }
+            for (auto &index : tab.indexes) {
+                InsertIndexEntry(sm_manager_, tab, index, old_rec.data, rid, txn);
+            }
+        } break;
+        case WType::UPDATE_TUPLE: {
+            RmRecord &old_rec = write_record->GetRecord();
+            auto rec = fh->get_record(rid, nullptr);
+            for (auto &index : tab.indexes) {
+                if (IndexKeyChanged(index, rec->data, old_rec.data)) {
+                    DeleteIndexEntry(sm_manager_, tab, index, rec->data, rid, txn);
+                    InsertIndexEntry(sm_manager_, tab, index, old_rec.data, rid, txn);
+                }
+            }
+            fh->update_record(rid, old_rec.data, nullptr);
+        } break;
+    }
+}
+
+/**
+ * @description: MVCC下撤销事务对一条记录的修改：用撤销日志恢复表堆中的元组、元信息和版本链的头部。
+ * 自己插入的记录标记为在所有快照中都已经删除。同一条记录的多个写操作只需要撤销一次
+ */
+void TransactionManager::rollback_mvcc_write(Transaction* txn, WriteRecord* write_record) {
+    auto &tab = sm_manager_->db_.get_table(write_record->GetTableName());
+    RmFileHandle *fh = sm_manager_->fhs_.at(tab.name).get();
+    Rid &rid = write_record->GetRid();
+    auto page_info = GetPageVersionInfo(fh->GetFd(), rid.page_no);
+    std::unique_lock<std::shared_mutex> lock(page_info->mutex_);
+    auto meta = page_info->tuple_meta_.find(rid.slot_no);
+    if (meta == page_info->tuple_meta_.end() || meta->second.ts_ != txn->get_temp_ts()) {
+        return;
+    }
+    auto link = page_info->prev_version_.find(rid.slot_no);
+    if (link == page_info->prev_version_.end() || link->second.prev_.prev_txn_ != txn->get_transaction_id()) {
+        meta->second = TupleMeta{0, true};
+        return;
+    }
+    UndoLog undo_log = txn->GetUndoLog(link->second.prev_.prev_log_idx_);
+    auto rec = fh->get_record(rid, nullptr);
+    auto value = undo_log.tuple_.begin();
+    for (size_t i = 0; i < tab.cols.size(); i++) {
+        if (undo_log.modified_fields_[i]) {
+            SetColumnValue(tab.cols[i], rec->data, *value++);
+        }
+    }
+    fh->update_record(rid, rec->data, nullptr);
+    meta->second = TupleMeta{undo_log.ts_, undo_log.is_deleted_};
+    if (undo_log.prev_version_.IsValid()) {
+        link->second.prev_ = undo_log.prev_version_;
+    } else {
+        page_info->prev_version_.erase(link);
+    }
+}
+
+/**
+ * @description: OCC提交：按照版本字的地址顺序锁住写集中的元组，不会死锁；然后验证读集中的每个版本字没有改变，
+ * 也没有被其他事务锁住。验证通过后用大于所有读写版本的TID安装写操作并解锁，TID只需要单调，不需要全局计数器。
+ * 验证失败时解锁写集并抛出异常，缓存的写操作直接丢弃
+ * @param {Transaction*} txn 需要提交的事务
+ */
+void TransactionManager::commit_occ(Transaction* txn) {
+    auto &write_set = txn->get_occ_write_set();
+    auto &read_set = txn->get_occ_read_set();
+    std::vector<OccWriteRecord *> writes;
+    std::vector<std::atomic<uint64_t> *> locked;
+    for (auto &[lock_data_id, write_record] : write_set) {
+        writes.push_back(&write_record);
+    }
+    std::sort(writes.begin(), writes.end(),
+              [](OccWriteRecord *a, OccWriteRecord *b) { return a->version_ < b->version_; });
+    uint64_t max_tid = 0;
+    for (auto write_record : writes) {
+        // 自己插入的记录其他事务看不到，不需要加锁
+        if (write_record->wtype_ == WType::INSERT_TUPLE) {
+            continue;
+        }
+        auto version = write_record->version_;
+        uint64_t tid = version->load();
+        while ((tid & OCC_LOCK_BIT) || !version->compare_exchange_weak(tid, tid | OCC_LOCK_BIT)) {
+            std::this_thread::yield();
+            tid = version->load();
+        }
+        max_tid = std::max(max_tid, tid & OCC_TID_MASK);
+        locked.push_back(version);
+    }
+
+    bool valid = true;
+    for (auto &read : read_set) {
+        uint64_t tid = read.version_->load();
+        if ((tid & ~OCC_LOCK_BIT) != read.tid_ ||
+            ((tid & OCC_LOCK_BIT) && !std::binary_search(locked.begin(), locked.end(), read.version_))) {
+            valid = false;
+            break;
+        }
+        max_tid = std::max(max_tid, tid & OCC_TID_MASK);
+    }
+    if (!valid) {
+        for (auto version : locked) {
+            version->fetch_and(~OCC_LOCK_BIT);
+        }
+        txn->set_state(TransactionState::ABORTED);
+        throw TransactionAbortException(txn->get_transaction_id(), AbortReason::VALIDATION_FAILED);
+    }
+
+    uint64_t commit_tid = max_tid + 1;
+    for (auto write_record : writes) {
+        install_occ_write(write_record, commit_tid);
+    }
+    write_set.clear();
+    read_set.clear();
+}
+
+/**
+ * @description: 把缓存的写操作安装到表堆和索引中，同时解锁版本字。删除在插入latch下释放槽位和修改版本字，
+ * 重新使用该槽位的插入不会被覆盖为不存在
+ */
+void TransactionManager::install_occ_write(OccWriteRecord* write_record, uint64_t tid) {
+    auto &tab = sm_manager_->db_.get_table(write_record->tab_name_);
+    RmFileHandle *fh = sm_manager_->fhs_.at(tab.name).get();
+    Rid &rid = write_record->rid_;
+    switch (write_record->wtype_) {
+        case WType::INSERT_TUPLE: {
+            write_record->version_->store(tid);
+        } break;
+        case WType::DELETE_TUPLE: {
+            auto rec = fh->get_record(rid, nullptr);
+            for (auto &index : tab.indexes) {
+                DeleteIndexEntry(sm_manager_, tab, index, rec->data, rid, nullptr);
+            }
+            std::lock_guard<std::mutex> insert_lock(fh->get_insert_latch());
+            fh->delete_record(rid, nullptr);
+            write_record->version_->store(tid | OCC_ABSENT_BIT);
+        } break;
+        case WType::UPDATE_TUPLE: {
+            auto rec = fh->get_record(rid, nullptr);
+            char *new_data = write_record->tuple_->data;
+            for (auto &index : tab.indexes) {
+                if (IndexKeyChanged(index, rec->data, new_data)) {
+                    DeleteIndexEntry(sm_manager_, tab, index, rec->data, rid, nullptr);
+                    InsertIndexEntry(sm_manager_, tab, index, new_data, rid, nullptr);
+                }
+            }
+            fh->update_record(rid, new_data, nullptr);
+            write_record->version_->store(tid);
+        } break;
+    }
+}
+
+/**
+ * @description: OCC下回滚：缓存的更新和删除直接丢弃；插入已经写入表堆和索引，但是版本字为不存在，
+ * 其他事务看不到，删除即可。已经被自己删除的插入不在写集中，跳过
+ */
+void TransactionManager::abort_occ(Transaction* txn) {
+    auto &write_set = txn->get_occ_write_set();
+    auto records = txn->get_write_set();
+    for (auto it = records->rbegin(); it != records->rend(); it++) {
+        RmFileHandle *fh = sm_manager_->fhs_.at((*it)->GetTableName()).get();
+        auto write_record = write_set.find(LockDataId(fh->GetFd(), (*it)->GetRid(), LockDataType::RECORD));
+        if (write_record == write_set.end() || write_record->second.wtype_ != WType::INSERT_TUPLE) {
+            continue;
+        }
+        // rollback_write在插入latch下从表堆中删除
+        rollback_write(txn, *it);
+        write_set.erase(write_record);
+    }
+    for (auto write_record : *records) {
+        delete write_record;
+    }
+    records->clear();
+    write_set.clear();
+    txn->get_occ_read_set().clear();
+}
+
+/**
+ * @description: 把escrow_record中的增量加到记录上。多个持有escrow锁的事务可能同时修改同一条记录，
+ * 修改记录期间持有记录所在页面分区的escrow latch。log_manager不为空时在latch内写入increment日志并设置页面的lsn，
+ * 同一个页面上的增量按照lsn的顺序写入页面，redo时可以根据页面的lsn判断增量是否已经写入
+ * @param {RmRecord*} old_rec 不为空时保存修改之前的记录
+ */
+void TransactionManager::apply_escrow(Transaction *txn, RmFileHandle *fh, const EscrowRecord &escrow_record,
+                                      LogManager *log_manager, RmRecord *old_rec) {
+    const Rid &rid = escrow_record.rid_;
+    PageId page_id{.fd = fh->GetFd(), .page_no = rid.page_no};
+    std::lock_guard<std::mutex> lock(escrow_latches_[std::hash<PageId>()(page_id) % NUM_ESCROW_LATCHES]);
+    RmPageHandle page_handle = fh->fetch_page_handle(rid.page_no);
+    char *data = page_handle.get_slot(rid.slot_no);
+    if (old_rec != nullptr) {
+        memcpy(old_rec->data, data, old_rec->size);
+    }
+    if (log_manager != nullptr) {
+        IncrementLogRecord increment_log(txn->get_transaction_id(), rid, escrow_record.tab_name_, escrow_record.deltas_);
+        increment_log.prev_lsn_ = txn->get_prev_lsn();
+        lsn_t lsn = log_manager->add_log_to_buffer(&increment_log);
+        txn->set_prev_lsn(lsn);
+        page_handle.page->set_page_lsn(lsn);
+    }
+    for (auto &[offset, delta] : escrow_record.deltas_) {
+        delta.add_to(data + offset);
+    }
+    sm_manager_->get_bpm()->unpin_page(page_id, true);
+}
+
+void TransactionManager::FlushEscrow(Transaction *txn, RmFileHandle *fh, const Rid &rid) {
+    auto &escrow_set = txn->get_escrow_set();
+    auto escrow_record = escrow_set.find(LockDataId(fh->GetFd(), rid, LockDataType::RECORD));
+    if (escrow_record == escrow_set.end()) {
+        return;
+    }
+    RmRecord old_rec(fh->get_file_hdr().record_size);
+    apply_escrow(txn, fh, escrow_record->second, nullptr, &old_rec);
+    txn->append_write_record(new WriteRecord(WType::UPDATE_TUPLE, escrow_record->second.tab_name_, rid, old_rec));
+    escrow_set.erase(escrow_record);
+}
+
+std::atomic<uint64_t> *TransactionManager::GetTupleVersion(RmFileHandle *fh, const Rid &rid) {
+    PageId page_id{.fd = fh->GetFd(), .page_no = rid.page_no};
+    {
+        std::shared_lock<std::shared_mutex> lock(occ_versions_mutex_);
+        auto it = occ_versions_.find(page_id);
+        if (it != occ_versions_.end()) {
+            return &it->second[rid.slot_no];
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(occ_versions_mutex_);
+    auto &versions = occ_versions_[page_id];
+    if (versions == nullptr) {
+        versions = std::make_unique<std::atomic<uint64_t>[]>(fh->get_file_hdr().num_records_per_page);
+    }
+    return &versions[rid.slot_no];
+}
+
+std::shared_ptr<TransactionManager::PageVersionInfo> TransactionManager::GetPageVersionInfo(int fd,
+                                                                                            page_id_t page_no) {
+    PageId page_id{.fd = fd, .page_no = page_no};
+    {
+        std::shared_lock<std::shared_mutex> lock(version_info_mutex_);
+        auto it = version_info_.find(page_id);
+        if (it != version_info_.end()) {
+            return it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(version_info_mutex_);
+    auto &page_info = version_info_[page_id];
+    if (page_info == nullptr) {
+        page_info = std::make_shared<PageVersionInfo>();
+    }
+    return page_info;
+}
+
+bool TransactionManager::UpdateUndoLink(int fd, Rid rid, std::optional<UndoLink> prev_link,
+                                        std::function<bool(std::optional<UndoLink>)> &&check) {
+    auto prev_version = VersionUndoLink::FromOptionalUndoLink(prev_link);
+    std::function<bool(std::optional<VersionUndoLink>)> version_check = nullptr;
+    if (check != nullptr) {
+        version_check = [&check](std::optional<VersionUndoLink> link) {
+            return check(link.has_value() ? std::optional<UndoLink>(link->prev_) : std::nullopt);
+        };
+    }
+    return UpdateVersionLink(fd, rid, prev_version, std::move(version_check));
+}
+
+bool TransactionManager::UpdateVersionLink(int fd, Rid rid, std::optional<VersionUndoLink> prev_version,
+                                           std::function<bool(std::optional<VersionUndoLink>)> &&check) {
+    auto page_info = GetPageVersionInfo(fd, rid.page_no);
+    std::unique_lock<std::shared_mutex> lock(page_info->mutex_);
+    auto it = page_info->prev_version_.find(rid.slot_no);
+    if (check != nullptr &&
+        !check(it != page_info->prev_version_.end() ? std::optional<VersionUndoLink>(it->second) : std::nullopt)) {
+        return false;
+    }
+    if (prev_version.has_value()) {
+        page_info->prev_version_[rid.slot_no] = *prev_version;
+    } else if (it != page_info->prev_version_.end()) {
+        page_info->prev_version_.erase(it);
+    }
+    return true;
+}
+
+std::optional<UndoLink> TransactionManager::GetUndoLink(int fd, Rid rid) {
+    auto version_link = GetVersionLink(fd, rid);
+    if (!version_link.has_value()) {
+        return std::nullopt;
+    }
+    return version_link->prev_;
+}
+
+std::optional<VersionUndoLink> TransactionManager::GetVersionLink(int fd, Rid rid) {
+    auto page_info = GetPageVersionInfo(fd, rid.page_no);
+    std::shared_lock<std::shared_mutex> lock(page_info->mutex_);
+    auto it = page_info->prev_version_.find(rid.slot_no);
+    if (it == page_info->prev_version_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+TupleMeta TransactionManager::GetTupleMeta(int fd, Rid rid) {
+    auto page_info = GetPageVersionInfo(fd, rid.page_no);
+    std::shared_lock<std::shared_mutex> lock(page_info->mutex_);
+    auto it = page_info->tuple_meta_.find(rid.slot_no);
+    return it != page_info->tuple_meta_.end() ? it->second : DEFAULT_TUPLE_META;
+}
+
+std::optional<UndoLog> TransactionManager::GetUndoLogOptional(UndoLink link) {
+    // 撤销日志还没有回收的事务一直留在全局事务表中，见recycle
+    Transaction *txn = get_transaction(link.prev_txn_);
+    if (txn == nullptr) {
+        return std::nullopt;
+    }
+    // 检查和复制在同一次加锁中完成，中间不会被垃圾回收取走撤销日志或者复用事务对象
+    return txn->GetUndoLogOptional(link.prev_txn_, link.prev_log_idx_);
+}
+
+UndoLog TransactionManager::GetUndoLog(UndoLink link) {
+    auto undo_log = GetUndoLogOptional(link);
+    if (!undo_log.has_value()) {
+        throw InternalError("TransactionManager::GetUndoLog: undo log of txn " + std::to_string(link.prev_txn_) +
+                            " does not exist");
+    }
+    return *undo_log;
+}
+
+UndoLink TransactionManager::AppendUndoLog(Transaction *txn, UndoLog undo_log) {
+    num_undo_logs_++;
+    undo_log_bytes_ += undo_log_bytes(undo_log);
+    return txn->AppendUndoLog(std::move(undo_log));
+}
+
+void TransactionManager::ModifyUndoLog(Transaction *txn, int log_idx, UndoLog undo_log) {
+    undo_log_bytes_ += undo_log_bytes(undo_log) - undo_log_bytes(txn->GetUndoLog(log_idx));
+    txn->ModifyUndoLog(log_idx, std::move(undo_log));
+}
+
+void TransactionManager::set_concurrency_mode(ConcurrencyMode concurrency_mode) {
+    concurrency_mode_ = concurrency_mode;
+    if (concurrency_mode == ConcurrencyMode::MVCC) {
+        start_garbage_collection();
+    } else {
+        stop_garbage_collection();
+    }
+}
+
+/**
+ * @description: 结束的事务如果有撤销日志，加入垃圾回收的候选事务，等到它的撤销日志都不可达时释放
+ */
+void TransactionManager::add_gc_candidate(Transaction* txn) {
+    if (txn->GetUndoLogNum() == 0) {
+        return;
+    }
+    // 垃圾回收成为事务对象的另一个持有者，回收撤销日志之后释放
+    txn->add_owner();
+    std::lock_guard<std::mutex> lock(gc_candidates_latch_);
+    gc_candidates_.push_back(txn);
+}
+
+/**
+ * @description: 剪短一个页面中的版本链，调用者持有页面的排他锁。
+ * 读时间戳不小于水印的事务沿着版本链最多读到第一个时间戳不大于水印的版本：
+ * 表堆中的版本时间戳不大于水印时整条版本链都不再需要，删除链接；否则该版本之前的撤销日志（包括它自己）仍然可达。
+ * 没有版本链、在水印之前提交的元组的元信息与DEFAULT_TUPLE_META等价，也删除
+ * @param {unordered_set<txn_id_t>*} reachable 撤销日志仍然可达的事务
+ */
+void TransactionManager::prune_page(PageVersionInfo *page_info, timestamp_t watermark,
+                                    std::unordered_set<txn_id_t> *reachable) {
+    auto &tuple_meta = page_info->tuple_meta_;
+    for (auto it = page_info->prev_version_.begin(); it != page_info->prev_version_.end();) {
+        auto meta = tuple_meta.find(it->first);
+        timestamp_t ts = meta != tuple_meta.end() ? meta->second.ts_ : DEFAULT_TUPLE_META.ts_;
+        if (ts <= watermark) {
+            it = page_info->prev_version_.erase(it);
+            continue;
+        }
+        UndoLink link = it->second.prev_;
+        while (link.IsValid()) {
+            auto undo_log = GetUndoLogOptional(link);
+            if (!undo_log.has_value()) {
+                break;
+            }
+            reachable->insert(link.prev_txn_);
+            if (undo_log->ts_ <= watermark) {
+                break;
+            }
+            link = undo_log->prev_version_;
+        }
+        it++;
+    }
+    for (auto it = tuple_meta.begin(); it != tuple_meta.end();) {
+        if (it->second.ts_ <= watermark && !it->second.is_deleted_ &&
+            page_info->prev_version_.find(it->first) == page_info->prev_version_.end()) {
+            it = tuple_meta.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+size_t TransactionManager::GarbageCollection() {
+    std::lock_guard<std::mutex> gc_lock(gc_latch_);
+    // 在计算水印之前取出候选事务，之后结束的事务留给下一轮
+    std::vector<Transaction *> candidates;
+    {
+        std::lock_guard<std::mutex> lock(gc_candidates_latch_);
+        candidates.swap(gc_candidates_);
+    }
+    timestamp_t watermark = GetWatermark();
+    std::vector<std::shared_ptr<PageVersionInfo>> pages;
+    {
+        std::shared_lock<std::shared_mutex> lock(version_info_mutex_);
+        for (auto &[page_id, page_info] : version_info_) {
+            pages.push_back(page_info);
+        }
+    }
+    // 每次只锁住一个页面，其他页面上的读写不受影响。水印只会增大，已经处理的页面上不可达的撤销日志不会重新变为可达
+    std::unordered_set<txn_id_t> reachable;
+    for (auto &page_info : pages) {
+        std::unique_lock<std::shared_mutex> lock(page_info->mutex_);
+        prune_page(page_info.get(), watermark, &reachable);
+    }
+    size_t num_reclaimed = 0;
+    std::vector<Transaction *> retained;
+    for (auto txn : candidates) {
+        if (reachable.count(txn->get_transaction_id()) > 0) {
+            retained.push_back(txn);
+            continue;
+        }
+        auto undo_logs = txn->TakeUndoLogs();
+        for (auto &undo_log : undo_logs) {
+            undo_log_bytes_ -= undo_log_bytes(undo_log);
+        }
+        num_undo_logs_ -= undo_logs.size();
+        num_reclaimed += undo_logs.size();
+        if (txn->release_owner()) {
+            release_transaction(txn);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(gc_candidates_latch_);
+        gc_candidates_.insert(gc_candidates_.end(), retained.begin(), retained.end());
+    }
+    num_gc_runs_++;
+    num_reclaimed_logs_ += num_reclaimed;
+    return num_reclaimed;
+}
+
+VersionMemoryStats TransactionManager::GetVersionMemoryStats() {
+    VersionMemoryStats stats{.num_undo_logs = (size_t)num_undo_logs_.load(),
+                             .undo_log_bytes = (size_t)undo_log_bytes_.load()};
+    size_t num_pages = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(version_info_mutex_);
+        num_pages = version_info_.size();
+        for (auto &[page_id, page_info] : version_info_) {
+            std::shared_lock<std::shared_mutex> page_lock(page_info->mutex_);
+            stats.num_version_links += page_info->prev_version_.size();
+            stats.num_tuple_metas += page_info->tuple_meta_.size();
+        }
+    }
+    // 哈希表的每个结点还有next指针和缓存的哈希值
+    const size_t node_overhead = 2 * sizeof(void *);
+    stats.total_bytes = stats.undo_log_bytes +
+                        stats.num_version_links * (sizeof(std::pair<slot_offset_t, VersionUndoLink>) + node_overhead) +
+                        stats.num_tuple_metas * (sizeof(std::pair<slot_offset_t, TupleMeta>) + node_overhead) +
+                        num_pages * (sizeof(PageVersionInfo) + sizeof(std::pair<PageId, std::shared_ptr<PageVersionInfo>>) +
+                                     node_overhead);
+    return stats;
+}
+
+void TransactionManager::start_garbage_collection() {
+    if (gc_thread_.joinable()) {
+        return;
+    }
+    enable_gc_ = true;
+    gc_thread_ = std::thread(&TransactionManager::run_garbage_collection, this);
+}
+
+void TransactionManager::stop_garbage_collection() {
+    if (!gc_thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(gc_thread_latch_);
+        enable_gc_ = false;
+    }
+    gc_thread_cv_.notify_all();
+    gc_thread_.join();
+}
+
+/**
+ * @description: 垃圾回收线程，每隔gc_interval进行一轮垃圾回收
+ */
+void TransactionManager::run_garbage_collection() {
+    std::unique_lock<std::mutex> lock(gc_thread_latch_);
+    while (true) {
+        gc_thread_cv_.wait_for(lock, gc_interval, [&]() { return !enable_gc_; });
+        if (!enable_gc_) {
+            break;
+        }
+        lock.unlock();
+        GarbageCollection();
+        lock.lock();
+    }
 }
\ No newline at end of file
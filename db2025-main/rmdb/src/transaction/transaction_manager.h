@@ -11,7 +11,10 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <optional>
 #include <functional>
 #include <shared_mutex>
@@ -23,8 +26,11 @@ See the Mulan PSL v2 for more details. */
 #include "system/sm_manager.h"
 #include "common/exception.h"
 
-/* 系统采用的并发控制算法，当前题目中要求两阶段封锁并发控制算法 */
-enum class ConcurrencyMode { TWO_PHASE_LOCKING = 0, BASIC_TO, MVCC };
+/**
+ * 系统采用的并发控制算法，当前题目中要求两阶段封锁并发控制算法。
+ * OCC：Silo风格的乐观并发控制，读不加锁，记录读到的元组版本字，写缓存在事务中，提交时验证并安装，适合冲突很少的短事务
+ */
+enum class ConcurrencyMode { TWO_PHASE_LOCKING = 0, BASIC_TO, MVCC, OCC };
 
 /// 版本链中的第一个撤销链接，将表堆元组链接到撤销日志。
 struct VersionUndoLink {
@@ -46,70 +52,138 @@ struct VersionUndoLink {
     }
 };
 
+/* MVCC下版本占用的内存 */
+struct VersionMemoryStats {
+    size_t num_undo_logs;       // 还没有回收的撤销日志个数
+    size_t undo_log_bytes;      // 撤销日志占用的内存
+    size_t num_version_links;   // 表堆元组到撤销日志的链接个数
+    size_t num_tuple_metas;     // 表堆元组的元信息个数
+    size_t total_bytes;         // 以上所有结构占用的内存，哈希表的元素按照结点大小估计
+};
+
+/* 垃圾回收的统计信息 */
+struct GarbageCollectionStats {
+    size_t num_runs;            // 垃圾回收的轮数
+    size_t num_reclaimed_logs;  // 回收的撤销日志个数
+};
+
 class TransactionManager{
 public:
     explicit TransactionManager(LockManager *lock_manager, SmManager *sm_manager,
                              ConcurrencyMode concurrency_mode = ConcurrencyMode::TWO_PHASE_LOCKING) {
         sm_manager_ = sm_manager;
         lock_manager_ = lock_manager;
-        concurrency_mode_ = concurrency_mode;
+        set_concurrency_mode(concurrency_mode);
     }
     
-    ~TransactionManager() = default;
+    ~TransactionManager();
 
     Transaction* begin(Transaction* txn, LogManager* log_manager);
 
+    Transaction* begin_read_only(LogManager* log_manager);
+
+    /**
+     * @description: 事务提交或者回滚之后由开始事务的调用者交还，之后不能再访问txn。
+     * 只读事务直接释放；MVCC下撤销日志还没有回收的事务留在全局事务表中，由垃圾回收在回收撤销日志之后交还；
+     * 其他事务从全局事务表中删除，放回事务池供之后的begin复用
+     * @param {Transaction*} txn 已经结束的事务
+     */
+    void recycle(Transaction* txn);
+
     void commit(Transaction* txn, LogManager* log_manager);
 
     void abort(Transaction* txn, LogManager* log_manager);
 
     ConcurrencyMode get_concurrency_mode() { return concurrency_mode_; }
 
-    void set_concurrency_mode(ConcurrencyMode concurrency_mode) { concurrency_mode_ = concurrency_mode; }
+    /* 修改并发控制算法，只能在没有正在运行的事务时调用，MVCC下启动垃圾回收线程 */
+    void set_concurrency_mode(ConcurrencyMode concurrency_mode);
 
     LockManager* get_lock_manager() { return lock_manager_; }
 
     /**
-     * @description: 获取事务ID为txn_id的事务对象
-     * @return {Transaction*} 事务对象的指针
+     * @description: 获取事务ID为txn_id的事务对象，只锁住txn_id所在的分区
+     * @return {Transaction*} 事务对象的指针，事务已经交还（见recycle）或者是只读事务时返回空指针
      * @param {txn_id_t} txn_id 事务ID
      */    
     Transaction* get_transaction(txn_id_t txn_id) {
         if(txn_id == INVALID_TXN_ID) return nullptr;
-        
-        std::unique_lock<std::mutex> lock(latch_);
-        assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-        auto *res = TransactionManager::txn_map[txn_id];
-        lock.unlock();
-        assert(res != nullptr);
-        assert(res->get_thread_id() == std::this_thread::get_id());
-
-        return res;
+
+        auto &shard = txn_map_shard(txn_id);
+        std::lock_guard<std::mutex> lock(shard.latch_);
+        auto it = shard.txns_.find(txn_id);
+        return it != shard.txns_.end() ? it->second : nullptr;
     }
 
-    static std::unordered_map<txn_id_t, Transaction *> txn_map;     // 全局事务表，存放事务ID与事务对象的映射关系
-    std::shared_mutex txn_map_mutex_;
+    /* 全局事务表中的事务个数和事务池中空闲的事务对象个数，需要锁住每个分区，只用于统计 */
+    size_t get_num_transactions();
+    size_t get_pool_size();
+
+    static constexpr size_t NUM_TXN_MAP_SHARDS = 64;
+    static constexpr size_t NUM_TXN_POOL_SHARDS = 64;
+    static constexpr size_t MAX_POOLED_TXNS_PER_SHARD = 64;
+    /**
+     * @brief OCC下表数据文件fh中rid的版本字，第一次访问页面时创建整个页面的版本字，初始为0（存在，TID为0）。
+     * 版本字在TransactionManager的生命周期内不会移动或者释放，读集和写集中直接保存指针
+     */
+    std::atomic<uint64_t> *GetTupleVersion(RmFileHandle *fh, const Rid &rid);
+
+    /**
+     * 提前释放锁（early lock release）：提交日志写入日志缓冲区之后立即释放锁，然后等待提交日志持久化再返回；
+     * 关闭时持有锁直到提交日志持久化。获得提前释放的锁的事务在提交前要等待释放者的提交日志持久化，见LockManager::unlock。
+     * 只在提交时传入了LogManager时生效
+     */
+    void set_early_lock_release(bool enabled) { early_lock_release_ = enabled; }
+    bool get_early_lock_release() const { return early_lock_release_; }
+
+    /* 两阶段封锁下只包含增量的update是否使用escrow锁，关闭时和普通的update一样加X锁 */
+    void set_escrow_enabled(bool enabled) { escrow_enabled_ = enabled; }
+    bool get_escrow_enabled() const { return escrow_enabled_; }
+
+    /**
+     * @brief 事务获得记录的X锁之后，把它在这条记录上缓存的增量写入表堆，保存旧的记录用于回滚，
+     * 之后这条记录上的读写直接访问表堆
+     */
+    void FlushEscrow(Transaction *txn, RmFileHandle *fh, const Rid &rid);
+
     /** ------------------------以下函数仅可能在MVCC当中使用------------------------------------------*/
 
+    /** 没有修改过的元组的元信息：在所有事务开始之前提交，对所有事务可见 */
+    static constexpr TupleMeta DEFAULT_TUPLE_META{0, false};
+
+    struct PageVersionInfo;
+
+    /**
+     * @brief 获取表数据文件fd中页面page_no的版本信息，不存在时创建。
+     * 读写元组、元信息和撤销链接时都要持有PageVersionInfo::mutex_，保证三者一致
+     */
+    std::shared_ptr<PageVersionInfo> GetPageVersionInfo(int fd, page_id_t page_no);
+
     /**
     * @brief 更新一个撤销链接，该链接将表堆元组与第一个撤销日志连接起来。
     * 在更新之前，将调用 `check` 函数以确保有效性。
     */
-    bool UpdateUndoLink(Rid rid, std::optional<UndoLink> prev_link,
+    bool UpdateUndoLink(int fd, Rid rid, std::optional<UndoLink> prev_link,
                         std::function<bool(std::optional<UndoLink>)> &&check = nullptr);
 
     /**
      * @brief 更新一个撤销链接，该链接将表堆元组与第一个撤销日志连接起来。
      * 在更新之前，将调用 `check` 函数以确保有效性。
      */
-    bool UpdateVersionLink(Rid rid, std::optional<VersionUndoLink> prev_version,
+    bool UpdateVersionLink(int fd, Rid rid, std::optional<VersionUndoLink> prev_version,
                            std::function<bool(std::optional<VersionUndoLink>)> &&check = nullptr);
 
     /** @brief 获取表堆元组的第一个撤销日志。 */
-    std::optional<UndoLink> GetUndoLink(Rid rid);
+    std::optional<UndoLink> GetUndoLink(int fd, Rid rid);
 
     /** @brief 获取表堆元组的第一个撤销日志。*/
-    std::optional<VersionUndoLink> GetVersionLink(Rid rid);
+    std::optional<VersionUndoLink> GetVersionLink(int fd, Rid rid);
+
+    /** @brief 获取表堆元组的元信息，没有修改过的元组返回DEFAULT_TUPLE_META。 */
+    TupleMeta GetTupleMeta(int fd, Rid rid);
+
+    /** @brief 最后提交的事务的提交时间戳，新开始的事务以此作为读时间戳。 */
+    timestamp_t GetLastCommitTs() { return last_commit_ts_.load(); }
 
     /** @brief 访问事务撤销日志缓冲区并获取撤销日志。如果事务不存在，返回 nullopt。
      * 如果索引超出范围仍然会抛出异常。 */
@@ -119,11 +193,28 @@ public:
      * 否则应该始终调用此函数以获取撤销日志，而不是手动检索事务 shared_ptr 并访问缓冲区。 */
     UndoLog GetUndoLog(UndoLink link);
 
+    /** @brief 在事务的撤销日志缓冲区中追加撤销日志，并计入版本占用的内存。 */
+    UndoLink AppendUndoLog(Transaction *txn, UndoLog undo_log);
+
+    /** @brief 修改事务已有的撤销日志，并更新版本占用的内存。 */
+    void ModifyUndoLog(Transaction *txn, int log_idx, UndoLog undo_log);
+
     /** @brief 获取系统中的最低读时间戳。 */
-    timestamp_t GetWatermark();
+    timestamp_t GetWatermark() { return running_txns_.GetWatermark(); }
+
+    /**
+     * @brief 一轮垃圾回收，由垃圾回收线程每隔gc_interval调用，也可以直接调用。
+     * 逐个页面剪短版本链，释放所有撤销日志都已经不可达的已结束事务的撤销日志，不阻塞正在运行的事务。
+     * @return 回收的撤销日志个数
+     */
+    size_t GarbageCollection();
+
+    VersionMemoryStats GetVersionMemoryStats();
 
-    /** @brief 垃圾回收。仅在所有事务都未访问时调用。 */
-    void GarbageCollection();
+    GarbageCollectionStats GetGarbageCollectionStats() const {
+        return GarbageCollectionStats{.num_runs = num_gc_runs_.load(),
+                                      .num_reclaimed_logs = num_reclaimed_logs_.load()};
+    }
 
     struct PageVersionInfo {
         std::shared_mutex mutex_;
@@ -131,22 +222,100 @@ public:
          * 即使不存在也会创建新元素。请使用 `find` 来代替。
          */
         std::unordered_map<slot_offset_t, VersionUndoLink> prev_version_;
+        /** 修改过的槽的元信息，其余的槽使用DEFAULT_TUPLE_META。同样只能使用 `find` 访问。 */
+        std::unordered_map<slot_offset_t, TupleMeta> tuple_meta_;
     };
 
     /** 保护版本信息 */
     std::shared_mutex version_info_mutex_;
-    /** 存储表堆中每个元组的先前版本。 */
-    std::unordered_map<page_id_t, std::shared_ptr<PageVersionInfo>> version_info_;
+    /** 存储表堆中每个元组的先前版本，按照(表数据文件fd, 页面号)区分不同表的页面。 */
+    std::unordered_map<PageId, std::shared_ptr<PageVersionInfo>> version_info_;
 
 
 private:
+    /**
+     * 全局事务表的一个分区，存放事务ID与事务对象的映射关系，事务ID决定事务属于哪个分区。
+     * 按照cache line对齐，避免相邻分区的latch互相干扰
+     */
+    struct alignas(64) TxnMapShard {
+        std::mutex latch_;
+        std::unordered_map<txn_id_t, Transaction *> txns_;
+    };
+
+    /* 事务池的一个分区，线程从自己对应的分区中取出和放回空闲的事务对象 */
+    struct alignas(64) TxnPoolShard {
+        std::mutex latch_;
+        std::vector<Transaction *> free_txns_;
+    };
+
+    TxnMapShard &txn_map_shard(txn_id_t txn_id) { return txn_map_[txn_id % NUM_TXN_MAP_SHARDS]; }
+
+    TxnPoolShard &txn_pool_shard() {
+        return txn_pool_[std::hash<std::thread::id>()(std::this_thread::get_id()) % NUM_TXN_POOL_SHARDS];
+    }
+
+    Transaction* allocate_transaction();
+
+    void release_transaction(Transaction* txn);
+
+    void start_snapshot(Transaction* txn);
+
+    void commit_read_only(Transaction* txn, LogManager* log_manager);
+
+    std::vector<LockDataId> release_locks(Transaction* txn, lsn_t commit_lsn = INVALID_LSN);
+
+    void rollback_write(Transaction* txn, WriteRecord* write_record);
+
+    void rollback_mvcc_write(Transaction* txn, WriteRecord* write_record);
+
+    void commit_occ(Transaction* txn);
+
+    void install_occ_write(OccWriteRecord* write_record, uint64_t tid);
+
+    void abort_occ(Transaction* txn);
+
+    void apply_escrow(Transaction *txn, RmFileHandle *fh, const EscrowRecord &escrow_record, LogManager *log_manager,
+                      RmRecord *old_rec);
+
+    void add_gc_candidate(Transaction* txn);
+
+    void prune_page(PageVersionInfo *page_info, timestamp_t watermark, std::unordered_set<txn_id_t> *reachable);
+
+    void start_garbage_collection();
+
+    void stop_garbage_collection();
+
+    void run_garbage_collection();
+
     ConcurrencyMode concurrency_mode_;      // 事务使用的并发控制算法，目前只需要考虑2PL
     std::atomic<txn_id_t> next_txn_id_{0};  // 用于分发事务ID
     std::atomic<timestamp_t> next_timestamp_{0};    // 用于分发事务时间戳
-    std::mutex latch_;  // 用于txn_map的并发
+    TxnMapShard txn_map_[NUM_TXN_MAP_SHARDS];   // 分区的全局事务表
+    TxnPoolShard txn_pool_[NUM_TXN_POOL_SHARDS];    // 分区的事务池
     SmManager *sm_manager_;
     LockManager *lock_manager_;
 
     std::atomic<timestamp_t> last_commit_ts_{0};    // 最后提交的时间戳,仅用于MVCC
+    std::mutex commit_latch_;               // MVCC下串行化提交，提交时间戳按照顺序生效
     Watermark running_txns_{0};             // 存储所有正在运行事务的读取时间戳，以便于垃圾回收，仅用于MVCC
+
+    std::shared_mutex occ_versions_mutex_;  // 保护occ_versions_
+    std::unordered_map<PageId, std::unique_ptr<std::atomic<uint64_t>[]>> occ_versions_;   // 每个页面中元组的版本字，仅用于OCC
+
+    static constexpr size_t NUM_ESCROW_LATCHES = 64;
+    bool early_lock_release_ = true;
+    bool escrow_enabled_ = true;
+    std::mutex escrow_latches_[NUM_ESCROW_LATCHES];    // 持有escrow锁的事务可能同时提交，按照页面分区串行地修改记录
+
+    std::mutex gc_latch_;                   // 同一时刻只进行一轮垃圾回收
+    std::mutex gc_candidates_latch_;
+    std::vector<Transaction *> gc_candidates_;  // 已经结束、撤销日志还没有回收的事务
+    std::thread gc_thread_;                 // 垃圾回收线程，只在MVCC下运行
+    std::mutex gc_thread_latch_;
+    std::condition_variable gc_thread_cv_;  // 停止垃圾回收时唤醒垃圾回收线程
+    bool enable_gc_ = false;
+    std::atomic<int64_t> num_undo_logs_{0};
+    std::atomic<int64_t> undo_log_bytes_{0};
+    std::atomic<size_t> num_gc_runs_{0};
+    std::atomic<size_t> num_reclaimed_logs_{0};
 };
\ No newline at end of file
@@ -65,6 +65,14 @@ class WriteRecord {
     RmRecord record_;
 };
 
+/**
+ * OCC下每个元组的版本字：最高位是锁位，提交时写事务持有；次高位表示元组不存在（已经删除，或者插入的事务还没有提交）；
+ * 其余位是最后一次修改该元组的事务的TID
+ */
+static constexpr uint64_t OCC_LOCK_BIT = 1ULL << 63;
+static constexpr uint64_t OCC_ABSENT_BIT = 1ULL << 62;
+static constexpr uint64_t OCC_TID_MASK = OCC_ABSENT_BIT - 1;
+
 /* 多粒度锁，加锁对象的类型，包括记录和表 */
 enum class LockDataType { TABLE = 0, RECORD = 1 };
 
@@ -117,7 +125,7 @@ struct std::hash<LockDataId> {
 };
 
 /* 事务回滚原因 */
-enum class AbortReason { LOCK_ON_SHIRINKING = 0, UPGRADE_CONFLICT, DEADLOCK_PREVENTION };
+enum class AbortReason { LOCK_ON_SHIRINKING = 0, UPGRADE_CONFLICT, DEADLOCK_PREVENTION, DEADLOCK_DETECTION, WRITE_WRITE_CONFLICT, VALIDATION_FAILED };
 
 /* 事务回滚异常，在rmdb.cpp中进行处理 */
 class TransactionAbortException : public std::exception {
@@ -146,6 +154,20 @@ class TransactionAbortException : public std::exception {
                 return "Transaction " + std::to_string(txn_id_) + " aborted for deadlock prevention\n";
             } break;
 
+            case AbortReason::DEADLOCK_DETECTION: {
+                return "Transaction " + std::to_string(txn_id_) + " aborted to break a deadlock\n";
+            } break;
+
+            case AbortReason::WRITE_WRITE_CONFLICT: {
+                return "Transaction " + std::to_string(txn_id_) +
+                       " aborted because the tuple was modified by a concurrent transaction\n";
+            } break;
+
+            case AbortReason::VALIDATION_FAILED: {
+                return "Transaction " + std::to_string(txn_id_) +
+                       " aborted because a tuple it read was modified before it committed\n";
+            } break;
+
             default: {
                 return "Transaction aborted\n";
             } break;
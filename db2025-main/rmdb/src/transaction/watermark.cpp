@@ -10,10 +10,35 @@ See the Mulan PSL v2 for more details. */
 
 #include "transaction/watermark.h"
 
+#include <thread>
 
-auto Watermark::AddTxn(timestamp_t read_ts) -> void {
-}
 
-auto Watermark::RemoveTxn(timestamp_t read_ts) -> void {
+auto Watermark::AddTxn(timestamp_t read_ts, size_t hint) -> size_t {
+    for (size_t probe = 0;; probe++) {
+        size_t i = (hint + probe) % NUM_SLOTS;
+        timestamp_t expected = INVALID_TS;
+        if (slots_[i].read_ts_.load(std::memory_order_relaxed) == INVALID_TS &&
+            slots_[i].read_ts_.compare_exchange_strong(expected, read_ts)) {
+            return i;
+        }
+        if (probe % NUM_SLOTS == NUM_SLOTS - 1) {
+            // 正在运行的事务比槽位多，等待其他事务结束
+            std::this_thread::yield();
+        }
+    }
+}
 
-}
\ No newline at end of file
+/**
+ * 先读取提交时间戳再扫描槽位：事务开始时先发布读到的提交时间戳，再重新读取提交时间戳作为读时间戳，
+ * 扫描时还没有发布的事务的读时间戳不会小于这里读到的提交时间戳
+ */
+auto Watermark::GetWatermark() const -> timestamp_t {
+    timestamp_t watermark = commit_ts_.load();
+    for (auto &slot : slots_) {
+        timestamp_t read_ts = slot.read_ts_.load();
+        if (read_ts != INVALID_TS && read_ts < watermark) {
+            watermark = read_ts;
+        }
+    }
+    return watermark;
+}
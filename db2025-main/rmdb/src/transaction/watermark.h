@@ -10,32 +10,41 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
-#include <map>
-#include <unordered_map>
+#include <atomic>
 
 #include "transaction/transaction.h"
 
 
 /**
- * @brief 追踪所有的读时间戳
- *
+ * @brief 追踪所有正在运行的事务的读时间戳，水印是其中最小的读时间戳，没有正在运行的事务时为最后的提交时间戳。
+ * 提交时间戳不大于水印的版本对所有正在运行和之后开始的事务都可见，更老的版本可以回收。
+ * 每个正在运行的事务占用一个槽位发布自己的读时间戳，开始和结束事务只需要一次CAS，不需要加锁；
+ * 计算水印时扫描所有槽位，由垃圾回收线程低频调用
  */
 class Watermark {
 public:
-  explicit Watermark(timestamp_t commit_ts) : commit_ts_(commit_ts), watermark_(commit_ts) {}
+  static constexpr size_t NUM_SLOTS = 1024;
 
-  void AddTxn(timestamp_t read_ts);
+  explicit Watermark(timestamp_t commit_ts) : commit_ts_(commit_ts) {}
 
-  void RemoveTxn(timestamp_t read_ts);
+  /** @return 发布read_ts的槽位，从hint开始查找空闲的槽位 */
+  size_t AddTxn(timestamp_t read_ts, size_t hint);
 
-  /** 调用者应在从水印中移除事务之前更新提交时间戳，以便我们能够正确跟踪水印。 */
-  void UpdateCommitTs(timestamp_t commit_ts);
+  /** 修改槽位中发布的读时间戳，只能改大 */
+  void UpdateTxn(size_t slot, timestamp_t read_ts) { slots_[slot].read_ts_.store(read_ts); }
+
+  void RemoveTxn(size_t slot) { slots_[slot].read_ts_.store(INVALID_TS); }
 
-  timestamp_t GetWatermark();
+  /** 调用者应在从水印中移除事务之前更新提交时间戳，以便我们能够正确跟踪水印。 */
+  void UpdateCommitTs(timestamp_t commit_ts) { commit_ts_.store(commit_ts); }
 
-  mutable timestamp_t commit_ts_;
+  timestamp_t GetWatermark() const;
 
-  timestamp_t watermark_;
+private:
+  struct alignas(64) Slot {
+    std::atomic<timestamp_t> read_ts_{INVALID_TS};
+  };
 
-  std::map<timestamp_t, int> current_reads_;
-};
\ No newline at end of file
+  std::atomic<timestamp_t> commit_ts_;
+  Slot slots_[NUM_SLOTS];   // 正在运行的事务的读时间戳，INVALID_TS表示空闲
+};
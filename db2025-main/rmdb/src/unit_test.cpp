@@ -18,23 +18,46 @@ See the Mulan PSL v2 for more details. */
 #undef private
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <malloc.h>
 #include <memory>
+#include <numeric>
+#include <optional>
 #include <random>
 #include <set>
+#include <sstream>
 #include <string>
 #include <thread>  // NOLINT
 #include <unordered_map>
 #include <vector>
 
+#include "analyze/analyze.h"
+#include "execution/execution_sort.h"
+#include "execution/executor_bitmap_scan.h"
+#include "execution/executor_delete.h"
+#include "execution/executor_index_only_scan.h"
+#include "execution/executor_insert.h"
+#include "execution/executor_update.h"
 #include "gtest/gtest.h"
+#include "optimizer/planner.h"
+#include "parser/parser.h"
+#include "recovery/log_recovery.h"
 #include "replacer/lru_replacer.h"
 #include "storage/disk_manager.h"
+#include "transaction/transaction_manager.h"
 
 const std::string TEST_DB_NAME = "BufferPoolManagerTest_db";  // 以数据库名作为根目录
 const std::string TEST_FILE_NAME = "basic";                   // 测试文件的名字
@@ -661,3 +684,4751 @@ TEST(RecordManagerTest, SimpleTest) {
     rm_manager->close_file(file_handle.get());
     rm_manager->destroy_file(filename);
 }
+
+/** 
+ * 优化器测试在DbMeta中构造表的元数据，并在TEST_DB_NAME目录下为每张表创建数据文件，
+ * 数据文件中不插入记录，只在文件头中设置记录数用于估算表的基数。
+ * SQL语句经过parser和analyze后交给planner生成查询计划，然后检查计划的形状 */
+class PlannerTest : public ::testing::Test {
+   public:
+    std::unique_ptr<RmManager> rm_manager_;
+    std::unique_ptr<SmManager> sm_manager_;
+    std::unique_ptr<Planner> planner_;
+
+   public:
+    void SetUp() override {
+        ::testing::Test::SetUp();
+        if (!disk_manager->is_dir(TEST_DB_NAME)) {
+            disk_manager->create_dir(TEST_DB_NAME);
+        }
+        assert(disk_manager->is_dir(TEST_DB_NAME));
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
+        rm_manager_ = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+        sm_manager_ = std::make_unique<SmManager>(disk_manager.get(), buffer_pool_manager.get(), rm_manager_.get(),
+                                                  nullptr);
+        planner_ = std::make_unique<Planner>(sm_manager_.get());
+    }
+
+    void TearDown() override {
+        for (auto &entry : sm_manager_->fhs_) {
+            rm_manager_->close_file(entry.second.get());
+            rm_manager_->destroy_file(entry.first);
+        }
+        sm_manager_->fhs_.clear();
+        if (chdir("..") < 0) {
+            throw UnixError();
+        }
+    }
+
+    // 创建表，cols中每一项为<列名, 类型, 长度>，num_rows为表的基数
+    void create_table(const std::string &tab_name, const std::vector<std::tuple<std::string, ColType, int>> &cols,
+                      int num_rows = 0) {
+        TabMeta tab;
+        tab.name = tab_name;
+        int offset = 0;
+        for (auto &col : cols) {
+            ColMeta col_meta = {.tab_name = tab_name,
+                                .name = std::get<0>(col),
+                                .type = std::get<1>(col),
+                                .len = std::get<2>(col),
+                                .offset = offset,
+                                .index = false};
+            offset += col_meta.len;
+            tab.cols.push_back(col_meta);
+        }
+        sm_manager_->db_.SetTabMeta(tab_name, tab);
+        if (disk_manager->is_file(tab_name)) {
+            disk_manager->destroy_file(tab_name);
+        }
+        rm_manager_->create_file(tab_name, offset);
+        auto fh = rm_manager_->open_file(tab_name);
+        fh->file_hdr_.num_records = num_rows;
+        sm_manager_->fhs_.emplace(tab_name, std::move(fh));
+    }
+
+    // 在表上添加索引的元数据，只用于生成查询计划
+    void add_index(const std::string &tab_name, const std::vector<std::string> &col_names,
+                   IndexType type = INDEX_BTREE) {
+        TabMeta &tab = sm_manager_->db_.get_table(tab_name);
+        IndexMeta index = {.tab_name = tab_name, .col_tot_len = 0, .col_num = (int)col_names.size(), .type = type};
+        for (auto &col_name : col_names) {
+            auto col = *tab.get_col(col_name);
+            index.col_tot_len += col.len;
+            index.cols.push_back(col);
+        }
+        tab.indexes.push_back(index);
+    }
+
+    // 解析sql语句，结果保存在ast::parse_tree中
+    void parse_sql(const std::string &sql) {
+        YY_BUFFER_STATE buf = yy_scan_string(sql.c_str());
+        int res = yyparse();
+        yy_delete_buffer(buf);
+        ASSERT_EQ(res, 0) << sql;
+        ASSERT_NE(ast::parse_tree, nullptr) << sql;
+    }
+
+    // 生成select语句的查询计划，返回最上层ProjectionPlan下面的计划
+    std::shared_ptr<Plan> plan_select(const std::string &sql) {
+        parse_sql(sql);
+        // 解析失败时抛出异常结束当前测试，避免后续解引用空的计划树
+        if (HasFatalFailure()) throw InternalError("failed to parse: " + sql);
+        Analyze analyze(sm_manager_.get());
+        auto query = analyze.do_analyze(ast::parse_tree);
+        auto root = std::dynamic_pointer_cast<DMLPlan>(planner_->do_planner(query, nullptr));
+        assert(root != nullptr && root->tag == T_select);
+        auto proj = std::dynamic_pointer_cast<ProjectionPlan>(root->subplan_);
+        assert(proj != nullptr);
+        return proj->subplan_;
+    }
+
+    // 在计划树中查找指定表的表扫描算子
+    static std::shared_ptr<ScanPlan> find_scan(const std::shared_ptr<Plan> &plan, const std::string &tab_name) {
+        if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+            return x->tab_name_ == tab_name ? x : nullptr;
+        } else if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+            return find_scan(x->subplan_, tab_name);
+        } else if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+            auto res = find_scan(x->left_, tab_name);
+            return res != nullptr ? res : find_scan(x->right_, tab_name);
+        } else if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
+            return find_scan(x->subplan_, tab_name);
+        }
+        return nullptr;
+    }
+
+    // 在计划树中查找包裹指定表扫描算子的投影算子
+    static std::shared_ptr<ProjectionPlan> find_scan_projection(const std::shared_ptr<Plan> &plan,
+                                                                const std::string &tab_name) {
+        if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+            auto scan = std::dynamic_pointer_cast<ScanPlan>(x->subplan_);
+            if (scan != nullptr && scan->tab_name_ == tab_name) return x;
+            return find_scan_projection(x->subplan_, tab_name);
+        } else if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+            auto res = find_scan_projection(x->left_, tab_name);
+            return res != nullptr ? res : find_scan_projection(x->right_, tab_name);
+        } else if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
+            return find_scan_projection(x->subplan_, tab_name);
+        }
+        return nullptr;
+    }
+
+    static bool has_cond(const std::vector<Condition> &conds, const std::string &lhs, CompOp op, int val) {
+        for (auto &cond : conds) {
+            if (cond.is_rhs_val && cond.lhs_col.col_name == lhs && cond.op == op && cond.rhs_val.int_val == val)
+                return true;
+        }
+        return false;
+    }
+};
+
+TEST_F(PlannerTest, PredicatePushdownTest) {
+    create_table("a", {{"id", TYPE_INT, 4}, {"x", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}});
+    create_table("b", {{"id", TYPE_INT, 4}, {"y", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}});
+
+    // 单表条件和同一张表的列之间的条件都下推到该表的扫描算子，连接算子上只保留连接条件
+    auto plan = plan_select("select a.x, b.y from a, b where a.id = b.id and a.x > 3 and b.y = b.id;");
+    auto scan_a = find_scan(plan, "a");
+    auto scan_b = find_scan(plan, "b");
+    ASSERT_NE(scan_a, nullptr);
+    ASSERT_NE(scan_b, nullptr);
+    EXPECT_TRUE(has_cond(scan_a->conds_, "x", OP_GT, 3));
+    ASSERT_EQ(scan_b->conds_.size(), 1u);
+    EXPECT_FALSE(scan_b->conds_[0].is_rhs_val);
+    auto join = std::dynamic_pointer_cast<JoinPlan>(plan);
+    ASSERT_NE(join, nullptr);
+    for (auto &cond : join->conds_) {
+        EXPECT_FALSE(cond.is_rhs_val);
+        EXPECT_NE(cond.lhs_col.tab_name, cond.rhs_col.tab_name);
+    }
+}
+
+TEST_F(PlannerTest, ImpliedEqualityTest) {
+    create_table("a", {{"id", TYPE_INT, 4}, {"x", TYPE_INT, 4}});
+    create_table("b", {{"id", TYPE_INT, 4}, {"y", TYPE_INT, 4}});
+    create_table("c", {{"id", TYPE_INT, 4}, {"z", TYPE_INT, 4}});
+
+    // a.x = b.y and b.y = 5 可以推导出 a.x = 5
+    auto plan = plan_select("select * from a, b where a.x = b.y and b.y = 5;");
+    EXPECT_TRUE(has_cond(find_scan(plan, "a")->conds_, "x", OP_EQ, 5));
+    EXPECT_TRUE(has_cond(find_scan(plan, "b")->conds_, "y", OP_EQ, 5));
+
+    // 范围条件同样沿着等值条件传播，并且能推导出 a.id = c.id
+    plan = plan_select("select * from a, b, c where a.id = b.id and b.id = c.id and c.id < 10;");
+    EXPECT_TRUE(has_cond(find_scan(plan, "a")->conds_, "id", OP_LT, 10));
+    EXPECT_TRUE(has_cond(find_scan(plan, "b")->conds_, "id", OP_LT, 10));
+    EXPECT_TRUE(has_cond(find_scan(plan, "c")->conds_, "id", OP_LT, 10));
+    size_t num_join_conds = 0;
+    std::function<void(const std::shared_ptr<Plan> &)> count_conds = [&](const std::shared_ptr<Plan> &node) {
+        if (auto x = std::dynamic_pointer_cast<JoinPlan>(node)) {
+            num_join_conds += x->conds_.size();
+            count_conds(x->left_);
+            count_conds(x->right_);
+        }
+    };
+    count_conds(plan);
+    EXPECT_EQ(num_join_conds, 3);
+}
+
+TEST_F(PlannerTest, ImpliedConstLengthTest) {
+    create_table("a", {{"id", TYPE_INT, 4}, {"s", TYPE_STRING, 16}});
+    create_table("b", {{"id", TYPE_INT, 4}, {"s", TYPE_STRING, 4}});
+
+    // b.s比常量短，按照b.s的长度生成raw会溢出，常量条件不能传播到b.s
+    std::shared_ptr<Plan> plan;
+    ASSERT_NO_THROW(plan = plan_select("select * from a, b where a.s = b.s and a.s = 'abcdefghij';"));
+    EXPECT_EQ(find_scan(plan, "a")->conds_.size(), 1u);
+    for (auto &cond : find_scan(plan, "b")->conds_) {
+        EXPECT_FALSE(cond.is_rhs_val);
+    }
+
+    // 类型和长度都相同的列之间照常传播
+    create_table("c", {{"id", TYPE_INT, 4}, {"s", TYPE_STRING, 16}});
+    plan = plan_select("select * from a, c where a.s = c.s and a.s = 'abcdefghij';");
+    EXPECT_EQ(find_scan(plan, "c")->conds_.size(), 1u);
+    EXPECT_TRUE(find_scan(plan, "c")->conds_[0].is_rhs_val);
+}
+
+TEST_F(PlannerTest, ProjectionPushdownTest) {
+    create_table("a", {{"id", TYPE_INT, 4}, {"x", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}});
+    create_table("b", {{"id", TYPE_INT, 4}, {"y", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}});
+    create_table("c", {{"id", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}});
+
+    // 每个表只输出select列表和连接条件中用到的列
+    auto plan = plan_select("select a.x, b.y from a, b, c where a.id = b.id;");
+    auto proj_a = find_scan_projection(plan, "a");
+    auto proj_b = find_scan_projection(plan, "b");
+    auto proj_c = find_scan_projection(plan, "c");
+    ASSERT_NE(proj_a, nullptr);
+    ASSERT_NE(proj_b, nullptr);
+    ASSERT_NE(proj_c, nullptr);
+    ASSERT_EQ(proj_a->sel_cols_.size(), 2);
+    EXPECT_EQ(proj_a->sel_cols_[0].col_name, "id");
+    EXPECT_EQ(proj_a->sel_cols_[1].col_name, "x");
+    ASSERT_EQ(proj_b->sel_cols_.size(), 2);
+    // c只参与笛卡尔积，只保留最短的一列
+    ASSERT_EQ(proj_c->sel_cols_.size(), 1);
+    EXPECT_EQ(proj_c->sel_cols_[0].col_name, "id");
+
+    // 单表条件在扫描算子中求值，不需要输出条件中的列
+    plan = plan_select("select a.id, b.id from a, b where a.id = b.id and a.pad = 'x';");
+    ASSERT_EQ(find_scan_projection(plan, "a")->sel_cols_.size(), 1);
+
+    // select * 不需要投影下推
+    plan = plan_select("select * from a, b where a.id = b.id;");
+    EXPECT_EQ(find_scan_projection(plan, "a"), nullptr);
+    EXPECT_EQ(find_scan_projection(plan, "b"), nullptr);
+}
+
+/** 
+ * TPC-C的表结构（只保留查询中用到的列）和1个warehouse时各个表的基数 */
+class TpccPlannerTest : public PlannerTest {
+   public:
+    void SetUp() override {
+        PlannerTest::SetUp();
+        create_table("warehouse", {{"w_id", TYPE_INT, 4}, {"w_name", TYPE_STRING, 10}, {"w_tax", TYPE_FLOAT, 4}}, 1);
+        create_table("district",
+                     {{"d_id", TYPE_INT, 4}, {"d_w_id", TYPE_INT, 4}, {"d_name", TYPE_STRING, 10},
+                      {"d_next_o_id", TYPE_INT, 4}},
+                     10);
+        create_table("customer",
+                     {{"c_id", TYPE_INT, 4}, {"c_d_id", TYPE_INT, 4}, {"c_w_id", TYPE_INT, 4},
+                      {"c_last", TYPE_STRING, 16}, {"c_balance", TYPE_FLOAT, 4}},
+                     30000);
+        create_table("orders",
+                     {{"o_id", TYPE_INT, 4}, {"o_d_id", TYPE_INT, 4}, {"o_w_id", TYPE_INT, 4}, {"o_c_id", TYPE_INT, 4},
+                      {"o_carrier_id", TYPE_INT, 4}},
+                     30000);
+        create_table("new_orders", {{"no_o_id", TYPE_INT, 4}, {"no_d_id", TYPE_INT, 4}, {"no_w_id", TYPE_INT, 4}},
+                     9000);
+        create_table("order_line",
+                     {{"ol_o_id", TYPE_INT, 4}, {"ol_d_id", TYPE_INT, 4}, {"ol_w_id", TYPE_INT, 4},
+                      {"ol_number", TYPE_INT, 4}, {"ol_i_id", TYPE_INT, 4}, {"ol_amount", TYPE_FLOAT, 4}},
+                     300000);
+        create_table("item", {{"i_id", TYPE_INT, 4}, {"i_name", TYPE_STRING, 24}, {"i_price", TYPE_FLOAT, 4}},
+                     100000);
+        create_table("stock", {{"s_i_id", TYPE_INT, 4}, {"s_w_id", TYPE_INT, 4}, {"s_quantity", TYPE_INT, 4}},
+                     100000);
+    }
+
+    // 收集计划中的表扫描算子（可能被投影算子包裹）和连接条件
+    static void collect(const std::shared_ptr<Plan> &plan, std::map<std::string, std::shared_ptr<Plan>> &scans,
+                        std::vector<Condition> &conds) {
+        if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+            conds.insert(conds.end(), x->conds_.begin(), x->conds_.end());
+            collect(x->left_, scans, conds);
+            collect(x->right_, scans, conds);
+        } else {
+            auto proj = std::dynamic_pointer_cast<ProjectionPlan>(plan);
+            auto base = proj != nullptr ? proj->subplan_ : plan;
+            scans[std::dynamic_pointer_cast<ScanPlan>(base)->tab_name_] = plan;
+        }
+    }
+
+    // 按照order给出的顺序生成左深树，每次连接时加入新表和已连接的表之间的所有条件
+    static std::shared_ptr<Plan> left_deep_plan(const std::vector<std::string> &order,
+                                                std::map<std::string, std::shared_ptr<Plan>> &scans,
+                                                const std::vector<Condition> &conds) {
+        std::shared_ptr<Plan> plan = scans.at(order[0]);
+        std::set<std::string> joined = {order[0]};
+        for (size_t i = 1; i < order.size(); i++) {
+            std::vector<Condition> join_conds;
+            for (auto &cond : conds) {
+                if ((joined.count(cond.lhs_col.tab_name) && cond.rhs_col.tab_name == order[i]) ||
+                    (joined.count(cond.rhs_col.tab_name) && cond.lhs_col.tab_name == order[i])) {
+                    join_conds.push_back(cond);
+                }
+            }
+            plan = std::make_shared<JoinPlan>(T_NestLoop, plan, scans.at(order[i]), join_conds);
+            joined.insert(order[i]);
+        }
+        return plan;
+    }
+
+    // 检查动态规划得到的计划不差于任何不含笛卡尔积的左深树，并输出相对于from子句顺序的代价比
+    void check_plan_quality(const std::string &sql, const std::vector<std::string> &from_order) {
+        auto plan = plan_select(sql);
+        CostModel cost_model(sm_manager_.get());
+        double dp_cost = cost_model.estimate(plan).cost;
+
+        std::map<std::string, std::shared_ptr<Plan>> scans;
+        std::vector<Condition> conds;
+        collect(plan, scans, conds);
+        ASSERT_EQ(scans.size(), from_order.size());
+
+        std::vector<std::string> order = from_order;
+        std::sort(order.begin(), order.end());
+        double best_left_deep = -1;
+        do {
+            bool connected = true;
+            for (size_t i = 1; i < order.size() && connected; i++) {
+                connected = std::any_of(conds.begin(), conds.end(), [&](const Condition &cond) {
+                    auto in_prefix = [&](const std::string &tab) {
+                        return std::find(order.begin(), order.begin() + i, tab) != order.begin() + i;
+                    };
+                    return (in_prefix(cond.lhs_col.tab_name) && cond.rhs_col.tab_name == order[i]) ||
+                           (in_prefix(cond.rhs_col.tab_name) && cond.lhs_col.tab_name == order[i]);
+                });
+            }
+            if (!connected) continue;
+            double cost = cost_model.estimate(left_deep_plan(order, scans, conds)).cost;
+            if (best_left_deep < 0 || cost < best_left_deep) best_left_deep = cost;
+        } while (std::next_permutation(order.begin(), order.end()));
+        EXPECT_LE(dp_cost, best_left_deep * (1 + 1e-9));
+
+        double naive_cost = cost_model.estimate(left_deep_plan(from_order, scans, conds)).cost;
+        EXPECT_LE(dp_cost, naive_cost * (1 + 1e-9));
+        std::cout << "dp cost " << dp_cost << ", best left-deep cost " << best_left_deep << ", from-order cost "
+                  << naive_cost << ", speedup " << naive_cost / dp_cost << '\n';
+    }
+};
+
+TEST_F(TpccPlannerTest, JoinOrderTest) {
+    // stock level
+    check_plan_quality(
+        "select ol_i_id, s_quantity from order_line, stock, district where ol_w_id = 1 and ol_d_id = 1 and "
+        "s_w_id = ol_w_id and s_i_id = ol_i_id and d_id = ol_d_id and d_w_id = ol_w_id and s_quantity < 10;",
+        {"order_line", "stock", "district"});
+    // 客户在某个区的订单明细，from子句的顺序会先连接两张大表
+    check_plan_quality(
+        "select c_last, o_id, ol_amount from order_line, orders, customer, district, warehouse where "
+        "ol_o_id = o_id and ol_d_id = o_d_id and ol_w_id = o_w_id and o_c_id = c_id and o_d_id = c_d_id and "
+        "o_w_id = c_w_id and c_d_id = d_id and c_w_id = d_w_id and d_w_id = w_id and d_name = 'abc';",
+        {"order_line", "orders", "customer", "district", "warehouse"});
+    // 新订单对应的商品库存
+    check_plan_quality(
+        "select i_name, s_quantity from item, stock, order_line, new_orders where s_i_id = i_id and "
+        "ol_i_id = i_id and ol_o_id = no_o_id and ol_d_id = no_d_id and ol_w_id = no_w_id and s_w_id = 1;",
+        {"item", "stock", "order_line", "new_orders"});
+}
+
+TEST_F(TpccPlannerTest, JoinMethodTest) {
+    std::string sql = "select o_id, ol_amount from orders, order_line where ol_o_id = o_id;";
+    std::function<bool(const std::shared_ptr<Plan> &, PlanTag)> has_join = [&](const std::shared_ptr<Plan> &plan,
+                                                                             PlanTag tag) {
+        auto x = std::dynamic_pointer_cast<JoinPlan>(plan);
+        return x != nullptr && (x->tag == tag || has_join(x->left_, tag) || has_join(x->right_, tag));
+    };
+    // 默认只开启nested loop join
+    EXPECT_TRUE(has_join(plan_select(sql), T_NestLoop));
+    // 两张大表的等值连接，sort merge join的代价更小
+    planner_->set_enable_sortmerge_join(true);
+    EXPECT_TRUE(has_join(plan_select(sql), T_SortMerge));
+    // 只开启sort merge join时，没有等值连接条件的连接仍然只能使用nested loop join
+    planner_->set_enable_nestedloop_join(false);
+    auto plan = plan_select("select o_id, ol_amount from orders, order_line where ol_o_id < o_id;");
+    EXPECT_TRUE(has_join(plan, T_NestLoop));
+    EXPECT_FALSE(has_join(plan, T_SortMerge));
+}
+
+TEST_F(PlannerTest, GreedyJoinOrderTest) {
+    // 表的个数超过动态规划的阈值，链式连接 t0 - t1 - ... - t11，贪心算法不能产生笛卡尔积
+    const size_t num_tables = Planner::DP_JOIN_THRESHOLD + 2;
+    std::string from, where;
+    for (size_t i = 0; i < num_tables; i++) {
+        std::string tab = "t" + std::to_string(i);
+        create_table(tab, {{"id", TYPE_INT, 4}, {"next_id", TYPE_INT, 4}}, 100 * (int)(i + 1));
+        from += (i == 0 ? "" : ", ") + tab;
+        if (i > 0) {
+            where += (i == 1 ? "" : " and ") + std::string("t") + std::to_string(i - 1) + ".next_id = " + tab + ".id";
+        }
+    }
+    auto plan = plan_select("select * from " + from + " where " + where + ";");
+    size_t num_joins = 0;
+    std::function<void(const std::shared_ptr<Plan> &)> check = [&](const std::shared_ptr<Plan> &node) {
+        if (auto x = std::dynamic_pointer_cast<JoinPlan>(node)) {
+            EXPECT_FALSE(x->conds_.empty());
+            num_joins++;
+            check(x->left_);
+            check(x->right_);
+        }
+    };
+    check(plan);
+    EXPECT_EQ(num_joins, num_tables - 1);
+}
+
+/** 
+ * 在倾斜数据上检查ANALYZE生成的统计信息的估算误差。
+ * k服从Zipf分布（大量重复的高频值），u服从均匀分布，s是字符串，前缀集中在少数几个值上。
+ * 误差使用q-error衡量：max(估算值 / 真实值, 真实值 / 估算值) */
+TEST_F(PlannerTest, IndexSelectionTest) {
+    create_table("t", {{"a", TYPE_INT, 4}, {"b", TYPE_INT, 4}, {"c", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}}, 100000);
+    add_index("t", {"a", "b"});
+    auto expect_scan = [&](const std::string &sql, PlanTag tag) {
+        auto scan = find_scan(plan_select(sql), "t");
+        ASSERT_NE(scan, nullptr) << sql;
+        EXPECT_EQ(scan->tag, tag) << sql;
+        if (tag == T_IndexScan || tag == T_BitmapHeapScan) {
+            EXPECT_EQ(scan->index_col_names_, std::vector<std::string>({"a", "b"})) << sql;
+        }
+    };
+
+    // 最左前缀上的等值条件，以及紧随其后的字段上的范围条件，与where条件的顺序无关；
+    // 没有统计信息时等值条件的选择率为0.1，需要回表的记录较多，按照页面顺序回表
+    expect_scan("select a, c from t where a = 1 and b < 3;", T_BitmapHeapScan);
+    expect_scan("select a, c from t where b < 3 and a = 1;", T_BitmapHeapScan);
+    expect_scan("select a, c from t where a = 1;", T_BitmapHeapScan);
+    expect_scan("select a, c from t where a = 1 and b = 2 and c > 3;", T_IndexScan);
+    // 不是最左前缀，或者条件不能确定扫描范围
+    expect_scan("select a, c from t where b = 3;", T_SeqScan);
+    expect_scan("select a, c from t where c = 3;", T_SeqScan);
+    expect_scan("select a, c from t where a <> 3;", T_SeqScan);
+    // 没有统计信息时范围条件的选择率为1/3，按照索引随机读取这么多记录比顺序扫描更慢，按照页面顺序回表仍然更快
+    expect_scan("select a, c from t where a > 99000;", T_BitmapHeapScan);
+
+    // 有统计信息之后根据估算的选择率选择访问路径
+    std::vector<double> vals;
+    for (int i = 0; i < 100000; i++) {
+        vals.push_back(i);
+    }
+    TabStats stats;
+    stats.num_rows = 100000;
+    stats.cols["a"] = ColStats::build(vals, stats.num_rows);
+    sm_manager_->stats_["t"] = stats;
+    expect_scan("select a, c from t where a > 99000;", T_IndexScan);
+    expect_scan("select a, c from t where a >= 1000 and a < 2000;", T_IndexScan);
+    expect_scan("select a, c from t where a > 1000;", T_SeqScan);
+}
+
+TEST_F(PlannerTest, CoveringIndexTest) {
+    create_table("t", {{"a", TYPE_INT, 4}, {"b", TYPE_INT, 4}, {"c", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}}, 100000);
+    create_table("u", {{"x", TYPE_INT, 4}, {"y", TYPE_INT, 4}}, 1000);
+    add_index("t", {"a", "b"});
+    auto scan_tag = [&](const std::string &sql) {
+        auto scan = find_scan(plan_select(sql), "t");
+        EXPECT_NE(scan, nullptr) << sql;
+        return scan == nullptr ? T_SeqScan : scan->tag;
+    };
+
+    // 投影和条件中的列都在索引中
+    EXPECT_EQ(scan_tag("select a, b from t where a = 1 and b < 3;"), T_IndexOnlyScan);
+    EXPECT_EQ(scan_tag("select b from t where a = 1;"), T_IndexOnlyScan);
+    // 投影或者条件中有不在索引中的列，需要回表
+    EXPECT_EQ(scan_tag("select a, c from t where a = 1;"), T_BitmapHeapScan);
+    EXPECT_EQ(scan_tag("select a from t where a = 1 and c = 3;"), T_BitmapHeapScan);
+    // 连接查询中只需要该表的a和b
+    EXPECT_EQ(scan_tag("select t.a, u.x from t, u where t.b = u.y and t.a = 5;"), T_IndexOnlyScan);
+
+    // 覆盖索引扫描不需要随机读取记录，选择率较高时仍然比顺序扫描更好
+    std::vector<double> vals;
+    for (int i = 0; i < 100000; i++) {
+        vals.push_back(i);
+    }
+    TabStats stats;
+    stats.num_rows = 100000;
+    stats.cols["a"] = ColStats::build(vals, stats.num_rows);
+    sm_manager_->stats_["t"] = stats;
+    EXPECT_EQ(scan_tag("select a, b from t where a > 50000;"), T_IndexOnlyScan);
+    EXPECT_EQ(scan_tag("select a, c from t where a > 50000;"), T_SeqScan);
+
+    // 覆盖索引扫描输出的记录由索引字段组成
+    IndexOnlyScanExecutor executor(sm_manager_.get(), "t", {}, {"a", "b"}, nullptr);
+    ASSERT_EQ(executor.cols().size(), 2);
+    EXPECT_EQ(executor.cols()[0].name, "a");
+    EXPECT_EQ(executor.cols()[1].name, "b");
+    EXPECT_EQ(executor.cols()[1].offset, 4);
+    EXPECT_EQ(executor.tupleLen(), 8);
+}
+
+TEST_F(PlannerTest, HashIndexTest) {
+    create_table("t", {{"a", TYPE_INT, 4}, {"b", TYPE_INT, 4}, {"c", TYPE_INT, 4}, {"pad", TYPE_STRING, 64}}, 100000);
+    add_index("t", {"a", "b"}, INDEX_HASH);
+    add_index("t", {"c"});
+    auto expect_scan = [&](const std::string &sql, PlanTag tag, const std::vector<std::string> &index_cols = {}) {
+        auto scan = find_scan(plan_select(sql), "t");
+        ASSERT_NE(scan, nullptr) << sql;
+        EXPECT_EQ(scan->tag, tag) << sql;
+        if (!index_cols.empty()) {
+            EXPECT_EQ(scan->index_col_names_, index_cols) << sql;
+        }
+    };
+
+    // 所有索引字段上都有等值条件时使用哈希索引，不需要回表的查询也不使用覆盖索引扫描
+    expect_scan("select a, c from t where a = 1 and b = 2;", T_HashScan, {"a", "b"});
+    expect_scan("select a, b from t where b = 2 and a = 1 and c > 3;", T_HashScan, {"a", "b"});
+    // 只有前缀上的等值条件或者范围条件时不能使用哈希索引
+    expect_scan("select a, c from t where a = 1;", T_SeqScan);
+    expect_scan("select a, c from t where a = 1 and b > 2;", T_SeqScan);
+    // 两个索引都可以使用时，哈希索引查找的代价与表的大小无关
+    expect_scan("select a, c from t where c = 3;", T_BitmapHeapScan, {"c"});
+    expect_scan("select a, c from t where a = 1 and b = 2 and c = 3;", T_HashScan, {"a", "b"});
+}
+
+/**
+ * bitmap heap scan的测试：表t(id, a, b, pad)中a和b都是与记录位置无关的随机排列，a和b上各有一个B+树索引。
+ * 记录按照顺序插入数据文件，缓冲池只有BUFFER_PAGES个页面，远少于表的页面数
+ */
+class BitmapScanTest : public PlannerTest {
+   public:
+    static constexpr int NUM_ROWS = 200000;
+    static constexpr int PAD_LEN = 100;
+    static constexpr size_t BUFFER_PAGES = 256;
+
+    std::unique_ptr<BufferPoolManager> bpm_;
+    std::unique_ptr<IxManager> ix_manager_;
+    int per_page_ = 0;
+
+    void SetUp() override {
+        PlannerTest::SetUp();
+        bpm_ = std::make_unique<BufferPoolManager>(BUFFER_PAGES, disk_manager.get());
+        ix_manager_ = std::make_unique<IxManager>(disk_manager.get(), bpm_.get());
+        rm_manager_ = std::make_unique<RmManager>(disk_manager.get(), bpm_.get());
+        sm_manager_ = std::make_unique<SmManager>(disk_manager.get(), bpm_.get(), rm_manager_.get(), ix_manager_.get());
+        planner_ = std::make_unique<Planner>(sm_manager_.get());
+    }
+
+    void TearDown() override {
+        for (auto &entry : sm_manager_->ihs_) {
+            ix_manager_->close_index(entry.second.get());
+            disk_manager->destroy_file(entry.first);
+        }
+        sm_manager_->ihs_.clear();
+        PlannerTest::TearDown();
+    }
+
+    static int a_of(int id) { return (int)((long long)id * 7919 % NUM_ROWS); }
+
+    static int b_of(int id) { return (int)((long long)id * 104729 % NUM_ROWS); }
+
+    Rid row_rid(int id) const { return Rid{.page_no = RM_FIRST_RECORD_PAGE + id / per_page_, .slot_no = id % per_page_}; }
+
+    // 写入NUM_ROWS条记录，第id条记录保存在row_rid(id)，然后在a和b上分别建立索引
+    void load_table() {
+        create_table("t", {{"id", TYPE_INT, 4}, {"a", TYPE_INT, 4}, {"b", TYPE_INT, 4}, {"pad", TYPE_STRING, PAD_LEN}});
+        RmFileHandle *fh = sm_manager_->fhs_.at("t").get();
+        per_page_ = fh->file_hdr_.num_records_per_page;
+        std::vector<char> rec(fh->file_hdr_.record_size);
+        for (int id = 0; id < NUM_ROWS; id++) {
+            int vals[3] = {id, a_of(id), b_of(id)};
+            memcpy(rec.data(), vals, sizeof(vals));
+            memset(rec.data() + sizeof(vals), 'x', PAD_LEN);
+            Rid rid = fh->insert_record(rec.data(), nullptr);
+            assert(rid == row_rid(id));
+        }
+
+        // 按照key的顺序插入索引
+        std::vector<int> id_of_a(NUM_ROWS), id_of_b(NUM_ROWS);
+        for (int id = 0; id < NUM_ROWS; id++) {
+            id_of_a[a_of(id)] = id;
+            id_of_b[b_of(id)] = id;
+        }
+        for (auto &[col_name, ids] : {std::make_pair("a", &id_of_a), std::make_pair("b", &id_of_b)}) {
+            add_index("t", {col_name});
+            auto &cols = sm_manager_->db_.get_table("t").indexes.back().cols;
+            if (ix_manager_->exists("t", cols)) {
+                ix_manager_->destroy_index("t", cols);
+            }
+            ix_manager_->create_index("t", cols);
+            auto ih = ix_manager_->open_index("t", cols);
+            for (int key = 0; key < NUM_ROWS; key++) {
+                ih->insert_entry((const char *)&key, row_rid((*ids)[key]), nullptr);
+            }
+            sm_manager_->ihs_.emplace(ix_manager_->get_index_name("t", cols), std::move(ih));
+        }
+    }
+
+    // 设置a和b上的统计信息，用于估算范围条件的选择率
+    void set_stats(double num_rows) {
+        std::vector<double> vals;
+        for (int i = 0; i < num_rows; i++) {
+            vals.push_back(i);
+        }
+        TabStats stats;
+        stats.num_rows = num_rows;
+        stats.cols["a"] = ColStats::build(vals, stats.num_rows);
+        stats.cols["b"] = ColStats::build(vals, stats.num_rows);
+        sm_manager_->stats_["t"] = stats;
+    }
+
+    static Condition make_cond(const std::string &col_name, CompOp op, int val) {
+        Condition cond;
+        cond.lhs_col = {.tab_name = "t", .col_name = col_name};
+        cond.op = op;
+        cond.is_rhs_val = true;
+        cond.rhs_val.set_int(val);
+        cond.rhs_val.init_raw(sizeof(int));
+        return cond;
+    }
+
+    // 执行表扫描算子，返回输出的记录的id
+    static std::vector<int> run(AbstractExecutor &executor, std::vector<Rid> *rids = nullptr) {
+        std::vector<int> ids;
+        for (executor.beginTuple(); !executor.is_end(); executor.nextTuple()) {
+            ids.push_back(*(int *)executor.Next()->data);
+            if (rids != nullptr) {
+                rids->push_back(executor.rid());
+            }
+        }
+        return ids;
+    }
+
+    // SeqScanExecutor还没有实现，这里按照页面顺序读取全表的记录并检查条件（只有int字段与常量的比较），代替顺序扫描
+    std::vector<int> seq_scan(const std::vector<Condition> &conds) {
+        RmFileHandle *fh = sm_manager_->fhs_.at("t").get();
+        auto &tab = sm_manager_->db_.get_table("t");
+        std::vector<int> ids;
+        std::vector<std::unique_ptr<RmRecord>> recs;
+        for (int page_no = RM_FIRST_RECORD_PAGE; page_no < fh->file_hdr_.num_pages; page_no++) {
+            int first = (page_no - RM_FIRST_RECORD_PAGE) * per_page_;
+            std::vector<int> slot_nos(std::min(per_page_, NUM_ROWS - first));
+            std::iota(slot_nos.begin(), slot_nos.end(), 0);
+            recs.clear();
+            fh->get_records(page_no, slot_nos, &recs, nullptr);
+            for (auto &rec : recs) {
+                if (std::all_of(conds.begin(), conds.end(), [&](const Condition &cond) {
+                        int lhs = *(int *)(rec->data + tab.get_col(cond.lhs_col.col_name)->offset);
+                        int rhs = cond.rhs_val.int_val;
+                        switch (cond.op) {
+                            case OP_EQ: return lhs == rhs;
+                            case OP_NE: return lhs != rhs;
+                            case OP_LT: return lhs < rhs;
+                            case OP_GT: return lhs > rhs;
+                            case OP_LE: return lhs <= rhs;
+                            default: return lhs >= rhs;
+                        }
+                    })) {
+                    ids.push_back(*(int *)rec->data);
+                }
+            }
+        }
+        return ids;
+    }
+};
+
+TEST_F(BitmapScanTest, RidBitmapTest) {
+    const int per_page = 37;
+    RidBitmap x(per_page), y(per_page);
+    std::set<std::pair<int, int>> xs, ys;
+    std::mt19937 rng(39);
+    for (int i = 0; i < 2000; i++) {
+        Rid rid{.page_no = (int)(rng() % 200), .slot_no = (int)(rng() % per_page)};
+        (i % 2 ? x : y).set(rid);
+        (i % 2 ? xs : ys).insert({rid.page_no, rid.slot_no});
+    }
+    auto to_set = [](const RidBitmap &bitmap) {
+        std::set<std::pair<int, int>> res;
+        size_t prev = 0;
+        for (size_t pos = 0; bitmap.next(&pos); pos++) {
+            EXPECT_TRUE(res.empty() || pos > prev);
+            prev = pos;
+            Rid rid = bitmap.rid_at(pos);
+            EXPECT_TRUE(bitmap.test(rid));
+            res.insert({rid.page_no, rid.slot_no});
+        }
+        return res;
+    };
+    EXPECT_EQ(to_set(x), xs);
+    EXPECT_EQ(x.count(), xs.size());
+
+    std::set<std::pair<int, int>> both, either;
+    std::set_intersection(xs.begin(), xs.end(), ys.begin(), ys.end(), std::inserter(both, both.end()));
+    std::set_union(xs.begin(), xs.end(), ys.begin(), ys.end(), std::inserter(either, either.end()));
+    RidBitmap z = x;
+    z.intersect(y);
+    EXPECT_EQ(to_set(z), both);
+    z = x;
+    z.unite(y);
+    EXPECT_EQ(to_set(z), either);
+    EXPECT_FALSE(RidBitmap(per_page).next(&*std::make_unique<size_t>(0)));
+}
+
+TEST_F(BitmapScanTest, ResultTest) {
+    load_table();
+    auto check = [&](const std::vector<Condition> &conds, const std::vector<std::vector<std::string>> &indexes) {
+        auto expected = seq_scan(conds);
+        IndexScanExecutor index_scan(sm_manager_.get(), "t", conds, indexes[0], nullptr);
+        auto index_ids = run(index_scan);
+        std::sort(index_ids.begin(), index_ids.end());
+        EXPECT_EQ(index_ids, expected);
+
+        // 记录按照Rid的顺序输出，第id条记录的Rid随id递增，所以输出的id也是递增的
+        BitmapHeapScanExecutor bitmap_scan(sm_manager_.get(), "t", conds, indexes, nullptr);
+        std::vector<Rid> rids;
+        auto bitmap_ids = run(bitmap_scan, &rids);
+        EXPECT_EQ(bitmap_ids, expected);
+        ASSERT_EQ(rids.size(), bitmap_ids.size());
+        for (size_t i = 0; i < rids.size(); i++) {
+            EXPECT_EQ(rids[i], row_rid(bitmap_ids[i]));
+        }
+    };
+    check({make_cond("a", OP_EQ, 123)}, {{"a"}});
+    check({make_cond("a", OP_LT, 1000)}, {{"a"}});
+    check({make_cond("a", OP_GE, 5000), make_cond("a", OP_LT, 60000)}, {{"a"}});
+    check({make_cond("a", OP_GT, NUM_ROWS)}, {{"a"}});
+    // 两个索引的Rid集合取交集，非索引字段上的条件在回表之后检查
+    check({make_cond("a", OP_LT, 100000), make_cond("b", OP_GE, 150000)}, {{"a"}, {"b"}});
+    check({make_cond("a", OP_LT, 100000), make_cond("b", OP_GE, 150000), make_cond("id", OP_NE, 7)}, {{"a"}, {"b"}});
+}
+
+TEST_F(BitmapScanTest, PlanTest) {
+    create_table("t", {{"id", TYPE_INT, 4}, {"a", TYPE_INT, 4}, {"b", TYPE_INT, 4}, {"pad", TYPE_STRING, PAD_LEN}},
+                 NUM_ROWS);
+    add_index("t", {"a"});
+    add_index("t", {"b"});
+    set_stats(NUM_ROWS);
+    auto expect_scan = [&](const std::string &sql, PlanTag tag, const std::vector<std::vector<std::string>> &indexes) {
+        auto scan = find_scan(plan_select(sql), "t");
+        ASSERT_NE(scan, nullptr) << sql;
+        EXPECT_EQ(scan->tag, tag) << sql;
+        EXPECT_EQ(scan->bitmap_indexes_, indexes) << sql;
+    };
+    // 选择率很低时每条记录在不同的页面中，直接按照索引回表；选择率超过一定比例之后按照页面顺序回表
+    expect_scan("select id from t where a < 100;", T_IndexScan, {});
+    expect_scan("select id from t where a < 20000;", T_BitmapHeapScan, {{"a"}});
+    expect_scan("select id from t where b >= 10000 and b < 30000;", T_BitmapHeapScan, {{"b"}});
+    // 两个索引的交集缩小了回表的范围
+    expect_scan("select id from t where a < 10000 and b < 10000;", T_BitmapHeapScan, {{"a"}, {"b"}});
+    // 几乎要读取所有页面时顺序扫描更好
+    expect_scan("select id from t where a > 10000;", T_SeqScan, {});
+}
+
+/**
+ * 不同选择率下普通索引扫描、bitmap heap scan和顺序扫描的执行时间，以及优化器选择的访问路径
+ */
+TEST_F(BitmapScanTest, SelectivityBenchmark) {
+    load_table();
+    set_stats(NUM_ROWS);
+    auto time = [](auto &&scan) {
+        auto start = std::chrono::steady_clock::now();
+        size_t n = scan();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(ms, n);
+    };
+    std::map<PlanTag, std::string> names = {
+        {T_SeqScan, "seq scan"}, {T_IndexScan, "index scan"}, {T_BitmapHeapScan, "bitmap heap scan"}};
+    std::cout << "selectivity  index scan(ms)  bitmap heap scan(ms)  seq scan(ms)  plan" << std::endl;
+    for (double sel : {0.0005, 0.002, 0.01, 0.05, 0.1, 0.2, 0.5, 1.0}) {
+        int bound = (int)(sel * NUM_ROWS);
+        std::vector<Condition> conds = {make_cond("a", OP_LT, bound)};
+        auto index = time([&]() {
+            IndexScanExecutor executor(sm_manager_.get(), "t", conds, {"a"}, nullptr);
+            return run(executor).size();
+        });
+        auto bitmap = time([&]() {
+            BitmapHeapScanExecutor executor(sm_manager_.get(), "t", conds, {{"a"}}, nullptr);
+            return run(executor).size();
+        });
+        auto seq = time([&]() { return seq_scan(conds).size(); });
+        EXPECT_EQ(index.second, bound);
+        EXPECT_EQ(bitmap.second, bound);
+        EXPECT_EQ(seq.second, bound);
+        auto plan = find_scan(plan_select("select id from t where a < " + std::to_string(bound) + ";"), "t");
+        std::cout << std::setw(11) << sel << std::setw(16) << index.first << std::setw(22) << bitmap.first
+                  << std::setw(14) << seq.first << "  " << names[plan->tag] << std::endl;
+        if (sel >= 0.05) {
+            EXPECT_LT(bitmap.first, index.first) << sel;
+        }
+    }
+}
+
+// 生成索引的文件头，btree_order_与IxManager::create_index中的计算方式相同
+static IxFileHdr make_ix_file_hdr(const std::vector<ColType> &col_types, const std::vector<int> &col_lens) {
+    IxFileHdr file_hdr;
+    file_hdr.col_num_ = col_types.size();
+    file_hdr.col_types_ = col_types;
+    file_hdr.col_lens_ = col_lens;
+    file_hdr.col_tot_len_ = 0;
+    for (int len : col_lens) {
+        file_hdr.col_tot_len_ += len;
+    }
+    file_hdr.btree_order_ = (PAGE_SIZE - sizeof(IxPageHdr)) / (file_hdr.col_tot_len_ + sizeof(Rid)) - 1;
+    file_hdr.keys_size_ = (file_hdr.btree_order_ + 1) * file_hdr.col_tot_len_;
+    return file_hdr;
+}
+
+// 把一个记录格式的key转换成规范化的key
+static std::vector<char> encode_key(const IxFileHdr &file_hdr, const void *key) {
+    std::vector<char> res(file_hdr.col_tot_len_);
+    ix_encode_key(res.data(), (const char *)key, file_hdr.col_types_, file_hdr.col_lens_);
+    return res;
+}
+
+TEST(IxNodeTest, SearchTest) {
+    auto file_hdr = make_ix_file_hdr({TYPE_INT}, {sizeof(int)});
+    auto page = std::make_unique<Page>();
+    IxNodeHandle node(&file_hdr, page.get());
+    reinterpret_cast<IxPageHdr *>(page->get_data())->is_leaf = true;
+
+    // 结点中的key为0, 2, 4, ...
+    int n = file_hdr.btree_order_;
+    for (int i = 0; i < n; i++) {
+        int key = i * 2;
+        node.set_key(i, encode_key(file_hdr, &key).data());
+        node.set_rid(i, Rid{.page_no = i, .slot_no = key});
+    }
+    node.set_size(n);
+
+    for (int target = -1; target <= n * 2; target++) {
+        int lower = std::min(n, std::max(0, (target + 1) / 2));
+        int upper = std::min(n, target < 0 ? 0 : target / 2 + 1);
+        auto target_key = encode_key(file_hdr, &target);
+        EXPECT_EQ(node.lower_bound(target_key.data()), lower) << target;
+        EXPECT_EQ(node.upper_bound(target_key.data()), upper) << target;
+        EXPECT_EQ(node.internal_lookup(target_key.data()), std::max(upper - 1, 0)) << target;
+        Rid *rid = nullptr;
+        bool found = node.leaf_lookup(target_key.data(), &rid);
+        EXPECT_EQ(found, target >= 0 && target % 2 == 0 && target < n * 2) << target;
+        if (found) {
+            EXPECT_EQ(rid->slot_no, target);
+        }
+    }
+}
+
+TEST(IxNodeTest, IntSearchTest) {
+    std::mt19937 rng(2025);
+    for (int n : {0, 1, 3, 4, 5, 31, 32, 33, 64, 100, 255}) {
+        for (int round = 0; round < 20; round++) {
+            // 值域较小时会有重复的key
+            int range = round % 2 == 0 ? 8 : 1000000;
+            std::vector<int> keys(n);
+            for (auto &key : keys) {
+                key = (int)(rng() % range) - range / 2;
+            }
+            std::sort(keys.begin(), keys.end());
+            std::vector<int> targets = {INT_MIN, INT_MAX, 0};
+            for (int i = 0; i < 20; i++) {
+                targets.push_back((int)(rng() % (range + 2)) - range / 2 - 1);
+            }
+            for (auto &key : keys) {
+                targets.push_back(key);
+            }
+            std::vector<char> encoded(n * sizeof(int));
+            for (int i = 0; i < n; i++) {
+                ix_encode_col(encoded.data() + i * sizeof(int), (const char *)&keys[i], TYPE_INT, sizeof(int));
+            }
+            for (int target : targets) {
+                int lower = std::lower_bound(keys.begin(), keys.end(), target) - keys.begin();
+                int upper = std::upper_bound(keys.begin(), keys.end(), target) - keys.begin();
+                char target_key[sizeof(int)];
+                ix_encode_col(target_key, (const char *)&target, TYPE_INT, sizeof(int));
+                ASSERT_EQ(ix_key32_search(encoded.data(), n, target_key, false), lower) << n << ' ' << target;
+                ASSERT_EQ(ix_key32_search(encoded.data(), n, target_key, true), upper) << n << ' ' << target;
+            }
+        }
+    }
+}
+
+TEST(IxNodeTest, CompositeSearchTest) {
+    // 两个INT字段的索引使用ix_key_compare按字节比较规范化的key
+    auto file_hdr = make_ix_file_hdr({TYPE_INT, TYPE_INT}, {sizeof(int), sizeof(int)});
+    auto page = std::make_unique<Page>();
+    IxNodeHandle node(&file_hdr, page.get());
+    reinterpret_cast<IxPageHdr *>(page->get_data())->is_leaf = true;
+    ASSERT_FALSE(node.is_key32());
+    int n = file_hdr.btree_order_;
+    std::vector<std::pair<int, int>> keys;
+    for (int i = 0; i < n; i++) {
+        keys.emplace_back(i / 4, i % 4 * 2);
+    }
+    for (int i = 0; i < n; i++) {
+        int key[2] = {keys[i].first, keys[i].second};
+        node.set_key(i, encode_key(file_hdr, key).data());
+    }
+    node.set_size(n);
+    for (int a = -1; a <= n / 4 + 1; a++) {
+        for (int b = -1; b <= 8; b++) {
+            int target[2] = {a, b};
+            auto target_key = encode_key(file_hdr, target);
+            int lower = std::lower_bound(keys.begin(), keys.end(), std::make_pair(a, b)) - keys.begin();
+            int upper = std::upper_bound(keys.begin(), keys.end(), std::make_pair(a, b)) - keys.begin();
+            ASSERT_EQ(node.lower_bound(target_key.data()), lower);
+            ASSERT_EQ(node.upper_bound(target_key.data()), upper);
+        }
+    }
+}
+
+TEST(IxNodeTest, InternalSearchTest) {
+    // 向最左边的子树插入更小的key时不更新祖先结点，内部结点的第0个key可能大于第1个key，查找孩子结点时不能参与比较
+    for (int key_num : {1, 2}) {
+        std::vector<ColType> col_types(key_num, TYPE_INT);
+        std::vector<int> col_lens(key_num, sizeof(int));
+        auto file_hdr = make_ix_file_hdr(col_types, col_lens);
+        auto page = std::make_unique<Page>();
+        IxNodeHandle node(&file_hdr, page.get());
+        ASSERT_FALSE(node.is_leaf_page());
+        int n = file_hdr.btree_order_;
+        for (int i = 0; i < n; i++) {
+            int key[2] = {i == 0 ? n * 100 : i * 10, 0};
+            node.set_key(i, encode_key(file_hdr, key).data());
+            node.set_rid(i, Rid{.page_no = i, .slot_no = -1});
+        }
+        node.set_size(n);
+        for (int target = -5; target <= n * 10 + 5; target++) {
+            int key[2] = {target, 0};
+            auto target_key = encode_key(file_hdr, key);
+            int child = std::min(n - 1, std::max(0, target / 10));
+            ASSERT_EQ(node.internal_lookup(target_key.data()), child) << key_num << ' ' << target;
+        }
+    }
+}
+
+/**
+ * 结点内查找的性能测试，结点中的key个数为btree_order_，比较：
+ * 1. 对记录格式的key使用ix_compare顺序查找（原来的实现）
+ * 2. 对记录格式的key使用ix_compare二分查找
+ * 3. 结点中的规范化key使用的无分支二分查找 + SIMD顺序比较
+ */
+TEST(IxNodeTest, SearchBenchmark) {
+    auto file_hdr = make_ix_file_hdr({TYPE_INT}, {sizeof(int)});
+    auto page = std::make_unique<Page>();
+    IxNodeHandle node(&file_hdr, page.get());
+    reinterpret_cast<IxPageHdr *>(page->get_data())->is_leaf = true;
+    int n = file_hdr.btree_order_;
+    std::vector<int> raw_keys(n);
+    for (int i = 0; i < n; i++) {
+        raw_keys[i] = i * 3;
+        node.set_key(i, encode_key(file_hdr, &raw_keys[i]).data());
+    }
+    node.set_size(n);
+
+    const int num_searches = 1000000;
+    std::mt19937 rng(7);
+    std::vector<int> targets(num_searches);
+    for (auto &target : targets) {
+        target = rng() % (n * 3 + 1);
+    }
+    auto linear = [&](const int &target) {
+        int pos = 0;
+        while (pos < n && ix_compare((const char *)&raw_keys[pos], (const char *)&target, file_hdr.col_types_, file_hdr.col_lens_) < 0) {
+            pos++;
+        }
+        return pos;
+    };
+    auto binary = [&](const int &target) {
+        int left = 0, right = n;
+        while (left < right) {
+            int mid = (left + right) / 2;
+            if (ix_compare((const char *)&raw_keys[mid], (const char *)&target, file_hdr.col_types_, file_hdr.col_lens_) < 0) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        return left;
+    };
+    auto specialized = [&](const int &target) { return node.lower_bound((const char *)&target); };
+
+    auto run = [&](const char *name, const std::vector<int> &targets, auto &&search) {
+        auto start = std::chrono::steady_clock::now();
+        long long checksum = 0;
+        for (const int &target : targets) {
+            checksum += search(target);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << ns / num_searches << " ns/search (fan-out " << n << ")" << std::endl;
+        return checksum;
+    };
+    // 规范化的key与int的长度相同，直接存放在int数组中
+    std::vector<int> encoded_targets(num_searches);
+    for (int i = 0; i < num_searches; i++) {
+        ix_encode_col((char *)&encoded_targets[i], (const char *)&targets[i], TYPE_INT, sizeof(int));
+    }
+    long long expected = run("ix_compare linear", targets, linear);
+    EXPECT_EQ(run("ix_compare binary", targets, binary), expected);
+    EXPECT_EQ(run("normalized key branch-free binary + simd", encoded_targets, specialized), expected);
+}
+
+TEST(IxKeyTest, EncodingTest) {
+    std::mt19937 rng(34);
+    auto sign = [](int x) { return (x > 0) - (x < 0); };
+    std::vector<int> ints = {INT_MIN, INT_MIN + 1, -256, -1, 0, 1, 255, 256, INT_MAX - 1, INT_MAX};
+    std::vector<float> floats = {-FLT_MAX, -1e10f, -1.5f, -1.0f, -FLT_MIN, -0.0f, 0.0f, FLT_MIN, 1.0f, 1.5f,
+                                 1e10f, FLT_MAX, -std::numeric_limits<float>::infinity(),
+                                 std::numeric_limits<float>::infinity()};
+    for (int i = 0; i < 200; i++) {
+        ints.push_back((int)rng());
+        floats.push_back(std::uniform_real_distribution<float>(-1e6f, 1e6f)(rng));
+    }
+    // 规范化的key按字节比较的结果与按照类型比较的结果相同，并且可以转换回原值
+    auto check = [&](ColType type, const auto &vals) {
+        for (auto &a : vals) {
+            char ea[4], eb[4], decoded[4];
+            ix_encode_col(ea, (const char *)&a, type, 4);
+            ix_decode_col(decoded, ea, type, 4);
+            ASSERT_EQ(ix_compare(decoded, (const char *)&a, type, 4), 0) << a;
+            for (auto &b : vals) {
+                ix_encode_col(eb, (const char *)&b, type, 4);
+                ASSERT_EQ(sign(ix_key_compare(ea, eb, 4)), sign(ix_compare((const char *)&a, (const char *)&b, type, 4)))
+                    << a << ' ' << b;
+                ASSERT_EQ(sign(ix_key_compare(ea, eb, 4)), sign(memcmp(ea, eb, 4))) << a << ' ' << b;
+            }
+        }
+    };
+    check(TYPE_INT, ints);
+    check(TYPE_FLOAT, floats);
+
+    // 复合key：(INT, FLOAT, CHAR(7))，长度15，覆盖ix_key_compare中8字节、4字节和剩余字节的比较
+    auto file_hdr = make_ix_file_hdr({TYPE_INT, TYPE_FLOAT, TYPE_STRING}, {4, 4, 7});
+    struct __attribute__((packed)) RawKey {
+        int a;
+        float b;
+        char c[7];
+    };
+    std::vector<RawKey> keys;
+    for (int i = 0; i < 300; i++) {
+        RawKey key;
+        key.a = (int)(rng() % 5) - 2;
+        key.b = (float)((int)(rng() % 5) - 2) / 2;
+        for (char &ch : key.c) {
+            ch = (char)(rng() % 3 == 0 ? 0xf0 : 'a' + rng() % 3);
+        }
+        keys.push_back(key);
+    }
+    for (auto &a : keys) {
+        auto ea = encode_key(file_hdr, &a);
+        std::vector<char> decoded(file_hdr.col_tot_len_);
+        ix_decode_key(decoded.data(), ea.data(), file_hdr.col_types_, file_hdr.col_lens_);
+        ASSERT_EQ(memcmp(decoded.data(), &a, sizeof(RawKey)), 0);
+        for (auto &b : keys) {
+            auto eb = encode_key(file_hdr, &b);
+            ASSERT_EQ(sign(ix_key_compare(ea.data(), eb.data(), file_hdr.col_tot_len_)),
+                      sign(ix_compare((const char *)&a, (const char *)&b, file_hdr.col_types_, file_hdr.col_lens_)));
+        }
+    }
+}
+
+/**
+ * 复合key的比较性能：ix_compare按照字段类型逐个比较，ix_key_compare对规范化的key按字节比较
+ */
+TEST(IxKeyTest, CompareBenchmark) {
+    auto file_hdr = make_ix_file_hdr({TYPE_INT, TYPE_INT, TYPE_STRING}, {4, 4, 16});
+    int key_len = file_hdr.col_tot_len_;
+    const int num_keys = 4096;
+    std::mt19937 rng(2025);
+    std::vector<char> raw(num_keys * key_len), encoded(num_keys * key_len);
+    for (int i = 0; i < num_keys; i++) {
+        int a = rng() % 4, b = rng() % 4;
+        char *key = raw.data() + i * key_len;
+        memcpy(key, &a, 4);
+        memcpy(key + 4, &b, 4);
+        snprintf(key + 8, 16, "str%08d", (int)(rng() % 1000));
+        ix_encode_key(encoded.data() + i * key_len, key, file_hdr.col_types_, file_hdr.col_lens_);
+    }
+    const int num_compares = 10000000;
+    auto run = [&](const char *name, auto &&compare) {
+        auto start = std::chrono::steady_clock::now();
+        long long checksum = 0;
+        for (int i = 0; i < num_compares; i++) {
+            int x = i % num_keys, y = (i * 7 + 1) % num_keys;
+            int cmp = compare(x, y);
+            checksum += (cmp > 0) - (cmp < 0);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": " << ns / num_compares << " ns/compare" << std::endl;
+        return checksum;
+    };
+    long long expected = run("ix_compare", [&](int x, int y) {
+        return ix_compare(raw.data() + x * key_len, raw.data() + y * key_len, file_hdr.col_types_, file_hdr.col_lens_);
+    });
+    EXPECT_EQ(run("ix_key_compare", [&](int x, int y) {
+                  return ix_key_compare(encoded.data() + x * key_len, encoded.data() + y * key_len, key_len);
+              }),
+              expected);
+}
+
+// 按顺序返回给定记录的儿子节点，用于测试上层算子
+class ValuesExecutor : public AbstractExecutor {
+   private:
+    std::vector<ColMeta> cols_;
+    std::vector<std::unique_ptr<RmRecord>> recs_;
+    size_t pos_ = 0;
+
+   public:
+    ValuesExecutor(std::vector<ColMeta> cols, std::vector<std::unique_ptr<RmRecord>> recs)
+        : cols_(std::move(cols)), recs_(std::move(recs)) {}
+
+    size_t tupleLen() const override { return cols_.back().offset + cols_.back().len; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    void beginTuple() override { pos_ = 0; }
+
+    void nextTuple() override { pos_++; }
+
+    bool is_end() const override { return pos_ >= recs_.size(); }
+
+    std::unique_ptr<RmRecord> Next() override { return std::make_unique<RmRecord>(*recs_[pos_]); }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
+    Rid &rid() override { return _abstract_rid; }
+};
+
+TEST(SortExecutorTest, FloatKeyTest) {
+    std::vector<ColMeta> cols = {{.tab_name = "t", .name = "a", .type = TYPE_INT, .len = 4, .offset = 0},
+                                 {.tab_name = "t", .name = "b", .type = TYPE_FLOAT, .len = 4, .offset = 4}};
+    std::vector<float> vals = {3.5f, -2.0f, 0.0f, -100.25f, 7.0f, -2.0f, 1e-3f, -1e-3f};
+    for (bool is_desc : {false, true}) {
+        std::vector<std::unique_ptr<RmRecord>> recs;
+        for (size_t i = 0; i < vals.size(); i++) {
+            auto rec = std::make_unique<RmRecord>(8);
+            int a = i;
+            memcpy(rec->data, &a, 4);
+            memcpy(rec->data + 4, &vals[i], 4);
+            recs.push_back(std::move(rec));
+        }
+        SortExecutor sort(std::make_unique<ValuesExecutor>(cols, std::move(recs)), {.tab_name = "t", .col_name = "b"},
+                          is_desc);
+        std::vector<std::pair<float, int>> expected;
+        for (size_t i = 0; i < vals.size(); i++) {
+            expected.emplace_back(is_desc ? -vals[i] : vals[i], i);
+        }
+        // 排序是稳定的，相同的值保持原来的顺序
+        std::sort(expected.begin(), expected.end());
+        std::vector<int> result;
+        for (sort.beginTuple(); !sort.is_end(); sort.nextTuple()) {
+            result.push_back(*(int *)sort.Next()->data);
+        }
+        ASSERT_EQ(result.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            EXPECT_EQ(result[i], expected[i].second) << is_desc << ' ' << i;
+        }
+    }
+}
+
+/**
+ * B+树并发测试：多个线程同时插入、删除和查找，检查latch crabbing之后B+树的结构仍然正确。
+ * 索引字段为INT(4) + CHAR(60)，每个结点大约55个key，少量数据就会产生多层的B+树和频繁的分裂合并
+ */
+class IxConcurrencyTest : public ::testing::Test {
+   public:
+    static constexpr int STR_LEN = 60;
+    static constexpr int KEY_LEN = sizeof(int) + STR_LEN;
+    const std::string TEST_INDEX_TABLE = "ix_concurrency";
+
+    std::unique_ptr<DiskManager> disk_manager_;
+    std::unique_ptr<BufferPoolManager> bpm_;
+    std::unique_ptr<IxManager> ix_manager_;
+    std::unique_ptr<IxIndexHandle> ih_;
+    std::vector<ColMeta> index_cols_;
+
+    void SetUp() override {
+        ::testing::Test::SetUp();
+        disk_manager_ = std::make_unique<DiskManager>();
+        bpm_ = std::make_unique<BufferPoolManager>(4096, disk_manager_.get());
+        ix_manager_ = std::make_unique<IxManager>(disk_manager_.get(), bpm_.get());
+        if (!disk_manager_->is_dir(TEST_DB_NAME)) {
+            disk_manager_->create_dir(TEST_DB_NAME);
+        }
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
+        index_cols_ = {{.tab_name = TEST_INDEX_TABLE, .name = "a", .type = TYPE_INT, .len = sizeof(int), .offset = 0},
+                       {.tab_name = TEST_INDEX_TABLE, .name = "b", .type = TYPE_STRING, .len = STR_LEN,
+                        .offset = sizeof(int)}};
+        open_new_index();
+    }
+
+    void TearDown() override {
+        close_index();
+        if (chdir("..") < 0) {
+            throw UnixError();
+        }
+    }
+
+    void open_new_index() {
+        if (ix_manager_->exists(TEST_INDEX_TABLE, index_cols_)) {
+            ix_manager_->destroy_index(TEST_INDEX_TABLE, index_cols_);
+        }
+        ix_manager_->create_index(TEST_INDEX_TABLE, index_cols_);
+        ih_ = ix_manager_->open_index(TEST_INDEX_TABLE, index_cols_);
+    }
+
+    void close_index() {
+        if (ih_ != nullptr) {
+            ix_manager_->close_index(ih_.get());
+            ih_.reset();
+            ix_manager_->destroy_index(TEST_INDEX_TABLE, index_cols_);
+        }
+    }
+
+    // key为 (i, "key-i")，相同的i对应相同的key，key的顺序与i的顺序相同
+    static std::vector<char> make_key(int i) {
+        std::vector<char> key(KEY_LEN, 0);
+        memcpy(key.data(), &i, sizeof(int));
+        snprintf(key.data() + sizeof(int), STR_LEN, "key-%d", i);
+        return key;
+    }
+
+    static Rid make_rid(int i) { return Rid{.page_no = i / 100 + 1, .slot_no = i % 100}; }
+
+    bool lookup(int i, Rid *rid) {
+        std::vector<Rid> result;
+        auto key = make_key(i);
+        if (!ih_->get_value(key.data(), &result, nullptr)) {
+            return false;
+        }
+        *rid = result.at(0);
+        return true;
+    }
+
+    // 从头到尾扫描所有叶子结点，返回按顺序读到的key中的整数
+    std::vector<int> scan_all() {
+        std::vector<int> res;
+        std::vector<char> key(KEY_LEN);
+        for (IxScan scan(ih_.get(), ih_->leaf_begin(), ih_->leaf_end(), bpm_.get()); !scan.is_end(); scan.next()) {
+            scan.key(key.data());
+            res.push_back(*(int *)key.data());
+        }
+        return res;
+    }
+};
+
+TEST_F(IxConcurrencyTest, InsertTest) {
+    const int num_keys = 20000;
+    const int num_writers = 4;
+    const int num_readers = 2;
+    std::atomic<bool> done{false};
+    std::atomic<int> num_errors{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_writers; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<int> keys;
+            for (int i = t; i < num_keys; i += num_writers) {
+                keys.push_back(i);
+            }
+            std::shuffle(keys.begin(), keys.end(), std::mt19937(t));
+            for (int i : keys) {
+                auto key = make_key(i);
+                if (ih_->insert_entry(key.data(), make_rid(i), nullptr) == IX_NO_PAGE) {
+                    num_errors++;
+                }
+            }
+        });
+    }
+    // 读线程在插入的同时查找，读到的key必须对应正确的rid
+    for (int t = 0; t < num_readers; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 rng(100 + t);
+            while (!done) {
+                int i = rng() % num_keys;
+                Rid rid;
+                if (lookup(i, &rid) && !(rid == make_rid(i))) {
+                    num_errors++;
+                }
+            }
+        });
+    }
+    for (int t = 0; t < num_writers; t++) {
+        threads[t].join();
+    }
+    done = true;
+    for (int t = num_writers; t < num_writers + num_readers; t++) {
+        threads[t].join();
+    }
+    ASSERT_EQ(num_errors, 0);
+
+    for (int i = 0; i < num_keys; i++) {
+        Rid rid;
+        ASSERT_TRUE(lookup(i, &rid)) << i;
+        ASSERT_EQ(rid, make_rid(i));
+    }
+    // 重复插入的key不会被插入
+    auto key = make_key(0);
+    EXPECT_EQ(ih_->insert_entry(key.data(), make_rid(0), nullptr), IX_NO_PAGE);
+
+    auto scanned = scan_all();
+    ASSERT_EQ(scanned.size(), num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        ASSERT_EQ(scanned[i], i);
+    }
+}
+
+TEST_F(IxConcurrencyTest, DeleteTest) {
+    const int num_keys = 20000;
+    const int num_threads = 4;
+    for (int i = 0; i < num_keys; i++) {
+        auto key = make_key(i);
+        ASSERT_NE(ih_->insert_entry(key.data(), make_rid(i), nullptr), IX_NO_PAGE);
+    }
+
+    // 写线程删除偶数key，同时插入区间之外的新key；读线程查找奇数key，奇数key必须一直存在
+    std::atomic<bool> done{false};
+    std::atomic<int> num_errors{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<int> keys;
+            for (int i = t * 2; i < num_keys; i += num_threads * 2) {
+                keys.push_back(i);
+            }
+            std::shuffle(keys.begin(), keys.end(), std::mt19937(t));
+            for (int i : keys) {
+                auto key = make_key(i);
+                if (!ih_->delete_entry(key.data(), nullptr)) {
+                    num_errors++;
+                }
+                auto new_key = make_key(num_keys + i);
+                if (ih_->insert_entry(new_key.data(), make_rid(num_keys + i), nullptr) == IX_NO_PAGE) {
+                    num_errors++;
+                }
+            }
+        });
+    }
+    threads.emplace_back([&]() {
+        std::mt19937 rng(100);
+        while (!done) {
+            int i = rng() % (num_keys / 2) * 2 + 1;
+            Rid rid;
+            if (!lookup(i, &rid) || !(rid == make_rid(i))) {
+                num_errors++;
+            }
+        }
+    });
+    for (int t = 0; t < num_threads; t++) {
+        threads[t].join();
+    }
+    done = true;
+    threads.back().join();
+    ASSERT_EQ(num_errors, 0);
+
+    std::vector<int> expected;
+    for (int i = 0; i < num_keys * 2; i++) {
+        Rid rid;
+        bool exist = i < num_keys ? i % 2 == 1 : (i - num_keys) % 2 == 0;
+        ASSERT_EQ(lookup(i, &rid), exist) << i;
+        if (exist) {
+            ASSERT_EQ(rid, make_rid(i));
+            expected.push_back(i);
+        }
+    }
+    EXPECT_EQ(scan_all(), expected);
+
+    // 删除所有key之后B+树退化为一个空的叶子结点
+    for (int i : expected) {
+        auto key = make_key(i);
+        ASSERT_TRUE(ih_->delete_entry(key.data(), nullptr)) << i;
+    }
+    EXPECT_TRUE(scan_all().empty());
+    auto key = make_key(0);
+    EXPECT_FALSE(ih_->delete_entry(key.data(), nullptr));
+}
+
+/**
+ * 多个线程按递增的顺序追加key，同时删除最前面的key，追加的key大多走最右叶子结点的快速路径，
+ * 线程之间的顺序交错时快速路径失败并退回到从根结点查找；删除使最前面的叶子结点不断合并
+ */
+TEST_F(IxConcurrencyTest, AppendTest) {
+    const int num_keys = 40000;
+    const int num_writers = 4;
+    std::atomic<int> next{0};
+    std::vector<std::atomic<bool>> inserted(num_keys);
+    std::atomic<bool> done{false};
+    std::atomic<int> num_errors{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_writers; t++) {
+        threads.emplace_back([&]() {
+            for (int i = next++; i < num_keys; i = next++) {
+                auto key = make_key(i);
+                if (ih_->insert_entry(key.data(), make_rid(i), nullptr) == IX_NO_PAGE) {
+                    num_errors++;
+                }
+                inserted[i] = true;
+            }
+        });
+    }
+    // 删除线程在前一半key中的偶数key插入之后删除它们
+    threads.emplace_back([&]() {
+        for (int i = 0; i < num_keys / 2; i += 2) {
+            while (!inserted[i]) {
+                std::this_thread::yield();
+            }
+            auto key = make_key(i);
+            if (!ih_->delete_entry(key.data(), nullptr)) {
+                num_errors++;
+            }
+        }
+    });
+    threads.emplace_back([&]() {
+        std::mt19937 rng(100);
+        while (!done) {
+            int i = rng() % num_keys;
+            Rid rid;
+            if (lookup(i, &rid) && !(rid == make_rid(i))) {
+                num_errors++;
+            }
+        }
+    });
+    for (int t = 0; t <= num_writers; t++) {
+        threads[t].join();
+    }
+    done = true;
+    threads.back().join();
+    ASSERT_EQ(num_errors, 0);
+
+    std::vector<int> expected;
+    for (int i = 0; i < num_keys; i++) {
+        Rid rid;
+        bool exist = i >= num_keys / 2 || i % 2 == 1;
+        ASSERT_EQ(lookup(i, &rid), exist) << i;
+        if (exist) {
+            ASSERT_EQ(rid, make_rid(i));
+            expected.push_back(i);
+        }
+    }
+    EXPECT_EQ(scan_all(), expected);
+    auto key = make_key(num_keys - 1);
+    EXPECT_EQ(ih_->insert_entry(key.data(), make_rid(0), nullptr), IX_NO_PAGE);
+}
+
+/**
+ * 不同线程数下并发插入和查找的吞吐量。
+ * 每次访问页面都要经过缓冲池的全局latch，线程数增加时吞吐量的提升受限于缓冲池，这里主要检查加锁之后不会明显退化
+ */
+TEST_F(IxConcurrencyTest, ThroughputBenchmark) {
+    const int num_keys = 40000;
+    for (int num_threads : {1, 2, 4, 8}) {
+        close_index();
+        open_new_index();
+        auto run = [&](auto &&op) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int t = 0; t < num_threads; t++) {
+                threads.emplace_back([&, t]() {
+                    for (int i = t; i < num_keys; i += num_threads) {
+                        op(i * 7919 % num_keys);
+                    }
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return num_keys / secs;
+        };
+        double insert_ops = run([&](int i) {
+            auto key = make_key(i);
+            ih_->insert_entry(key.data(), make_rid(i), nullptr);
+        });
+        std::atomic<int> num_found{0};
+        double lookup_ops = run([&](int i) {
+            Rid rid;
+            if (lookup(i, &rid)) num_found++;
+        });
+        EXPECT_EQ(num_found, num_keys);
+        std::cout << num_threads << " threads: insert " << (long long)insert_ops << " ops/s, lookup "
+                  << (long long)lookup_ops << " ops/s" << std::endl;
+    }
+}
+
+/**
+ * 批量构建B+树的测试，使用与并发测试相同的索引字段
+ */
+class IxBulkLoadTest : public IxConcurrencyTest {
+   public:
+    // 外部排序器和批量构建使用规范化的key
+    std::vector<char> make_sort_key(int i) { return encode_key(*ih_->get_file_hdr(), make_key(i).data()); }
+
+    // 把key为0..num_keys-1的键值对乱序加入外部排序器，然后批量构建
+    void bulk_load(int num_keys, double fill_factor, size_t mem_limit = IX_SORT_MEMORY) {
+        std::vector<int> keys(num_keys);
+        for (int i = 0; i < num_keys; i++) {
+            keys[i] = i;
+        }
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(num_keys));
+        IxExternalSorter sorter(ih_->get_file_hdr(), TEST_INDEX_TABLE, mem_limit);
+        for (int i : keys) {
+            sorter.add(make_sort_key(i).data(), make_rid(i));
+        }
+        sorter.finish();
+        ih_->bulk_load(sorter, fill_factor);
+    }
+};
+
+TEST_F(IxBulkLoadTest, ExternalSortTest) {
+    const int num_keys = 50000;
+    // 每个run最多1000个键值对
+    size_t mem_limit = 1000 * (KEY_LEN + sizeof(Rid) + sizeof(size_t));
+    std::string run_name;
+    {
+        IxExternalSorter sorter(ih_->get_file_hdr(), TEST_INDEX_TABLE, mem_limit);
+        std::vector<int> keys(num_keys);
+        for (int i = 0; i < num_keys; i++) {
+            keys[i] = i;
+        }
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+        for (int i : keys) {
+            sorter.add(make_sort_key(i).data(), make_rid(i));
+        }
+        sorter.finish();
+        EXPECT_EQ(sorter.size(), num_keys);
+        EXPECT_EQ(sorter.num_runs(), num_keys / 1000);
+        run_name = TEST_INDEX_TABLE + ".run0";
+        EXPECT_TRUE(disk_manager_->is_file(run_name));
+        std::vector<char> key(KEY_LEN);
+        Rid rid;
+        for (int i = 0; i < num_keys; i++) {
+            ASSERT_TRUE(sorter.next(key.data(), &rid));
+            ASSERT_EQ(key, make_sort_key(i));
+            ASSERT_EQ(rid, make_rid(i));
+        }
+        EXPECT_FALSE(sorter.next(key.data(), &rid));
+    }
+    // 排序器析构时删除run文件
+    EXPECT_FALSE(disk_manager_->is_file(run_name));
+}
+
+TEST_F(IxBulkLoadTest, BuildTest) {
+    for (double fill_factor : {0.5, 0.9, 1.0}) {
+        for (int num_keys : {0, 1, 30, 55, 56, 57, 1000, 20000}) {
+            close_index();
+            open_new_index();
+            bulk_load(num_keys, fill_factor, 4096 * (KEY_LEN + sizeof(Rid) + sizeof(size_t)));
+            std::vector<int> expected;
+            for (int i = 0; i < num_keys; i++) {
+                Rid rid;
+                ASSERT_TRUE(lookup(i, &rid)) << fill_factor << ' ' << num_keys << ' ' << i;
+                ASSERT_EQ(rid, make_rid(i));
+                expected.push_back(i);
+            }
+            ASSERT_EQ(scan_all(), expected);
+
+            // 批量构建之后的B+树可以继续插入和删除
+            for (int i = 0; i < num_keys; i += 2) {
+                ASSERT_TRUE(ih_->delete_entry(make_key(i).data(), nullptr)) << i;
+            }
+            for (int i = num_keys; i < num_keys + 1000; i++) {
+                ASSERT_NE(ih_->insert_entry(make_key(i).data(), make_rid(i), nullptr), IX_NO_PAGE);
+            }
+            expected.clear();
+            for (int i = 0; i < num_keys + 1000; i++) {
+                if (i >= num_keys || i % 2 == 1) {
+                    expected.push_back(i);
+                }
+            }
+            ASSERT_EQ(scan_all(), expected) << fill_factor << ' ' << num_keys;
+        }
+    }
+}
+
+TEST_F(IxBulkLoadTest, DuplicateKeyTest) {
+    IxExternalSorter sorter(ih_->get_file_hdr(), TEST_INDEX_TABLE);
+    for (int i = 0; i < 1000; i++) {
+        sorter.add(make_sort_key(i % 999).data(), make_rid(i));
+    }
+    sorter.finish();
+    EXPECT_THROW(ih_->bulk_load(sorter), IndexEntryExistsError);
+}
+
+/**
+ * 比较批量构建和逐条乱序插入的构建时间以及索引的页面数
+ */
+TEST_F(IxBulkLoadTest, BuildBenchmark) {
+    const int num_keys = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    bulk_load(num_keys, IX_BULK_FILL_FACTOR);
+    double bulk_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int bulk_pages = ih_->get_file_hdr()->num_pages_;
+
+    close_index();
+    open_new_index();
+    std::vector<int> keys(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(num_keys));
+    start = std::chrono::steady_clock::now();
+    for (int i : keys) {
+        ih_->insert_entry(make_key(i).data(), make_rid(i), nullptr);
+    }
+    double insert_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int insert_pages = ih_->get_file_hdr()->num_pages_;
+
+    std::cout << "bulk load: " << bulk_secs << " s, " << bulk_pages << " pages" << std::endl;
+    std::cout << "repeated insert: " << insert_secs << " s, " << insert_pages << " pages" << std::endl;
+    EXPECT_LT(bulk_pages, insert_pages);
+}
+
+/**
+ * 比较按递增顺序插入、乱序插入和批量构建的构建时间以及索引的页面数
+ */
+TEST_F(IxBulkLoadTest, SequentialInsertBenchmark) {
+    const int num_keys = 1000000;
+    std::vector<int> keys(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i;
+    }
+    auto build = [&](const char *name) {
+        close_index();
+        open_new_index();
+        auto start = std::chrono::steady_clock::now();
+        for (int i : keys) {
+            ih_->insert_entry(make_key(i).data(), make_rid(i), nullptr);
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        int pages = ih_->get_file_hdr()->num_pages_;
+        std::cout << name << ": " << (long long)(num_keys / secs) << " inserts/s, " << pages << " pages" << std::endl;
+        return pages;
+    };
+    int seq_pages = build("sequential insert");
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(num_keys));
+    int random_pages = build("random insert");
+
+    close_index();
+    open_new_index();
+    bulk_load(num_keys, IX_BULK_FILL_FACTOR);
+    int bulk_pages = ih_->get_file_hdr()->num_pages_;
+    std::cout << "bulk load: " << bulk_pages << " pages" << std::endl;
+    EXPECT_LT(seq_pages, random_pages);
+}
+
+/**
+ * 内部结点前缀压缩和后缀截断的测试，索引字段为CHAR(100)，key为 "customer/000123/orders"，
+ * 相邻的key有很长的公共前缀，内部结点的分隔key截断之后只需要几个字节
+ */
+class IxPrefixCompressionTest : public IxConcurrencyTest {
+   public:
+    static constexpr int NAME_LEN = 100;
+
+    void SetUp() override {
+        IxConcurrencyTest::SetUp();
+        close_index();
+        index_cols_ = {{.tab_name = TEST_INDEX_TABLE, .name = "name", .type = TYPE_STRING, .len = NAME_LEN, .offset = 0}};
+        open_new_index();
+    }
+
+    static std::vector<char> make_name(int i) {
+        std::vector<char> key(NAME_LEN, 0);
+        snprintf(key.data(), NAME_LEN, "customer/%06d/orders", i);
+        return key;
+    }
+
+    bool lookup_name(int i, Rid *rid) {
+        std::vector<Rid> result;
+        if (!ih_->get_value(make_name(i).data(), &result, nullptr)) {
+            return false;
+        }
+        *rid = result.at(0);
+        return true;
+    }
+
+    // 扫描所有叶子结点，把key解析回整数
+    std::vector<int> scan_names() {
+        std::vector<int> res;
+        std::vector<char> key(NAME_LEN);
+        for (IxScan scan(ih_.get(), ih_->leaf_begin(), ih_->leaf_end(), bpm_.get()); !scan.is_end(); scan.next()) {
+            scan.key(key.data());
+            res.push_back(atoi(key.data() + strlen("customer/")));
+        }
+        return res;
+    }
+
+    // 在空的B+树上设置内部结点是否压缩，用于和不压缩的B+树对照
+    void set_prefix_compression(bool enabled) {
+        const_cast<IxFileHdr *>(ih_->get_file_hdr())->prefix_compression_ = enabled;
+    }
+};
+
+TEST(IxKeyTest, SeparatorTest) {
+    const int len = 16;
+    std::vector<char> left(len, 0), right(len, 0), sep(len);
+    memcpy(left.data(), "apple/0099", 10);
+    memcpy(right.data(), "apple/0100x", 11);
+    ix_shortest_separator(sep.data(), left.data(), right.data(), len);
+    EXPECT_EQ(ix_significant_len(sep.data(), len), 8);
+    EXPECT_EQ(memcmp(sep.data(), "apple/01", 8), 0);
+    EXPECT_LT(ix_key_compare(left.data(), sep.data(), len), 0);
+    EXPECT_LE(ix_key_compare(sep.data(), right.data(), len), 0);
+
+    // right比left多出的部分之前都相同时，截断到第一个多出的字节
+    memcpy(right.data(), "apple/0099", 10);
+    right[10] = '!';
+    ix_shortest_separator(sep.data(), left.data(), right.data(), len);
+    EXPECT_EQ(ix_significant_len(sep.data(), len), 11);
+    EXPECT_EQ(ix_key_compare(sep.data(), right.data(), len), 0);
+}
+
+TEST_F(IxPrefixCompressionTest, InsertDeleteTest) {
+    ASSERT_TRUE(ih_->get_file_hdr()->prefix_compression_);
+    const int num_keys = 50000;
+    std::vector<int> keys(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(35));
+    for (int i : keys) {
+        ASSERT_NE(ih_->insert_entry(make_name(i).data(), make_rid(i), nullptr), IX_NO_PAGE) << i;
+    }
+    std::vector<int> expected(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        Rid rid;
+        ASSERT_TRUE(lookup_name(i, &rid)) << i;
+        ASSERT_EQ(rid, make_rid(i));
+        expected[i] = i;
+    }
+    ASSERT_EQ(scan_names(), expected);
+    // 每个叶子结点大约37个key，不压缩时内部结点也只有37个孩子，压缩之后扇出在100以上
+    EXPECT_LE(ih_->get_height(), 3);
+
+    // 乱序删除三分之二的key，触发内部结点的合并和重新分配
+    std::vector<bool> exist(num_keys, true);
+    for (int i : keys) {
+        if (i % 3 == 0) continue;
+        ASSERT_TRUE(ih_->delete_entry(make_name(i).data(), nullptr)) << i;
+        exist[i] = false;
+    }
+    expected.clear();
+    for (int i = 0; i < num_keys; i++) {
+        Rid rid;
+        ASSERT_EQ(lookup_name(i, &rid), exist[i]) << i;
+        if (exist[i]) expected.push_back(i);
+    }
+    ASSERT_EQ(scan_names(), expected);
+
+    // 重新插入删除的key
+    for (int i : keys) {
+        if (!exist[i]) {
+            ASSERT_NE(ih_->insert_entry(make_name(i).data(), make_rid(i), nullptr), IX_NO_PAGE) << i;
+        }
+    }
+    expected.resize(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        expected[i] = i;
+    }
+    ASSERT_EQ(scan_names(), expected);
+}
+
+/**
+ * 比较内部结点压缩前后字符串索引的高度、索引文件大小和查找延迟
+ */
+TEST_F(IxPrefixCompressionTest, CompressionBenchmark) {
+    const int num_keys = 500000;
+    const int num_lookups = 500000;
+    std::vector<int> keys(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(num_keys));
+    std::vector<std::vector<char>> lookup_keys;
+    std::mt19937 rng(1);
+    for (int i = 0; i < num_lookups; i++) {
+        lookup_keys.push_back(make_name(rng() % num_keys));
+    }
+    int heights[2], pages[2];
+    for (bool compressed : {false, true}) {
+        close_index();
+        open_new_index();
+        set_prefix_compression(compressed);
+        for (int i : keys) {
+            ih_->insert_entry(make_name(i).data(), make_rid(i), nullptr);
+        }
+        std::vector<Rid> result;
+        auto start = std::chrono::steady_clock::now();
+        for (auto &key : lookup_keys) {
+            result.clear();
+            ih_->get_value(key.data(), &result, nullptr);
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        heights[compressed] = ih_->get_height();
+        pages[compressed] = ih_->get_file_hdr()->num_pages_;
+        std::cout << (compressed ? "prefix compression: " : "full keys: ") << "height " << heights[compressed]
+                  << ", " << pages[compressed] * (PAGE_SIZE / 1024) << " KB, lookup "
+                  << secs * 1e9 / num_lookups << " ns" << std::endl;
+    }
+    EXPECT_LT(heights[1], heights[0]);
+    EXPECT_LT(pages[1], pages[0]);
+}
+
+TEST(IxKeyTest, PostingEncodingTest) {
+    std::mt19937 rng(37);
+    std::vector<char> buf(16);
+    for (int i = 0; i < 10000; i++) {
+        uint64_t x = rng() % 4 == 0 ? rng() % 200 : ((uint64_t)rng() << 16 | rng() % 65536) >> (rng() % 48);
+        int len = ix_put_varint(buf.data(), x);
+        ASSERT_EQ(len, ix_varint_len(x));
+        ASSERT_LE(len, IX_RID_VARINT_MAX);
+        uint64_t y;
+        ASSERT_EQ(ix_get_varint(buf.data(), &y), len);
+        ASSERT_EQ(x, y);
+    }
+    // posting list中Rid的大小关系与key末尾规范化的Rid相同
+    std::vector<char> ea(IX_RID_KEY_LEN), eb(IX_RID_KEY_LEN);
+    for (int i = 0; i < 10000; i++) {
+        Rid a = {.page_no = (int)(rng() % 1000), .slot_no = (int)(rng() % 300)};
+        Rid b = {.page_no = (int)(rng() % 1000), .slot_no = (int)(rng() % 300)};
+        ASSERT_EQ(ix_posting_rid(ix_posting_value(a)), a);
+        ix_encode_rid(ea.data(), a);
+        ix_encode_rid(eb.data(), b);
+        int cmp = ix_key_compare(ea.data(), eb.data(), IX_RID_KEY_LEN);
+        ASSERT_EQ(cmp < 0, ix_posting_value(a) < ix_posting_value(b));
+        ASSERT_EQ(cmp == 0, ix_posting_value(a) == ix_posting_value(b));
+    }
+    EXPECT_THROW(ix_posting_value(Rid{.page_no = 1, .slot_no = 1 << IX_POSTING_SLOT_BITS}), InternalError);
+}
+
+/**
+ * 非唯一索引的测试，索引字段为一个INT，与TPC-C中的ol_w_id一样只有少数几个不同的值，每个值对应数千个Rid，
+ * 叶子结点使用posting list格式，一个值的Rid分布在多个相邻的叶子结点中
+ */
+class IxPostingListTest : public IxConcurrencyTest {
+   public:
+    static constexpr int NUM_VALUES = 10;
+
+    void SetUp() override {
+        IxConcurrencyTest::SetUp();
+        close_index();
+        index_cols_ = {{.tab_name = TEST_INDEX_TABLE, .name = "w_id", .type = TYPE_INT, .len = sizeof(int), .offset = 0}};
+        open_posting_index();
+    }
+
+    void open_posting_index() {
+        if (ix_manager_->exists(TEST_INDEX_TABLE, index_cols_)) {
+            ix_manager_->destroy_index(TEST_INDEX_TABLE, index_cols_);
+        }
+        ix_manager_->create_index(TEST_INDEX_TABLE, index_cols_, false);
+        ih_ = ix_manager_->open_index(TEST_INDEX_TABLE, index_cols_);
+    }
+
+    // 第i条记录的字段值
+    static int value_of(int i) { return i * 7 % NUM_VALUES; }
+
+    // 外部排序器中的key：规范化的字段之后是规范化的Rid
+    static std::vector<char> make_sort_key(int value, const Rid &rid) {
+        std::vector<char> key(sizeof(int) + IX_RID_KEY_LEN);
+        ix_encode_col(key.data(), (const char *)&value, TYPE_INT, sizeof(int));
+        ix_encode_rid(key.data() + sizeof(int), rid);
+        return key;
+    }
+
+    std::vector<Rid> lookup_all(int value) {
+        std::vector<Rid> result;
+        bool exist = ih_->get_value((const char *)&value, &result, nullptr);
+        EXPECT_EQ(exist, !result.empty());
+        return result;
+    }
+
+    // 用lower_bound和upper_bound确定范围之后扫描，结果应与get_value相同
+    std::vector<Rid> scan_value(int value) {
+        std::vector<Rid> result;
+        Iid lower = ih_->lower_bound((const char *)&value), upper = ih_->upper_bound((const char *)&value);
+        for (IxScan scan(ih_.get(), lower, upper, bpm_.get()); !scan.is_end(); scan.next()) {
+            result.push_back(scan.rid());
+        }
+        return result;
+    }
+
+    // 扫描所有叶子结点，返回(字段值, Rid)
+    std::vector<std::pair<int, Rid>> scan_entries() {
+        std::vector<std::pair<int, Rid>> res;
+        int value;
+        for (IxScan scan(ih_.get(), ih_->leaf_begin(), ih_->leaf_end(), bpm_.get()); !scan.is_end(); scan.next()) {
+            scan.key((char *)&value);
+            res.emplace_back(value, scan.rid());
+        }
+        return res;
+    }
+
+    // 检查索引中恰好是exist[i]为true的记录，每个值的Rid从小到大排列
+    void check(const std::vector<bool> &exist) {
+        std::vector<std::pair<int, Rid>> expected_entries;
+        for (int value = 0; value < NUM_VALUES; value++) {
+            std::vector<Rid> expected;
+            for (size_t i = 0; i < exist.size(); i++) {
+                if (exist[i] && value_of(i) == value) {
+                    expected.push_back(make_rid(i));
+                    expected_entries.emplace_back(value, make_rid(i));
+                }
+            }
+            ASSERT_EQ(lookup_all(value), expected) << value;
+            ASSERT_EQ(scan_value(value), expected) << value;
+        }
+        ASSERT_EQ(scan_entries(), expected_entries);
+        EXPECT_TRUE(lookup_all(NUM_VALUES).empty());
+        EXPECT_TRUE(lookup_all(-1).empty());
+    }
+};
+
+TEST_F(IxPostingListTest, InsertDeleteTest) {
+    ASSERT_FALSE(ih_->is_unique());
+    const int num_rows = 50000;
+    std::vector<int> rows(num_rows);
+    for (int i = 0; i < num_rows; i++) {
+        rows[i] = i;
+    }
+    std::shuffle(rows.begin(), rows.end(), std::mt19937(37));
+    for (int i : rows) {
+        int value = value_of(i);
+        ASSERT_NE(ih_->insert_entry((const char *)&value, make_rid(i), nullptr), IX_NO_PAGE) << i;
+    }
+    // 字段和Rid都相同的键值对不能重复插入
+    int value = value_of(0);
+    EXPECT_EQ(ih_->insert_entry((const char *)&value, make_rid(0), nullptr), IX_NO_PAGE);
+    std::vector<bool> exist(num_rows, true);
+    check(exist);
+    // 每个Rid平均只占一两个字节，叶子结点比每个Rid都重复保存key时少得多
+    EXPECT_LT(ih_->get_file_hdr()->num_pages_, num_rows / 500);
+
+    // 非唯一索引删除时必须指定Rid
+    EXPECT_THROW(ih_->delete_entry((const char *)&value, nullptr), InternalError);
+    for (int i : rows) {
+        if (i % 3 == 0) continue;
+        value = value_of(i);
+        ASSERT_TRUE(ih_->delete_entry((const char *)&value, make_rid(i), nullptr)) << i;
+        exist[i] = false;
+    }
+    value = value_of(1);
+    EXPECT_FALSE(ih_->delete_entry((const char *)&value, make_rid(1), nullptr));
+    check(exist);
+
+    // 重新插入删除的记录
+    for (int i : rows) {
+        if (!exist[i]) {
+            value = value_of(i);
+            ASSERT_NE(ih_->insert_entry((const char *)&value, make_rid(i), nullptr), IX_NO_PAGE) << i;
+            exist[i] = true;
+        }
+    }
+    check(exist);
+}
+
+TEST_F(IxPostingListTest, ConcurrencyTest) {
+    const int num_rows = 40000;
+    const int num_threads = 4;
+    // 每个线程插入自己的一部分记录，同时删除前一半中偶数编号的记录，所有线程都集中在少数几个值上
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = t; i < num_rows; i += num_threads) {
+                int value = value_of(i);
+                ASSERT_NE(ih_->insert_entry((const char *)&value, make_rid(i), nullptr), IX_NO_PAGE) << i;
+                int j = i - num_rows / 2;
+                if (j >= 0 && j % 2 == 0) {
+                    value = value_of(j);
+                    ASSERT_TRUE(ih_->delete_entry((const char *)&value, make_rid(j), nullptr)) << j;
+                }
+                std::vector<Rid> result;
+                value = value_of(i);
+                ih_->get_value((const char *)&value, &result, nullptr);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::vector<bool> exist(num_rows);
+    for (int i = 0; i < num_rows; i++) {
+        exist[i] = i >= num_rows / 2 || i % 2 == 1;
+    }
+    check(exist);
+}
+
+TEST_F(IxPostingListTest, BulkLoadTest) {
+    for (double fill_factor : {0.5, 0.9, 1.0}) {
+        for (int num_rows : {0, 1, 100, 5000, 50000}) {
+            close_index();
+            open_posting_index();
+            IxExternalSorter sorter(ih_->get_file_hdr(), TEST_INDEX_TABLE);
+            for (int i = num_rows - 1; i >= 0; i--) {
+                sorter.add(make_sort_key(value_of(i), make_rid(i)).data(), make_rid(i));
+            }
+            sorter.finish();
+            ih_->bulk_load(sorter, fill_factor);
+            std::vector<bool> exist(num_rows, true);
+            check(exist);
+
+            // 批量构建之后的B+树可以继续插入和删除
+            for (int i = 0; i < num_rows; i += 2) {
+                int value = value_of(i);
+                ASSERT_TRUE(ih_->delete_entry((const char *)&value, make_rid(i), nullptr)) << i;
+                exist[i] = false;
+            }
+            for (int i = num_rows; i < num_rows + 1000; i++) {
+                int value = value_of(i);
+                ASSERT_NE(ih_->insert_entry((const char *)&value, make_rid(i), nullptr), IX_NO_PAGE) << i;
+                exist.push_back(true);
+            }
+            check(exist);
+        }
+    }
+}
+
+/**
+ * 比较posting list格式的非唯一索引和每个Rid都重复保存key的索引的大小和等值扫描的速度，
+ * 后者用字段和Rid组成的唯一索引 (w_id, page_no, slot_no) 模拟，两个索引都批量构建
+ */
+TEST_F(IxPostingListTest, PostingListBenchmark) {
+    const int num_rows = 1000000;
+    const int num_rounds = 5;
+    std::mt19937 rng(1);
+    std::vector<int> values(num_rows);
+    for (int i = 0; i < num_rows; i++) {
+        values[i] = rng() % NUM_VALUES;
+    }
+    int pages[2];
+    double scan_ns[2];
+    size_t total = 0;
+    for (bool posting : {false, true}) {
+        close_index();
+        if (posting) {
+            index_cols_.resize(1);
+            open_posting_index();
+        } else {
+            index_cols_ = {
+                {.tab_name = TEST_INDEX_TABLE, .name = "w_id", .type = TYPE_INT, .len = sizeof(int), .offset = 0},
+                {.tab_name = TEST_INDEX_TABLE, .name = "page_no", .type = TYPE_INT, .len = sizeof(int), .offset = 4},
+                {.tab_name = TEST_INDEX_TABLE, .name = "slot_no", .type = TYPE_INT, .len = sizeof(int), .offset = 8}};
+            open_new_index();
+        }
+        {
+            IxExternalSorter sorter(ih_->get_file_hdr(), TEST_INDEX_TABLE);
+            for (int i = 0; i < num_rows; i++) {
+                sorter.add(make_sort_key(values[i], make_rid(i)).data(), make_rid(i));
+            }
+            sorter.finish();
+            ih_->bulk_load(sorter);
+        }
+        pages[posting] = ih_->get_file_hdr()->num_pages_;
+
+        // 读出每个值对应的所有Rid
+        auto start = std::chrono::steady_clock::now();
+        size_t count = 0;
+        for (int round = 0; round < num_rounds; round++) {
+            for (int value = 0; value < NUM_VALUES; value++) {
+                if (posting) {
+                    count += lookup_all(value).size();
+                } else {
+                    int lower[3] = {value, INT_MIN, INT_MIN}, upper[3] = {value, INT_MAX, INT_MAX};
+                    Iid lo = ih_->lower_bound((const char *)lower), hi = ih_->upper_bound((const char *)upper);
+                    for (IxScan scan(ih_.get(), lo, hi, bpm_.get()); !scan.is_end(); scan.next()) {
+                        scan.rid();
+                        count++;
+                    }
+                }
+            }
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ASSERT_EQ(count, (size_t)num_rows * num_rounds);
+        total += count;
+        scan_ns[posting] = secs * 1e9 / count;
+        std::cout << (posting ? "posting list: " : "key per rid: ") << pages[posting] * (PAGE_SIZE / 1024) << " KB, "
+                  << scan_ns[posting] << " ns per rid" << std::endl;
+    }
+    EXPECT_LT(pages[1] * 4, pages[0]);
+    EXPECT_LT(scan_ns[1], scan_ns[0]);
+}
+
+/**
+ * 可扩展哈希索引的测试，索引字段为一个INT
+ */
+class IxHashTest : public ::testing::Test {
+   public:
+    const std::string TEST_INDEX_TABLE = "ix_hash";
+
+    std::unique_ptr<DiskManager> disk_manager_;
+    std::unique_ptr<BufferPoolManager> bpm_;
+    std::unique_ptr<IxManager> ix_manager_;
+    std::unique_ptr<IxHashHandle> hh_;
+    std::vector<ColMeta> index_cols_;
+
+    void SetUp() override {
+        ::testing::Test::SetUp();
+        disk_manager_ = std::make_unique<DiskManager>();
+        bpm_ = std::make_unique<BufferPoolManager>(4096, disk_manager_.get());
+        ix_manager_ = std::make_unique<IxManager>(disk_manager_.get(), bpm_.get());
+        if (!disk_manager_->is_dir(TEST_DB_NAME)) {
+            disk_manager_->create_dir(TEST_DB_NAME);
+        }
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
+        index_cols_ = {{.tab_name = TEST_INDEX_TABLE, .name = "id", .type = TYPE_INT, .len = sizeof(int), .offset = 0}};
+        open_new_index();
+    }
+
+    void TearDown() override {
+        close_index();
+        if (chdir("..") < 0) {
+            throw UnixError();
+        }
+    }
+
+    void open_new_index() {
+        if (ix_manager_->exists(TEST_INDEX_TABLE, index_cols_)) {
+            ix_manager_->destroy_index(TEST_INDEX_TABLE, index_cols_);
+        }
+        ix_manager_->create_hash_index(TEST_INDEX_TABLE, index_cols_);
+        hh_ = ix_manager_->open_hash_index(TEST_INDEX_TABLE, index_cols_);
+    }
+
+    void close_index(bool destroy = true) {
+        if (hh_ != nullptr) {
+            ix_manager_->close_hash_index(hh_.get());
+            hh_.reset();
+            if (destroy) {
+                ix_manager_->destroy_index(TEST_INDEX_TABLE, index_cols_);
+            }
+        }
+    }
+
+    static Rid make_rid(int i) { return Rid{.page_no = i / 100 + 1, .slot_no = i % 100}; }
+
+    bool lookup(int i, Rid *rid) {
+        std::vector<Rid> result;
+        if (!hh_->get_value((const char *)&i, &result, nullptr)) {
+            return false;
+        }
+        EXPECT_EQ(result.size(), 1);
+        *rid = result.at(0);
+        return true;
+    }
+};
+
+TEST(IxKeyTest, HashTest) {
+    // 规范化之后0.0和-0.0是同一个key，哈希值也相同
+    std::vector<ColType> col_types = {TYPE_FLOAT};
+    std::vector<int> col_lens = {sizeof(float)};
+    float pos_zero = 0.0f, neg_zero = -0.0f;
+    char a[4], b[4];
+    ix_encode_key(a, (const char *)&pos_zero, col_types, col_lens);
+    ix_encode_key(b, (const char *)&neg_zero, col_types, col_lens);
+    EXPECT_EQ(ix_hash_key(a, 4), ix_hash_key(b, 4));
+
+    // 连续的整数key的哈希值低位分布均匀，目录的每一项分到的key个数相近
+    const int num_keys = 1 << 16, num_slots = 256;
+    std::vector<int> counts(num_slots);
+    for (int i = 0; i < num_keys; i++) {
+        char key[4];
+        ix_encode_col(key, (const char *)&i, TYPE_INT, sizeof(int));
+        counts[ix_hash_key(key, 4) % num_slots]++;
+    }
+    for (int count : counts) {
+        EXPECT_GT(count, num_keys / num_slots / 2);
+        EXPECT_LT(count, num_keys / num_slots * 2);
+    }
+}
+
+TEST_F(IxHashTest, InsertDeleteTest) {
+    const int num_keys = 100000;
+    std::vector<int> keys(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i * 7 - num_keys;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(36));
+    for (int i = 0; i < num_keys; i++) {
+        ASSERT_NE(hh_->insert_entry((const char *)&keys[i], make_rid(i), nullptr), IX_NO_PAGE) << keys[i];
+    }
+    // key已经存在时不插入
+    EXPECT_EQ(hh_->insert_entry((const char *)&keys[0], make_rid(0), nullptr), IX_NO_PAGE);
+    int capacity = hh_->get_file_hdr()->bucket_capacity_;
+    EXPECT_GE(hh_->get_num_buckets(), num_keys / capacity);
+    EXPECT_LE(hh_->get_num_buckets(), 1 << hh_->get_global_depth());
+    for (int i = 0; i < num_keys; i++) {
+        Rid rid;
+        ASSERT_TRUE(lookup(keys[i], &rid)) << keys[i];
+        ASSERT_EQ(rid, make_rid(i));
+    }
+    Rid rid;
+    EXPECT_FALSE(lookup(1, &rid));
+
+    // 删除一半的key
+    for (int i = 0; i < num_keys; i += 2) {
+        ASSERT_TRUE(hh_->delete_entry((const char *)&keys[i], nullptr)) << keys[i];
+    }
+    EXPECT_FALSE(hh_->delete_entry((const char *)&keys[0], nullptr));
+    for (int i = 0; i < num_keys; i++) {
+        ASSERT_EQ(lookup(keys[i], &rid), i % 2 == 1) << keys[i];
+    }
+
+    // 关闭之后重新打开，目录和桶都从文件中读取
+    int global_depth = hh_->get_global_depth(), num_buckets = hh_->get_num_buckets();
+    close_index(false);
+    hh_ = ix_manager_->open_hash_index(TEST_INDEX_TABLE, index_cols_);
+    EXPECT_EQ(hh_->get_global_depth(), global_depth);
+    EXPECT_EQ(hh_->get_num_buckets(), num_buckets);
+    for (int i = 0; i < num_keys; i++) {
+        ASSERT_EQ(lookup(keys[i], &rid), i % 2 == 1) << keys[i];
+    }
+    // 重新插入删除的key，再插入一倍的新key使目录继续加倍
+    for (int i = 0; i < num_keys; i += 2) {
+        ASSERT_NE(hh_->insert_entry((const char *)&keys[i], make_rid(i), nullptr), IX_NO_PAGE) << keys[i];
+    }
+    for (int i = 0; i < num_keys; i++) {
+        int key = keys[i] + 1;
+        ASSERT_NE(hh_->insert_entry((const char *)&key, make_rid(i), nullptr), IX_NO_PAGE) << key;
+    }
+    EXPECT_GT(hh_->get_global_depth(), global_depth);
+    for (int i = 0; i < num_keys; i++) {
+        int key = keys[i] + 1;
+        ASSERT_TRUE(lookup(keys[i], &rid)) << keys[i];
+        ASSERT_TRUE(lookup(key, &rid)) << key;
+        ASSERT_EQ(rid, make_rid(i));
+    }
+}
+
+TEST_F(IxHashTest, ConcurrencyTest) {
+    const int num_threads = 8;
+    const int num_keys = 80000;
+    auto run = [&](auto &&op) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; t++) {
+            threads.emplace_back([&, t]() {
+                for (int i = t; i < num_keys; i += num_threads) {
+                    op(i * 7919 % num_keys);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    };
+    // 并发插入，分裂桶和目录加倍与其他线程的插入和查找交错
+    std::atomic<int> num_inserted{0};
+    run([&](int i) {
+        if (hh_->insert_entry((const char *)&i, make_rid(i), nullptr) != IX_NO_PAGE) num_inserted++;
+        Rid rid;
+        EXPECT_TRUE(lookup(i, &rid)) << i;
+    });
+    EXPECT_EQ(num_inserted, num_keys);
+    // 并发删除一半，同时查找另一半
+    run([&](int i) {
+        Rid rid;
+        if (i % 2 == 0) {
+            EXPECT_TRUE(hh_->delete_entry((const char *)&i, nullptr)) << i;
+        } else {
+            EXPECT_TRUE(lookup(i, &rid)) << i;
+            EXPECT_EQ(rid, make_rid(i));
+        }
+    });
+    for (int i = 0; i < num_keys; i++) {
+        Rid rid;
+        ASSERT_EQ(lookup(i, &rid), i % 2 == 1) << i;
+    }
+}
+
+/**
+ * 主键上的点查询：比较B+树和哈希索引的查找延迟，以及90%查找、10%插入的混合负载的吞吐
+ */
+TEST_F(IxHashTest, PointLookupBenchmark) {
+    const int num_keys = 500000;
+    const int num_ops = 1000000;
+    std::vector<int> keys(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(num_keys));
+    std::vector<int> lookup_keys;
+    std::mt19937 rng(1);
+    for (int i = 0; i < num_ops; i++) {
+        lookup_keys.push_back(rng() % num_keys);
+    }
+
+    // insert(key, rid)返回是否插入，lookup(key)返回是否找到
+    auto bench = [&](const std::string &name, auto &&insert, auto &&lookup_key) {
+        for (int i = 0; i < num_keys; i++) {
+            insert(keys[i], make_rid(keys[i]));
+        }
+        int num_found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int key : lookup_keys) {
+            num_found += lookup_key(key);
+        }
+        double lookup_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_EQ(num_found, num_ops) << name;
+
+        int next_key = num_keys;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_ops; i++) {
+            if (i % 10 == 0) {
+                insert(next_key, make_rid(next_key));
+                next_key++;
+            } else {
+                lookup_key(lookup_keys[i]);
+            }
+        }
+        double mixed_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << ": lookup " << lookup_secs * 1e9 / num_ops << " ns, 90% lookup + 10% insert "
+                  << (long long)(num_ops / mixed_secs) << " ops/s" << std::endl;
+    };
+
+    // B+树使用另一个表名，与哈希索引的文件区分开
+    const std::string btree_table = TEST_INDEX_TABLE + "_btree";
+    std::vector<ColMeta> btree_cols = index_cols_;
+    btree_cols[0].tab_name = btree_table;
+    if (ix_manager_->exists(btree_table, btree_cols)) {
+        ix_manager_->destroy_index(btree_table, btree_cols);
+    }
+    ix_manager_->create_index(btree_table, btree_cols);
+    auto ih = ix_manager_->open_index(btree_table, btree_cols);
+    std::vector<Rid> result;
+    bench(
+        "b+ tree", [&](int key, const Rid &rid) { return ih->insert_entry((const char *)&key, rid, nullptr) != IX_NO_PAGE; },
+        [&](int key) {
+            result.clear();
+            return ih->get_value((const char *)&key, &result, nullptr);
+        });
+    std::cout << "b+ tree height " << ih->get_height() << std::endl;
+    ix_manager_->close_index(ih.get());
+    ix_manager_->destroy_index(btree_table, btree_cols);
+
+    bench(
+        "extendible hash", [&](int key, const Rid &rid) { return hh_->insert_entry((const char *)&key, rid, nullptr) != IX_NO_PAGE; },
+        [&](int key) {
+            result.clear();
+            return hh_->get_value((const char *)&key, &result, nullptr);
+        });
+    std::cout << "extendible hash global depth " << hh_->get_global_depth() << ", " << hh_->get_num_buckets()
+              << " buckets" << std::endl;
+}
+
+TEST(IxKeyTest, BloomFilterTest) {
+    const int num_keys = 100000;
+    IxBloomFilter bloom(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        bloom.add(ix_hash_key((const char *)&i, sizeof(int)));
+    }
+    for (int i = 0; i < num_keys; i++) {
+        ASSERT_TRUE(bloom.may_contain(ix_hash_key((const char *)&i, sizeof(int)))) << i;
+    }
+    int num_positives = 0;
+    for (int i = num_keys; i < num_keys * 11; i++) {
+        num_positives += bloom.may_contain(ix_hash_key((const char *)&i, sizeof(int)));
+    }
+    double fpr = (double)num_positives / (num_keys * 10);
+    double expected = bloom.expected_false_positive_rate();
+    std::cout << "bloom filter: " << IX_BLOOM_BITS_PER_KEY << " bits per key, false positive rate " << fpr
+              << ", expected " << expected << std::endl;
+    EXPECT_LT(fpr, 0.02);
+    EXPECT_LT(fpr, expected * 1.5);
+    EXPECT_GT(fpr, expected / 1.5);
+    EXPECT_EQ(bloom.stats().num_keys, num_keys);
+}
+
+class IxBloomTest : public IxConcurrencyTest {
+   public:
+    IxBloomStats bloom_stats() const { return ih_->get_bloom_filter()->stats(); }
+};
+
+TEST_F(IxBloomTest, LookupTest) {
+    const int num_keys = 20000;
+    Rid rid;
+    for (int i = 0; i < num_keys; i += 2) {
+        ih_->insert_entry(make_key(i).data(), make_rid(i), nullptr);
+    }
+    ASSERT_EQ(ih_->get_bloom_filter(), nullptr);
+    EXPECT_TRUE(ih_->may_contain(make_key(1).data()));
+    ih_->build_bloom_filter();
+    ASSERT_NE(ih_->get_bloom_filter(), nullptr);
+    EXPECT_EQ(bloom_stats().num_keys, num_keys / 2);
+
+    // 偶数存在，奇数和超出范围的key不存在
+    for (int i = 0; i < num_keys * 2; i++) {
+        bool exist = i % 2 == 0 && i < num_keys;
+        ASSERT_EQ(lookup(i, &rid), exist) << i;
+        if (exist) {
+            ASSERT_EQ(rid, make_rid(i));
+            ASSERT_TRUE(ih_->may_contain(make_key(i).data()));
+        }
+    }
+    auto stats = bloom_stats();
+    EXPECT_EQ(stats.num_probes, num_keys * 2);
+    EXPECT_EQ(stats.num_negatives + stats.num_false_positives, num_keys * 3 / 2);
+    EXPECT_LT(stats.false_positive_rate(), 0.02);
+
+    // 构建之后插入的key加入Bloom filter，删除的key仍然可能通过Bloom filter，在B+树中查找之后才确定不存在
+    for (int i = 1; i < num_keys; i += 2) {
+        ih_->insert_entry(make_key(i).data(), make_rid(i), nullptr);
+    }
+    for (int i = 0; i < num_keys; i += 4) {
+        ih_->delete_entry(make_key(i).data(), nullptr);
+    }
+    for (int i = 0; i < num_keys; i++) {
+        ASSERT_EQ(lookup(i, &rid), i % 4 != 0) << i;
+    }
+    EXPECT_EQ(bloom_stats().num_keys, num_keys);
+    EXPECT_EQ(bloom_stats().num_false_positives, stats.num_false_positives + num_keys / 4);
+
+    // 重新构建之后删除的key不再通过Bloom filter
+    ih_->build_bloom_filter();
+    EXPECT_EQ(bloom_stats().num_keys, num_keys * 3 / 4);
+    int num_passed = 0;
+    for (int i = 0; i < num_keys; i += 4) {
+        num_passed += ih_->may_contain(make_key(i).data());
+    }
+    EXPECT_LT(num_passed, num_keys / 4 / 50);
+}
+
+TEST_F(IxPostingListTest, BloomFilterTest) {
+    // 非唯一索引的Bloom filter只对字段哈希，不包括key末尾的Rid
+    const int num_rows = 5000;
+    for (int i = 0; i < num_rows; i++) {
+        int value = value_of(i);
+        ih_->insert_entry((const char *)&value, make_rid(i), nullptr);
+    }
+    ih_->build_bloom_filter();
+    EXPECT_EQ(ih_->get_bloom_filter()->stats().num_keys, num_rows);
+    std::vector<bool> exist(num_rows, true);
+    for (int i = num_rows; i < num_rows + 100; i++) {
+        int value = value_of(i);
+        ih_->insert_entry((const char *)&value, make_rid(i), nullptr);
+        exist.push_back(true);
+    }
+    check(exist);
+    int num_passed = 0;
+    for (int value = NUM_VALUES; value < NUM_VALUES + 10000; value++) {
+        num_passed += !lookup_all(value).empty() || ih_->may_contain((const char *)&value);
+    }
+    EXPECT_LT(num_passed, 10000 / 50);
+}
+
+/**
+ * 查找不存在的key的延迟：没有Bloom filter时每次都要从根结点向下查找到叶子结点，
+ * 有Bloom filter时绝大多数只需要计算一次哈希并读取一个cache line
+ */
+TEST_F(IxBloomTest, NegativeLookupBenchmark) {
+    const int num_keys = 500000;
+    const int num_ops = 1000000;
+    std::vector<int> keys(num_keys);
+    for (int i = 0; i < num_keys; i++) {
+        keys[i] = i * 2;
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(num_keys));
+    for (int key : keys) {
+        ih_->insert_entry(make_key(key).data(), make_rid(key), nullptr);
+    }
+    std::vector<std::vector<char>> absent_keys, present_keys;
+    std::mt19937 rng(40);
+    for (int i = 0; i < num_ops; i++) {
+        int key = rng() % num_keys * 2;
+        present_keys.push_back(make_key(key));
+        absent_keys.push_back(make_key(key + 1));
+    }
+    auto bench = [&](const std::vector<std::vector<char>> &lookup_keys) {
+        std::vector<Rid> result;
+        int num_found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto &key : lookup_keys) {
+            result.clear();
+            num_found += ih_->get_value(key.data(), &result, nullptr);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(ns / lookup_keys.size(), num_found);
+    };
+
+    auto absent = bench(absent_keys);
+    auto present = bench(present_keys);
+    EXPECT_EQ(absent.second, 0);
+    EXPECT_EQ(present.second, num_ops);
+    ih_->build_bloom_filter();
+    auto absent_bloom = bench(absent_keys);
+    auto present_bloom = bench(present_keys);
+    EXPECT_EQ(absent_bloom.second, 0);
+    EXPECT_EQ(present_bloom.second, num_ops);
+    auto stats = bloom_stats();
+    std::cout << "b+ tree height " << ih_->get_height() << ", bloom filter " << stats.num_bits / 8 / 1024
+              << " KB, false positive rate " << stats.false_positive_rate() << std::endl;
+    std::cout << "negative lookup: " << absent.first << " ns without bloom filter, " << absent_bloom.first
+              << " ns with bloom filter" << std::endl;
+    std::cout << "positive lookup: " << present.first << " ns without bloom filter, " << present_bloom.first
+              << " ns with bloom filter" << std::endl;
+    EXPECT_LT(stats.false_positive_rate(), 0.02);
+    EXPECT_LT(absent_bloom.first, absent.first);
+}
+
+/**
+ * CREATE INDEX的测试：表t(id, a, b, pad)中插入NUM_ROWS条记录之后删除id为奇数的记录，
+ * SmManager::create_index通过RmScan扫描表中剩下的记录构建索引。a是id的一个排列，b上的值全部相同
+ */
+class CreateIndexTest : public PlannerTest {
+   public:
+    static constexpr int NUM_ROWS = 5000;
+    static constexpr int PAD_LEN = 100;
+    static constexpr size_t BUFFER_PAGES = 256;
+
+    std::unique_ptr<BufferPoolManager> bpm_;
+    std::unique_ptr<IxManager> ix_manager_;
+    std::vector<Rid> rids_;  // 第id条记录的位置
+
+    void SetUp() override {
+        PlannerTest::SetUp();
+        bpm_ = std::make_unique<BufferPoolManager>(BUFFER_PAGES, disk_manager.get());
+        ix_manager_ = std::make_unique<IxManager>(disk_manager.get(), bpm_.get());
+        rm_manager_ = std::make_unique<RmManager>(disk_manager.get(), bpm_.get());
+        sm_manager_ = std::make_unique<SmManager>(disk_manager.get(), bpm_.get(), rm_manager_.get(), ix_manager_.get());
+        planner_ = std::make_unique<Planner>(sm_manager_.get());
+    }
+
+    void TearDown() override {
+        for (auto &entry : sm_manager_->ihs_) {
+            ix_manager_->close_index(entry.second.get());
+            disk_manager->destroy_file(entry.first);
+        }
+        sm_manager_->ihs_.clear();
+        for (auto &entry : sm_manager_->hhs_) {
+            ix_manager_->close_hash_index(entry.second.get());
+            disk_manager->destroy_file(entry.first);
+        }
+        sm_manager_->hhs_.clear();
+        PlannerTest::TearDown();
+    }
+
+    static int a_of(int id) { return (int)((long long)id * 7919 % NUM_ROWS); }
+
+    // 插入NUM_ROWS条记录，第一条记录的首字节为0，然后删除id为奇数的记录
+    void load_table() {
+        create_table("t", {{"id", TYPE_INT, 4}, {"a", TYPE_INT, 4}, {"b", TYPE_INT, 4}, {"pad", TYPE_STRING, PAD_LEN}});
+        RmFileHandle *fh = sm_manager_->fhs_.at("t").get();
+        std::vector<char> rec(fh->file_hdr_.record_size, 'x');
+        for (int id = 0; id < NUM_ROWS; id++) {
+            int vals[3] = {id, a_of(id), 0};
+            memcpy(rec.data(), vals, sizeof(vals));
+            rids_.push_back(fh->insert_record(rec.data(), nullptr));
+        }
+        for (int id = 1; id < NUM_ROWS; id += 2) {
+            fh->delete_record(rids_[id], nullptr);
+        }
+    }
+
+    // 删除上一次运行遗留的索引文件
+    void drop_index_file(const std::vector<std::string> &col_names) {
+        if (ix_manager_->exists("t", col_names)) {
+            ix_manager_->destroy_index("t", col_names);
+        }
+    }
+};
+
+/**
+ * 批量构建B+树：删除过记录的页面中的空槽位不能出现在索引中
+ */
+TEST_F(CreateIndexTest, BTreeTest) {
+    load_table();
+    std::vector<Rid> scanned;
+    for (RmScan scan(sm_manager_->fhs_.at("t").get()); !scan.is_end(); scan.next()) {
+        scanned.push_back(scan.rid());
+    }
+    ASSERT_EQ(scanned.size(), (size_t)NUM_ROWS / 2);
+
+    std::vector<std::string> cols = {"id"}, dup_cols = {"b"};
+    drop_index_file(cols);
+    drop_index_file(dup_cols);
+    sm_manager_->create_index("t", cols, nullptr);
+    auto &ih = sm_manager_->ihs_.at(ix_manager_->get_index_name("t", cols));
+    for (int id = 0; id < NUM_ROWS; id++) {
+        std::vector<Rid> result;
+        ASSERT_EQ(ih->get_value((const char *)&id, &result, nullptr), id % 2 == 0) << id;
+        if (id % 2 == 0) {
+            ASSERT_EQ(result, std::vector<Rid>{rids_[id]}) << id;
+        }
+    }
+    EXPECT_TRUE(sm_manager_->db_.get_table("t").is_index(cols));
+
+    // b上的值全部相同，唯一索引构建失败时删除索引文件
+    EXPECT_THROW(sm_manager_->create_index("t", dup_cols, nullptr), IndexEntryExistsError);
+    EXPECT_FALSE(sm_manager_->db_.get_table("t").is_index(dup_cols));
+    EXPECT_FALSE(ix_manager_->exists("t", dup_cols));
+}
+
+/**
+ * CREATE INDEX ... USING HASH逐条插入哈希索引，并加入数据库的元数据
+ */
+TEST_F(CreateIndexTest, HashTest) {
+    load_table();
+    std::vector<std::string> cols = {"a", "id"}, dup_cols = {"b"};
+    drop_index_file(cols);
+    drop_index_file(dup_cols);
+    sm_manager_->create_index("t", cols, nullptr, INDEX_HASH);
+    auto &tab = sm_manager_->db_.get_table("t");
+    ASSERT_TRUE(tab.is_index(cols));
+    EXPECT_EQ(tab.get_index_meta(cols)->type, INDEX_HASH);
+    auto &hh = sm_manager_->hhs_.at(ix_manager_->get_index_name("t", cols));
+    for (int id = 0; id < NUM_ROWS; id++) {
+        int key[2] = {a_of(id), id};
+        std::vector<Rid> result;
+        ASSERT_EQ(hh->get_value((const char *)key, &result, nullptr), id % 2 == 0) << id;
+        if (id % 2 == 0) {
+            ASSERT_EQ(result, std::vector<Rid>{rids_[id]}) << id;
+        }
+    }
+
+    // b上的值全部相同，哈希索引只能是唯一索引，构建失败时删除索引文件
+    EXPECT_THROW(sm_manager_->create_index("t", dup_cols, nullptr, INDEX_HASH), IndexEntryExistsError);
+    EXPECT_FALSE(tab.is_index(dup_cols));
+    EXPECT_FALSE(ix_manager_->exists("t", dup_cols));
+}
+
+/**
+ * CREATE INDEX ... WITH BLOOM批量构建B+树之后从叶子结点构建Bloom filter，已经删除的记录不在其中
+ */
+TEST_F(CreateIndexTest, BloomTest) {
+    load_table();
+    std::vector<std::string> cols = {"id"};
+    drop_index_file(cols);
+    sm_manager_->create_index("t", cols, nullptr, INDEX_BTREE, true, true);
+    EXPECT_TRUE(sm_manager_->db_.get_table("t").get_index_meta(cols)->bloom);
+    auto &ih = sm_manager_->ihs_.at(ix_manager_->get_index_name("t", cols));
+    ASSERT_NE(ih->get_bloom_filter(), nullptr);
+    EXPECT_EQ(ih->get_bloom_filter()->stats().num_keys, (size_t)NUM_ROWS / 2);
+    for (int id = 0; id < NUM_ROWS; id++) {
+        std::vector<Rid> result;
+        ASSERT_EQ(ih->get_value((const char *)&id, &result, nullptr), id % 2 == 0) << id;
+    }
+    auto stats = ih->get_bloom_filter()->stats();
+    EXPECT_EQ(stats.num_probes, (size_t)NUM_ROWS);
+    EXPECT_GT(stats.num_negatives, (size_t)NUM_ROWS / 2 * 9 / 10);
+}
+
+TEST(StatsTest, SkewedDataTest) {
+    const size_t num_rows = 100000;
+    const int num_keys = 1000;
+    TabMeta tab;
+    tab.name = "t";
+    tab.cols = {{.tab_name = "t", .name = "k", .type = TYPE_INT, .len = 4, .offset = 0, .index = false},
+                {.tab_name = "t", .name = "u", .type = TYPE_INT, .len = 4, .offset = 4, .index = false},
+                {.tab_name = "t", .name = "s", .type = TYPE_STRING, .len = 8, .offset = 8, .index = false}};
+
+    std::mt19937 rng(2025);
+    std::vector<double> zipf_weights;
+    for (int i = 1; i <= num_keys; i++) {
+        zipf_weights.push_back(1.0 / std::pow(i, 1.2));
+    }
+    std::discrete_distribution<int> zipf(zipf_weights.begin(), zipf_weights.end());
+    std::uniform_int_distribution<int> uniform(0, 9999);
+    std::vector<std::string> prefixes = {"aa", "ab", "ba", "zz"};
+
+    std::vector<int> ks, us;
+    std::vector<std::string> ss;
+    ReservoirSampler sampler(STATS_SAMPLE_SIZE, 7);
+    std::vector<std::unique_ptr<RmRecord>> samples;
+    for (size_t i = 0; i < num_rows; i++) {
+        int k = zipf(rng) + 1, u = uniform(rng);
+        std::string s = prefixes[zipf(rng) % prefixes.size()] + std::to_string(u % 100);
+        ks.push_back(k);
+        us.push_back(u);
+        ss.push_back(s);
+        int64_t pos = sampler.offer();
+        if (pos < 0) continue;
+        auto rec = std::make_unique<RmRecord>(16);
+        memset(rec->data, 0, 16);
+        memcpy(rec->data, &k, 4);
+        memcpy(rec->data + 4, &u, 4);
+        memcpy(rec->data + 8, s.c_str(), s.size());
+        if ((size_t)pos == samples.size()) {
+            samples.push_back(std::move(rec));
+        } else {
+            samples[pos] = std::move(rec);
+        }
+    }
+    ASSERT_EQ(samples.size(), STATS_SAMPLE_SIZE);
+    ASSERT_EQ(sampler.num_seen(), num_rows);
+    TabStats stats = TabStats::build(tab, samples, num_rows, 0);
+
+    auto make_cond = [](const std::string &col, CompOp op, Value val) {
+        Condition cond;
+        cond.lhs_col = {.tab_name = "t", .col_name = col};
+        cond.op = op;
+        cond.is_rhs_val = true;
+        cond.rhs_val = val;
+        return cond;
+    };
+    auto int_val = [](int v) {
+        Value val;
+        val.set_int(v);
+        return val;
+    };
+    auto q_error = [&](double est, double actual) {
+        actual = std::max(actual, 1.0 / num_rows);
+        return std::max(est / actual, actual / est);
+    };
+    auto actual_int = [&](const std::vector<int> &vals, CompOp op, int v) {
+        size_t cnt = std::count_if(vals.begin(), vals.end(), [&](int x) {
+            switch (op) {
+                case OP_EQ: return x == v;
+                case OP_NE: return x != v;
+                case OP_LT: return x < v;
+                case OP_GT: return x > v;
+                case OP_LE: return x <= v;
+                default: return x >= v;
+            }
+        });
+        return (double)cnt / num_rows;
+    };
+
+    // 不同值个数
+    std::set<int> distinct_k(ks.begin(), ks.end()), distinct_u(us.begin(), us.end());
+    EXPECT_LT(q_error(stats.cols["k"].ndv, distinct_k.size()), 2);
+    EXPECT_LT(q_error(stats.cols["u"].ndv, distinct_u.size()), 1.5);
+    EXPECT_EQ(stats.cols["k"].num_nulls, 0);
+
+    // 高频值的等值条件
+    for (int k = 1; k <= 5; k++) {
+        double est = stats.get_selectivity(make_cond("k", OP_EQ, int_val(k)));
+        EXPECT_LT(q_error(est, actual_int(ks, OP_EQ, k)), 1.2) << "k = " << k;
+    }
+    // 低频值的等值条件，平均误差远小于默认选择率
+    double stats_err = 0, default_err = 0;
+    int num_probes = 0;
+    for (int k = 100; k <= num_keys; k += 50) {
+        double actual = actual_int(ks, OP_EQ, k);
+        stats_err += q_error(stats.get_selectivity(make_cond("k", OP_EQ, int_val(k))), actual);
+        default_err += q_error(CostModel::DEFAULT_EQ_SEL, actual);
+        num_probes++;
+    }
+    EXPECT_LT(stats_err / num_probes, 4);
+    EXPECT_LT(stats_err * 10, default_err);
+
+    // 倾斜数据和均匀数据上的范围条件
+    for (CompOp op : {OP_LT, OP_LE, OP_GT, OP_GE}) {
+        for (int k : {2, 10, 50, 300}) {
+            double actual = actual_int(ks, op, k);
+            EXPECT_LT(q_error(stats.get_selectivity(make_cond("k", op, int_val(k))), actual), 1.5)
+                << "op " << op << " k " << k;
+        }
+        for (int u : {100, 2500, 5000, 9000}) {
+            double actual = actual_int(us, op, u);
+            EXPECT_LT(q_error(stats.get_selectivity(make_cond("u", op, int_val(u))), actual), 1.2)
+                << "op " << op << " u " << u;
+        }
+    }
+    // 不在取值范围内的值
+    EXPECT_DOUBLE_EQ(stats.get_selectivity(make_cond("u", OP_LT, int_val(-5))), 1.0 / num_rows);
+    EXPECT_DOUBLE_EQ(stats.get_selectivity(make_cond("u", OP_EQ, int_val(20000))), 1.0 / num_rows);
+
+    // 字符串的范围条件
+    Value str_val;
+    str_val.set_str("b");
+    double actual = (double)std::count_if(ss.begin(), ss.end(), [](const std::string &s) { return s < "b"; }) / num_rows;
+    EXPECT_LT(q_error(stats.get_selectivity(make_cond("s", OP_LT, str_val)), actual), 1.2);
+
+    // 统计信息写入文件后读回，估算结果不变
+    std::stringstream ss_stats;
+    ss_stats << std::setprecision(17) << stats;
+    TabStats loaded;
+    ss_stats >> loaded;
+    EXPECT_EQ(loaded.num_rows, stats.num_rows);
+    for (int k : {1, 3, 77, 500}) {
+        for (CompOp op : {OP_EQ, OP_LT, OP_GE}) {
+            EXPECT_DOUBLE_EQ(loaded.get_selectivity(make_cond("k", op, int_val(k))),
+                             stats.get_selectivity(make_cond("k", op, int_val(k))));
+        }
+    }
+}
+
+/**
+ * SQL的ANALYZE：通过RmScan扫描表中的记录生成统计信息，已经删除的记录不计入。
+ * 关闭数据库时统计信息写入db.stats，重新打开数据库之后读回的估算结果不变
+ */
+TEST_F(PlannerTest, AnalyzeTest) {
+    const std::string db_name = "analyze_db";
+    const int num_rows = 3000;
+    if (sm_manager_->is_dir(db_name)) {
+        sm_manager_->drop_db(db_name);
+    }
+    sm_manager_->create_db(db_name);
+    sm_manager_->open_db(db_name);
+    sm_manager_->create_table("t", {{"id", TYPE_INT, 4}, {"a", TYPE_INT, 4}, {"s", TYPE_STRING, 8}}, nullptr);
+    RmFileHandle *fh = sm_manager_->fhs_.at("t").get();
+    std::vector<char> rec(fh->get_file_hdr().record_size, 0);
+    std::vector<Rid> rids;
+    for (int id = 0; id < num_rows; id++) {
+        int vals[2] = {id, id % 10};
+        memcpy(rec.data(), vals, sizeof(vals));
+        rec[8] = (char)('a' + id % 26);
+        rids.push_back(fh->insert_record(rec.data(), nullptr));
+    }
+    for (int id = num_rows / 2; id < num_rows; id++) {
+        fh->delete_record(rids[id], nullptr);
+    }
+    sm_manager_->analyze_table("t", nullptr);
+    TabStats stats = sm_manager_->stats_.at("t");
+    EXPECT_EQ(stats.num_rows, (size_t)num_rows / 2);
+    EXPECT_EQ(stats.num_pages, fh->get_file_hdr().num_pages);
+    EXPECT_EQ(stats.cols.at("id").ndv, (size_t)num_rows / 2);
+    EXPECT_EQ(stats.cols.at("id").min_val, 0);
+    EXPECT_EQ(stats.cols.at("id").max_val, num_rows / 2 - 1);
+    EXPECT_EQ(stats.cols.at("a").ndv, 10u);
+    EXPECT_EQ(stats.cols.at("s").ndv, 26u);
+    sm_manager_->close_db();
+
+    auto make_cond = [](const std::string &col, CompOp op, int val) {
+        Condition cond;
+        cond.lhs_col = {.tab_name = "t", .col_name = col};
+        cond.op = op;
+        cond.is_rhs_val = true;
+        cond.rhs_val.set_int(val);
+        return cond;
+    };
+    SmManager sm_manager(disk_manager.get(), buffer_pool_manager.get(), rm_manager_.get(), nullptr);
+    sm_manager.open_db(db_name);
+    ASSERT_EQ(sm_manager.stats_.count("t"), 1u);
+    auto &loaded = sm_manager.stats_.at("t");
+    EXPECT_EQ(loaded.num_rows, stats.num_rows);
+    EXPECT_EQ(loaded.num_pages, stats.num_pages);
+    for (int val : {-1, 0, 3, 9, 700, 1499, 2000}) {
+        for (CompOp op : {OP_EQ, OP_LT, OP_GE}) {
+            for (auto &col_name : {"id", "a"}) {
+                EXPECT_DOUBLE_EQ(loaded.get_selectivity(make_cond(col_name, op, val)),
+                                 stats.get_selectivity(make_cond(col_name, op, val)))
+                    << col_name << ' ' << op << ' ' << val;
+            }
+        }
+    }
+    sm_manager.close_db();
+    sm_manager.drop_db(db_name);
+}
+
+class LockManagerTest : public ::testing::Test {
+   public:
+    static constexpr int TAB_FD = 3;
+
+    std::unique_ptr<LockManager> lock_manager_;
+    std::unique_ptr<TransactionManager> txn_manager_;
+    std::vector<std::unique_ptr<Transaction>> txns_;
+
+    void SetUp() override {
+        ::testing::Test::SetUp();
+        set_policy(DeadlockPolicy::NO_WAIT);
+    }
+
+    void set_policy(DeadlockPolicy policy) {
+        lock_manager_ = std::make_unique<LockManager>(policy);
+        txn_manager_ = std::make_unique<TransactionManager>(lock_manager_.get(), nullptr);
+    }
+
+    // 事务ID按照创建的顺序递增，越早创建的事务越老
+    Transaction *begin() {
+        txns_.emplace_back(txn_manager_->begin(nullptr, nullptr));
+        return txns_.back().get();
+    }
+
+    static Rid rid(int i) { return Rid{.page_no = 1 + i / 100, .slot_no = i % 100}; }
+
+    // 加锁失败时返回事务回滚的原因
+    template <typename F>
+    static std::optional<AbortReason> try_lock(F &&lock) {
+        try {
+            lock();
+        } catch (TransactionAbortException &e) {
+            return e.GetAbortReason();
+        }
+        return std::nullopt;
+    }
+
+    // 等待另一个线程进入等待状态
+    static void wait_blocked() { std::this_thread::sleep_for(std::chrono::milliseconds(50)); }
+
+    static const char *policy_name(DeadlockPolicy policy) {
+        static const char *names[] = {"no-wait", "wait-die", "wound-wait", "detection"};
+        return names[static_cast<int>(policy)];
+    }
+
+    struct ContentionResult {
+        double seconds;
+        double commits_per_sec;
+        long long aborts;
+        double abort_rate;
+    };
+
+    /**
+     * 多线程争用：每个事务在NUM_ROWS行中随机选择OPS_PER_TXN行，一半加S锁读取，一半加X锁并把计数器加一，
+     * 回滚的事务重试直到提交。最后检查计数器之和等于写操作的个数，并且所有锁都已经释放
+     */
+    ContentionResult run_contention(int num_threads) {
+        const int NUM_ROWS = 1000;
+        const int OPS_PER_TXN = 8;
+        const auto duration = std::chrono::milliseconds(300);
+        std::vector<long long> counters(NUM_ROWS, 0);
+        std::atomic<long long> commits = 0, aborts = 0, committed_writes = 0;
+        std::atomic<bool> stop = false;
+        std::mutex txns_latch;
+        auto worker = [&](int id) {
+            std::mt19937 rng(id);
+            // 访问倾斜：一半操作落在前10%的行上
+            auto pick = [&]() { return rng() % 2 ? rng() % (NUM_ROWS / 10) : rng() % NUM_ROWS; };
+            while (!stop) {
+                std::vector<std::pair<int, bool>> ops;
+                for (int i = 0; i < OPS_PER_TXN; i++) {
+                    ops.emplace_back(pick(), i % 2 == 0);
+                }
+                while (true) {
+                    Transaction *txn;
+                    {
+                        std::lock_guard<std::mutex> lock(txns_latch);
+                        txn = begin();
+                    }
+                    try {
+                        for (auto &[row, write] : ops) {
+                            if (write) {
+                                lock_manager_->lock_exclusive_on_record(txn, rid(row), TAB_FD);
+                            } else {
+                                lock_manager_->lock_shared_on_record(txn, rid(row), TAB_FD);
+                            }
+                        }
+                        // 持有X锁时非原子地修改计数器，锁不互斥时会丢失修改
+                        for (auto &[row, write] : ops) {
+                            if (write) {
+                                counters[row] = counters[row] + 1;
+                                committed_writes++;
+                            }
+                        }
+                        txn_manager_->commit(txn, nullptr);
+                    } catch (TransactionAbortException &) {
+                        txn_manager_->abort(txn, nullptr);
+                        aborts++;
+                        continue;
+                    }
+                    break;
+                }
+                commits++;
+            }
+        };
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_threads; i++) {
+            threads.emplace_back(worker, i);
+        }
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_GT(commits, 0);
+        EXPECT_EQ(std::accumulate(counters.begin(), counters.end(), 0LL), committed_writes);
+        for (auto &bucket : lock_manager_->buckets_) {
+            EXPECT_TRUE(bucket.lock_table_.empty());
+        }
+        txns_.clear();
+        return ContentionResult{.seconds = secs,
+                                .commits_per_sec = commits / secs,
+                                .aborts = aborts,
+                                .abort_rate = (double)aborts / (commits + aborts)};
+    }
+};
+
+TEST_F(LockManagerTest, CompatibilityTest) {
+    auto t1 = begin(), t2 = begin();
+    // 行级锁先申请表级意向锁
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t1, rid(0), TAB_FD));
+    EXPECT_EQ(t1->get_lock_set()->size(), 2);
+    EXPECT_EQ(t1->get_state(), TransactionState::GROWING);
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t2, rid(1), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t2, rid(0), TAB_FD));
+    // 重复申请已经持有的锁
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t1, rid(0), TAB_FD));
+    EXPECT_EQ(t1->get_lock_set()->size(), 2);
+
+    // t1持有IS，t2持有IX，表级S与IX冲突，no-wait立即回滚
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_shared_on_table(t1, TAB_FD); }), AbortReason::DEADLOCK_PREVENTION);
+    EXPECT_EQ(t1->get_state(), TransactionState::ABORTED);
+    txn_manager_->abort(t1, nullptr);
+    EXPECT_TRUE(t1->get_lock_set()->empty());
+
+    // t2的S升级为X，IX升级之后与S合并为SIX
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t2, rid(0), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_shared_on_table(t2, TAB_FD));
+    auto t3 = begin();
+    EXPECT_TRUE(lock_manager_->lock_IS_on_table(t3, TAB_FD));
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_IX_on_table(t3, TAB_FD); }), AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(t3, nullptr);
+    auto t4 = begin();
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_shared_on_record(t4, rid(0), TAB_FD); }),
+              AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(t4, nullptr);
+
+    // 两阶段封锁：释放锁之后不能再加锁
+    EXPECT_TRUE(lock_manager_->unlock(t2, LockDataId(TAB_FD, rid(1), LockDataType::RECORD)));
+    EXPECT_EQ(t2->get_state(), TransactionState::SHRINKING);
+    EXPECT_FALSE(lock_manager_->unlock(t2, LockDataId(TAB_FD, rid(1), LockDataType::RECORD)));
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_shared_on_record(t2, rid(2), TAB_FD); }),
+              AbortReason::LOCK_ON_SHIRINKING);
+    txn_manager_->abort(t2, nullptr);
+
+    // 所有锁都释放之后锁表为空
+    auto t5 = begin();
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_table(t5, TAB_FD));
+    txn_manager_->commit(t5, nullptr);
+    EXPECT_EQ(t5->get_state(), TransactionState::COMMITTED);
+    for (auto &bucket : lock_manager_->buckets_) {
+        EXPECT_TRUE(bucket.lock_table_.empty());
+    }
+}
+
+TEST_F(LockManagerTest, WaitDieTest) {
+    set_policy(DeadlockPolicy::WAIT_DIE);
+    auto old_txn = begin(), young_txn = begin();
+    // 年轻事务遇到老事务持有的锁时回滚自己
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(old_txn, rid(0), TAB_FD));
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_shared_on_record(young_txn, rid(0), TAB_FD); }),
+              AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(young_txn, nullptr);
+
+    // 老事务等待年轻事务释放锁
+    young_txn = begin();
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(young_txn, rid(1), TAB_FD));
+    std::atomic<bool> granted = false;
+    std::thread waiter([&]() {
+        lock_manager_->lock_exclusive_on_record(old_txn, rid(1), TAB_FD);
+        granted = true;
+    });
+    wait_blocked();
+    EXPECT_FALSE(granted);
+    // 排在老事务后面的年轻事务回滚
+    auto younger_txn = begin();
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_shared_on_record(younger_txn, rid(1), TAB_FD); }),
+              AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(younger_txn, nullptr);
+    txn_manager_->commit(young_txn, nullptr);
+    waiter.join();
+    EXPECT_TRUE(granted);
+    txn_manager_->commit(old_txn, nullptr);
+
+    // 两个事务都持有S锁时同时升级，后升级的事务回滚
+    auto t1 = begin(), t2 = begin();
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t1, rid(2), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t2, rid(2), TAB_FD));
+    std::thread upgrader([&]() { lock_manager_->lock_exclusive_on_record(t1, rid(2), TAB_FD); });
+    wait_blocked();
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_exclusive_on_record(t2, rid(2), TAB_FD); }),
+              AbortReason::UPGRADE_CONFLICT);
+    txn_manager_->abort(t2, nullptr);
+    upgrader.join();
+    txn_manager_->commit(t1, nullptr);
+}
+
+TEST_F(LockManagerTest, WoundWaitTest) {
+    set_policy(DeadlockPolicy::WOUND_WAIT);
+    // 年轻事务等待老事务
+    auto old_txn = begin(), young_txn = begin();
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(old_txn, rid(0), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(young_txn, rid(1), TAB_FD));
+    std::optional<AbortReason> young_result;
+    std::thread young([&]() {
+        young_result = try_lock([&]() { lock_manager_->lock_exclusive_on_record(young_txn, rid(0), TAB_FD); });
+        // 被wound之后回滚，释放rid(1)上的锁
+        txn_manager_->abort(young_txn, nullptr);
+    });
+    wait_blocked();
+    // 老事务申请年轻事务持有的锁，wound正在等待的年轻事务，否则两个事务死锁
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(old_txn, rid(1), TAB_FD));
+    young.join();
+    EXPECT_EQ(young_result, AbortReason::DEADLOCK_PREVENTION);
+    EXPECT_EQ(young_txn->get_state(), TransactionState::ABORTED);
+
+    // 没有在等待的年轻事务被wound之后，下一次加锁或者提交时发现自己已经回滚
+    auto t = begin();
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t, rid(2), TAB_FD));
+    std::thread old([&]() { lock_manager_->lock_exclusive_on_record(old_txn, rid(2), TAB_FD); });
+    wait_blocked();
+    EXPECT_EQ(t->get_state(), TransactionState::ABORTED);
+    EXPECT_EQ(try_lock([&]() { txn_manager_->commit(t, nullptr); }), AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(t, nullptr);
+    old.join();
+    txn_manager_->commit(old_txn, nullptr);
+}
+
+/**
+ * 多线程争用下各种冲突处理策略的吞吐量和回滚率
+ */
+TEST_F(LockManagerTest, ContentionBenchmark) {
+    std::cout << "policy      threads  commits/s  abort rate" << std::endl;
+    for (auto policy : {DeadlockPolicy::NO_WAIT, DeadlockPolicy::WAIT_DIE, DeadlockPolicy::WOUND_WAIT}) {
+        for (int num_threads : {1, 4, 8, 16}) {
+            set_policy(policy);
+            auto result = run_contention(num_threads);
+            std::cout << std::left << std::setw(12) << policy_name(policy) << std::right << std::setw(7) << num_threads
+                      << std::setw(11) << (long long)result.commits_per_sec << std::setw(12) << result.abort_rate
+                      << std::endl;
+        }
+    }
+}
+
+TEST_F(LockManagerTest, DeadlockDetectionTest) {
+    set_policy(DeadlockPolicy::DETECTION);
+    // 检测线程不参与，直接调用detect_deadlocks
+    lock_manager_->stop_cycle_detection();
+    auto t1 = begin(), t2 = begin(), t3 = begin();
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t1, rid(1), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t2, rid(2), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t3, rid(3), TAB_FD));
+    EXPECT_EQ(lock_manager_->detect_deadlocks(), 0);
+
+    // t1 -> t2 -> t3 -> t1构成环路，回滚最年轻的t3
+    std::optional<AbortReason> results[3];
+    std::vector<std::thread> threads;
+    Transaction *txns[3] = {t1, t2, t3};
+    for (int i = 0; i < 3; i++) {
+        threads.emplace_back([&, i]() {
+            results[i] = try_lock([&]() { lock_manager_->lock_exclusive_on_record(txns[i], rid((i + 1) % 3 + 1), TAB_FD); });
+            if (results[i].has_value()) {
+                txn_manager_->abort(txns[i], nullptr);
+            }
+        });
+        wait_blocked();
+    }
+    EXPECT_EQ(lock_manager_->detect_deadlocks(), 1);
+    threads[2].join();
+    EXPECT_EQ(results[2], AbortReason::DEADLOCK_DETECTION);
+    // t3释放锁之后t2获得rid(3)，t1仍然等待t2
+    threads[1].join();
+    EXPECT_EQ(results[1], std::nullopt);
+    EXPECT_EQ(lock_manager_->detect_deadlocks(), 0);
+    txn_manager_->commit(t2, nullptr);
+    threads[0].join();
+    EXPECT_EQ(results[0], std::nullopt);
+    txn_manager_->commit(t1, nullptr);
+
+    // 后台检测线程运行。两个事务同时从S锁升级为X锁会构成环路，后升级的事务不等待，立即回滚
+    set_policy(DeadlockPolicy::DETECTION);
+    auto t4 = begin(), t5 = begin();
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t4, rid(4), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t5, rid(4), TAB_FD));
+    std::thread upgrader([&]() { lock_manager_->lock_exclusive_on_record(t4, rid(4), TAB_FD); });
+    wait_blocked();
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_exclusive_on_record(t5, rid(4), TAB_FD); }),
+              AbortReason::UPGRADE_CONFLICT);
+    txn_manager_->abort(t5, nullptr);
+    upgrader.join();
+    txn_manager_->commit(t4, nullptr);
+
+    // 检测线程打破环路
+    auto t6 = begin(), t7 = begin();
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t6, rid(6), TAB_FD));
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t7, rid(7), TAB_FD));
+    std::optional<AbortReason> t7_result;
+    std::thread young([&]() {
+        t7_result = try_lock([&]() { lock_manager_->lock_exclusive_on_record(t7, rid(6), TAB_FD); });
+        txn_manager_->abort(t7, nullptr);
+    });
+    wait_blocked();
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t6, rid(7), TAB_FD));
+    young.join();
+    EXPECT_EQ(t7_result, AbortReason::DEADLOCK_DETECTION);
+    txn_manager_->commit(t6, nullptr);
+    auto stats = lock_manager_->get_detection_stats();
+    EXPECT_GT(stats.num_runs, 0u);
+    EXPECT_EQ(stats.num_victims, 1);
+}
+
+/**
+ * 死锁检测与no-wait的对比，以及检测间隔对吞吐量和检测线程CPU开销的影响。
+ * 检测间隔越短，陷入死锁的事务等待的时间越短，但是检测线程每次都要锁住所有分区
+ */
+TEST_F(LockManagerTest, DeadlockDetectionBenchmark) {
+    auto saved_interval = cycle_detection_interval;
+    std::cout << "policy      interval  threads  commits/s  abort rate  runs  detector cpu" << std::endl;
+    for (int num_threads : {4, 16}) {
+        set_policy(DeadlockPolicy::NO_WAIT);
+        auto result = run_contention(num_threads);
+        std::cout << std::left << std::setw(12) << "no-wait" << std::right << std::setw(8) << "-" << std::setw(9)
+                  << num_threads << std::setw(11) << (long long)result.commits_per_sec << std::setw(12)
+                  << result.abort_rate << std::endl;
+        for (int interval : {1, 10, 50}) {
+            cycle_detection_interval = std::chrono::milliseconds(interval);
+            set_policy(DeadlockPolicy::DETECTION);
+            auto result = run_contention(num_threads);
+            auto stats = lock_manager_->get_detection_stats();
+            double cpu = std::chrono::duration<double>(stats.cpu_time).count() / result.seconds;
+            std::cout << std::left << std::setw(12) << "detection" << std::right << std::setw(6) << interval << "ms"
+                      << std::setw(9) << num_threads << std::setw(11) << (long long)result.commits_per_sec
+                      << std::setw(12) << result.abort_rate << std::setw(6) << stats.num_runs << std::setw(13)
+                      << cpu * 100 << "%" << std::endl;
+            EXPECT_LE(stats.num_victims, (size_t)result.aborts);
+        }
+    }
+    cycle_detection_interval = saved_interval;
+}
+
+TEST_F(LockManagerTest, LockEscalationTest) {
+    lock_manager_->set_escalation_threshold(10);
+    // 第10个行锁之后升级为表级X锁，释放所有行锁，之后的行不再加锁
+    auto t1 = begin();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t1, rid(i), TAB_FD));
+    }
+    EXPECT_EQ(t1->get_lock_set()->size(), 1);
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 1);
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t1, rid(10), TAB_FD));
+    EXPECT_EQ(t1->get_lock_set()->size(), 1);
+    auto t2 = begin();
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_shared_on_record(t2, rid(100), TAB_FD); }),
+              AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(t2, nullptr);
+    txn_manager_->commit(t1, nullptr);
+    auto stats = lock_manager_->get_escalation_stats();
+    EXPECT_EQ(stats.num_escalations, 1);
+    EXPECT_EQ(stats.num_released_locks, 10);
+
+    // 只有行级S锁时升级为表级S锁，其他事务仍然可以读
+    auto t3 = begin(), t4 = begin();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(lock_manager_->lock_shared_on_record(t3, rid(i), TAB_FD));
+    }
+    EXPECT_EQ(t3->get_lock_set()->size(), 1);
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t4, rid(0), TAB_FD));
+    EXPECT_EQ(try_lock([&]() { lock_manager_->lock_exclusive_on_record(t4, rid(0), TAB_FD); }),
+              AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(t4, nullptr);
+    txn_manager_->commit(t3, nullptr);
+
+    // 其他事务持有表级意向锁时不能升级，保留行锁，行锁个数达到阈值的下一个整数倍时再尝试
+    auto t5 = begin(), t6 = begin();
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t5, rid(100), TAB_FD));
+    for (int i = 0; i < 20; i++) {
+        EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t6, rid(i), TAB_FD));
+    }
+    EXPECT_EQ(t6->get_lock_set()->size(), 21);
+    EXPECT_EQ(lock_manager_->get_escalation_stats().num_failures, 2);
+    txn_manager_->commit(t5, nullptr);
+    for (int i = 20; i < 30; i++) {
+        EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t6, rid(i), TAB_FD));
+    }
+    EXPECT_EQ(t6->get_lock_set()->size(), 1);
+    txn_manager_->commit(t6, nullptr);
+    stats = lock_manager_->get_escalation_stats();
+    EXPECT_EQ(stats.num_escalations, 3);
+    EXPECT_EQ(stats.num_released_locks, 50);
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 0);
+}
+
+TEST_F(LockManagerTest, TransactionPoolTest) {
+    // 交还的事务从全局事务表中删除，放回事务池，同一线程的下一个事务复用该对象
+    auto t1 = txn_manager_->begin(nullptr, nullptr);
+    txn_id_t id1 = t1->get_transaction_id();
+    EXPECT_EQ(txn_manager_->get_transaction(id1), t1);
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t1, rid(0), TAB_FD));
+    t1->set_prev_lsn(3);
+    txn_manager_->commit(t1, nullptr);
+    txn_manager_->recycle(t1);
+    EXPECT_EQ(txn_manager_->get_transaction(id1), nullptr);
+    EXPECT_EQ(txn_manager_->get_pool_size(), 1);
+    auto t2 = txn_manager_->begin(nullptr, nullptr);
+    EXPECT_EQ(t2, t1);
+    EXPECT_GT(t2->get_transaction_id(), id1);
+    EXPECT_EQ(t2->get_state(), TransactionState::DEFAULT);
+    EXPECT_TRUE(t2->get_lock_set()->empty());
+    EXPECT_TRUE(t2->get_row_lock_counts().empty());
+    EXPECT_EQ(t2->get_prev_lsn(), INVALID_LSN);
+    EXPECT_EQ(txn_manager_->get_pool_size(), 0);
+
+    // 其他线程也可以通过事务ID查找事务
+    std::thread([&]() { EXPECT_EQ(txn_manager_->get_transaction(t2->get_transaction_id()), t2); }).join();
+    txn_manager_->abort(t2, nullptr);
+    txn_manager_->recycle(t2);
+    EXPECT_EQ(txn_manager_->get_num_transactions(), 0);
+}
+
+/**
+ * 多个线程并发地开始和提交空事务，对比交还事务对象（复用事务池中的对象）与不交还（每次分配新对象）的吞吐量，
+ * 以及每个事务留在堆上的内存
+ */
+TEST_F(LockManagerTest, BeginCommitBenchmark) {
+    const int txns_per_thread = 20000;
+    std::cout << "recycle  threads     txns/s  heap(B)/txn" << std::endl;
+    for (bool recycle : {false, true}) {
+        for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+            set_policy(DeadlockPolicy::NO_WAIT);
+            std::vector<std::vector<Transaction *>> leaked(num_threads);
+            for (auto &txns : leaked) {
+                txns.reserve(recycle ? 0 : txns_per_thread);
+            }
+            size_t heap_before = mallinfo2().uordblks;
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (int i = 0; i < num_threads; i++) {
+                threads.emplace_back([&, i]() {
+                    for (int j = 0; j < txns_per_thread; j++) {
+                        Transaction *txn = txn_manager_->begin(nullptr, nullptr);
+                        txn_manager_->commit(txn, nullptr);
+                        if (recycle) {
+                            txn_manager_->recycle(txn);
+                        } else {
+                            leaked[i].push_back(txn);
+                        }
+                    }
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            long heap_bytes =
+                ((long)mallinfo2().uordblks - (long)heap_before) / (num_threads * txns_per_thread);
+            std::cout << std::left << std::setw(9) << (recycle ? "on" : "off") << std::right << std::setw(7)
+                      << num_threads << std::setw(11) << (long long)(num_threads * txns_per_thread / secs)
+                      << std::setw(13) << heap_bytes << std::endl;
+            for (auto &txns : leaked) {
+                for (auto txn : txns) {
+                    delete txn;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(LockManagerTest, EarlyLockReleaseTest) {
+    auto record = LockDataId(TAB_FD, rid(0), LockDataType::RECORD), table = LockDataId(TAB_FD, LockDataType::TABLE);
+    // 提前释放的写锁记录释放者的提交日志lsn，加锁队列为空也保留在锁表中，之后获得锁的事务依赖于它
+    auto t1 = begin();
+    EXPECT_TRUE(lock_manager_->lock_exclusive_on_record(t1, rid(0), TAB_FD));
+    EXPECT_TRUE(lock_manager_->unlock(t1, record, 5));
+    EXPECT_TRUE(lock_manager_->unlock(t1, table, 5));
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 2);
+    auto t2 = begin();
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t2, rid(0), TAB_FD));
+    EXPECT_EQ(t2->get_dependency_lsn(), 5);
+
+    // 提前释放读锁不产生依赖：t4只依赖于t1释放的表级IX锁
+    auto t3 = begin();
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t3, rid(1), TAB_FD));
+    EXPECT_TRUE(lock_manager_->unlock(t3, LockDataId(TAB_FD, rid(1), LockDataType::RECORD), 9));
+    EXPECT_TRUE(lock_manager_->unlock(t3, table, 9));
+    auto t4 = begin();
+    EXPECT_TRUE(lock_manager_->lock_shared_on_record(t4, rid(1), TAB_FD));
+    EXPECT_EQ(t4->get_dependency_lsn(), 5);
+    txn_manager_->commit(t2, nullptr);
+    txn_manager_->commit(t4, nullptr);
+
+    // 提交日志持久化之后清除
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 2);
+    lock_manager_->clear_release_lsn(record, 4);
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 2);
+    lock_manager_->clear_release_lsn(record, 5);
+    lock_manager_->clear_release_lsn(table, 5);
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 0);
+}
+
+/**
+ * 大批量更新：一个事务给num_rows行加X锁然后提交，对比不同锁升级阈值下加锁和提交的耗时、
+ * 锁集和锁表的大小，以及加锁期间堆内存的增长
+ */
+TEST_F(LockManagerTest, LockEscalationBenchmark) {
+    std::cout << "rows     threshold  latency(ms)  lock set  lock table  heap(KB)" << std::endl;
+    for (int num_rows : {10000, 100000}) {
+        for (size_t threshold : {(size_t)0, LockManager::DEFAULT_ESCALATION_THRESHOLD, (size_t)1000}) {
+            lock_manager_->set_escalation_threshold(threshold);
+            size_t heap_before = mallinfo2().uordblks;
+            auto start = std::chrono::steady_clock::now();
+            auto txn = begin();
+            for (int i = 0; i < num_rows; i++) {
+                lock_manager_->lock_exclusive_on_record(txn, Rid{.page_no = 1 + i / 100, .slot_no = i % 100}, TAB_FD);
+            }
+            size_t lock_set_size = txn->get_lock_set()->size();
+            size_t lock_table_size = lock_manager_->get_lock_table_size();
+            long heap_kb = ((long)mallinfo2().uordblks - (long)heap_before) / 1024;
+            txn_manager_->commit(txn, nullptr);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << std::left << std::setw(9) << num_rows << std::setw(11)
+                      << (threshold == 0 ? std::string("off") : std::to_string(threshold)) << std::right
+                      << std::setw(11) << ms << std::setw(10) << lock_set_size << std::setw(12) << lock_table_size
+                      << std::setw(10) << heap_kb << std::endl;
+            if (threshold == 0) {
+                EXPECT_EQ(lock_set_size, num_rows + 1);
+            } else {
+                EXPECT_LE(lock_set_size, threshold);
+            }
+            EXPECT_EQ(lock_manager_->get_lock_table_size(), 0);
+        }
+    }
+}
+
+/**
+ * 账户表t(name, id, balance)上的MVCC测试，第id个账户保存在row_rid(id)，id上有B+树索引。
+ * 读写都通过执行算子完成，Context中的事务管理器决定使用两阶段封锁还是MVCC
+ */
+class MvccTest : public BitmapScanTest {
+   public:
+    static constexpr int NUM_ACCOUNTS = 1000;
+    static constexpr int INIT_BALANCE = 1000;
+    static constexpr int ID_OFFSET = 8;
+    static constexpr int BALANCE_OFFSET = 12;
+
+    struct Account {
+        Rid rid;
+        int id;
+        int balance;
+    };
+
+    std::unique_ptr<LockManager> lock_manager_;
+    std::unique_ptr<TransactionManager> txn_manager_;
+    std::mutex txns_latch_;
+    std::vector<std::unique_ptr<Transaction>> txns_;
+
+    void TearDown() override {
+        // 先停止垃圾回收线程，再释放事务
+        txn_manager_.reset();
+        txns_.clear();
+        BitmapScanTest::TearDown();
+    }
+
+    void load_accounts() {
+        create_table("t", {{"name", TYPE_STRING, ID_OFFSET}, {"id", TYPE_INT, 4}, {"balance", TYPE_INT, 4}});
+        RmFileHandle *fh = sm_manager_->fhs_.at("t").get();
+        per_page_ = fh->file_hdr_.num_records_per_page;
+        std::vector<char> rec(fh->file_hdr_.record_size, 0);
+        for (int id = 0; id < NUM_ACCOUNTS; id++) {
+            int vals[2] = {id, INIT_BALANCE};
+            memcpy(rec.data(), "acct", 4);
+            memcpy(rec.data() + ID_OFFSET, vals, sizeof(vals));
+            Rid rid = fh->insert_record(rec.data(), nullptr);
+            assert(rid == row_rid(id));
+        }
+
+        add_index("t", {"id"});
+        auto &cols = sm_manager_->db_.get_table("t").indexes.back().cols;
+        if (ix_manager_->exists("t", cols)) {
+            ix_manager_->destroy_index("t", cols);
+        }
+        ix_manager_->create_index("t", cols);
+        auto ih = ix_manager_->open_index("t", cols);
+        for (int id = 0; id < NUM_ACCOUNTS; id++) {
+            ih->insert_entry((const char *)&id, row_rid(id), nullptr);
+        }
+        sm_manager_->ihs_.emplace(ix_manager_->get_index_name("t", cols), std::move(ih));
+    }
+
+    void set_mode(ConcurrencyMode mode, DeadlockPolicy policy = DeadlockPolicy::NO_WAIT) {
+        txn_manager_.reset();
+        lock_manager_ = std::make_unique<LockManager>(policy);
+        txn_manager_ = std::make_unique<TransactionManager>(lock_manager_.get(), sm_manager_.get(), mode);
+    }
+
+    Transaction *begin() {
+        std::lock_guard<std::mutex> lock(txns_latch_);
+        txns_.emplace_back(txn_manager_->begin(nullptr, nullptr));
+        return txns_.back().get();
+    }
+
+    Transaction *begin_read_only() {
+        std::lock_guard<std::mutex> lock(txns_latch_);
+        txns_.emplace_back(txn_manager_->begin_read_only(nullptr));
+        return txns_.back().get();
+    }
+
+    Context context(Transaction *txn) {
+        Context ctx(lock_manager_.get(), nullptr, txn);
+        ctx.txn_mgr_ = txn_manager_.get();
+        return ctx;
+    }
+
+    // 用id上的索引扫描txn能看到的账户
+    std::vector<Account> scan(Transaction *txn, const std::vector<Condition> &conds) {
+        auto ctx = context(txn);
+        IndexScanExecutor executor(sm_manager_.get(), "t", conds, {"id"}, &ctx);
+        std::vector<Account> accounts;
+        for (executor.beginTuple(); !executor.is_end(); executor.nextTuple()) {
+            auto rec = executor.Next();
+            accounts.push_back({executor.rid(), *(int *)(rec->data + ID_OFFSET), *(int *)(rec->data + BALANCE_OFFSET)});
+        }
+        return accounts;
+    }
+
+    std::optional<Account> find(Transaction *txn, int id) {
+        auto accounts = scan(txn, {make_cond("id", OP_EQ, id)});
+        EXPECT_LE(accounts.size(), 1u);
+        return accounts.empty() ? std::nullopt : std::optional<Account>(accounts[0]);
+    }
+
+    std::optional<int> balance_of(Transaction *txn, int id) {
+        auto account = find(txn, id);
+        return account.has_value() ? std::optional<int>(account->balance) : std::nullopt;
+    }
+
+    void update(Transaction *txn, int id, const std::string &col_name, int val) {
+        auto account = find(txn, id);
+        ASSERT_TRUE(account.has_value());
+        SetClause set_clause{.lhs = {.tab_name = "t", .col_name = col_name}};
+        set_clause.rhs.set_int(val);
+        auto ctx = context(txn);
+        UpdateExecutor executor(sm_manager_.get(), "t", {set_clause}, {}, {account->rid}, &ctx);
+        executor.Next();
+    }
+
+    // 与Portal中的update相同：扫描满足条件的记录（可以使用escrow锁时加escrow锁而不是S锁），然后执行 col = col + delta
+    void increment(Transaction *txn, int id, const std::string &col_name, int delta) {
+        SetClause set_clause{.lhs = {.tab_name = "t", .col_name = col_name}, .is_incr = true};
+        set_clause.rhs.set_int(delta);
+        std::vector<Condition> conds = {make_cond("id", OP_EQ, id)};
+        auto ctx = context(txn);
+        ctx.escrow_ = UseEscrow(&ctx, sm_manager_->db_.get_table("t"), {set_clause}, conds);
+        IndexScanExecutor scan(sm_manager_.get(), "t", conds, {"id"}, &ctx);
+        std::vector<Rid> rids;
+        for (scan.beginTuple(); !scan.is_end(); scan.nextTuple()) {
+            rids.push_back(scan.rid());
+        }
+        ctx.escrow_ = false;
+        UpdateExecutor executor(sm_manager_.get(), "t", {set_clause}, conds, rids, &ctx);
+        executor.Next();
+    }
+
+    void remove(Transaction *txn, int id) {
+        auto account = find(txn, id);
+        ASSERT_TRUE(account.has_value());
+        auto ctx = context(txn);
+        DeleteExecutor executor(sm_manager_.get(), "t", {}, {account->rid}, &ctx);
+        executor.Next();
+    }
+
+    Rid insert(Transaction *txn, int id, int balance) {
+        std::vector<Value> values(3);
+        values[0].set_str("acct");
+        values[1].set_int(id);
+        values[2].set_int(balance);
+        auto ctx = context(txn);
+        InsertExecutor executor(sm_manager_.get(), "t", values, &ctx);
+        executor.Next();
+        return executor.rid();
+    }
+
+    static std::optional<AbortReason> try_write(const std::function<void()> &write) {
+        try {
+            write();
+        } catch (TransactionAbortException &e) {
+            return e.GetAbortReason();
+        }
+        return std::nullopt;
+    }
+
+    struct MixedResult {
+        double transfers_per_sec;
+        double transfer_abort_rate;
+        double scans_per_sec;
+        double scan_abort_rate;
+        long long scan_aborts;
+    };
+
+    /**
+     * 读写混合负载：写事务在两个随机账户之间转账，读事务用索引扫描读取全部账户并求和。
+     * 每个提交的读事务都应该看到所有账户，并且余额之和不变
+     */
+    MixedResult run_mixed(int num_writers, int num_readers) {
+        const auto duration = std::chrono::milliseconds(500);
+        std::atomic<long long> transfers = 0, transfer_aborts = 0, scans = 0, scan_aborts = 0, inconsistent = 0;
+        std::atomic<bool> stop = false;
+        auto run_txn = [&](auto &&body) {
+            Transaction *txn = begin();
+            try {
+                body(txn);
+                txn_manager_->commit(txn, nullptr);
+            } catch (TransactionAbortException &) {
+                txn_manager_->abort(txn, nullptr);
+                return false;
+            }
+            return true;
+        };
+        auto writer = [&](int seed) {
+            std::mt19937 rng(seed);
+            while (!stop) {
+                int from = rng() % NUM_ACCOUNTS, to = rng() % NUM_ACCOUNTS, amount = rng() % 100;
+                if (from == to) {
+                    continue;
+                }
+                bool committed = run_txn([&](Transaction *txn) {
+                    int from_balance = *balance_of(txn, from), to_balance = *balance_of(txn, to);
+                    update(txn, from, "balance", from_balance - amount);
+                    update(txn, to, "balance", to_balance + amount);
+                });
+                (committed ? transfers : transfer_aborts)++;
+            }
+        };
+        auto reader = [&]() {
+            while (!stop) {
+                std::vector<Account> accounts;
+                bool committed = run_txn([&](Transaction *txn) { accounts = scan(txn, {make_cond("id", OP_GE, 0)}); });
+                if (!committed) {
+                    scan_aborts++;
+                    continue;
+                }
+                long long sum = 0;
+                for (auto &account : accounts) {
+                    sum += account.balance;
+                }
+                if (accounts.size() != NUM_ACCOUNTS || sum != (long long)NUM_ACCOUNTS * INIT_BALANCE) {
+                    inconsistent++;
+                }
+                scans++;
+            }
+        };
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_writers; i++) {
+            threads.emplace_back(writer, i);
+        }
+        for (int i = 0; i < num_readers; i++) {
+            threads.emplace_back(reader);
+        }
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        EXPECT_EQ(inconsistent, 0);
+        return MixedResult{.transfers_per_sec = transfers / secs,
+                           .transfer_abort_rate = (double)transfer_aborts / std::max(1LL, transfers + transfer_aborts),
+                           .scans_per_sec = scans / secs,
+                           .scan_abort_rate = (double)scan_aborts / std::max(1LL, scans + scan_aborts),
+                           .scan_aborts = scan_aborts};
+    }
+};
+
+TEST_F(MvccTest, ReconstructTupleTest) {
+    TabMeta schema;
+    for (int i = 0; i < 3; i++) {
+        schema.cols.push_back(ColMeta{.tab_name = "t", .name = "c" + std::to_string(i), .type = TYPE_INT, .len = 4,
+                                      .offset = i * 4, .index = false});
+    }
+    auto make_tuple = [](int a, int b, int c) {
+        RmRecord tuple(12);
+        int vals[3] = {a, b, c};
+        memcpy(tuple.data, vals, sizeof(vals));
+        return tuple;
+    };
+    auto make_log = [](std::vector<bool> modified, std::vector<int> vals, bool is_deleted = false) {
+        UndoLog log;
+        log.is_deleted_ = is_deleted;
+        log.modified_fields_ = std::move(modified);
+        for (int val : vals) {
+            Value value;
+            value.set_int(val);
+            log.tuple_.push_back(value);
+        }
+        return log;
+    };
+    auto same = [](const std::optional<RmRecord> &tuple, const RmRecord &expected) {
+        return tuple.has_value() && memcmp(tuple->data, expected.data, 12) == 0;
+    };
+    RmRecord base = make_tuple(1, 2, 3);
+    TupleMeta meta{10, false};
+    EXPECT_TRUE(same(ReconstructTuple(&schema, base, meta, {}), base));
+    // 撤销日志从新到旧应用，较老的日志覆盖较新的日志中的同一个字段
+    std::vector<UndoLog> logs = {make_log({true, false, true}, {10, 30}), make_log({true, true, false}, {100, 200})};
+    EXPECT_TRUE(same(ReconstructTuple(&schema, base, meta, {logs[0]}), make_tuple(10, 2, 30)));
+    EXPECT_TRUE(same(ReconstructTuple(&schema, base, meta, logs), make_tuple(100, 200, 30)));
+    // 删除标记：表堆中已经删除的元组恢复出删除之前的版本，更老的删除标记表示记录还不存在
+    EXPECT_FALSE(ReconstructTuple(&schema, base, TupleMeta{10, true}, {}).has_value());
+    EXPECT_TRUE(same(ReconstructTuple(&schema, base, TupleMeta{10, true}, {make_log({false, false, false}, {})}), base));
+    EXPECT_FALSE(ReconstructTuple(&schema, base, meta, {logs[0], make_log({false, false, false}, {}, true)}).has_value());
+}
+
+TEST_F(MvccTest, SnapshotReadTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::MVCC);
+    auto t1 = begin();
+    auto t2 = begin();
+    update(t2, 5, "balance", 500);
+    EXPECT_EQ(balance_of(t2, 5), 500);
+    EXPECT_EQ(balance_of(t1, 5), INIT_BALANCE);    // 未提交的修改不可见
+    txn_manager_->commit(t2, nullptr);
+    EXPECT_EQ(balance_of(t1, 5), INIT_BALANCE);    // 快照之后提交的修改不可见
+    auto t3 = begin();
+    EXPECT_EQ(balance_of(t3, 5), 500);
+
+    auto t4 = begin();
+    remove(t4, 5);
+    EXPECT_FALSE(balance_of(t4, 5).has_value());
+    EXPECT_EQ(balance_of(t3, 5), 500);
+    txn_manager_->commit(t4, nullptr);
+    EXPECT_EQ(balance_of(t3, 5), 500);
+    EXPECT_EQ(balance_of(t1, 5), INIT_BALANCE);
+    auto t5 = begin();
+    EXPECT_FALSE(balance_of(t5, 5).has_value());
+
+    auto t6 = begin();
+    insert(t6, NUM_ACCOUNTS, 7);
+    EXPECT_EQ(balance_of(t6, NUM_ACCOUNTS), 7);
+    EXPECT_FALSE(balance_of(t5, NUM_ACCOUNTS).has_value());
+    txn_manager_->commit(t6, nullptr);
+    EXPECT_FALSE(balance_of(t5, NUM_ACCOUNTS).has_value());
+    EXPECT_EQ(balance_of(begin(), NUM_ACCOUNTS), 7);
+    EXPECT_EQ(scan(t1, {make_cond("id", OP_GE, 0)}).size(), NUM_ACCOUNTS);
+    EXPECT_EQ(scan(t5, {make_cond("id", OP_GE, 0)}).size(), NUM_ACCOUNTS - 1);
+
+    // 水印是最老的正在运行的事务的读时间戳
+    EXPECT_EQ(txn_manager_->GetWatermark(), t1->get_read_ts());
+    for (auto txn : {t1, t3, t5}) {
+        txn_manager_->commit(txn, nullptr);
+    }
+    txn_manager_->commit(txns_.back().get(), nullptr);
+    EXPECT_EQ(txn_manager_->GetWatermark(), txn_manager_->GetLastCommitTs());
+}
+
+TEST_F(MvccTest, IndexKeyUpdateTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::MVCC);
+    auto t1 = begin();
+    auto t2 = begin();
+    update(t2, 7, "id", 5000);
+    txn_manager_->commit(t2, nullptr);
+    auto t3 = begin();
+    // 旧的索引项保留给t1，每条记录在范围扫描中只输出一次
+    EXPECT_TRUE(find(t1, 7).has_value());
+    EXPECT_FALSE(find(t1, 5000).has_value());
+    EXPECT_FALSE(find(t3, 7).has_value());
+    EXPECT_TRUE(find(t3, 5000).has_value());
+    EXPECT_EQ(scan(t1, {make_cond("id", OP_GE, 0)}).size(), NUM_ACCOUNTS);
+    EXPECT_EQ(scan(t3, {make_cond("id", OP_GE, 0)}).size(), NUM_ACCOUNTS);
+}
+
+TEST_F(MvccTest, WriteWriteConflictTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::MVCC);
+    // 其他事务未提交的修改
+    auto t1 = begin();
+    auto t2 = begin();
+    update(t2, 1, "balance", 1);
+    EXPECT_EQ(try_write([&]() { update(t1, 1, "balance", 2); }), AbortReason::WRITE_WRITE_CONFLICT);
+    EXPECT_EQ(t1->get_state(), TransactionState::ABORTED);
+    txn_manager_->abort(t1, nullptr);
+    // 快照之后提交的修改
+    auto t3 = begin();
+    txn_manager_->commit(t2, nullptr);
+    EXPECT_EQ(try_write([&]() { update(t3, 1, "balance", 3); }), AbortReason::WRITE_WRITE_CONFLICT);
+    txn_manager_->abort(t3, nullptr);
+    EXPECT_EQ(try_write([&]() { remove(begin(), 1); }), std::nullopt);
+    // 同一个事务可以多次修改同一条记录
+    auto t4 = begin();
+    update(t4, 2, "balance", 4);
+    update(t4, 2, "balance", 5);
+    EXPECT_EQ(balance_of(t4, 2), 5);
+    txn_manager_->commit(t4, nullptr);
+    EXPECT_EQ(balance_of(begin(), 2), 5);
+}
+
+TEST_F(MvccTest, AbortTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::MVCC);
+    auto t1 = begin();
+    update(t1, 3, "balance", 300);
+    txn_manager_->commit(t1, nullptr);
+    auto old_reader = begin();
+
+    auto t2 = begin();
+    update(t2, 3, "balance", 400);
+    update(t2, 3, "id", 3000);
+    remove(t2, 4);
+    Rid rid = insert(t2, NUM_ACCOUNTS, 7);
+    txn_manager_->abort(t2, nullptr);
+
+    auto t3 = begin();
+    for (auto txn : {old_reader, t3}) {
+        EXPECT_EQ(balance_of(txn, 3), 300);
+        EXPECT_EQ(balance_of(txn, 4), INIT_BALANCE);
+        EXPECT_FALSE(find(txn, 3000).has_value());
+        EXPECT_FALSE(find(txn, NUM_ACCOUNTS).has_value());
+        EXPECT_EQ(scan(txn, {make_cond("id", OP_GE, 0)}).size(), NUM_ACCOUNTS);
+    }
+    // 版本链恢复为t1的撤销日志，t1之前开始的事务仍然可以读到旧版本
+    RmFileHandle *fh = sm_manager_->fhs_.at("t").get();
+    auto link = txn_manager_->GetUndoLink(fh->GetFd(), row_rid(3));
+    ASSERT_TRUE(link.has_value());
+    EXPECT_EQ(link->prev_txn_, t1->get_transaction_id());
+    EXPECT_TRUE(txn_manager_->GetTupleMeta(fh->GetFd(), rid).is_deleted_);
+    // 被回滚的修改不会与之后的事务冲突
+    EXPECT_EQ(try_write([&]() { update(t3, 3, "balance", 500); }), std::nullopt);
+}
+
+TEST_F(MvccTest, TwoPhaseLockingTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::TWO_PHASE_LOCKING);
+    auto t1 = begin();
+    update(t1, 3, "balance", 300);
+    update(t1, 4, "id", 4000);
+    remove(t1, 5);
+    insert(t1, NUM_ACCOUNTS, 7);
+    EXPECT_EQ(balance_of(t1, 3), 300);
+    EXPECT_EQ(balance_of(t1, 4000), INIT_BALANCE);
+    EXPECT_FALSE(find(t1, 5).has_value());
+    // 读取被修改的记录需要等待排他锁
+    auto t2 = begin();
+    EXPECT_EQ(try_write([&]() { balance_of(t2, 3); }), AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(t2, nullptr);
+    txn_manager_->abort(t1, nullptr);
+    // 回滚恢复表堆和索引
+    auto t3 = begin();
+    EXPECT_EQ(balance_of(t3, 3), INIT_BALANCE);
+    EXPECT_EQ(balance_of(t3, 4), INIT_BALANCE);
+    EXPECT_EQ(balance_of(t3, 5), INIT_BALANCE);
+    EXPECT_FALSE(find(t3, 4000).has_value());
+    EXPECT_FALSE(find(t3, NUM_ACCOUNTS).has_value());
+    txn_manager_->commit(t3, nullptr);
+}
+
+TEST_F(MvccTest, EscrowUpdateTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::TWO_PHASE_LOCKING);
+    // escrow锁之间相容，两个事务同时增加同一个账户的余额
+    auto t1 = begin(), t2 = begin();
+    increment(t1, 0, "balance", 10);
+    increment(t2, 0, "balance", 20);
+    increment(t1, 0, "balance", 5);
+    EXPECT_EQ(t1->get_escrow_set().size(), 1);
+    // 读取需要S锁，与escrow锁冲突
+    auto t3 = begin();
+    EXPECT_EQ(try_write([&]() { balance_of(t3, 0); }), AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(t3, nullptr);
+    txn_manager_->commit(t1, nullptr);
+    txn_manager_->commit(t2, nullptr);
+    auto t4 = begin();
+    EXPECT_EQ(balance_of(t4, 0), INIT_BALANCE + 35);
+
+    // 读取自己增加过的记录时升级为X锁，缓存的增量写入记录，回滚时恢复
+    increment(t4, 1, "balance", 7);
+    EXPECT_EQ(balance_of(t4, 1), INIT_BALANCE + 7);
+    EXPECT_TRUE(t4->get_escrow_set().empty());
+    increment(t4, 2, "balance", -9);
+    txn_manager_->abort(t4, nullptr);
+    auto t5 = begin();
+    EXPECT_EQ(balance_of(t5, 1), INIT_BALANCE);
+    EXPECT_EQ(balance_of(t5, 2), INIT_BALANCE);
+    txn_manager_->commit(t5, nullptr);
+
+    // 被修改的字段出现在索引或者where条件中、不是增量或者不是两阶段封锁时不使用escrow锁
+    auto t6 = begin();
+    auto ctx = context(t6);
+    auto &tab = sm_manager_->db_.get_table("t");
+    SetClause incr_balance{.lhs = {.tab_name = "t", .col_name = "balance"}, .is_incr = true};
+    incr_balance.rhs.set_int(1);
+    SetClause incr_id{.lhs = {.tab_name = "t", .col_name = "id"}, .is_incr = true};
+    incr_id.rhs.set_int(1);
+    SetClause set_balance{.lhs = {.tab_name = "t", .col_name = "balance"}};
+    set_balance.rhs.set_int(1);
+    EXPECT_TRUE(UseEscrow(&ctx, tab, {incr_balance}, {make_cond("id", OP_EQ, 1)}));
+    EXPECT_FALSE(UseEscrow(&ctx, tab, {incr_id}, {}));
+    EXPECT_FALSE(UseEscrow(&ctx, tab, {incr_balance}, {make_cond("balance", OP_GT, 0)}));
+    EXPECT_FALSE(UseEscrow(&ctx, tab, {incr_balance, set_balance}, {}));
+    txn_manager_->set_escrow_enabled(false);
+    EXPECT_FALSE(UseEscrow(&ctx, tab, {incr_balance}, {}));
+    txn_manager_->commit(t6, nullptr);
+    set_mode(ConcurrencyMode::MVCC);
+    auto t7 = begin();
+    auto mvcc_ctx = context(t7);
+    EXPECT_FALSE(UseEscrow(&mvcc_ctx, tab, {incr_balance}, {}));
+    // MVCC下增量按照读-修改-写执行
+    increment(t7, 3, "balance", 11);
+    EXPECT_EQ(balance_of(t7, 3), INIT_BALANCE + 11);
+    txn_manager_->commit(t7, nullptr);
+}
+
+TEST_F(MvccTest, IncrementRedoTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::TWO_PHASE_LOCKING);
+    // 使用新的日志文件，避免重做其他测试写入的日志
+    if (disk_manager->is_file(LOG_FILE_NAME)) {
+        disk_manager->destroy_file(LOG_FILE_NAME);
+    }
+    disk_manager->create_file(LOG_FILE_NAME);
+    DiskManager log_disk;
+    Value delta;
+    delta.set_int(10);
+    // 事务1已经提交，事务2没有提交
+    IncrementLogRecord incr1(1, row_rid(0), "t", {{BALANCE_OFFSET, delta}});
+    incr1.lsn_ = 1;
+    CommitLogRecord commit1(1);
+    commit1.lsn_ = 2;
+    IncrementLogRecord incr2(2, row_rid(1), "t", {{BALANCE_OFFSET, delta}});
+    incr2.lsn_ = 3;
+    for (LogRecord *log : std::vector<LogRecord *>{&incr1, &commit1, &incr2}) {
+        std::vector<char> buf(log->log_tot_len_);
+        log->serialize(buf.data());
+        log_disk.write_log(buf.data(), buf.size());
+    }
+    // 第二次恢复时页面的lsn已经不小于日志的lsn，不会重复加上增量
+    for (int i = 0; i < 2; i++) {
+        RecoveryManager recovery(&log_disk, bpm_.get(), sm_manager_.get());
+        recovery.analyze();
+        recovery.redo();
+        EXPECT_EQ(recovery.get_next_lsn(), 4);
+        auto txn = begin();
+        EXPECT_EQ(balance_of(txn, 0), INIT_BALANCE + 10);
+        EXPECT_EQ(balance_of(txn, 1), INIT_BALANCE);
+        txn_manager_->commit(txn, nullptr);
+    }
+}
+
+TEST_F(MvccTest, EarlyLockReleaseTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::TWO_PHASE_LOCKING);
+    if (!disk_manager->is_file(LOG_FILE_NAME)) {
+        disk_manager->create_file(LOG_FILE_NAME);
+    }
+    DiskManager log_disk;
+    int log_offset = log_disk.get_file_size(LOG_FILE_NAME);
+    auto log_manager = std::make_unique<LogManager>(&log_disk);
+
+    // 提交时写入提交日志，释放锁之后等待日志持久化再返回，持久化之后锁表中不再保留提前释放的锁
+    auto t1 = begin();
+    update(t1, 0, "balance", 1);
+    txn_manager_->commit(t1, log_manager.get());
+    EXPECT_EQ(t1->get_state(), TransactionState::COMMITTED);
+    EXPECT_NE(t1->get_prev_lsn(), INVALID_LSN);
+    EXPECT_GE(log_manager->get_persist_lsn(), t1->get_prev_lsn());
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 0);
+    std::vector<char> buf(LOG_HEADER_SIZE);
+    ASSERT_EQ(log_disk.read_log(buf.data(), LOG_HEADER_SIZE, log_offset), LOG_HEADER_SIZE);
+    CommitLogRecord commit_record;
+    commit_record.deserialize(buf.data());
+    EXPECT_EQ(commit_record.log_type_, LogType::commit);
+    EXPECT_EQ(commit_record.log_tid_, t1->get_transaction_id());
+    EXPECT_EQ(commit_record.lsn_, t1->get_prev_lsn());
+
+    // 只读事务不写提交日志
+    auto t2 = begin();
+    EXPECT_EQ(balance_of(t2, 0), 1);
+    txn_manager_->commit(t2, log_manager.get());
+    EXPECT_EQ(t2->get_prev_lsn(), INVALID_LSN);
+
+    // t3的提交日志还在缓冲区中时提前释放锁，读到它的修改的只读事务提交前要等待日志持久化
+    auto t3 = begin();
+    update(t3, 1, "balance", 2);
+    CommitLogRecord commit_log(t3->get_transaction_id());
+    lsn_t commit_lsn = log_manager->add_log_to_buffer(&commit_log);
+    EXPECT_LT(log_manager->get_persist_lsn(), commit_lsn);
+    std::vector<LockDataId> locks(t3->get_lock_set()->begin(), t3->get_lock_set()->end());
+    for (auto &lock_data_id : locks) {
+        lock_manager_->unlock(t3, lock_data_id, commit_lsn);
+    }
+    auto t4 = begin();
+    EXPECT_EQ(balance_of(t4, 1), 2);
+    EXPECT_EQ(t4->get_dependency_lsn(), commit_lsn);
+    txn_manager_->commit(t4, log_manager.get());
+    EXPECT_GE(log_manager->get_persist_lsn(), commit_lsn);
+    txn_manager_->commit(t3, nullptr);
+    for (auto &lock_data_id : locks) {
+        lock_manager_->clear_release_lsn(lock_data_id, log_manager->get_persist_lsn());
+    }
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 0);
+}
+
+TEST_F(MvccTest, IncrementLogTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::TWO_PHASE_LOCKING);
+    // 使用新的日志文件，避免重做其他测试写入的日志
+    if (disk_manager->is_file(LOG_FILE_NAME)) {
+        disk_manager->destroy_file(LOG_FILE_NAME);
+    }
+    disk_manager->create_file(LOG_FILE_NAME);
+    DiskManager log_disk;
+    auto log_manager = std::make_unique<LogManager>(&log_disk);
+
+    // 提交时在提交日志之前写入increment日志，页面的lsn设置为increment日志的lsn
+    auto t1 = begin();
+    increment(t1, 0, "balance", 10);
+    txn_manager_->commit(t1, log_manager.get());
+    RmFileHandle *fh = sm_manager_->fhs_.at("t").get();
+    RmPageHandle page_handle = fh->fetch_page_handle(row_rid(0).page_no);
+    EXPECT_GT(page_handle.page->get_page_lsn(), 0);
+    EXPECT_LT(page_handle.page->get_page_lsn(), t1->get_prev_lsn());
+
+    // 模拟修改过的页面没有写入磁盘：恢复修改之前的记录和页面的lsn，redo之后增量重新加到记录上
+    *(int *)(page_handle.get_slot(row_rid(0).slot_no) + BALANCE_OFFSET) = INIT_BALANCE;
+    page_handle.page->set_page_lsn(0);
+    bpm_->unpin_page(page_handle.page->get_page_id(), true);
+    RecoveryManager recovery(&log_disk, bpm_.get(), sm_manager_.get());
+    recovery.analyze();
+    recovery.redo();
+    EXPECT_EQ(recovery.get_next_lsn(), t1->get_prev_lsn() + 1);
+    auto t2 = begin();
+    EXPECT_EQ(balance_of(t2, 0), INIT_BALANCE + 10);
+    txn_manager_->commit(t2, nullptr);
+}
+
+TEST_F(MvccTest, TransactionPoolTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::MVCC);
+    // 撤销日志还可能被读到时，交还的事务仍然留在全局事务表中，垃圾回收回收撤销日志之后才放回事务池
+    auto reader = txn_manager_->begin(nullptr, nullptr);
+    auto writer = txn_manager_->begin(nullptr, nullptr);
+    txn_id_t writer_id = writer->get_transaction_id();
+    update(writer, 0, "balance", 5);
+    txn_manager_->commit(writer, nullptr);
+    txn_manager_->recycle(writer);
+    EXPECT_EQ(txn_manager_->get_transaction(writer_id), writer);
+    EXPECT_EQ(balance_of(reader, 0), INIT_BALANCE);
+    txn_manager_->commit(reader, nullptr);
+    txn_manager_->recycle(reader);
+    txn_manager_->GarbageCollection();
+    EXPECT_EQ(txn_manager_->get_transaction(writer_id), nullptr);
+    EXPECT_EQ(txn_manager_->get_num_transactions(), 0);
+    auto txn = txn_manager_->begin(nullptr, nullptr);
+    EXPECT_EQ(txn->GetUndoLogNum(), 0);
+    EXPECT_EQ(balance_of(txn, 0), 5);
+    txn_manager_->commit(txn, nullptr);
+    txn_manager_->recycle(txn);
+}
+
+TEST_F(MvccTest, ReadOnlyTransactionTest) {
+    load_accounts();
+    // MVCC下只读事务读取快照，不分配写集和锁集，不加入全局事务表
+    set_mode(ConcurrencyMode::MVCC);
+    auto t1 = begin();
+    update(t1, 0, "balance", 5);
+    auto ro1 = begin_read_only();
+    EXPECT_TRUE(ro1->is_read_only());
+    EXPECT_EQ(balance_of(ro1, 0), INIT_BALANCE);
+    EXPECT_EQ(ro1->get_write_set(), nullptr);
+    EXPECT_FALSE(ro1->has_lock_set());
+    EXPECT_EQ(txn_manager_->get_transaction(ro1->get_transaction_id()), nullptr);
+    txn_manager_->commit(ro1, nullptr);
+    EXPECT_EQ(ro1->get_state(), TransactionState::COMMITTED);
+    txn_manager_->commit(t1, nullptr);
+    auto ro2 = begin_read_only();
+    EXPECT_EQ(balance_of(ro2, 0), 5);
+    txn_manager_->commit(ro2, nullptr);
+    EXPECT_EQ(txn_manager_->GetWatermark(), txn_manager_->GetLastCommitTs());
+
+    // 两阶段封锁下只读事务仍然加S锁，锁集在第一次加锁时分配
+    set_mode(ConcurrencyMode::TWO_PHASE_LOCKING);
+    auto t2 = begin();
+    update(t2, 1, "balance", 6);
+    auto ro3 = begin_read_only();
+    EXPECT_EQ(try_write([&]() { balance_of(ro3, 1); }), AbortReason::DEADLOCK_PREVENTION);
+    txn_manager_->abort(ro3, nullptr);
+    EXPECT_EQ(ro3->get_state(), TransactionState::ABORTED);
+    txn_manager_->commit(t2, nullptr);
+    auto ro4 = begin_read_only();
+    EXPECT_EQ(balance_of(ro4, 1), 6);
+    EXPECT_TRUE(ro4->has_lock_set());
+    txn_manager_->commit(ro4, nullptr);
+    EXPECT_EQ(lock_manager_->get_lock_table_size(), 0);
+
+    // OCC下只读事务提交时也要验证读集
+    set_mode(ConcurrencyMode::OCC);
+    auto ro5 = begin_read_only();
+    EXPECT_EQ(balance_of(ro5, 2), INIT_BALANCE);
+    auto t3 = begin();
+    update(t3, 2, "balance", 7);
+    txn_manager_->commit(t3, nullptr);
+    EXPECT_THROW(txn_manager_->commit(ro5, nullptr), TransactionAbortException);
+    txn_manager_->abort(ro5, nullptr);
+    auto ro6 = begin_read_only();
+    EXPECT_EQ(balance_of(ro6, 2), 7);
+    txn_manager_->commit(ro6, nullptr);
+}
+
+/**
+ * 点查询的延迟和每个事务对象占用的堆内存：普通事务与只读事务对比。
+ * 普通事务分配写集、锁集和索引latch集并加入全局事务表，只读事务没有这些容器。
+ * 两种事务都在计时结束、读取堆内存之后才释放
+ */
+TEST_F(MvccTest, ReadOnlyTransactionBenchmark) {
+    load_accounts();
+    const int num_queries = 20000;
+    std::cout << "mode  txn        latency(us)  heap(B)/query" << std::endl;
+    for (auto mode : {ConcurrencyMode::TWO_PHASE_LOCKING, ConcurrencyMode::MVCC, ConcurrencyMode::OCC}) {
+        set_mode(mode);
+        for (bool read_only : {false, true}) {
+            std::vector<Transaction *> txns;
+            txns.reserve(num_queries);
+            size_t heap_before = mallinfo2().uordblks;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < num_queries; i++) {
+                Transaction *txn =
+                    read_only ? txn_manager_->begin_read_only(nullptr) : txn_manager_->begin(nullptr, nullptr);
+                EXPECT_EQ(balance_of(txn, i % NUM_ACCOUNTS), INIT_BALANCE);
+                txn_manager_->commit(txn, nullptr);
+                txns.push_back(txn);
+            }
+            double latency =
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / num_queries;
+            long heap_bytes = ((long)mallinfo2().uordblks - (long)heap_before) / num_queries;
+            const char *mode_names[] = {"2pl", "", "mvcc", "occ"};
+            std::cout << std::left << std::setw(6) << mode_names[static_cast<int>(mode)] << std::setw(11)
+                      << (read_only ? "read-only" : "regular") << std::right << std::setw(11) << std::fixed
+                      << std::setprecision(2) << latency << std::setw(15) << heap_bytes << std::endl;
+            // 普通事务没有交还给事务管理器，MVCC下还可能是垃圾回收的候选事务，测试结束时再释放
+            for (auto txn : txns) {
+                if (read_only) {
+                    delete txn;
+                } else {
+                    txns_.emplace_back(txn);
+                }
+            }
+        }
+    }
+    std::cout.unsetf(std::ios::fixed);
+}
+
+TEST(IncrementLogRecordTest, SerializeTest) {
+    Value int_delta, float_delta;
+    int_delta.set_int(-3);
+    float_delta.set_float(2.5);
+    IncrementLogRecord log(7, Rid{.page_no = 2, .slot_no = 5}, "warehouse", {{8, int_delta}, {16, float_delta}});
+    log.prev_lsn_ = 3;
+    std::vector<char> buf(log.log_tot_len_);
+    log.serialize(buf.data());
+    IncrementLogRecord copy;
+    copy.deserialize(buf.data());
+    EXPECT_EQ(copy.log_type_, LogType::INCREMENT);
+    EXPECT_EQ(copy.log_tot_len_, log.log_tot_len_);
+    EXPECT_EQ(copy.log_tid_, 7);
+    EXPECT_EQ(copy.prev_lsn_, 3);
+    EXPECT_EQ(copy.rid_, (Rid{.page_no = 2, .slot_no = 5}));
+    EXPECT_EQ(copy.table_name_, "warehouse");
+    ASSERT_EQ(copy.deltas_.size(), 2);
+    EXPECT_EQ(copy.deltas_[0].first, 8);
+    EXPECT_EQ(copy.deltas_[0].second.type, TYPE_INT);
+    EXPECT_EQ(copy.deltas_[0].second.int_val, -3);
+    EXPECT_EQ(copy.deltas_[1].first, 16);
+    EXPECT_EQ(copy.deltas_[1].second.type, TYPE_FLOAT);
+    EXPECT_EQ(copy.deltas_[1].second.float_val, 2.5);
+}
+
+/**
+ * 读写混合负载下两阶段封锁与MVCC的对比：两阶段封锁下扫描全表的读事务持有所有记录的共享锁，与转账事务互相阻塞；
+ * MVCC下读事务读取快照，不加锁也不会回滚，转账事务之间只有写写冲突
+ */
+TEST_F(MvccTest, MixedWorkloadBenchmark) {
+    load_accounts();
+    const int NUM_WRITERS = 4;
+    std::cout << "mode     readers  transfers/s  transfer aborts  scans/s  scan aborts" << std::endl;
+    for (int num_readers : {1, 4}) {
+        for (auto mode : {ConcurrencyMode::TWO_PHASE_LOCKING, ConcurrencyMode::MVCC}) {
+            set_mode(mode, DeadlockPolicy::WOUND_WAIT);
+            auto result = run_mixed(NUM_WRITERS, num_readers);
+            std::cout << std::left << std::setw(9) << (mode == ConcurrencyMode::MVCC ? "mvcc" : "2pl") << std::right
+                      << std::setw(7) << num_readers << std::setw(13) << (long long)result.transfers_per_sec
+                      << std::setw(17) << result.transfer_abort_rate << std::setw(9) << (long long)result.scans_per_sec
+                      << std::setw(13) << result.scan_abort_rate << std::endl;
+            if (mode == ConcurrencyMode::MVCC) {
+                EXPECT_EQ(result.scan_aborts, 0);
+                EXPECT_GT(result.scans_per_sec, 0);
+            }
+        }
+    }
+}
+
+TEST_F(MvccTest, OccTest) {
+    load_accounts();
+    set_mode(ConcurrencyMode::OCC);
+    // 缓存的写操作在提交之前对其他事务不可见，事务自己可以读到
+    auto t1 = begin();
+    update(t1, 1, "balance", 100);
+    update(t1, 2, "id", 2000);
+    remove(t1, 3);
+    insert(t1, NUM_ACCOUNTS, 7);
+    EXPECT_EQ(balance_of(t1, 1), 100);
+    EXPECT_EQ(balance_of(t1, NUM_ACCOUNTS), 7);
+    EXPECT_FALSE(find(t1, 2).has_value());
+    EXPECT_FALSE(find(t1, 3).has_value());
+    auto t2 = begin();
+    EXPECT_EQ(balance_of(t2, 1), INIT_BALANCE);
+    EXPECT_TRUE(find(t2, 2).has_value());
+    EXPECT_TRUE(find(t2, 3).has_value());
+    EXPECT_FALSE(find(t2, NUM_ACCOUNTS).has_value());
+    txn_manager_->commit(t1, nullptr);
+    // t2读过的记录已经被t1修改，验证失败
+    update(t2, 4, "balance", 400);
+    EXPECT_EQ(try_write([&]() { txn_manager_->commit(t2, nullptr); }), AbortReason::VALIDATION_FAILED);
+    txn_manager_->abort(t2, nullptr);
+
+    auto t3 = begin();
+    EXPECT_EQ(balance_of(t3, 1), 100);
+    EXPECT_EQ(balance_of(t3, 2000), INIT_BALANCE);
+    EXPECT_FALSE(find(t3, 2).has_value());
+    EXPECT_FALSE(find(t3, 3).has_value());
+    EXPECT_EQ(balance_of(t3, 4), INIT_BALANCE);
+    EXPECT_EQ(balance_of(t3, NUM_ACCOUNTS), 7);
+    txn_manager_->commit(t3, nullptr);
+
+    // 回滚的插入从表堆和索引中删除，缓存的更新直接丢弃
+    auto t4 = begin();
+    insert(t4, NUM_ACCOUNTS + 1, 8);
+    update(t4, NUM_ACCOUNTS + 1, "balance", 9);
+    update(t4, 5, "balance", 500);
+    txn_manager_->abort(t4, nullptr);
+    // 读集中的记录没有被修改时验证通过
+    auto t5 = begin();
+    EXPECT_FALSE(find(t5, NUM_ACCOUNTS + 1).has_value());
+    EXPECT_EQ(balance_of(t5, 5), INIT_BALANCE);
+    update(t5, 5, "balance", 600);
+    EXPECT_EQ(try_write([&]() { txn_manager_->commit(t5, nullptr); }), std::nullopt);
+    EXPECT_EQ(balance_of(begin(), 5), 600);
+}
+
+TEST(WatermarkTest, SlotTest) {
+    Watermark watermark(5);
+    EXPECT_EQ(watermark.GetWatermark(), 5);
+    size_t a = watermark.AddTxn(5, 0);
+    size_t b = watermark.AddTxn(7, 0);    // 槽位已经被占用时使用下一个槽位
+    size_t c = watermark.AddTxn(9, Watermark::NUM_SLOTS - 1);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(c, Watermark::NUM_SLOTS - 1);
+    watermark.UpdateCommitTs(9);
+    EXPECT_EQ(watermark.GetWatermark(), 5);
+    watermark.RemoveTxn(a);
+    EXPECT_EQ(watermark.GetWatermark(), 7);
+    watermark.UpdateTxn(b, 8);
+    EXPECT_EQ(watermark.GetWatermark(), 8);
+    watermark.RemoveTxn(b);
+    watermark.RemoveTxn(c);
+    EXPECT_EQ(watermark.GetWatermark(), 9);
+    EXPECT_EQ(watermark.AddTxn(9, 0), 0u);  // 释放的槽位可以重新使用
+}
+
+TEST(UndoLogTest, OptionalAccessTest) {
+    Transaction txn(3);
+    UndoLog log;
+    log.is_deleted_ = false;
+    log.ts_ = 10;
+    auto link = txn.AppendUndoLog(log);
+    ASSERT_TRUE(txn.GetUndoLogOptional(3, link.prev_log_idx_).has_value());
+    EXPECT_EQ(txn.GetUndoLogOptional(3, link.prev_log_idx_)->ts_, 10);
+    EXPECT_FALSE(txn.GetUndoLogOptional(3, link.prev_log_idx_ + 1).has_value());
+    // 垃圾回收取走撤销日志之后，以及事务对象复用为其他事务之后都读不到
+    txn.TakeUndoLogs();
+    EXPECT_FALSE(txn.GetUndoLogOptional(3, link.prev_log_idx_).has_value());
+    txn.reset(4);
+    txn.AppendUndoLog(log);
+    EXPECT_FALSE(txn.GetUndoLogOptional(3, link.prev_log_idx_).has_value());
+    EXPECT_TRUE(txn.GetUndoLogOptional(4, link.prev_log_idx_).has_value());
+}
+
+TEST_F(MvccTest, GarbageCollectionTest) {
+    auto saved_interval = gc_interval;
+    gc_interval = std::chrono::hours(1);    // 只由测试调用垃圾回收
+    load_accounts();
+    set_mode(ConcurrencyMode::MVCC);
+    auto t1 = begin();  // 需要账户1的初始版本
+    auto t2 = begin();
+    update(t2, 1, "balance", 100);
+    txn_manager_->commit(t2, nullptr);
+    auto t3 = begin();  // 需要t2写入的版本
+    auto t4 = begin();
+    update(t4, 1, "balance", 200);
+    txn_manager_->commit(t4, nullptr);
+    auto stats = txn_manager_->GetVersionMemoryStats();
+    EXPECT_EQ(stats.num_undo_logs, 2u);
+    EXPECT_EQ(stats.num_version_links, 1u);
+    EXPECT_GT(stats.undo_log_bytes, 0u);
+    EXPECT_EQ(txn_manager_->GarbageCollection(), 0u);
+
+    // t1结束之后水印是t3的读时间戳，t3读到t4的撤销日志为止，t2的撤销日志不再可达
+    txn_manager_->commit(t1, nullptr);
+    EXPECT_EQ(txn_manager_->GarbageCollection(), 1u);
+    EXPECT_EQ(balance_of(t3, 1), 100);
+    EXPECT_EQ(txn_manager_->GetVersionMemoryStats().num_undo_logs, 1u);
+
+    // 没有正在运行的事务时所有的版本链都可以删除
+    txn_manager_->commit(t3, nullptr);
+    EXPECT_EQ(txn_manager_->GarbageCollection(), 1u);
+    stats = txn_manager_->GetVersionMemoryStats();
+    EXPECT_EQ(stats.num_undo_logs, 0u);
+    EXPECT_EQ(stats.undo_log_bytes, 0u);
+    EXPECT_EQ(stats.num_version_links, 0u);
+    EXPECT_EQ(stats.num_tuple_metas, 0u);
+    auto reader = begin();
+    EXPECT_EQ(balance_of(reader, 1), 200);
+    txn_manager_->commit(reader, nullptr);
+
+    // 删除标记需要保留；回滚的事务的撤销日志立即不可达
+    auto t5 = begin();
+    remove(t5, 2);
+    txn_manager_->commit(t5, nullptr);
+    auto t6 = begin();
+    update(t6, 3, "balance", 300);
+    txn_manager_->abort(t6, nullptr);
+    EXPECT_EQ(txn_manager_->GarbageCollection(), 2u);
+    stats = txn_manager_->GetVersionMemoryStats();
+    EXPECT_EQ(stats.num_undo_logs, 0u);
+    EXPECT_EQ(stats.num_tuple_metas, 1u);
+    EXPECT_FALSE(find(begin(), 2).has_value());
+    EXPECT_EQ(balance_of(begin(), 3), INIT_BALANCE);
+    EXPECT_EQ(txn_manager_->GetGarbageCollectionStats().num_reclaimed_logs, 4u);
+    gc_interval = saved_interval;
+}
+
+/**
+ * 长时间运行的更新负载下版本占用的内存：写事务不断更新随机的账户，读事务持有快照一段时间，推迟水印。
+ * 没有垃圾回收时版本占用的内存随着时间线性增长；后台垃圾回收时只保留水印之后的版本，内存保持稳定
+ */
+TEST_F(MvccTest, VersionGcBenchmark) {
+    load_accounts();
+    auto saved_interval = gc_interval;
+    const int NUM_WRITERS = 4;
+    const int NUM_SAMPLES = 10;
+    const auto sample_interval = std::chrono::milliseconds(200);
+    std::vector<size_t> samples[2];
+    size_t num_updates[2] = {0, 0};
+    for (int gc : {0, 1}) {
+        gc_interval = gc ? std::chrono::milliseconds(10) : std::chrono::hours(1);
+        set_mode(ConcurrencyMode::MVCC);
+        std::atomic<bool> stop = false;
+        std::atomic<size_t> updates = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < NUM_WRITERS; i++) {
+            threads.emplace_back([&, i]() {
+                std::mt19937 rng(i);
+                while (!stop) {
+                    Transaction *txn = begin();
+                    int id = rng() % NUM_ACCOUNTS;
+                    if (try_write([&]() { update(txn, id, "balance", (int)rng()); }).has_value()) {
+                        txn_manager_->abort(txn, nullptr);
+                    } else {
+                        txn_manager_->commit(txn, nullptr);
+                        updates++;
+                    }
+                }
+            });
+        }
+        threads.emplace_back([&]() {
+            while (!stop) {
+                Transaction *txn = begin();
+                balance_of(txn, 0);
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                txn_manager_->commit(txn, nullptr);
+            }
+        });
+        for (int i = 0; i < NUM_SAMPLES; i++) {
+            std::this_thread::sleep_for(sample_interval);
+            samples[gc].push_back(txn_manager_->GetVersionMemoryStats().total_bytes);
+        }
+        stop = true;
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        num_updates[gc] = updates;
+    }
+    gc_interval = saved_interval;
+    std::cout << "time(ms)  version memory without gc  with gc" << std::endl;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        std::cout << std::setw(8) << (i + 1) * sample_interval.count() << std::setw(27) << samples[0][i]
+                  << std::setw(9) << samples[1][i] << std::endl;
+    }
+    std::cout << "updates: " << num_updates[0] << " without gc, " << num_updates[1] << " with gc, gc runs "
+              << txn_manager_->GetGarbageCollectionStats().num_runs << std::endl;
+    EXPECT_LT(*std::max_element(samples[1].begin() + NUM_SAMPLES / 2, samples[1].end()) * 4, samples[0].back());
+}
+
+/**
+ * 在自带的TPC-C数据（test/performance_test/table_data）上运行NewOrder和Payment事务。
+ * 只加载事务用到的字段；每张表的第一个字段是非空的标签，表堆把首字节为0的槽位当作空闲槽位
+ */
+class TpccTxnTest : public MvccTest {
+   public:
+    static constexpr int NUM_DISTRICTS = 3;
+    static constexpr int CUSTOMERS_PER_DISTRICT = 10;
+    static constexpr int NUM_ITEMS = 10;
+    static constexpr int ITEMS_PER_ORDER = 5;
+
+    struct Column {
+        std::string name;
+        ColType type;
+        int len;
+    };
+
+    struct Row {
+        Rid rid;
+        std::unique_ptr<RmRecord> rec;
+    };
+
+    void SetUp() override {
+        MvccTest::SetUp();
+        load("warehouse", {{"w_id", TYPE_INT, 4}, {"w_tax", TYPE_FLOAT, 4}, {"w_ytd", TYPE_FLOAT, 4}}, {"w_id"});
+        load("district",
+             {{"d_id", TYPE_INT, 4}, {"d_w_id", TYPE_INT, 4}, {"d_tax", TYPE_FLOAT, 4}, {"d_ytd", TYPE_FLOAT, 4},
+              {"d_next_o_id", TYPE_INT, 4}},
+             {"d_w_id", "d_id"});
+        load("customer",
+             {{"c_id", TYPE_INT, 4}, {"c_d_id", TYPE_INT, 4}, {"c_w_id", TYPE_INT, 4}, {"c_discount", TYPE_FLOAT, 4},
+              {"c_balance", TYPE_FLOAT, 4}, {"c_ytd_payment", TYPE_FLOAT, 4}, {"c_payment_cnt", TYPE_INT, 4}},
+             {"c_w_id", "c_d_id", "c_id"});
+        load("item", {{"i_id", TYPE_INT, 4}, {"i_price", TYPE_FLOAT, 4}}, {"i_id"});
+        load("stock",
+             {{"s_i_id", TYPE_INT, 4}, {"s_w_id", TYPE_INT, 4}, {"s_quantity", TYPE_INT, 4}, {"s_order_cnt", TYPE_INT, 4}},
+             {"s_w_id", "s_i_id"});
+        // 新订单只插入、不读取，不需要加载已有的订单，也不需要索引
+        load("orders",
+             {{"o_id", TYPE_INT, 4}, {"o_d_id", TYPE_INT, 4}, {"o_w_id", TYPE_INT, 4}, {"o_c_id", TYPE_INT, 4},
+              {"o_ol_cnt", TYPE_INT, 4}},
+             {}, false);
+        load("new_orders", {{"no_o_id", TYPE_INT, 4}, {"no_d_id", TYPE_INT, 4}, {"no_w_id", TYPE_INT, 4}}, {}, false);
+        load("order_line",
+             {{"ol_o_id", TYPE_INT, 4}, {"ol_d_id", TYPE_INT, 4}, {"ol_w_id", TYPE_INT, 4}, {"ol_number", TYPE_INT, 4},
+              {"ol_i_id", TYPE_INT, 4}, {"ol_amount", TYPE_FLOAT, 4}},
+             {}, false);
+    }
+
+    static std::vector<std::string> split(const std::string &line) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) {
+            fields.push_back(field);
+        }
+        return fields;
+    }
+
+    static Value make_value(ColType type, const std::string &str) {
+        Value value;
+        if (type == TYPE_INT) {
+            value.set_int(std::stoi(str));
+        } else if (type == TYPE_FLOAT) {
+            value.set_float(std::stof(str));
+        } else {
+            value.set_str(str);
+        }
+        return value;
+    }
+
+    // 创建表，key_cols非空时在这些字段上建立索引，load_rows时从csv文件中读取cols中的字段插入
+    void load(const std::string &tab_name, const std::vector<Column> &cols, const std::vector<std::string> &key_cols,
+              bool load_rows = true) {
+        std::vector<std::tuple<std::string, ColType, int>> schema = {{"tag", TYPE_STRING, 4}};
+        for (auto &col : cols) {
+            schema.emplace_back(col.name, col.type, col.len);
+        }
+        create_table(tab_name, schema);
+        if (!key_cols.empty()) {
+            add_index(tab_name, key_cols);
+            auto &index_cols = sm_manager_->db_.get_table(tab_name).indexes.back().cols;
+            if (ix_manager_->exists(tab_name, index_cols)) {
+                ix_manager_->destroy_index(tab_name, index_cols);
+            }
+            ix_manager_->create_index(tab_name, index_cols);
+            sm_manager_->ihs_.emplace(ix_manager_->get_index_name(tab_name, index_cols),
+                                      ix_manager_->open_index(tab_name, index_cols));
+        }
+        if (!load_rows) {
+            return;
+        }
+        std::string file = __FILE__;
+        std::ifstream in(file.substr(0, file.rfind('/')) + "/test/performance_test/table_data/" + tab_name + ".csv");
+        ASSERT_TRUE(in.is_open());
+        std::string line;
+        std::getline(in, line);
+        auto header = split(line);
+        while (std::getline(in, line)) {
+            auto fields = split(line);
+            std::vector<Value> values = {make_value(TYPE_STRING, "tpcc")};
+            for (auto &col : cols) {
+                auto pos = std::find(header.begin(), header.end(), col.name) - header.begin();
+                values.push_back(make_value(col.type, fields.at(pos)));
+            }
+            InsertExecutor executor(sm_manager_.get(), tab_name, values, nullptr);
+            executor.Next();
+        }
+    }
+
+    // 用索引上的等值条件读取一条记录，keys按照索引字段的顺序给出
+    std::optional<Row> lookup(Transaction *txn, const std::string &tab_name,
+                              const std::vector<std::pair<std::string, int>> &keys) {
+        std::vector<Condition> conds;
+        std::vector<std::string> index_cols;
+        for (auto &[col_name, val] : keys) {
+            Condition cond;
+            cond.lhs_col = {.tab_name = tab_name, .col_name = col_name};
+            cond.op = OP_EQ;
+            cond.is_rhs_val = true;
+            cond.rhs_val.set_int(val);
+            cond.rhs_val.init_raw(sizeof(int));
+            conds.push_back(cond);
+            index_cols.push_back(col_name);
+        }
+        auto ctx = context(txn);
+        IndexScanExecutor executor(sm_manager_.get(), tab_name, conds, index_cols, &ctx);
+        executor.beginTuple();
+        if (executor.is_end()) {
+            return std::nullopt;
+        }
+        return Row{executor.rid(), executor.Next()};
+    }
+
+    template <typename T>
+    T get(const std::string &tab_name, const Row &row, const std::string &col_name) {
+        return *(T *)(row.rec->data + sm_manager_->db_.get_table(tab_name).get_col(col_name)->offset);
+    }
+
+    void set(Transaction *txn, const std::string &tab_name, const Rid &rid,
+             const std::vector<std::pair<std::string, Value>> &vals) {
+        std::vector<SetClause> set_clauses;
+        for (auto &[col_name, val] : vals) {
+            set_clauses.push_back(SetClause{.lhs = {.tab_name = tab_name, .col_name = col_name}, .rhs = val});
+        }
+        auto ctx = context(txn);
+        UpdateExecutor executor(sm_manager_.get(), tab_name, set_clauses, {}, {rid}, &ctx);
+        executor.Next();
+    }
+
+    // UPDATE tab_name SET col = col + delta, ... WHERE keys：扫描时按照Portal中的规则决定是否加escrow锁
+    void add(Transaction *txn, const std::string &tab_name, const std::vector<std::pair<std::string, int>> &keys,
+             const std::vector<std::pair<std::string, Value>> &deltas) {
+        std::vector<Condition> conds;
+        std::vector<std::string> index_cols;
+        for (auto &[col_name, val] : keys) {
+            Condition cond;
+            cond.lhs_col = {.tab_name = tab_name, .col_name = col_name};
+            cond.op = OP_EQ;
+            cond.is_rhs_val = true;
+            cond.rhs_val.set_int(val);
+            cond.rhs_val.init_raw(sizeof(int));
+            conds.push_back(cond);
+            index_cols.push_back(col_name);
+        }
+        std::vector<SetClause> set_clauses;
+        for (auto &[col_name, delta] : deltas) {
+            set_clauses.push_back(
+                SetClause{.lhs = {.tab_name = tab_name, .col_name = col_name}, .rhs = delta, .is_incr = true});
+        }
+        auto ctx = context(txn);
+        ctx.escrow_ = UseEscrow(&ctx, sm_manager_->db_.get_table(tab_name), set_clauses, conds);
+        IndexScanExecutor scan(sm_manager_.get(), tab_name, conds, index_cols, &ctx);
+        std::vector<Rid> rids;
+        for (scan.beginTuple(); !scan.is_end(); scan.nextTuple()) {
+            rids.push_back(scan.rid());
+        }
+        ctx.escrow_ = false;
+        UpdateExecutor executor(sm_manager_.get(), tab_name, set_clauses, conds, rids, &ctx);
+        executor.Next();
+    }
+
+    void insert_row(Transaction *txn, const std::string &tab_name, std::vector<Value> values) {
+        values.insert(values.begin(), make_value(TYPE_STRING, "tpcc"));
+        auto ctx = context(txn);
+        InsertExecutor executor(sm_manager_.get(), tab_name, values, &ctx);
+        executor.Next();
+    }
+
+    static Value int_value(int val) {
+        Value value;
+        value.set_int(val);
+        return value;
+    }
+
+    static Value float_value(float val) {
+        Value value;
+        value.set_float(val);
+        return value;
+    }
+
+    // NewOrder：分配district的下一个订单号，插入订单，每个订单项读取商品价格并更新库存
+    void new_order(Transaction *txn, std::mt19937 &rng) {
+        int d_id = rng() % NUM_DISTRICTS + 1, c_id = rng() % CUSTOMERS_PER_DISTRICT + 1;
+        auto warehouse = lookup(txn, "warehouse", {{"w_id", 1}});
+        auto district = lookup(txn, "district", {{"d_w_id", 1}, {"d_id", d_id}});
+        int o_id = get<int>("district", *district, "d_next_o_id");
+        set(txn, "district", district->rid, {{"d_next_o_id", int_value(o_id + 1)}});
+        auto customer = lookup(txn, "customer", {{"c_w_id", 1}, {"c_d_id", d_id}, {"c_id", c_id}});
+        float tax = get<float>("warehouse", *warehouse, "w_tax") + get<float>("district", *district, "d_tax");
+        float discount = get<float>("customer", *customer, "c_discount");
+        insert_row(txn, "orders", {int_value(o_id), int_value(d_id), int_value(1), int_value(c_id),
+                                   int_value(ITEMS_PER_ORDER)});
+        insert_row(txn, "new_orders", {int_value(o_id), int_value(d_id), int_value(1)});
+        for (int ol_number = 1; ol_number <= ITEMS_PER_ORDER; ol_number++) {
+            int i_id = rng() % NUM_ITEMS + 1, quantity = rng() % 10 + 1;
+            auto item = lookup(txn, "item", {{"i_id", i_id}});
+            auto stock = lookup(txn, "stock", {{"s_w_id", 1}, {"s_i_id", i_id}});
+            int s_quantity = get<int>("stock", *stock, "s_quantity");
+            s_quantity = s_quantity >= quantity + 10 ? s_quantity - quantity : s_quantity - quantity + 91;
+            set(txn, "stock", stock->rid,
+                {{"s_quantity", int_value(s_quantity)},
+                 {"s_order_cnt", int_value(get<int>("stock", *stock, "s_order_cnt") + 1)}});
+            float amount = quantity * get<float>("item", *item, "i_price") * (1 + tax) * (1 - discount);
+            insert_row(txn, "order_line", {int_value(o_id), int_value(d_id), int_value(1), int_value(ol_number),
+                                           int_value(i_id), float_value(amount)});
+        }
+    }
+
+    // Payment：warehouse、district和customer的累计金额加上付款金额（col = col + amount），返回付款金额
+    int payment(Transaction *txn, std::mt19937 &rng) {
+        int d_id = rng() % NUM_DISTRICTS + 1, c_id = rng() % CUSTOMERS_PER_DISTRICT + 1, amount = rng() % 10 + 1;
+        add(txn, "warehouse", {{"w_id", 1}}, {{"w_ytd", float_value(amount)}});
+        add(txn, "district", {{"d_w_id", 1}, {"d_id", d_id}}, {{"d_ytd", float_value(amount)}});
+        add(txn, "customer", {{"c_w_id", 1}, {"c_d_id", d_id}, {"c_id", c_id}},
+            {{"c_balance", float_value(-amount)},
+             {"c_ytd_payment", float_value(amount)},
+             {"c_payment_cnt", int_value(1)}});
+        return amount;
+    }
+
+    // 已经分配的订单号个数、warehouse和所有district的累计付款金额，用于检查提交的事务没有丢失修改
+    struct Totals {
+        long long orders;
+        double w_ytd;
+        double d_ytd;
+    };
+
+    Totals totals() {
+        Totals totals{0, 0, 0};
+        Transaction *txn = begin();
+        totals.w_ytd = get<float>("warehouse", *lookup(txn, "warehouse", {{"w_id", 1}}), "w_ytd");
+        for (int d_id = 1; d_id <= NUM_DISTRICTS; d_id++) {
+            auto district = lookup(txn, "district", {{"d_w_id", 1}, {"d_id", d_id}});
+            totals.orders += get<int>("district", *district, "d_next_o_id");
+            totals.d_ytd += get<float>("district", *district, "d_ytd");
+        }
+        txn_manager_->commit(txn, nullptr);
+        return totals;
+    }
+
+    struct TpccResult {
+        double txns_per_sec;
+        double abort_rate;
+    };
+
+    /**
+     * 每个线程随机执行NewOrder（占new_order_percent%）和Payment，回滚的事务不重试。
+     * 最后检查分配的订单号个数等于提交的NewOrder个数，累计金额的增量等于提交的付款金额之和
+     */
+    TpccResult run_tpcc(int num_threads, std::chrono::milliseconds duration, int new_order_percent = 50,
+                        LogManager *log_manager = nullptr) {
+        auto before = totals();
+        std::atomic<long long> commits = 0, aborts = 0, new_orders = 0, paid = 0;
+        std::atomic<bool> stop = false;
+        auto worker = [&](int seed) {
+            std::mt19937 rng(seed);
+            while (!stop) {
+                bool is_new_order = (int)(rng() % 100) < new_order_percent;
+                int amount = 0;
+                Transaction *txn = begin();
+                try {
+                    if (is_new_order) {
+                        new_order(txn, rng);
+                    } else {
+                        amount = payment(txn, rng);
+                    }
+                    txn_manager_->commit(txn, log_manager);
+                } catch (TransactionAbortException &) {
+                    txn_manager_->abort(txn, log_manager);
+                    aborts++;
+                    continue;
+                }
+                commits++;
+                (is_new_order ? new_orders : paid) += is_new_order ? 1 : amount;
+            }
+        };
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_threads; i++) {
+            threads.emplace_back(worker, i);
+        }
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        auto after = totals();
+        EXPECT_EQ(after.orders - before.orders, new_orders);
+        EXPECT_EQ(after.w_ytd - before.w_ytd, paid);
+        EXPECT_EQ(after.d_ytd - before.d_ytd, paid);
+        return TpccResult{.txns_per_sec = commits / secs,
+                          .abort_rate = (double)aborts / std::max(1LL, commits + aborts)};
+    }
+};
+
+/**
+ * NewOrder和Payment各一半的负载下三种并发控制算法的吞吐量。自带的数据只有一个warehouse、三个district和十种商品，
+ * 几乎所有事务都会修改相同的几行：两阶段封锁在读写同一行时互相等待（wound-wait），MVCC和OCC遇到冲突时回滚
+ */
+TEST_F(TpccTxnTest, ConcurrencyModeBenchmark) {
+    const auto duration = std::chrono::milliseconds(300);
+    std::cout << "mode  threads    txns/s  abort rate" << std::endl;
+    for (auto mode : {ConcurrencyMode::TWO_PHASE_LOCKING, ConcurrencyMode::MVCC, ConcurrencyMode::OCC}) {
+        set_mode(mode, DeadlockPolicy::WOUND_WAIT);
+        for (int num_threads : {1, 2, 4, 8}) {
+            auto result = run_tpcc(num_threads, duration);
+            const char *name = mode == ConcurrencyMode::OCC ? "occ" : mode == ConcurrencyMode::MVCC ? "mvcc" : "2pl";
+            std::cout << std::left << std::setw(6) << name << std::right << std::setw(7) << num_threads
+                      << std::setw(10) << (long long)result.txns_per_sec << std::setw(12) << result.abort_rate
+                      << std::endl;
+            EXPECT_GT(result.txns_per_sec, 0);
+        }
+    }
+}
+
+/**
+ * 两阶段封锁下Payment的累计金额使用escrow锁与X锁的对比。Payment只做增量修改，escrow锁之间不冲突；
+ * NewOrder需要读取d_next_o_id再写回，并且读取warehouse和district，仍然与Payment的escrow锁冲突
+ */
+TEST_F(TpccTxnTest, EscrowBenchmark) {
+    const auto duration = std::chrono::milliseconds(300);
+    std::cout << "escrow  new_order%  threads    txns/s  abort rate" << std::endl;
+    // 订单表在各轮之间不断增长，NewOrder越来越慢，所以相同线程数下交替运行关闭和打开escrow的两轮
+    for (int new_order_percent : {0, 50}) {
+        for (int num_threads : {1, 2, 4, 8}) {
+            for (bool escrow : {false, true}) {
+                set_mode(ConcurrencyMode::TWO_PHASE_LOCKING, DeadlockPolicy::WOUND_WAIT);
+                txn_manager_->set_escrow_enabled(escrow);
+                auto result = run_tpcc(num_threads, duration, new_order_percent);
+                std::cout << std::left << std::setw(8) << (escrow ? "on" : "off") << std::right << std::setw(10)
+                          << new_order_percent << std::setw(9) << num_threads << std::setw(10)
+                          << (long long)result.txns_per_sec << std::setw(12) << result.abort_rate << std::endl;
+                EXPECT_GT(result.txns_per_sec, 0);
+            }
+        }
+    }
+}
+
+/**
+ * 提交日志需要fsync时，对比持有锁直到日志持久化与提前释放锁。关闭escrow锁，Payment在warehouse行上加X锁，
+ * 持有锁等待fsync时所有Payment串行执行；提前释放锁时等待fsync的事务不阻塞其他事务，多个提交日志一起刷盘
+ */
+TEST_F(TpccTxnTest, EarlyLockReleaseBenchmark) {
+    const auto duration = std::chrono::milliseconds(300);
+    if (!disk_manager->is_file(LOG_FILE_NAME)) {
+        disk_manager->create_file(LOG_FILE_NAME);
+    }
+    DiskManager log_disk;
+    {
+        // 本地磁盘上fsync的延迟
+        auto log_manager = std::make_unique<LogManager>(&log_disk);
+        const int num_syncs = 20;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_syncs; i++) {
+            CommitLogRecord commit_log(i);
+            log_manager->wait_for_durable(log_manager->add_log_to_buffer(&commit_log));
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << "fsync latency: " << elapsed.count() / num_syncs << " us" << std::endl;
+    }
+    std::cout << "elr  new_order%  threads    txns/s  abort rate" << std::endl;
+    for (int new_order_percent : {0, 50}) {
+        for (int num_threads : {1, 2, 4, 8}) {
+            for (bool early_lock_release : {false, true}) {
+                set_mode(ConcurrencyMode::TWO_PHASE_LOCKING, DeadlockPolicy::WOUND_WAIT);
+                txn_manager_->set_escrow_enabled(false);
+                txn_manager_->set_early_lock_release(early_lock_release);
+                auto log_manager = std::make_unique<LogManager>(&log_disk);
+                auto result = run_tpcc(num_threads, duration, new_order_percent, log_manager.get());
+                std::cout << std::left << std::setw(5) << (early_lock_release ? "on" : "off") << std::right
+                          << std::setw(10) << new_order_percent << std::setw(9) << num_threads << std::setw(10)
+                          << (long long)result.txns_per_sec << std::setw(12) << result.abort_rate << std::endl;
+                EXPECT_GT(result.txns_per_sec, 0);
+                EXPECT_EQ(lock_manager_->get_lock_table_size(), 0);
+            }
+        }
+    }
+}